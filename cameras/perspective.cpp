@@ -305,6 +305,38 @@ void PerspectiveCamera::ClampRay(Ray &ray) const
 	ray.maxt = min(ray.maxt, ClipYon / cosi);
 }
 
+float PerspectiveCamera::GenerateRay(const Scene &scene, const Sample &sample,
+	Ray *ray, float *x, float *y) const
+{
+	// Same ray as the one sampled through PerspectiveBSDF::SampleF,
+	// without the camera BSDF and the projection back to the screen,
+	// the sampled screen position is the requested one
+	// Don't transform directly in world coordinates
+	// this could cause accuracy issues with small hither and
+	// large translation
+	Vector d(RasterToCamera * Point(sample.imageX, sample.imageY, 0.f));
+	Point o(pos);
+	if (LensRadius > 0.f) {
+		Point pL(0.f);
+		SampleLens(sample.lensU, sample.lensV, &pL.x, &pL.y);
+		pL.x *= LensRadius;
+		pL.y *= LensRadius;
+		d -= Vector(pL) * (d.z / FocalDistance);
+		o = CameraToWorld * pL;
+	}
+
+	*ray = Ray(o, Normalize(CameraToWorld * d));
+	ray->time = sample.realTime;
+	const float cosi = Dot(ray->d, normal);
+	if (!(cosi > 0.f))
+		return 0.f;
+	ray->mint = max(ray->mint, ClipHither / cosi);
+	ray->maxt = min(ray->maxt, ClipYon / cosi);
+	*x = sample.imageX;
+	*y = sample.imageY;
+	return 1.f;
+}
+
 void PerspectiveCamera::SampleLens(float u1, float u2, float *dx, float *dy) const
 {
 	if (shape < 3) {
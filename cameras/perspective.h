@@ -51,6 +51,8 @@ public:
 	virtual bool GetSamplePosition(const Point &p, const Vector &wi,
 		float distance, float *x, float *y) const;
 	virtual void ClampRay(Ray &ray) const;
+	virtual float GenerateRay(const Scene &scene, const Sample &sample,
+		Ray *ray, float *x, float *y) const;
 	virtual bool IsDelta() const { return LensRadius == 0.f; }
 	virtual bool IsLensBased() const { return true; }
 	virtual BBox Bounds() const;
@@ -69,9 +69,11 @@ SET(lux_core_src
 	core/exrio.cpp
 	core/filedata.cpp
 	core/film.cpp
+	core/flmcodec.cpp
 	core/igiio.cpp
 	core/imagereader.cpp
 	core/light.cpp
+	core/majorantgrid.cpp
 	core/material.cpp
 	core/mc.cpp
 	core/motionsystem.cpp
@@ -80,6 +82,7 @@ SET(lux_core_src
 	core/photonmap.cpp
 	core/pngio.cpp
 	core/primitive.cpp
+	core/profiler.cpp
 	core/rendererstatistics.cpp
 	core/renderfarm.cpp
 	core/renderinghints.cpp
@@ -90,6 +93,7 @@ SET(lux_core_src
 	core/spectrum.cpp
 	core/spectrumwavelengths.cpp
 	core/texture.cpp
+	core/texturebake.cpp
 	core/tgaio.cpp
 	core/timer.cpp
 	core/tigerhash.cpp
@@ -290,6 +294,7 @@ SET(lux_samplers_src
 	samplers/lowdiscrepancy.cpp
 	samplers/metrosampler.cpp
 	samplers/random.cpp
+	samplers/sobol.cpp
 	)
 SOURCE_GROUP("Source Files\\Samplers" FILES ${lux_samplers_src})
 
@@ -496,24 +501,29 @@ SET(lux_core_hdr
 	core/fastmutex.h
 	core/filedata.h
 	core/film.h
+	core/flmcodec.h
 	core/filter.h
 	core/igiio.h
 	core/imagereader.h
 	core/kdtree.h
 	core/light.h
 	core/lux.h
+	core/majorantgrid.h
 	core/material.h
 	core/mc.h
 	core/mcdistribution.h
 	core/memory.h
 	core/mipmap.h
 	core/motionsystem.h
+	core/netprotocol.h
 	core/octree.h
 	core/osfunc.h
+	core/parallel.h
 	core/paramset.h
 	core/photonmap.h
 	core/pngio.h
 	core/primitive.h
+	core/profiler.h
 	core/randomgen.h
 	core/renderer.h
 	core/rendererstatistics.h
@@ -527,6 +537,7 @@ SET(lux_core_hdr
 	core/spectrumwavelengths.h
 	core/streamio.h
 	core/texture.h
+	core/texturebake.h
 	core/texturecolor.h
 	core/tgaio.h
 	core/timer.h
@@ -738,6 +749,7 @@ SET(lux_samplers_hdr
 	samplers/lowdiscrepancy.h
 	samplers/metrosampler.h
 	samplers/random.h
+	samplers/sobol.h
 	)
 SOURCE_GROUP("Header Files\\Samplers" FILES ${lux_samplers_hdr})
 SET(lux_shapes_hdr
@@ -79,6 +79,7 @@ bool ProcessCommandLine(int argc, char **argv, clConfig& config, unsigned int fe
 			if (!(features & featureSet::INTERACTIVE))
 				optStandalone.add_options()
 					("bindump,b",        "Dump binary RGB framebuffer to stdout when finished")
+					("scaling,S",        po::value< unsigned int >(), "Render each scene for the specified number of seconds with 1, 2, 4... threads up to the thread count and print a scaling report")
 					;
 		}
 
@@ -237,9 +238,13 @@ bool ProcessCommandLine(int argc, char **argv, clConfig& config, unsigned int fe
 			luxEnableDebugMode();
 		}
 
-		if (vm.count("threads"))
+		if (vm.count("threads")) {
 			config.threadCount = vm["threads"].as<unsigned int>();
-		else
+			if (config.threadCount < 1) {
+				warn << "The number of threads must be at least 1";
+				return false;
+			}
+		} else
 			config.threadCount = std::max<unsigned int>(1, boost::thread::hardware_concurrency());
 		LOG(LUX_INFO,LUX_NOERROR) << "Threads: " << config.threadCount;
 
@@ -332,6 +337,9 @@ bool ProcessCommandLine(int argc, char **argv, clConfig& config, unsigned int fe
 
 			if (vm.count("bindump"))
 				config.binDump = true;
+
+			if (vm.count("scaling"))
+				config.scalingTime = std::max(1U, vm["scaling"].as<unsigned int>());
 		// END Handling standalone and standalone / master node options
 
 		// BEGIN Handling slave node options
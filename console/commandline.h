@@ -38,7 +38,8 @@ struct clConfig
 	clConfig() :
 		slave(false), binDump(false), log2console(false), writeFlmFile(false),
 		verbosity(0), pollInterval(luxGetIntAttribute("render_farm", "pollingInterval")),
-		tcpPort(luxGetIntAttribute("render_farm", "defaultTcpPort")), threadCount(0) {};
+		tcpPort(luxGetIntAttribute("render_farm", "defaultTcpPort")), threadCount(0),
+		scalingTime(0) {};
 
 	boost::program_options::variables_map vm;
 
@@ -51,6 +52,7 @@ struct clConfig
 	unsigned int pollInterval;
 	unsigned int tcpPort;
 	unsigned int threadCount;
+	unsigned int scalingTime; // 0 unless a thread scaling report is requested
 	std::string password;
 	std::string cacheDir;
 	std::vector< std::string > queueFiles;
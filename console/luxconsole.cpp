@@ -21,6 +21,7 @@
  ***************************************************************************/
 
 #include <exception>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -80,6 +81,109 @@ void addNetworkSlavesThread(std::vector<std::string> slaves) {
 	}
 }
 
+struct ScalingRun {
+	unsigned int threads;
+	double samplesPerSecond, contributionsPerSecond, lockWait;
+};
+
+enum ScalingStatus { SCALING_DONE, SCALING_PARSE_ERROR, SCALING_TIMEOUT };
+
+// Longest wait for the renderer to start its first thread, in milliseconds
+static const unsigned int scalingStartTimeout = 60000;
+
+// Renders the current scene once with the given number of threads and
+// measures it for the given time after a warm up
+ScalingStatus scalingRun(unsigned int threads, unsigned int seconds, ScalingRun &run) {
+	// Same random sequences for all runs
+	luxDisableRandomMode();
+
+	parseError = false;
+	boost::thread engine(&engineThread);
+	while (!luxStatistics("sceneIsReady") && !parseError)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+	if (parseError) {
+		engine.join();
+		return SCALING_PARSE_ERROR;
+	}
+
+	// The renderer starts its first thread after the scene is ready
+	for (unsigned int waited = 0; luxGetIntAttribute("renderer_statistics", "threadCount") < 1; waited += 10) {
+		if (waited >= scalingStartTimeout) {
+			LOG(LUX_SEVERE,LUX_SYSTEM) << "The renderer didn't start within " << scalingStartTimeout / 1000 << " seconds, aborting the scaling report";
+			// The renderer may never answer, don't wait for it
+			luxExit();
+			engine.detach();
+			return SCALING_TIMEOUT;
+		}
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+	}
+	for (unsigned int i = 1; i < threads; ++i)
+		luxAddThread();
+
+	boost::this_thread::sleep(boost::posix_time::milliseconds(250 * seconds));
+
+	const double samples = luxGetDoubleAttribute("film", "numberOfLocalSamples");
+	const double contributions = luxGetDoubleAttribute("film", "splattedContributions");
+	const double lockWait = luxGetDoubleAttribute("film", "splattingLockWait");
+	const boost::posix_time::ptime start(boost::posix_time::microsec_clock::universal_time());
+	boost::this_thread::sleep(boost::posix_time::seconds(seconds));
+	const double elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+
+	run.threads = threads;
+	run.samplesPerSecond = (luxGetDoubleAttribute("film", "numberOfLocalSamples") - samples) / elapsed;
+	run.contributionsPerSecond = (luxGetDoubleAttribute("film", "splattedContributions") - contributions) / elapsed;
+	// Fraction of the thread time spent waiting
+	run.lockWait = (luxGetDoubleAttribute("film", "splattingLockWait") - lockWait) / (elapsed * threads);
+
+	luxExit();
+	luxWait();
+	engine.join();
+	luxCleanup();
+	return SCALING_DONE;
+}
+
+// Renders the current scene with 1, 2, 4... threads up to the thread count
+// and prints how the throughput scales, returns false if the renderer
+// couldn't be started
+bool scalingReport(const clConfig &config) {
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int t = 1; t < config.threadCount; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(config.threadCount);
+
+	std::vector<ScalingRun> runs;
+	for (std::vector<unsigned int>::iterator it = threadCounts.begin(); it < threadCounts.end(); it++) {
+		LOG(LUX_INFO,LUX_NOERROR) << "Scaling run with " << *it << " threads";
+		ScalingRun run;
+		const ScalingStatus status = scalingRun(*it, config.scalingTime, run);
+		if (status == SCALING_TIMEOUT)
+			return false;
+		if (status == SCALING_PARSE_ERROR) {
+			LOG(LUX_SEVERE,LUX_BADFILE) << "Skipping invalid scenefile '" << sceneFileName << "'";
+			return true;
+		}
+		runs.push_back(run);
+	}
+
+	const double base = runs[0].samplesPerSecond / runs[0].threads;
+	std::cout << "Thread scaling of '" << sceneFileName << "' (" << config.scalingTime << "s per run)" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "samples/s" <<
+		std::setw(16) << "contribs/s" << std::setw(10) << "speedup" <<
+		std::setw(12) << "efficiency" << std::setw(12) << "lock wait" << std::endl;
+	std::cout << std::fixed;
+	for (std::vector<ScalingRun>::iterator it = runs.begin(); it < runs.end(); it++) {
+		const double speedup = base > 0. ? it->samplesPerSecond / base : 0.;
+		std::cout << std::setw(8) << it->threads <<
+			std::setprecision(0) << std::setw(14) << it->samplesPerSecond <<
+			std::setw(16) << it->contributionsPerSecond <<
+			std::setprecision(2) << std::setw(10) << speedup <<
+			std::setprecision(1) << std::setw(11) << 100. * speedup / it->threads << "%" <<
+			std::setw(11) << 100. * it->lockWait << "%" << std::endl;
+	}
+	std::cout.unsetf(std::ios_base::floatfield);
+	return true;
+}
+
 LuxErrorHandler prevErrorHandler;
 
 void serverErrorHandler(int code, int severity, const char *msg) {
@@ -146,6 +250,14 @@ int main(int argc, char **argv) {
 			} else
 				LOG(LUX_INFO,LUX_NOERROR) << "Loading piped scene...";
 
+			if (config.scalingTime > 0) {
+				if (sceneFileName == "-")
+					LOG(LUX_ERROR,LUX_NOFILE) << "The scaling report needs a scene file, skipping piped scene";
+				else if (!scalingReport(config))
+					return 1;
+				continue;
+			}
+
 			parseError = false;
 			boost::thread engine(&engineThread);
 
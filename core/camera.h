@@ -71,6 +71,8 @@ public:
 	 * This interface is no longer the prefered way to sample a ray,
 	 * you should instead use SampleW to sample the ray origin and use
 	 * the returned BSDF to sample the ray direction.
+	 * Camera models can override it to generate the ray without going
+	 * through SampleW and the camera BSDF.
 	 *
 	 * @param scene The current scene being rendered
 	 * @param sample The sample to be used to generate the ray
@@ -79,7 +81,7 @@ public:
 	 * @param y The sampled y position on screen in pixels
 	 * @return he ray weighting
 	 */
-	float GenerateRay(const Scene &scene, const Sample &sample,
+	virtual float GenerateRay(const Scene &scene, const Sample &sample,
 		Ray *ray, float *x, float *y) const;
 	/**
 	 * Samples the origin of a ray.
@@ -34,10 +34,12 @@
 #include "volume.h"
 #include "material.h"
 #include "renderfarm.h"
+#include "profiler.h"
 #include "film/fleximage.h"
 #include "luxrays/core/epsilon.h"
 using luxrays::MachineEpsilon;
 #include "renderers/samplerrenderer.h"
+#include "renderers/sppmrenderer.h"
 
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
@@ -136,6 +138,7 @@ void Context::Init() {
 	pushedGraphicsStates.clear();
 	pushedTransforms.clear();
 	renderFarm = new RenderFarm();
+	profiler = CreateProfiler();
 	filmOverrideParams = NULL;
 	shapeNo = 0;
 }
@@ -158,6 +161,9 @@ void Context::Free() {
 	delete renderFarm;
 	renderFarm = NULL;
 
+	delete profiler;
+	profiler = NULL;
+
 	delete filmOverrideParams;
 	filmOverrideParams = NULL;
 }
@@ -1026,6 +1032,22 @@ void Context::WorldEnd() {
 				renderFarm->start(luxCurrentScene);
 
 				luxCurrentRenderer->Render(luxCurrentScene);
+#ifdef LUX_PROFILER
+				Queryable &p(*profiler);
+				LOG(LUX_INFO, LUX_NOERROR) << "Profile (thread seconds): sampler " <<
+					p["samplerTime"].DoubleValue() << ", integrator " <<
+					p["integratorTime"].DoubleValue() << ", intersect " <<
+					p["intersectTime"].DoubleValue() << ", material " <<
+					p["materialTime"].DoubleValue() << ", texture " <<
+					p["textureTime"].DoubleValue() << ", light sampling " <<
+					p["lightSamplingTime"].DoubleValue() << ", splat " <<
+					p["splatTime"].DoubleValue();
+				LOG(LUX_INFO, LUX_NOERROR) << "Profile: " <<
+					p["pathRays"].DoubleValue() << " path rays, " <<
+					p["shadowRays"].DoubleValue() << " shadow rays, " <<
+					p["traversedRays"].DoubleValue() << " traversals, " <<
+					p["arenaBytes"].DoubleValue() << " arena bytes";
+#endif
 
 				// Signal that rendering is done, so any slaves connected
 				// after this won't start rendering
@@ -1223,10 +1245,11 @@ void Context::Abort() {
 
 //controlling number of threads
 u_int Context::AddThread() {
-	if (dynamic_cast<SamplerRenderer *>(luxCurrentRenderer)) {
+	if (dynamic_cast<SamplerRenderer *>(luxCurrentRenderer) ||
+		dynamic_cast<SPPMRenderer *>(luxCurrentRenderer)) {
 		const vector<RendererHostDescription *> &hosts = luxCurrentRenderer->GetHostDescs();
 
-		SRDeviceDescription *desc = (SRDeviceDescription *)hosts[0]->GetDeviceDescs()[0];
+		RendererDeviceDescription *desc = hosts[0]->GetDeviceDescs()[0];
 		desc->SetUsedUnitsCount(desc->GetUsedUnitsCount() + 1);
 
 		return desc->GetUsedUnitsCount();
@@ -1235,10 +1258,11 @@ u_int Context::AddThread() {
 }
 
 void Context::RemoveThread() {
-	if (dynamic_cast<SamplerRenderer *>(luxCurrentRenderer)) {
+	if (dynamic_cast<SamplerRenderer *>(luxCurrentRenderer) ||
+		dynamic_cast<SPPMRenderer *>(luxCurrentRenderer)) {
 		const vector<RendererHostDescription *> &hosts = luxCurrentRenderer->GetHostDescs();
 
-		SRDeviceDescription *desc = (SRDeviceDescription *)hosts[0]->GetDeviceDescs()[0];
+		RendererDeviceDescription *desc = hosts[0]->GetDeviceDescs()[0];
 		desc->SetUsedUnitsCount(max(desc->GetUsedUnitsCount() - 1, 1u));
 	}
 }
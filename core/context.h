@@ -323,6 +323,8 @@ private:
 	vector<GraphicsState> pushedGraphicsStates;
 	vector<lux::MotionTransform> pushedTransforms;
 	RenderFarm *renderFarm;
+	// "profiler" Queryable object, see profiler.h
+	Queryable *profiler;
 
 	ParamSet *filmOverrideParams;
 	
@@ -24,13 +24,15 @@
 #include "lux.h"
 #include "contribution.h"
 #include "film.h"
+#include "error.h"
+#include "profiler.h"
 
 #include <boost/thread/locks.hpp>
 
 namespace lux
 {
 
-ContributionBuffer::Buffer::Buffer() : pos(0) {
+ContributionBuffer::Buffer::Buffer(u_int n) : pos(0), node(n) {
 	contribs = AllocAligned<Contribution>(CONTRIB_BUF_SIZE);
 }
 
@@ -39,22 +41,25 @@ ContributionBuffer::Buffer::~Buffer() {
 }
 
 
-void ContributionBuffer::Buffer::Splat(Film *film, u_int tileIndex)
+u_int ContributionBuffer::Buffer::Splat(Film *film, u_int tileIndex)
 {
 	const u_int num_contribs = min(pos, CONTRIB_BUF_SIZE);
+	PROFILE_COUNT(PROF_CONTRIBUTIONS, num_contribs);
 	film->AddTileSamples(contribs, num_contribs, tileIndex);
 	pos = 0;
+	return num_contribs;
 }
 
-ContributionBuffer::ContributionBuffer(ContributionPool *p) :
-	sampleCount(0.f), pool(p)
+ContributionBuffer::ContributionBuffer(ContributionPool *p, u_int n) :
+	sampleCount(0.f), pool(p), node(n)
 {
+	// The buffers are only taken from the pool on the first contribution
+	// to their tile, with many film tiles a thread often uses a few
 	buffers.resize(pool->CFull.size());
-	for (u_int i = 0; i < buffers.size(); ++i) {
-		buffers[i].resize(pool->CFull[i].size());
-		for (u_int j = 0; j < buffers[i].size(); ++j)
-			buffers[i][j] = new Buffer();
-	}
+	for (u_int i = 0; i < buffers.size(); ++i)
+		buffers[i].resize(pool->CFull[i].size(), NULL);
+	fast_mutex::scoped_lock poolAction(pool->poolMutex);
+	++pool->contributionBuffers;
 }
 
 ContributionBuffer::~ContributionBuffer()
@@ -71,7 +76,9 @@ void ScopedPoolLock::unlock() {
 	lock.unlock();
 }
 
-ContributionPool::ContributionPool(Film *f) : sampleCount(0.f), film(f)
+ContributionPool::ContributionPool(Film *f) : sampleCount(0.f),
+	splattingMisses(0), contributionBuffers(0), allocatedBuffers(0),
+	splattedContributions(0.), lockWaitTime(0.), film(f)
 {
 	CFull.resize(film->GetTileCount());
 	for (u_int i = 0; i < CFull.size(); ++i)
@@ -79,8 +86,10 @@ ContributionPool::ContributionPool(Film *f) : sampleCount(0.f), film(f)
 	for (u_int i = 0; i < CFull.size(); ++i)
 		tileSplattingMutexes.push_back(new tile_mutex);
 	splattingTile.resize(CFull.size());
+	CFree.resize(1);
 	for (u_int total = 0; total < CONTRIB_BUF_KEEPALIVE; ++total) {
-		CFree.push_back(new ContributionBuffer::Buffer());
+		CFree[0].push_back(new ContributionBuffer::Buffer());
+		++allocatedBuffers;
 	}
 }
 
@@ -92,23 +101,47 @@ void ContributionPool::End(ContributionBuffer *c)
 	fast_mutex::scoped_lock poolAction(poolMutex);
 
 	for (u_int i = 0; i < c->buffers.size(); ++i) {
-		for (u_int j = 0; j < c->buffers[i].size(); ++j)
-			CFull[i][j].push_back(c->buffers[i][j]);
+		for (u_int j = 0; j < c->buffers[i].size(); ++j) {
+			if (c->buffers[i][j])
+				CFull[i][j].push_back(c->buffers[i][j]);
+		}
 	}
 	sampleCount = c->sampleCount;
 	c->sampleCount = 0.f;
+	--contributionBuffers;
 
 	// Any splatting not done by other threads 
 	// will be done in Flush.
 }
 
+void ContributionPool::Get(ContributionBuffer::Buffer* volatile *b, u_int node)
+{
+	fast_mutex::scoped_lock poolAction(poolMutex);
+
+	// Another thread may have set the buffer while we waited for the lock
+	if (*b)
+		return;
+	if (node < CFree.size() && !CFree[node].empty()) {
+		*b = CFree[node].back();
+		CFree[node].pop_back();
+		return;
+	}
+	*b = new ContributionBuffer::Buffer(node);
+	++allocatedBuffers;
+}
+
 void ContributionPool::Next(ContributionBuffer::Buffer* volatile *b, float *sc,
-	u_int tileIndex, u_int bufferGroup)
+	u_int tileIndex, u_int bufferGroup, u_int node)
 {
+	PROFILE_SCOPE(PROF_SPLAT);
 	// store the current Buffer pointer for later comparison
 	ContributionBuffer::Buffer* const buf = *b;
 
+	// The waits for the locks are timed, this is called once for
+	// CONTRIB_BUF_SIZE contributions so the cost of the clock is negligible
+	double lockStart = osWallClockTime();
 	fast_mutex::scoped_lock pool_lock(poolMutex);
+	lockWaitTime += osWallClockTime() - lockStart;
 
 	// If the Buffer* pointed to by b has changed
 	// while we waited for the lock then another thread 
@@ -118,6 +151,9 @@ void ContributionPool::Next(ContributionBuffer::Buffer* volatile *b, float *sc,
 		return;
 
 	vector<vector<ContributionBuffer::Buffer*> > &full_buffers(CFull[tileIndex]);
+	if (node >= CFree.size())
+		CFree.resize(node + 1);
+	vector<ContributionBuffer::Buffer*> &free_buffers(CFree[node]);
 
 	// Accumulate sample count and reset the ContributionBuffer's count.
 	sampleCount += *sc;
@@ -130,22 +166,22 @@ void ContributionPool::Next(ContributionBuffer::Buffer* volatile *b, float *sc,
 	if (isSplattingTile > 0) {
 		// Another thread is splatting this tile, so
 		// get a free buffer
-		if (!CFree.empty()) {
-			*b = CFree.back();
-			CFree.pop_back();
+		if (!free_buffers.empty()) {
+			*b = free_buffers.back();
+			free_buffers.pop_back();
 			return;
 		}
 		// No free buffers, try allocating a new one
 		// but make sure we don't allocate too many new buffers.
-		const u_int maxBufferMisses = CFull.size() * 32; // TODO less arbitrary limit
-		u_int bufferMisses = ++splattingMisses;
-		if (bufferMisses < maxBufferMisses) {
-			*b = new ContributionBuffer::Buffer();
+		// The limit depends on the number of threads adding
+		// contributions, not on the number of tiles, so that
+		// small tiles don't let the pool grow without bound
+		const u_int maxBufferMisses = max(contributionBuffers, 1U) * 32;
+		if (splattingMisses < maxBufferMisses) {
+			++splattingMisses;
+			*b = new ContributionBuffer::Buffer(node);
+			++allocatedBuffers;
 			return;
-		} 
-		if (bufferMisses > 1000000) {
-			// reset to avoid overflow
-			splattingMisses = maxBufferMisses;
 		}
 	}
 
@@ -166,7 +202,9 @@ void ContributionPool::Next(ContributionBuffer::Buffer* volatile *b, float *sc,
 	// until CFree is filled with free buffers again.
 	// This prevents a thread from trying to splat
 	// prematurely.
+	lockStart = osWallClockTime();
 	boost::mutex::scoped_lock main_splatting_lock(mainSplattingMutex);
+	double lockWait = osWallClockTime() - lockStart;
 
 	const float count = sampleCount;
 	sampleCount = 0.f;
@@ -176,30 +214,51 @@ void ContributionPool::Next(ContributionBuffer::Buffer* volatile *b, float *sc,
 
 	film->AddSampleCount(count);
 
+	u_int splatted = 0;
 	{
 		// aquire tile splatting lock
+		lockStart = osWallClockTime();
 		tile_mutex::scoped_lock tile_splatting_lock(tileSplattingMutexes[tileIndex]);
+		lockWait += osWallClockTime() - lockStart;
 
 		// release main splatting lock
 		main_splatting_lock.unlock();
 
 		for(u_int i = 0; i < splat_buffers.size(); ++i)
-			splat_buffers[i]->Splat(film, tileIndex);
+			splatted += splat_buffers[i]->Splat(film, tileIndex);
 
 		// indicate we're done splatting this tile
 		osAtomicWrite(&splattingTile[tileIndex], 0);
 	}
 
-	// get buffer from the now free buffers
-	*b = splat_buffers.back();
+	// get buffer from the now free buffers, preferably one of our node
+	u_int mine = splat_buffers.size() - 1;
+	for (u_int i = 0; i < splat_buffers.size(); ++i) {
+		if (splat_buffers[i]->GetNode() == node) {
+			mine = i;
+			break;
+		}
+	}
+	*b = splat_buffers[mine];
+	splat_buffers[mine] = splat_buffers.back();
 	splat_buffers.pop_back();
 
 	{
 		// reaquire pool lock
+		lockStart = osWallClockTime();
 		fast_mutex::scoped_lock pool_lock_end(poolMutex);
+		lockWait += osWallClockTime() - lockStart;
 
 		// put splatted buffers back
-		CFree.insert(CFree.end(), splat_buffers.begin(), splat_buffers.end());
+		for (u_int i = 0; i < splat_buffers.size(); ++i) {
+			const u_int bufNode = splat_buffers[i]->GetNode();
+			if (bufNode >= CFree.size())
+				CFree.resize(bufNode + 1);
+			CFree[bufNode].push_back(splat_buffers[i]);
+		}
+
+		splattedContributions += splatted;
+		lockWaitTime += lockWait;
 	}
 }
 
@@ -207,10 +266,13 @@ void ContributionPool::Flush()
 {
 	for (u_int tileIndex = 0; tileIndex < CFull.size(); ++tileIndex) {
 		for (u_int j = 0; j < CFull[tileIndex].size(); ++j) {
-			for (u_int k = 0; k < CFull[tileIndex][j].size(); ++k)
-				CFull[tileIndex][j][k]->Splat(film, tileIndex);
-			CFree.insert(CFree.end(),
-				CFull[tileIndex][j].begin(), CFull[tileIndex][j].end());
+			for (u_int k = 0; k < CFull[tileIndex][j].size(); ++k) {
+				ContributionBuffer::Buffer *buf = CFull[tileIndex][j][k];
+				splattedContributions += buf->Splat(film, tileIndex);
+				if (buf->GetNode() >= CFree.size())
+					CFree.resize(buf->GetNode() + 1);
+				CFree[buf->GetNode()].push_back(buf);
+			}
 			CFull[tileIndex][j].clear();
 		}
 	}
@@ -219,13 +281,27 @@ void ContributionPool::Flush()
 void ContributionPool::Delete()
 {
 	Flush();
+	LOG(LUX_DEBUG, LUX_NOERROR) << "Contribution buffers allocated: " <<
+		allocatedBuffers << " (" << allocatedBuffers *
+		CONTRIB_BUF_SIZE * sizeof(Contribution) / (1024 * 1024) << "MB)";
 	// At this point CFull doesn't hold any buffer
-	for(u_int i = 0; i < CFree.size(); ++i)
-		delete CFree[i];
+	for (u_int i = 0; i < CFree.size(); ++i) {
+		for (u_int j = 0; j < CFree[i].size(); ++j)
+			delete CFree[i][j];
+		CFree[i].clear();
+	}
+}
+
+void ContributionPool::GetStatistics(double *splatted, double *lockWait)
+{
+	fast_mutex::scoped_lock poolAction(poolMutex);
+
+	*splatted = splattedContributions;
+	*lockWait = lockWaitTime;
 }
 
-u_int ContributionPool::GetFilmTileIndexes(const Contribution &contrib, u_int *tileIndex0, u_int *tileIndex1) const {
-	return film->GetTileIndexes(contrib, tileIndex0, tileIndex1);
+u_int ContributionPool::GetFilmTileIndexes(const Contribution &contrib, u_int *tileIndexes) const {
+	return film->GetTileIndexes(contrib, tileIndexes);
 }
 
 }
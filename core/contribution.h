@@ -69,7 +69,8 @@ class ContributionBuffer {
 	friend class ContributionPool;
 	class Buffer {
 	public:
-		Buffer();
+		// node is the NUMA node of the threads filling the buffer
+		Buffer(u_int node = 0);
 		~Buffer();
 
 		// Thread-safe way of adding a contribution to a buffer
@@ -87,14 +88,22 @@ class ContributionBuffer {
 			return true;
 		}
 
-		void Splat(Film *film, u_int tileIndex);
+		// Returns the number of contributions splatted
+		u_int Splat(Film *film, u_int tileIndex);
+
+		u_int GetNode() const { return node; }
 
 	private:
 		u_int pos;
+		u_int node;
 		Contribution *contribs;
 	};
 public:
-	ContributionBuffer(ContributionPool *p);
+	/**
+	 * @param node NUMA node of the thread using the buffer, the pool
+	 * hands it empty buffers first used on the same node
+	 */
+	ContributionBuffer(ContributionPool *p, u_int node = 0);
 
 	~ContributionBuffer();
 
@@ -108,6 +117,7 @@ private:
 	float sampleCount;
 	vector<vector<Buffer *> > buffers;
 	ContributionPool *pool;
+	u_int node;
 };
 
 class ScopedPoolLock : public boost::noncopyable {
@@ -147,9 +157,21 @@ public:
 	 * accumulated to in the Film.
 	 *
 	 * @param bufferGroup The buffer group that the contributions in the Buffer belongs to.
+	 *
+	 * @param node NUMA node of the calling thread.
 	 */
 	void Next(ContributionBuffer::Buffer* volatile *b, float *sc, u_int tileIndex,
-		u_int bufferGroup);
+		u_int bufferGroup, u_int node);
+
+	/*
+	 * Sets a missing Buffer pointer to an empty Buffer, taken from the free
+	 * buffers of the node or newly allocated. This method is thread-safe.
+	 *
+	 * @param b Pointer to a NULL Buffer pointer.
+	 *
+	 * @param node NUMA node of the calling thread.
+	 */
+	void Get(ContributionBuffer::Buffer* volatile *b, u_int node);
 
 	// Flush() and Delete() are not thread safe,
 	// they can only be called by Scene after rendering is finished.
@@ -162,22 +184,37 @@ public:
 
 	/**
 	 * Get the indexes that the current contribution spans.
-	 * Current implementation is limited to at most two tiles, ie the tiles are slabs.
-	 * @param tileIndex0 First tile index, always set.
-	 * @param tileIndex1 Second tile index if the contribution spans more than one tile, otherwise undefined.
-	 * @return Number of tiles that the contribution spans, 1 or 2.
+	 * @param tileIndexes Array of at least 4 elements receiving the tile indexes.
+	 * @return Number of tiles that the contribution spans, 1 to 4.
 	 */
-	u_int GetFilmTileIndexes(const Contribution &contrib, u_int *tileIndex0, u_int *tileIndex1) const;
+	u_int GetFilmTileIndexes(const Contribution &contrib, u_int *tileIndexes) const;
+
+	/**
+	 * Get the splatting statistics since the creation of the pool.
+	 * @param splatted Number of contributions splatted to the film.
+	 * @param lockWait Time spent by the threads waiting for the pool and
+	 * splatting locks, in seconds. Several threads waiting at the same
+	 * time all count.
+	 */
+	void GetStatistics(double *splatted, double *lockWait);
 
 private:
 	typedef boost::mutex tile_mutex;
 	//typedef fast_mutex tile_mutex;
 
 	float sampleCount;
-	vector<ContributionBuffer::Buffer*> CFree; // Emptied/available buffers
+	// Emptied/available buffers, by the NUMA node they were first used on
+	vector<vector<ContributionBuffer::Buffer*> > CFree;
 	vector<vector<vector<ContributionBuffer::Buffer*> > > CFull; // Full buffers
 	vector<u_int> splattingTile;
+	// Buffers allocated because the tile was being splatted, bounded
+	// by a multiple of contributionBuffers, protected by poolMutex
 	u_int splattingMisses;
+	// Number of live ContributionBuffers and of allocated Buffers,
+	// protected by poolMutex
+	u_int contributionBuffers, allocatedBuffers;
+	// Statistics, protected by poolMutex
+	double splattedContributions, lockWaitTime;
 
 	Film *film;
 	fast_mutex poolMutex;
@@ -187,14 +224,15 @@ private:
 
 inline void ContributionBuffer::Add(const Contribution &c, float weight)
 {
-
-	u_int tileIndex0, tileIndex1;
+	u_int tileIndexes[4];
 	// Add the contribution to each tile that it spans.
-	u_int num_tiles = pool->GetFilmTileIndexes(c, &tileIndex0, &tileIndex1);
+	const u_int num_tiles = pool->GetFilmTileIndexes(c, tileIndexes);
 
-	//if (num_tiles > 0) is always true
-	{
-		Buffer* volatile* const buf = &(buffers[tileIndex0][c.bufferGroup]);
+	for (u_int t = 0; t < num_tiles; ++t) {
+		const u_int tileIndex = tileIndexes[t];
+		Buffer* volatile* const buf = &(buffers[tileIndex][c.bufferGroup]);
+		if (!*buf)
+			pool->Get(buf, node);
 		u_int i = 0;
 		// Try adding contribution to the active buffer
 		// if the buffer is full, try to get a fresh buffer.
@@ -204,22 +242,13 @@ inline void ContributionBuffer::Add(const Contribution &c, float weight)
 			// Get an empty buffer from the pool.
 			// Next() will reset sampleCount if current thread 
 			// swaps buffers.
-			pool->Next(buf, &sampleCount, tileIndex0, c.bufferGroup);
+			pool->Next(buf, &sampleCount, tileIndex, c.bufferGroup, node);
 			// Another thread may have swapped buf before we managed to.
 			// Technically there's a chance we waited so long for the lock
 			// in Next() that the buffer we got back has already been filled
 			// thus we try to Add() again in a loop just to be sure.
 		}
 	}
-
-	if (num_tiles > 1) {		
-		Buffer* volatile* const buf = &(buffers[tileIndex1][c.bufferGroup]);
-		u_int i = 0;
-		while (!((*buf)->Add(c, weight)) && (i++ < 10)) {
-			pool->Next(buf, &sampleCount, tileIndex1, c.bufferGroup);
-		}
-	}
-
 }
 
 }//namespace lux
@@ -29,6 +29,7 @@
 #include "shape.h"
 #include "material.h"
 #include "texture.h"
+#include "texturebake.h"
 #include "volume.h"
 
 namespace lux {
@@ -74,6 +75,7 @@ boost::shared_ptr<Texture<float> > MakeFloatTexture(const string &name,
 	if (DynamicLoader::registeredFloatTextures().find(name) !=
 		DynamicLoader::registeredFloatTextures().end()) {
 		boost::shared_ptr<Texture<float> > ret(DynamicLoader::registeredFloatTextures()[name](tex2world, tp));
+		ret = BakeFloatTexture(ret, tp);
 		tp.ReportUnused();
 		return ret;
 	}
@@ -33,14 +33,18 @@
 #include "osfunc.h"
 #include "streamio.h"
 #include "exrio.h"
+#include "parallel.h"
 
 #include <algorithm>
 #include <fstream>
+#include <map>
+#include <new>
 
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread.hpp>
 #include <boost/math/special_functions/bessel.hpp>
@@ -792,6 +796,65 @@ FilterLUTs::FilterLUTs(Filter *filter, const unsigned int size) {
 	}
 }
 
+// SparsePixelArray Definitions
+const Pixel SparsePixelArray::black;
+
+SparsePixelArray::SparsePixelArray(u_int x, u_int y) : uRes(x), vRes(y),
+	uPages((x + pageSize - 1) >> logPageSize),
+	pageCount(uPages * ((y + pageSize - 1) >> logPageSize))
+{
+	pages = new Pixel *[pageCount];
+	for (u_int i = 0; i < pageCount; ++i)
+		pages[i] = NULL;
+}
+
+SparsePixelArray::~SparsePixelArray()
+{
+	for (u_int i = 0; i < pageCount; ++i)
+		FreeAligned(pages[i]);
+	delete[] pages;
+}
+
+Pixel *SparsePixelArray::AllocatePage(u_int index)
+{
+	boost::mutex::scoped_lock lock(allocationMutex);
+	// Another thread may have allocated the page while we waited
+	Pixel *page = osAtomicReadPointer(&pages[index]);
+	if (!page) {
+		page = AllocAligned<Pixel>(pageSize * pageSize);
+		if (!page) {
+			LOG(LUX_SEVERE, LUX_NOMEM) << "Couldn't allocate film buffer pixels";
+			throw std::bad_alloc();
+		}
+		for (u_int i = 0; i < pageSize * pageSize; ++i)
+			new (&page[i]) Pixel();
+		// The pixels must be constructed before other threads see the page
+		osAtomicWritePointer(&pages[index], page);
+	}
+	return page;
+}
+
+void SparsePixelArray::Clear()
+{
+	for (u_int i = 0; i < pageCount; ++i) {
+		Pixel *page = osAtomicReadPointer(&pages[i]);
+		if (!page)
+			continue;
+		for (u_int j = 0; j < pageSize * pageSize; ++j)
+			page[j] = Pixel();
+	}
+}
+
+size_t SparsePixelArray::GetAllocatedBytes() const
+{
+	size_t count = 0;
+	for (u_int i = 0; i < pageCount; ++i) {
+		if (osAtomicReadPointer(&pages[i]))
+			++count;
+	}
+	return count * pageSize * pageSize * sizeof(Pixel);
+}
+
 // OutlierData Definitions
 ColorSystem OutlierData::cs(0.63f, 0.34f, 0.31f, 0.595f, 0.155f, 0.07f, 0.314275f, 0.329411f);
 
@@ -815,7 +878,7 @@ void BufferGroup::CreateBuffers(const vector<BufferConfig> &configs, u_int x, u_
 			buffer = NULL;
 			assert(0);
 		}
-		if (buffer && buffer->xPixelCount && buffer->yPixelCount)
+		if (buffer)
 			buffers.push_back(buffer);
 		else {
 			LOG(LUX_SEVERE, LUX_NOMEM) << "Couldn't allocate film buffers, aborting";
@@ -856,11 +919,33 @@ u_int Film::GetYPixelCount()
 	return yPixelCount;
 }
 
+double Film::GetSplattedContributions()
+{
+	if (!contribPool)
+		return 0.;
+	double splatted, lockWait;
+	contribPool->GetStatistics(&splatted, &lockWait);
+	return splatted;
+}
+
+double Film::GetSplattingLockWait()
+{
+	if (!contribPool)
+		return 0.;
+	double splatted, lockWait;
+	contribPool->GetStatistics(&splatted, &lockWait);
+	return lockWait;
+}
+
+// Largest number of square film tiles
+static const u_int maxSquareTiles = 256;
+
 Film::Film(u_int xres, u_int yres, Filter *filt, u_int filtRes, const float crop[4], 
 		   const string &filename1, bool premult, bool useZbuffer,
 		   bool w_resume_FLM, bool restart_resume_FLM, bool write_FLM_direct,
+		   bool write_FLM_chunked, FlmCompression flm_compression,
 		   int haltspp, int halttime, float haltthreshold,
-		   bool debugmode, int outlierk, int tilec, const string &samplingmapfilename) :
+		   bool debugmode, int outlierk, int tilec, u_int tilesize, const string &samplingmapfilename) :
 	Queryable("film"),
 	xResolution(xres), yResolution(yres),
 	EV(0.f), averageLuminance(0.f),
@@ -874,6 +959,7 @@ Film::Film(u_int xres, u_int yres, Filter *filt, u_int filtRes, const float crop
 	ZBuffer(NULL), use_Zbuf(useZbuffer),
 	debug_mode(debugmode), premultiplyAlpha(premult),
 	writeResumeFlm(w_resume_FLM), restartResumeFlm(restart_resume_FLM), writeFlmDirect(write_FLM_direct),
+	writeFlmChunked(write_FLM_chunked), flmCompression(flm_compression),
 	outlierRejection_k(outlierk), haltSamplesPerPixel(haltspp),
 	haltTime(halttime), haltThreshold(haltthreshold), haltThresholdComplete(0.f),
 	histogram(NULL), enoughSamplesPerPixel(false)
@@ -910,10 +996,14 @@ Film::Film(u_int xres, u_int yres, Filter *filt, u_int filtRes, const float crop
 	AddBoolAttribute(*this, "writeResumeFlm", "Write resume file", writeResumeFlm, &Film::writeResumeFlm, Queryable::ReadWriteAccess);
 	AddBoolAttribute(*this, "restartResumeFlm", "Restart (overwrite) resume file", restartResumeFlm, &Film::restartResumeFlm, Queryable::ReadWriteAccess);
 	AddBoolAttribute(*this, "writeFlmDirect", "Write resume file directly to disk", writeFlmDirect, &Film::writeFlmDirect, Queryable::ReadWriteAccess);	
+	AddBoolAttribute(*this, "writeFlmChunked", "Write resume file in the chunked random access format", writeFlmChunked, &Film::writeFlmChunked, Queryable::ReadWriteAccess);
+	AddStringAttribute(*this, "flmCompression", "Compression codec of resume files and network films", &Film::GetFlmCompression, &Film::SetFlmCompression);
 	AddFloatAttribute(*this, "cropWindow.0", "Crop window 0", &Film::GetCropWindow0);
 	AddFloatAttribute(*this, "cropWindow.1", "Crop window 1", &Film::GetCropWindow1);
 	AddFloatAttribute(*this, "cropWindow.2", "Crop window 2", &Film::GetCropWindow2);
 	AddFloatAttribute(*this, "cropWindow.3", "Crop window 3", &Film::GetCropWindow3);
+	AddDoubleAttribute(*this, "splattedContributions", "Number of contributions splatted to the film", &Film::GetSplattedContributions);
+	AddDoubleAttribute(*this, "splattingLockWait", "Time spent by the rendering threads waiting for the splatting locks, in seconds", &Film::GetSplattingLockWait);
 
 	// Precompute filter tables
 	filterLUTs = new FilterLUTs(filt, max(min(filtRes, 64u), 2u));
@@ -923,33 +1013,64 @@ Film::Film(u_int xres, u_int yres, Filter *filt, u_int filtRes, const float crop
 	outlierCellHeight = max(1U, Floor2UInt(2 * filter->yWidth));
 	outlierInvCellHeight = 1.f / outlierCellHeight;
 
-	const u_int thread_count = boost::thread::hardware_concurrency();
-	// base min tile size on outlier cell height, as it's a good measure anyway
-	const u_int minTileHeight = outlierCellHeight;
-	if (tilec > 0)
-		tileCount = tilec;
-	else
-		// TODO - thread_count * 2 is fairly arbitrary, find better choice?
-		tileCount = thread_count * (tilec < 0 ? -tilec : 2);
+	if (tilesize > 0 && outlierRejection_k > 0) {
+		// the outlier rejection data is organized by rows of tiles
+		LOG(LUX_WARNING, LUX_CONSISTENCY) << "Outlier rejection requires film slabs, ignoring the film tile size";
+		tilesize = 0;
+	}
+
+	if (tilesize > 0) {
+		// Square tiles, kept larger than the filter footprint so that
+		// a contribution spans at most 2x2 tiles
+		const u_int minTileSize = max(outlierCellWidth, outlierCellHeight);
+		tileWidth = tileHeight = max(tilesize, minTileSize);
+		for (;;) {
+			tileColumns = max(Ceil2UInt(static_cast<float>(xRealWidth) / tileWidth), 1u);
+			tileCount = tileColumns * max(Ceil2UInt(static_cast<float>(yRealHeight) / tileHeight), 1u);
+			// Every rendering thread can end up with a contribution
+			// buffer per tile, keep their number bounded
+			if (tileCount <= maxSquareTiles)
+				break;
+			tileWidth = tileHeight = tileWidth + max(tileWidth / 4, 1u);
+		}
+		if (tileWidth > max(tilesize, minTileSize))
+			LOG(LUX_INFO, LUX_NOERROR) << "Film tile size raised to " << tileWidth << " to keep at most " << maxSquareTiles << " tiles";
+	} else {
+		const u_int thread_count = boost::thread::hardware_concurrency();
+		// base min tile size on outlier cell height, as it's a good measure anyway
+		const u_int minTileHeight = outlierCellHeight;
+		if (tilec > 0)
+			tileCount = tilec;
+		else
+			// TODO - thread_count * 2 is fairly arbitrary, find better choice?
+			tileCount = thread_count * (tilec < 0 ? -tilec : 2);
 	
-	LOG(LUX_DEBUG, LUX_NOERROR) << "Requested film tile count: " << tileCount;
+		LOG(LUX_DEBUG, LUX_NOERROR) << "Requested film tile count: " << tileCount;
 
-	tileCount = Clamp(tileCount, 1u, yRealHeight / minTileHeight);
-	//tileCount = 2;
+		tileCount = Clamp(tileCount, 1u, yRealHeight / minTileHeight);
+		//tileCount = 2;
 
-	tileHeight = max(Ceil2UInt(static_cast<float>(yRealHeight) / tileCount), minTileHeight);
-	if (outlierRejection_k > 0) {
-		// if outlier rejection is enabled, tileHeight must be multiple of outlierCellHeight
-		// increase tileHeight to ensure this
-		tileHeight = outlierCellHeight * max(Ceil2UInt(static_cast<float>(tileHeight) / outlierCellHeight), 1u);
-		tileCount = max(Ceil2UInt(static_cast<float>(yRealHeight) / tileHeight), 1u);
+		tileHeight = max(Ceil2UInt(static_cast<float>(yRealHeight) / tileCount), minTileHeight);
+		if (outlierRejection_k > 0) {
+			// if outlier rejection is enabled, tileHeight must be multiple of outlierCellHeight
+			// increase tileHeight to ensure this
+			tileHeight = outlierCellHeight * max(Ceil2UInt(static_cast<float>(tileHeight) / outlierCellHeight), 1u);
+			tileCount = max(Ceil2UInt(static_cast<float>(yRealHeight) / tileHeight), 1u);
+		}
+
+		// A single column spanning the whole film
+		tileColumns = 1;
+		tileWidth = static_cast<u_int>(max(xRealWidth, 1));
 	}
 
-	LOG(LUX_DEBUG, LUX_NOERROR) << "Actual film tile count: " << tileCount;
+	LOG(LUX_DEBUG, LUX_NOERROR) << "Actual film tile count: " << tileCount << " (" << tileColumns << " columns)";
 
 	invTileHeight = 1.f / tileHeight;
 	tileOffset = -0.5f - filter->yWidth - yPixelStart;
 	tileOffset2 = 2 * filter->yWidth * invTileHeight;
+	invTileWidth = 1.f / tileWidth;
+	tileOffsetX = -0.5f - filter->xWidth - xPixelStart;
+	tileOffset2X = 2 * filter->xWidth * invTileWidth;
 
 	if (outlierRejection_k > 0) {
 		const u_int outliers_width = xRealWidth / outlierCellWidth;
@@ -1048,6 +1169,12 @@ void Film::CreateBuffers()
 	// initialize the contribution pool
 	// needs to be done before anyone tries to lock it
 	contribPool = new ContributionPool(this);
+	// The buffers of a tile are allocated when a thread first adds to it
+	LOG(LUX_DEBUG, LUX_NOERROR) << "Contribution buffers: " <<
+		CONTRIB_BUF_SIZE * sizeof(Contribution) / 1024 <<
+		"kB per tile and buffer group used by a rendering thread, up to " <<
+		tileCount * bufferGroups.size() * CONTRIB_BUF_SIZE * sizeof(Contribution) / (1024 * 1024) <<
+		"MB per thread";
 
     // Dade - check if we have to resume a rendering and restore the buffers
     if(writeResumeFlm) {
@@ -1333,25 +1460,44 @@ u_int Film::GetTileCount() const {
 	return tileCount;
 }
 
-u_int Film::GetTileIndexes(const Contribution &contrib, u_int *tile0, u_int *tile1) const {
-	const float imageY = contrib.imageY + tileOffset;
+u_int Film::GetTileIndexes(const Contribution &contrib, u_int *tiles) const {
+	const u_int tileRows = tileCount / tileColumns;
 
-	const float tileY = imageY * invTileHeight;
+	const float tileY = (contrib.imageY + tileOffset) * invTileHeight;
+	const u_int row0 = static_cast<u_int>(Clamp(static_cast<int>(tileY), 0, static_cast<int>(tileRows-1)));
+	const u_int rows = (row0 + 1 >= tileRows || tileY + tileOffset2 < row0 + 1) ? 1u : 2u;
 
-	*tile0 = static_cast<u_int>(Clamp(static_cast<int>(tileY), 0, static_cast<int>(tileCount-1)));
-	*tile1 = *tile0 + 1;
+	if (tileColumns == 1) {
+		tiles[0] = row0;
+		tiles[1] = row0 + 1;
+		return rows;
+	}
 
-	if (*tile1 >= tileCount || tileY + tileOffset2 < *tile1)
-		return 1u;
+	const float tileX = (contrib.imageX + tileOffsetX) * invTileWidth;
+	const u_int column0 = static_cast<u_int>(Clamp(static_cast<int>(tileX), 0, static_cast<int>(tileColumns-1)));
+	const u_int columns = (column0 + 1 >= tileColumns || tileX + tileOffset2X < column0 + 1) ? 1u : 2u;
 
-	return 2u;
+	u_int count = 0;
+	for (u_int row = row0; row < row0 + rows; ++row) {
+		for (u_int column = column0; column < column0 + columns; ++column)
+			tiles[count++] = row * tileColumns + column;
+	}
+
+	return count;
 }
 
 void Film::GetTileExtent(u_int tileIndex, int *xstart, int *xend, int *ystart, int *yend) const {
-	*xstart = xPixelStart;
-	*xend = xPixelStart + xPixelCount;
-	*ystart = yPixelStart + min(tileIndex * tileHeight, yPixelCount);
-	*yend = yPixelStart + min((tileIndex+1) * tileHeight, yPixelCount);
+	const u_int row = tileIndex / tileColumns;
+	const u_int column = tileIndex - row * tileColumns;
+	if (tileColumns == 1) {
+		*xstart = xPixelStart;
+		*xend = xPixelStart + xPixelCount;
+	} else {
+		*xstart = xPixelStart + min(column * tileWidth, xPixelCount);
+		*xend = xPixelStart + min((column+1) * tileWidth, xPixelCount);
+	}
+	*ystart = yPixelStart + min(row * tileHeight, yPixelCount);
+	*yend = yPixelStart + min((row+1) * tileHeight, yPixelCount);
 }
 
 void Film::AddTileSamples(const Contribution* const contribs, u_int num_contribs,
@@ -1360,8 +1506,25 @@ void Film::AddTileSamples(const Contribution* const contribs, u_int num_contribs
 	int yTilePixelStart, yTilePixelEnd;
 	GetTileExtent(tileIndex, &xTilePixelStart, &xTilePixelEnd, &yTilePixelStart, &yTilePixelEnd);
 
-	for (u_int ci = 0; ci < num_contribs; ci++) {
-		const Contribution &contrib(contribs[ci]);
+	// Square tiles are splatted in pixel order so that consecutive
+	// contributions update the same cache lines. The sort keys hold the
+	// buffer and the tile relative pixel in the high bits and the
+	// contribution index in the low bits.
+	vector<boost::uint64_t> order;
+	if (tileColumns > 1 && num_contribs > 1) {
+		order.reserve(num_contribs);
+		for (u_int ci = 0; ci < num_contribs; ++ci) {
+			const Contribution &contrib(contribs[ci]);
+			const boost::uint64_t x = static_cast<boost::uint64_t>(Clamp(Floor2Int(contrib.imageX) - xTilePixelStart + 0x800, 0, 0xfff));
+			const boost::uint64_t y = static_cast<boost::uint64_t>(Clamp(Floor2Int(contrib.imageY) - yTilePixelStart + 0x800, 0, 0xfff));
+			const boost::uint64_t buffer = min<boost::uint64_t>(contrib.buffer, 0xff);
+			order.push_back((((buffer << 24) | (y << 12) | x) << 32) | ci);
+		}
+		std::sort(order.begin(), order.end());
+	}
+
+	for (u_int i = 0; i < num_contribs; ++i) {
+		const Contribution &contrib(contribs[order.empty() ? i : static_cast<u_int>(order[i] & 0xffffffffU)]);
 
 		XYZColor xyz = contrib.color;
 		const float alpha = contrib.alpha;
@@ -1421,42 +1584,55 @@ void Film::AddTileSamples(const Contribution* const contribs, u_int num_contribs
 		if (x1 < x0 || y1 < y0 || x1 < 0 || y1 < 0)
 			continue;
 
-		const u_int xStart = static_cast<u_int>(max(x0, xTilePixelStart));
-		const u_int yStart = static_cast<u_int>(max(y0, yTilePixelStart));
-		const u_int xEnd = static_cast<u_int>(min(x1, xTilePixelEnd));
-		const u_int yEnd = static_cast<u_int>(min(y1, yTilePixelEnd));
-
-		for (u_int y = yStart; y < yEnd; ++y) {
-			const int yoffset = (y - y0) * filterLUT.GetWidth();
-			const u_int yPixel = y - yPixelStart;
-			for (u_int x = xStart; x < xEnd; ++x) {
-				// Evaluate filter value at $(x,y)$ pixel
-				const int xoffset = x-x0;
-				const float filterWt = lut[yoffset + xoffset];
-
-				// Update pixel values with filtered sample contribution
-				const u_int xPixel = x - xPixelStart;
-				const float w = filterWt * weight;
-				buffer->Add(xPixel, yPixel, xyz, alpha, w);
-
-				// Update ZBuffer values with filtered zdepth contribution
-				if(use_Zbuf && contrib.zdepth != 0.f)
+		const int xStart = max(x0, xTilePixelStart);
+		const int yStart = max(y0, yTilePixelStart);
+		const int xEnd = min(x1, xTilePixelEnd);
+		const int yEnd = min(y1, yTilePixelEnd);
+		if (xStart >= xEnd || yStart >= yEnd)
+			continue;
+
+		// Filter values of the first pixel of the splatted rows
+		const u_int lutWidth = filterLUT.GetWidth();
+		const float *lutStart = lut + (yStart - y0) * lutWidth + (xStart - x0);
+		const u_int xPixel0 = static_cast<u_int>(xStart) - xPixelStart;
+		const u_int xPixel1 = static_cast<u_int>(xEnd) - xPixelStart;
+		const u_int yPixel0 = static_cast<u_int>(yStart) - yPixelStart;
+		const u_int yPixel1 = static_cast<u_int>(yEnd) - yPixelStart;
+
+		// Update pixel values with filtered sample contribution
+		const float *lutRow = lutStart;
+		for (u_int yPixel = yPixel0; yPixel < yPixel1; ++yPixel, lutRow += lutWidth) {
+			for (u_int xPixel = xPixel0, i = 0; xPixel < xPixel1; ++xPixel, ++i)
+				buffer->Add(xPixel, yPixel, xyz, alpha, lutRow[i] * weight);
+		}
+
+		// The optional buffers get their own passes to keep
+		// the tests out of the loop above
+
+		// Update ZBuffer values with filtered zdepth contribution
+		if (use_Zbuf && contrib.zdepth != 0.f) {
+			for (u_int yPixel = yPixel0; yPixel < yPixel1; ++yPixel) {
+				for (u_int xPixel = xPixel0; xPixel < xPixel1; ++xPixel)
 					ZBuffer->Add(xPixel, yPixel, contrib.zdepth, 1.0f);
+			}
+		}
 
-				// Update variance information
-				if (varianceBuffer)
-					varianceBuffer->Add(xPixel, yPixel, xyz, w);
+		// Update variance information
+		if (varianceBuffer) {
+			lutRow = lutStart;
+			for (u_int yPixel = yPixel0; yPixel < yPixel1; ++yPixel, lutRow += lutWidth) {
+				for (u_int xPixel = xPixel0, i = 0; xPixel < xPixel1; ++xPixel, ++i)
+					varianceBuffer->Add(xPixel, yPixel, xyz, lutRow[i] * weight);
 			}
 		}
 	}
 }
 
 void Film::AddSample(Contribution *contrib) {
-	u_int tileIndex0, tileIndex1;
-	u_int tiles = GetTileIndexes(*contrib, &tileIndex0, &tileIndex1);
-	AddTileSamples(contrib, 1, tileIndex0);
-	if (tiles > 1)
-		AddTileSamples(contrib, 1, tileIndex1);
+	u_int tileIndexes[4];
+	const u_int tiles = GetTileIndexes(*contrib, tileIndexes);
+	for (u_int i = 0; i < tiles; ++i)
+		AddTileSamples(contrib, 1, tileIndexes[i]);
 }
 
 void Film::SetSample(const Contribution *contrib) {
@@ -1635,7 +1811,8 @@ void Film::AddSampleNoFiltering(const Contribution *contrib) {
  *
  * Remarks:
  *  - data is written as binary little-endian
- *  - data is gzipped
+ *  - data is compressed, either gzipped or with the LZ codecs of flmcodec.h
+ *    (selected by the "flm_compression" film parameter and detected on read)
  *  - the version is not intended for backward/forward compatibility but just as a check
  */
 static const int FLM_MAGIC_NUMBER = 0xCEBCD816;
@@ -1777,8 +1954,9 @@ private:
 class FlmHeader {
 public:
 	FlmHeader() {}
-	bool Read(boost::iostreams::filtering_stream<boost::iostreams::input> &in, bool isLittleEndian, Film *film );
+	bool Read(std::basic_istream<char> &in, bool isLittleEndian, Film *film );
 	void Write(std::basic_ostream<char> &os, bool isLittleEndian) const;
+	void Fill(Film *film, bool transmitParams);
 
 	int magicNumber;
 	int versionNumber;
@@ -1791,7 +1969,7 @@ public:
 	vector<FlmParameter> params;
 };
 
-bool FlmHeader::Read(boost::iostreams::filtering_stream<boost::iostreams::input> &in, bool isLittleEndian, Film *film ) {
+bool FlmHeader::Read(std::basic_istream<char> &in, bool isLittleEndian, Film *film ) {
 	// Read and verify magic number and version
 	magicNumber = osReadLittleEndianInt(isLittleEndian, in);
 	if (!in.good()) {
@@ -1915,6 +2093,658 @@ void FlmHeader::Write(std::basic_ostream<char> &os, bool isLittleEndian) const
 	}
 }
 
+void FlmHeader::Fill(Film *film, bool transmitParams)
+{
+	magicNumber = FLM_MAGIC_NUMBER;
+	versionNumber = FLM_VERSION;
+	xResolution = film->GetXPixelCount();
+	yResolution = film->GetYPixelCount();
+	numBufferGroups = film->GetNumBufferGroups();
+	numBufferConfigs = film->GetNumBufferConfigs();
+	for (u_int i = 0; i < film->GetNumBufferConfigs(); ++i)
+		bufferTypes.push_back(film->GetBufferConfig(i).type);
+	// Parameters
+	if (transmitParams) {
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_TONEMAPKERNEL, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_REINHARD_PRESCALE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_REINHARD_POSTSCALE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_REINHARD_BURN, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_SENSITIVITY, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_EXPOSURE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_FSTOP, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_GAMMA, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_CONTRAST_YWA, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LDR_CLAMP_METHOD, 0));		
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_WHITE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_WHITE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_RED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_RED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_GREEN, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_GREEN, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_BLUE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_BLUE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_GAMMA, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_CAMERA_RESPONSE_ENABLED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_STRING, LUX_FILM_CAMERA_RESPONSE_FILE, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_UPDATEBLOOMLAYER, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_DELETEBLOOMLAYER, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_BLOOMRADIUS, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_BLOOMWEIGHT, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_VIGNETTING_ENABLED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_VIGNETTING_SCALE, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_ABERRATION_ENABLED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_ABERRATION_AMOUNT, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_UPDATEGLARELAYER, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_DELETEGLARELAYER, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_AMOUNT, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_RADIUS, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_BLADES, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_THRESHOLD, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_CHIU_ENABLED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_CHIU_RADIUS, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_CHIU_INCLUDECENTER, 0));
+
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_ENABLED, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_AMPLITUDE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_NBITER, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_SHARPNESS, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_ANISOTROPY, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_ALPHA, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_SIGMA, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_FASTAPPROX, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_GAUSSPREC, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_DL, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_DA, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_INTERP, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_TILE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_BTILE, 0));
+		params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_THREADS, 0));
+
+		for(u_int i = 0; i < film->GetNumBufferGroups(); ++i) {
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE, i));
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_ENABLE, i));
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE_RED, i));
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE_GREEN, i));
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE_BLUE, i));
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_TEMPERATURE, i));
+
+			params.push_back(FlmParameter(film, FLM_PARAMETER_TYPE_STRING, LUX_FILM_LG_NAME, i));
+		}
+
+		numParams = params.size();
+	} else {
+		numParams = 0;
+	}
+}
+
+// Decoded content of a streamed FLM, read before touching the film buffers
+class FlmStreamData {
+public:
+	FlmStreamData() { }
+	~FlmStreamData() {
+		for (u_int i = 0; i < pixelArrays.size(); ++i)
+			delete pixelArrays[i];
+	}
+
+	bool Read(std::basic_istream<char> &stream, bool isLittleEndian, Film *film);
+
+	FlmHeader header;
+	vector<double> numberOfSamples;
+	vector<BlockedArray<Pixel>*> pixelArrays;
+};
+
+bool FlmStreamData::Read(std::basic_istream<char> &stream, bool isLittleEndian, Film *film)
+{
+	// Enable compression
+	// TODO Move this below header when implementing FILM VERSION 2
+	boost::iostreams::filtering_stream<boost::iostreams::input> in;
+	PushFlmDecompressor(in, stream);
+	in.push(stream);
+
+	// Read header
+	if (!header.Read(in, isLittleEndian, film))
+		return false;
+
+	// Read buffer groups
+	const u_int numBufferGroups = film->GetNumBufferGroups();
+	const u_int numBufferConfigs = film->GetNumBufferConfigs();
+	numberOfSamples.resize(numBufferGroups);
+	pixelArrays.resize(numBufferGroups * numBufferConfigs, NULL);
+	for (u_int i = 0; i < numBufferGroups; i++) {
+		double groupSamples;
+		groupSamples = osReadLittleEndianDouble(isLittleEndian, in);
+		if (!in.good())
+			break;
+		numberOfSamples[i] = groupSamples;
+
+		// Read buffers
+		for(u_int j = 0; j < numBufferConfigs; ++j) {
+			const Buffer* localBuffer = film->GetBufferGroup(i).getBuffer(j);
+			// Read pixels
+			BlockedArray<Pixel> *tmpPixelArr = new BlockedArray<Pixel>(
+				localBuffer->xPixelCount, localBuffer->yPixelCount);
+			pixelArrays[i*numBufferConfigs + j] = tmpPixelArr;
+			for (u_int y = 0; y < tmpPixelArr->vSize(); ++y) {
+				for (u_int x = 0; x < tmpPixelArr->uSize(); ++x) {
+					Pixel &pixel = (*tmpPixelArr)(x, y);
+					pixel.L.c[0] = osReadLittleEndianFloat(isLittleEndian, in);
+					pixel.L.c[1] = osReadLittleEndianFloat(isLittleEndian, in);
+					pixel.L.c[2] = osReadLittleEndianFloat(isLittleEndian, in);
+					pixel.alpha = osReadLittleEndianFloat(isLittleEndian, in);
+					pixel.weightSum = osReadLittleEndianFloat(isLittleEndian, in);
+				}
+			}
+			if (!in.good())
+				break;
+		}
+		if (!in.good())
+			break;
+
+		LOG( LUX_DEBUG,LUX_NOERROR)
+			<< "Received " << numberOfSamples[i] << " samples for buffer group " << i
+			<< " (buffer config size: " << numBufferConfigs << ")";
+	}
+
+	return in.good();
+}
+
+/**
+ * Chunked FLM format
+ * ------------------
+ *
+ * Random access variant of the FLM format for resume files, enabled with the
+ * "write_flm_chunked" film parameter. The file is not compressed as a whole,
+ * instead each tile of each buffer is compressed independently so that the
+ * file can be memory mapped and its tiles decoded and merged in parallel.
+ *
+ * Layout:
+ *
+ *   chunked_magic                 - 8 bytes - "LUXFLMC" followed by the chunked format version
+ *   HEADER                        - *       - the FLM header described above, uncompressed
+ *   chunk_codec                   - int     - the FlmCompression of the chunks, lz or lzshuffle
+ *   tile_size                     - u_int   - the width and height of the tiles
+ *   for i in 1:#buffer_groups
+ *     #samples                    - double  - the number of samples in the i'th buffer group
+ *   for i in 1:#buffer_groups, j in 1:#buffer_configs, each tile in row major order
+ *     offset_low                  - u_int   - low 32 bits of the chunk offset from the start of the file
+ *     offset_high                 - u_int   - high 32 bits of the chunk offset
+ *     packed_size                 - u_int   - the size of the chunk
+ *   chunks                        - *       - the tile pixels (X, Y, Z, alpha, weight_sum as little-endian floats,
+ *                                             row major), each compressed as a single LZ block
+ */
+static const char FLM_CHUNKED_MAGIC[8] = { 'L', 'U', 'X', 'F', 'L', 'M', 'C', 1 };
+static const u_int FLM_CHUNKED_TILE_SIZE = 64;
+static const u_int FLM_PIXEL_SIZE = 5 * sizeof(float);
+
+class FlmChunkIndex {
+public:
+	FlmChunkIndex() : shuffle(true), tileSize(FLM_CHUNKED_TILE_SIZE),
+		xTiles(0), yTiles(0) { }
+
+	void Init(u_int size) {
+		tileSize = size;
+		xTiles = (header.xResolution + tileSize - 1) / tileSize;
+		yTiles = (header.yResolution + tileSize - 1) / tileSize;
+	}
+	u_int GetNumChunks() const {
+		return header.numBufferGroups * header.numBufferConfigs * xTiles * yTiles;
+	}
+	// Decomposes a chunk index into buffer group, buffer and tile extent
+	void GetChunk(u_int chunk, u_int *group, u_int *buffer,
+		u_int *x0, u_int *y0, u_int *width, u_int *height) const {
+		const u_int tiles = xTiles * yTiles;
+		const u_int tile = chunk % tiles;
+		*buffer = (chunk / tiles) % header.numBufferConfigs;
+		*group = chunk / (tiles * header.numBufferConfigs);
+		*x0 = (tile % xTiles) * tileSize;
+		*y0 = (tile / xTiles) * tileSize;
+		*width = min(tileSize, header.xResolution - *x0);
+		*height = min(tileSize, header.yResolution - *y0);
+	}
+	u_int GetRawSize(u_int chunk) const {
+		u_int group, buffer, x0, y0, width, height;
+		GetChunk(chunk, &group, &buffer, &x0, &y0, &width, &height);
+		return width * height * FLM_PIXEL_SIZE;
+	}
+
+	static bool ReadMagic(std::basic_istream<char> &in) {
+		char magic[8];
+		in.read(magic, 8);
+		return in.good() && std::equal(magic, magic + 8, FLM_CHUNKED_MAGIC);
+	}
+	bool ReadHeader(std::basic_istream<char> &in, bool isLittleEndian, Film *film) {
+		if (!ReadMagic(in)) {
+			LOG(LUX_ERROR, LUX_BADFILE) << "Invalid chunked FLM magic number";
+			return false;
+		}
+		return header.Read(in, isLittleEndian, film);
+	}
+	bool Read(std::basic_istream<char> &in, bool isLittleEndian, Film *film, boost::uint64_t fileSize);
+	void Write(std::basic_ostream<char> &os, bool isLittleEndian, const vector<vector<char> > &chunks) const;
+
+	FlmHeader header;
+	bool shuffle;
+	u_int tileSize, xTiles, yTiles;
+	vector<double> numberOfSamples;
+	vector<boost::uint64_t> offsets;
+	vector<u_int> packedSizes;
+};
+
+bool FlmChunkIndex::Read(std::basic_istream<char> &in, bool isLittleEndian, Film *film, boost::uint64_t fileSize)
+{
+	if (!ReadHeader(in, isLittleEndian, film))
+		return false;
+	const int codec = osReadLittleEndianInt(isLittleEndian, in);
+	const u_int size = osReadLittleEndianUInt(isLittleEndian, in);
+	if (!in.good() || size == 0 ||
+		static_cast<boost::uint64_t>(size) * size * FLM_PIXEL_SIZE > LZCODEC_BLOCK_SIZE ||
+		(codec != FLM_COMPRESSION_LZ && codec != FLM_COMPRESSION_LZ_SHUFFLE)) {
+		LOG(LUX_ERROR, LUX_BADFILE) << "Invalid chunked FLM layout (codec=" << codec << ", tile size=" << size << ")";
+		return false;
+	}
+	shuffle = codec == FLM_COMPRESSION_LZ_SHUFFLE;
+	Init(size);
+
+	numberOfSamples.resize(header.numBufferGroups);
+	for (u_int i = 0; i < header.numBufferGroups; ++i)
+		numberOfSamples[i] = osReadLittleEndianDouble(isLittleEndian, in);
+
+	const u_int numChunks = GetNumChunks();
+	offsets.resize(numChunks);
+	packedSizes.resize(numChunks);
+	for (u_int i = 0; i < numChunks; ++i) {
+		const boost::uint64_t low = osReadLittleEndianUInt(isLittleEndian, in);
+		const boost::uint64_t high = osReadLittleEndianUInt(isLittleEndian, in);
+		offsets[i] = low | (high << 32);
+		packedSizes[i] = osReadLittleEndianUInt(isLittleEndian, in);
+		if (!in.good()) {
+			LOG(LUX_ERROR, LUX_SYSTEM) << "Error while reading chunked FLM index";
+			return false;
+		}
+		if (packedSizes[i] > GetRawSize(i) || offsets[i] > fileSize ||
+			packedSizes[i] > fileSize - offsets[i]) {
+			LOG(LUX_ERROR, LUX_BADFILE) << "Invalid chunked FLM index entry " << i;
+			return false;
+		}
+	}
+	return true;
+}
+
+void FlmChunkIndex::Write(std::basic_ostream<char> &os, bool isLittleEndian, const vector<vector<char> > &chunks) const
+{
+	const std::streampos start = os.tellp();
+	os.write(FLM_CHUNKED_MAGIC, 8);
+	header.Write(os, isLittleEndian);
+	osWriteLittleEndianInt(isLittleEndian, os, shuffle ? FLM_COMPRESSION_LZ_SHUFFLE : FLM_COMPRESSION_LZ);
+	osWriteLittleEndianUInt(isLittleEndian, os, tileSize);
+	for (u_int i = 0; i < header.numBufferGroups; ++i)
+		osWriteLittleEndianDouble(isLittleEndian, os, numberOfSamples[i]);
+
+	// The chunks follow the index
+	boost::uint64_t offset = static_cast<boost::uint64_t>(os.tellp() - start) + chunks.size() * 12;
+	for (u_int i = 0; i < chunks.size(); ++i) {
+		osWriteLittleEndianUInt(isLittleEndian, os, static_cast<u_int>(offset & 0xffffffffU));
+		osWriteLittleEndianUInt(isLittleEndian, os, static_cast<u_int>(offset >> 32));
+		osWriteLittleEndianUInt(isLittleEndian, os, chunks[i].size());
+		offset += chunks[i].size();
+	}
+	for (u_int i = 0; i < chunks.size() && os.good(); ++i)
+		os.write(&chunks[i][0], chunks[i].size());
+}
+
+static inline void StoreFlmFloat(char *dst, float value, bool isLittleEndian)
+{
+	char *src = reinterpret_cast<char *>(&value);
+	if (isLittleEndian)
+		std::copy(src, src + sizeof(float), dst);
+	else
+		std::reverse_copy(src, src + sizeof(float), dst);
+}
+
+static inline float LoadFlmFloat(const char *src, bool isLittleEndian)
+{
+	float value;
+	char *dst = reinterpret_cast<char *>(&value);
+	if (isLittleEndian)
+		std::copy(src, src + sizeof(float), dst);
+	else
+		std::reverse_copy(src, src + sizeof(float), dst);
+	return value;
+}
+
+static void PackFlmChunk(const FlmChunkIndex *index, const vector<BufferGroup> *bufferGroups,
+	bool isLittleEndian, vector<vector<char> > *chunks, u_int chunk)
+{
+	u_int group, buf, x0, y0, width, height;
+	index->GetChunk(chunk, &group, &buf, &x0, &y0, &width, &height);
+	const Buffer *buffer = (*bufferGroups)[group].getBuffer(buf);
+
+	vector<char> raw(width * height * FLM_PIXEL_SIZE), scratch;
+	char *dst = &raw[0];
+	for (u_int y = y0; y < y0 + height; ++y) {
+		for (u_int x = x0; x < x0 + width; ++x) {
+			const Pixel &pixel = buffer->pixels(x, y);
+			StoreFlmFloat(dst, pixel.L.c[0], isLittleEndian);
+			StoreFlmFloat(dst + 4, pixel.L.c[1], isLittleEndian);
+			StoreFlmFloat(dst + 8, pixel.L.c[2], isLittleEndian);
+			StoreFlmFloat(dst + 12, pixel.alpha, isLittleEndian);
+			StoreFlmFloat(dst + 16, pixel.weightSum, isLittleEndian);
+			dst += FLM_PIXEL_SIZE;
+		}
+	}
+
+	vector<char> &packed = (*chunks)[chunk];
+	packed.resize(LZCompressBlock(&raw[0], raw.size(), index->shuffle, scratch, packed));
+}
+
+static void MergeFlmChunk(const FlmChunkIndex *index, const char *data, vector<BufferGroup> *bufferGroups,
+	bool isLittleEndian, volatile boost::uint32_t *failedChunks, u_int chunk)
+{
+	u_int group, buf, x0, y0, width, height;
+	index->GetChunk(chunk, &group, &buf, &x0, &y0, &width, &height);
+	Buffer *buffer = (*bufferGroups)[group].getBuffer(buf);
+
+	vector<char> raw(width * height * FLM_PIXEL_SIZE), scratch;
+	if (!LZDecompressBlock(data + index->offsets[chunk], index->packedSizes[chunk],
+		raw.size(), index->shuffle, scratch, &raw[0])) {
+		atomic_inc32(failedChunks);
+		return;
+	}
+
+	const char *src = &raw[0];
+	for (u_int y = y0; y < y0 + height; ++y) {
+		for (u_int x = x0; x < x0 + width; ++x) {
+			const float X = LoadFlmFloat(src, isLittleEndian);
+			const float Y = LoadFlmFloat(src + 4, isLittleEndian);
+			const float Z = LoadFlmFloat(src + 8, isLittleEndian);
+			const float alpha = LoadFlmFloat(src + 12, isLittleEndian);
+			const float weightSum = LoadFlmFloat(src + 16, isLittleEndian);
+			src += FLM_PIXEL_SIZE;
+			// Don't allocate pixels for nothing
+			if (X == 0.f && Y == 0.f && Z == 0.f && alpha == 0.f && weightSum == 0.f)
+				continue;
+			Pixel &pixel = buffer->pixels(x, y);
+			pixel.L.c[0] += X;
+			pixel.L.c[1] += Y;
+			pixel.L.c[2] += Z;
+			pixel.alpha += alpha;
+			pixel.weightSum += weightSum;
+		}
+	}
+}
+
+bool Film::IsChunkedFilmFile(const string &filename)
+{
+	std::ifstream is(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	return is.good() && FlmChunkIndex::ReadMagic(is);
+}
+
+bool Film::WriteChunkedFilmToStream(std::basic_ostream<char> &os)
+{
+	const bool isLittleEndian = osIsLittleEndian();
+	LOG(LUX_DEBUG, LUX_NOERROR) << "Writing chunked film (little endian=" << boost::lexical_cast<std::string>(isLittleEndian) << ")";
+
+	ScopedPoolLock lock(contribPool);
+
+	FlmChunkIndex index;
+	index.header.Fill(this, true);
+	// The chunks are LZ compressed so that they can be decoded on their
+	// own, gzip is replaced by the closest LZ codec
+	if (flmCompression == FLM_COMPRESSION_GZIP)
+		LOG(LUX_WARNING, LUX_UNIMPLEMENT) << "Chunked films don't support gzip compression, using \"lzshuffle\" instead";
+	index.shuffle = (flmCompression != FLM_COMPRESSION_LZ);
+	index.Init(FLM_CHUNKED_TILE_SIZE);
+	for (u_int i = 0; i < bufferGroups.size(); ++i)
+		index.numberOfSamples.push_back(bufferGroups[i].numberOfSamples);
+
+	// Compress all the tiles in parallel
+	vector<vector<char> > chunks(index.GetNumChunks());
+	ParallelFor(chunks.size(), boost::bind(&PackFlmChunk, &index, &bufferGroups,
+		isLittleEndian, &chunks, _1));
+
+	index.Write(os, isLittleEndian, chunks);
+
+	return os.good();
+}
+
+double Film::MergeChunkedFilmFromFile(const string &filename)
+{
+	const bool isLittleEndian = osIsLittleEndian();
+	LOG(LUX_DEBUG, LUX_NOERROR) << "Merging chunked film (little endian=" << boost::lexical_cast<std::string>(isLittleEndian) << ")";
+
+	boost::iostreams::mapped_file_source file;
+	try {
+		file.open(filename);
+	} catch (std::exception &e) {
+		LOG(LUX_ERROR, LUX_SYSTEM) << "Unable to map film file '" << filename << "' (" << e.what() << ")";
+		return 0.;
+	}
+
+	FlmChunkIndex index;
+	{
+		boost::iostreams::stream<boost::iostreams::array_source> in(file.data(), file.size());
+		if (!index.Read(in, isLittleEndian, this, file.size()))
+			return 0.;
+	}
+
+	// Update parameters
+	for (vector<FlmParameter>::iterator it = index.header.params.begin(); it != index.header.params.end(); ++it)
+		it->Set(this);
+
+	// lock the pool
+	ScopedPoolLock poolLock(contribPool);
+
+	// Decode and add the tiles in parallel, each tile belongs to
+	// a single buffer so there is no contention between threads
+	volatile boost::uint32_t failedChunks = 0;
+	ParallelFor(index.GetNumChunks(), boost::bind(&MergeFlmChunk, &index, file.data(),
+		&bufferGroups, isLittleEndian, &failedChunks, _1));
+	if (failedChunks > 0)
+		LOG(LUX_ERROR, LUX_BADFILE) << "Skipped " << failedChunks << " corrupted tiles while merging film '" << filename << "'";
+
+	return AddBufferGroupSamples(index.numberOfSamples);
+}
+
+// A memory mapped chunked film taking part in a N-way merge
+struct FlmChunkedInput {
+	FlmChunkedInput() : failedChunks(0) { }
+
+	string filename;
+	boost::iostreams::mapped_file_source file;
+	FlmChunkIndex index;
+	volatile boost::uint32_t failedChunks;
+};
+
+static void MergeFlmChunks(const vector<FlmChunkedInput *> *inputs, vector<BufferGroup> *bufferGroups,
+	bool isLittleEndian, u_int chunk)
+{
+	// The same tile of every input is added by the same thread
+	for (u_int i = 0; i < inputs->size(); ++i) {
+		FlmChunkedInput &input = *(*inputs)[i];
+		MergeFlmChunk(&input.index, input.file.data(), bufferGroups,
+			isLittleEndian, &input.failedChunks, chunk);
+	}
+}
+
+// Decodes a streamed film, the slot is left NULL if the file can't be read
+static void DecodeFlmStreamFile(const vector<string> *filenames, u_int first,
+	Film *film, vector<FlmStreamData *> *decoded, u_int index)
+{
+	const string &filename = (*filenames)[first + index];
+	std::ifstream ifs(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!ifs.good()) {
+		LOG(LUX_ERROR, LUX_NOFILE) << "Unable to open FLM file '" << filename << "'";
+		return;
+	}
+
+	FlmStreamData *data = new FlmStreamData();
+	if (!data->Read(ifs, osIsLittleEndian(), film)) {
+		LOG(LUX_ERROR, LUX_BADFILE) << "Error reading FLM file '" << filename << "'";
+		delete data;
+		return;
+	}
+	(*decoded)[index] = data;
+}
+
+// Adds one row of every decoded film, rows don't overlap so the
+// reduction needs no locking
+static void MergeFlmStreamRow(const vector<FlmStreamData *> *decoded,
+	vector<BufferGroup> *bufferGroups, u_int bufferCount, u_int y)
+{
+	for (u_int k = 0; k < decoded->size(); ++k) {
+		const FlmStreamData *data = (*decoded)[k];
+		if (!data)
+			continue;
+		for (u_int i = 0; i < bufferGroups->size(); ++i) {
+			for (u_int j = 0; j < bufferCount; ++j) {
+				const BlockedArray<Pixel> *receivedPixels = data->pixelArrays[i * bufferCount + j];
+				Buffer *buffer = (*bufferGroups)[i].getBuffer(j);
+				if (y >= buffer->yPixelCount)
+					continue;
+				for (u_int x = 0; x < buffer->xPixelCount; ++x) {
+					const Pixel &pixel = (*receivedPixels)(x, y);
+					// Don't allocate pixels for nothing
+					if (pixel.weightSum == 0.f && pixel.alpha == 0.f && pixel.L.Black())
+						continue;
+					Pixel &pixelResult = buffer->pixels(x, y);
+					pixelResult.L.c[0] += pixel.L.c[0];
+					pixelResult.L.c[1] += pixel.L.c[1];
+					pixelResult.L.c[2] += pixel.L.c[2];
+					pixelResult.alpha += pixel.alpha;
+					pixelResult.weightSum += pixel.weightSum;
+				}
+			}
+		}
+	}
+}
+
+u_int Film::MergeFilmsFromFiles(const vector<string> &filenames, u_int threadCount,
+	size_t memoryBudget, u_int *skippedCount)
+{
+	const bool isLittleEndian = osIsLittleEndian();
+	if (threadCount == 0)
+		threadCount = max(1U, boost::thread::hardware_concurrency());
+	u_int skipped = 0;
+
+	// Sort the inputs, chunked films are mapped and only their index is
+	// kept in memory, grouped by tile size so that their tiles match
+	vector<string> streamed;
+	vector<FlmChunkedInput> chunked;
+	chunked.reserve(filenames.size());
+	for (u_int i = 0; i < filenames.size(); ++i) {
+		if (!IsChunkedFilmFile(filenames[i])) {
+			streamed.push_back(filenames[i]);
+			continue;
+		}
+		chunked.push_back(FlmChunkedInput());
+		FlmChunkedInput &input = chunked.back();
+		input.filename = filenames[i];
+		try {
+			input.file.open(filenames[i]);
+		} catch (std::exception &e) {
+			LOG(LUX_ERROR, LUX_SYSTEM) << "Unable to map film file '" << filenames[i] << "' (" << e.what() << ")";
+			chunked.pop_back();
+			++skipped;
+			continue;
+		}
+		boost::iostreams::stream<boost::iostreams::array_source> in(input.file.data(), input.file.size());
+		if (!input.index.Read(in, isLittleEndian, this, input.file.size())) {
+			LOG(LUX_ERROR, LUX_BADFILE) << "Error reading FLM file '" << filenames[i] << "'";
+			chunked.pop_back();
+			++skipped;
+		}
+	}
+	std::map<u_int, vector<FlmChunkedInput *> > tileGroups;
+	for (u_int i = 0; i < chunked.size(); ++i)
+		tileGroups[chunked[i].index.tileSize].push_back(&chunked[i]);
+
+	u_int mergedCount = 0;
+	if (chunked.size() > 0) {
+		LOG(LUX_INFO, LUX_NOERROR) << "Merging " << chunked.size() << " chunked FLM files with " << threadCount << " threads";
+
+		for (u_int i = 0; i < chunked.size(); ++i) {
+			for (vector<FlmParameter>::iterator it = chunked[i].index.header.params.begin(); it != chunked[i].index.header.params.end(); ++it)
+				it->Set(this);
+		}
+
+		ScopedPoolLock poolLock(contribPool);
+		for (std::map<u_int, vector<FlmChunkedInput *> >::const_iterator it = tileGroups.begin(); it != tileGroups.end(); ++it) {
+			const vector<FlmChunkedInput *> &inputs = it->second;
+			ParallelFor(inputs[0]->index.GetNumChunks(), boost::bind(&MergeFlmChunks, &inputs,
+				&bufferGroups, isLittleEndian, _1), threadCount);
+		}
+
+		// The intact tiles of a damaged film are kept but the film
+		// is not reported as merged
+		for (u_int i = 0; i < chunked.size(); ++i) {
+			AddBufferGroupSamples(chunked[i].index.numberOfSamples);
+			if (chunked[i].failedChunks > 0) {
+				LOG(LUX_ERROR, LUX_BADFILE) << "Skipped " << chunked[i].failedChunks << " corrupted tiles while merging film '" << chunked[i].filename << "'";
+				++skipped;
+			} else
+				++mergedCount;
+		}
+	}
+
+	if (streamed.size() > 0) {
+		// Each streamed film in flight needs a full copy of the buffers
+		const size_t filmSize = static_cast<size_t>(bufferGroups.size()) * bufferConfigs.size() *
+			xPixelCount * yPixelCount * sizeof(Pixel);
+		u_int inFlight = min<u_int>(threadCount, streamed.size());
+		if (memoryBudget > 0)
+			inFlight = max(1U, min<u_int>(inFlight, memoryBudget / max<size_t>(filmSize, 1)));
+
+		LOG(LUX_INFO, LUX_NOERROR) << "Merging " << streamed.size() << " streamed FLM files, decoding " << inFlight << " at a time";
+
+		// Batches of films are decoded concurrently, then added row by row
+		// across all the threads
+		for (u_int first = 0; first < streamed.size(); first += inFlight) {
+			vector<FlmStreamData *> decoded(min<u_int>(inFlight, streamed.size() - first), NULL);
+			ParallelFor(decoded.size(), boost::bind(&DecodeFlmStreamFile, &streamed, first,
+				this, &decoded, _1), inFlight);
+
+			for (u_int i = 0; i < decoded.size(); ++i) {
+				if (!decoded[i]) {
+					++skipped;
+					continue;
+				}
+				for (vector<FlmParameter>::iterator it = decoded[i]->header.params.begin(); it != decoded[i]->header.params.end(); ++it)
+					it->Set(this);
+			}
+
+			{
+				ScopedPoolLock poolLock(contribPool);
+				ParallelFor(yPixelCount, boost::bind(&MergeFlmStreamRow, &decoded,
+					&bufferGroups, bufferConfigs.size(), _1), threadCount);
+			}
+
+			for (u_int i = 0; i < decoded.size(); ++i) {
+				if (!decoded[i])
+					continue;
+				AddBufferGroupSamples(decoded[i]->numberOfSamples);
+				LOG(LUX_INFO, LUX_NOERROR) << "Merged FLM file " << streamed[first + i];
+				delete decoded[i];
+				++mergedCount;
+			}
+		}
+	}
+
+	if (skippedCount)
+		*skippedCount = skipped;
+	return mergedCount;
+}
+
 bool Film::WriteFilmToFile(const string &filename)
 {
 	const string tempFilename = filename + ".temp";
@@ -1928,7 +2758,8 @@ bool Film::WriteFilmToFile(const string &filename)
 		return false;
 	}
 
-	bool writeSuccessful = WriteFilmToStream(ofs, false, true, writeFlmDirect);
+	bool writeSuccessful = writeFlmChunked ? WriteChunkedFilmToStream(ofs) :
+		WriteFilmToStream(ofs, false, true, writeFlmDirect);
 	ofs.close();
 
 	if (writeSuccessful)
@@ -1988,6 +2819,11 @@ bool Film::WriteFilmToStream(
 
 double Film::MergeFilmFromFile(const std::string& filename)
 {
+	if (IsChunkedFilmFile(filename)) {
+		LOG(LUX_INFO, LUX_NOERROR) << "Reading chunked resume film from file " << filename;
+		return MergeChunkedFilmFromFile(filename);
+	}
+
 	std::ifstream ifs(filename.c_str(), std::ios_base::in | std::ios_base::binary);
 	if (!ifs.good())
 		return 0;
@@ -2000,102 +2836,70 @@ double Film::MergeFilmFromStream(std::basic_istream<char> &stream) {
 	const bool isLittleEndian = osIsLittleEndian();
 	LOG(LUX_DEBUG, LUX_NOERROR) << "Receiving film (little endian=" << boost::lexical_cast<std::string>(isLittleEndian) << ")";
 
-	// Enable compression
-	// TODO Move this below header when implementing FILM VERSION 2
-	boost::iostreams::filtering_stream<boost::iostreams::input> in;
-	in.push(boost::iostreams::gzip_decompressor());
-	in.push(stream);
-
-	// Read header
-	FlmHeader header;
-	if (!header.Read(in, isLittleEndian, this))
-		return 0.f;
+	FlmStreamData data;
+	if (!data.Read(stream, isLittleEndian, this)) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "IO error while receiving film buffers";
+		return 0.;
+	}
 
-	// Read buffer groups
-	vector<double> bufferGroupNumSamples(bufferGroups.size());
-	vector<BlockedArray<Pixel>*> tmpPixelArrays(bufferGroups.size() * bufferConfigs.size());
-	for (u_int i = 0; i < bufferGroups.size(); i++) {
-		double numberOfSamples;
-		numberOfSamples = osReadLittleEndianDouble(isLittleEndian, in);
-		if (!in.good())
-			break;
-		bufferGroupNumSamples[i] = numberOfSamples;
+	// Update parameters
+	for (vector<FlmParameter>::iterator it = data.header.params.begin(); it != data.header.params.end(); ++it)
+		it->Set(this);
 
-		// Read buffers
-		for(u_int j = 0; j < bufferConfigs.size(); ++j) {
-			const Buffer* localBuffer = bufferGroups[i].getBuffer(j);
-			// Read pixels
-			BlockedArray<Pixel> *tmpPixelArr = new BlockedArray<Pixel>(
-				localBuffer->xPixelCount, localBuffer->yPixelCount);
-			tmpPixelArrays[i*bufferConfigs.size() + j] = tmpPixelArr;
-			for (u_int y = 0; y < tmpPixelArr->vSize(); ++y) {
-				for (u_int x = 0; x < tmpPixelArr->uSize(); ++x) {
-					Pixel &pixel = (*tmpPixelArr)(x, y);
-					pixel.L.c[0] = osReadLittleEndianFloat(isLittleEndian, in);
-					pixel.L.c[1] = osReadLittleEndianFloat(isLittleEndian, in);
-					pixel.L.c[2] = osReadLittleEndianFloat(isLittleEndian, in);
-					pixel.alpha = osReadLittleEndianFloat(isLittleEndian, in);
-					pixel.weightSum = osReadLittleEndianFloat(isLittleEndian, in);
-				}
-			}
-			if (!in.good())
-				break;
-		}
-		if (!in.good())
-			break;
+	// lock the pool
+	ScopedPoolLock poolLock(contribPool);
 
-		LOG( LUX_DEBUG,LUX_NOERROR)
-			<< "Received " << bufferGroupNumSamples[i] << " samples for buffer group " << i
-			<< " (buffer config size: " << bufferConfigs.size() << ")";
-	}
+	// Dade - add all received data
+	AddPixelArrays(data.pixelArrays);
+	const double maxTotNumberOfSamples = AddBufferGroupSamples(data.numberOfSamples);
 
-	// Dade - check for errors
-	double totNumberOfSamples = 0.;
-	double maxTotNumberOfSamples = 0.;
-	if (in.good()) {
-		// Update parameters
-		for (vector<FlmParameter>::iterator it = header.params.begin(); it != header.params.end(); ++it)
-			it->Set(this);
+	LOG( LUX_DEBUG,LUX_NOERROR) << "Received film with " << maxTotNumberOfSamples << " samples per buffer group";
 
-		// lock the pool
-		ScopedPoolLock poolLock(contribPool);
+	return maxTotNumberOfSamples;
+}
 
-		// Dade - add all received data
-		for (u_int i = 0; i < bufferGroups.size(); ++i) {
-			BufferGroup &currentGroup = bufferGroups[i];
-			for (u_int j = 0; j < bufferConfigs.size(); ++j) {
-				const BlockedArray<Pixel> *receivedPixels = tmpPixelArrays[ i * bufferConfigs.size() + j ];
-				Buffer *buffer = currentGroup.getBuffer(j);
-
-				for (u_int y = 0; y < buffer->yPixelCount; ++y) {
-					for (u_int x = 0; x < buffer->xPixelCount; ++x) {
-						const Pixel &pixel = (*receivedPixels)(x, y);
-						Pixel &pixelResult = buffer->pixels(x, y);
-						pixelResult.L.c[0] += pixel.L.c[0];
-						pixelResult.L.c[1] += pixel.L.c[1];
-						pixelResult.L.c[2] += pixel.L.c[2];
-						pixelResult.alpha += pixel.alpha;
-						pixelResult.weightSum += pixel.weightSum;
-					}
+void Film::AddPixelArrays(const vector<BlockedArray<Pixel>*> &pixelArrays)
+{
+	for (u_int i = 0; i < bufferGroups.size(); ++i) {
+		BufferGroup &currentGroup = bufferGroups[i];
+		for (u_int j = 0; j < bufferConfigs.size(); ++j) {
+			const BlockedArray<Pixel> *receivedPixels = pixelArrays[ i * bufferConfigs.size() + j ];
+			Buffer *buffer = currentGroup.getBuffer(j);
+
+			for (u_int y = 0; y < buffer->yPixelCount; ++y) {
+				for (u_int x = 0; x < buffer->xPixelCount; ++x) {
+					const Pixel &pixel = (*receivedPixels)(x, y);
+					// Don't allocate pixels for nothing
+					if (pixel.weightSum == 0.f && pixel.alpha == 0.f && pixel.L.Black())
+						continue;
+					Pixel &pixelResult = buffer->pixels(x, y);
+					pixelResult.L.c[0] += pixel.L.c[0];
+					pixelResult.L.c[1] += pixel.L.c[1];
+					pixelResult.L.c[2] += pixel.L.c[2];
+					pixelResult.alpha += pixel.alpha;
+					pixelResult.weightSum += pixel.weightSum;
 				}
 			}
-
-			currentGroup.numberOfSamples += bufferGroupNumSamples[i];
-			// Check if we have enough samples per pixel
-			if ((haltSamplesPerPixel > 0) &&
-				(currentGroup.numberOfSamples >= haltSamplesPerPixel * samplePerPass))
-				enoughSamplesPerPixel = true;
-			totNumberOfSamples += bufferGroupNumSamples[i];
-			maxTotNumberOfSamples = max(maxTotNumberOfSamples, bufferGroupNumSamples[i]);
 		}
+	}
+}
 
-		LOG( LUX_DEBUG,LUX_NOERROR) << "Received film with " << totNumberOfSamples << " samples";
-	} else
-		LOG( LUX_ERROR,LUX_SYSTEM)<< "IO error while receiving film buffers";
+double Film::AddBufferGroupSamples(const vector<double> &numberOfSamples)
+{
+	double totNumberOfSamples = 0.;
+	double maxTotNumberOfSamples = 0.;
+	for (u_int i = 0; i < bufferGroups.size(); ++i) {
+		BufferGroup &currentGroup = bufferGroups[i];
+		currentGroup.numberOfSamples += numberOfSamples[i];
+		// Check if we have enough samples per pixel
+		if ((haltSamplesPerPixel > 0) &&
+			(currentGroup.numberOfSamples >= haltSamplesPerPixel * samplePerPass))
+			enoughSamplesPerPixel = true;
+		totNumberOfSamples += numberOfSamples[i];
+		maxTotNumberOfSamples = max(maxTotNumberOfSamples, numberOfSamples[i]);
+	}
 
-	// Clean up
-	for (u_int i = 0; i < tmpPixelArrays.size(); ++i)
-		delete tmpPixelArrays[i];
+	LOG( LUX_DEBUG,LUX_NOERROR) << "Added " << totNumberOfSamples << " samples to the film";
 
 	return maxTotNumberOfSamples;
 }
@@ -2115,103 +2919,16 @@ bool Film::WriteFilmDataToStream(
 	// Enable compression
 	// TODO Move this below header when implementing FILM VERSION 2
 	boost::iostreams::filtering_stream<boost::iostreams::output> fs;
-	fs.push(boost::iostreams::gzip_compressor(4));
+	PushFlmCompressor(fs, flmCompression, 4);
 	fs.push(os);
 
 	// Write the header
 	FlmHeader header;
-	header.magicNumber = FLM_MAGIC_NUMBER;
-	header.versionNumber = FLM_VERSION;
-	header.xResolution = xPixelCount;
-	header.yResolution = yPixelCount;
-	header.numBufferGroups = bufferGroups.size();
-	header.numBufferConfigs = bufferConfigs.size();
-	for (u_int i = 0; i < bufferConfigs.size(); ++i)
-		header.bufferTypes.push_back(bufferConfigs[i].type);
-	// Write parameters
-	if (transmitParams) {
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_TONEMAPKERNEL, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_REINHARD_PRESCALE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_REINHARD_POSTSCALE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_REINHARD_BURN, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_SENSITIVITY, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_EXPOSURE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_FSTOP, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_LINEAR_GAMMA, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TM_CONTRAST_YWA, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LDR_CLAMP_METHOD, 0));		
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_WHITE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_WHITE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_RED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_RED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_GREEN, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_GREEN, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_X_BLUE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_Y_BLUE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_TORGB_GAMMA, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_CAMERA_RESPONSE_ENABLED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_STRING, LUX_FILM_CAMERA_RESPONSE_FILE, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_UPDATEBLOOMLAYER, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_DELETEBLOOMLAYER, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_BLOOMRADIUS, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_BLOOMWEIGHT, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_VIGNETTING_ENABLED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_VIGNETTING_SCALE, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_ABERRATION_ENABLED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_ABERRATION_AMOUNT, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_UPDATEGLARELAYER, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_DELETEGLARELAYER, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_AMOUNT, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_RADIUS, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_BLADES, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_GLARE_THRESHOLD, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_CHIU_ENABLED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_CHIU_RADIUS, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_CHIU_INCLUDECENTER, 0));
-
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_ENABLED, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_AMPLITUDE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_NBITER, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_SHARPNESS, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_ANISOTROPY, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_ALPHA, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_SIGMA, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_FASTAPPROX, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_GAUSSPREC, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_DL, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_DA, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_INTERP, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_TILE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_BTILE, 0));
-		header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_NOISE_GREYC_THREADS, 0));
-
-		for(u_int i = 0; i < GetNumBufferGroups(); ++i) {
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE, i));
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_ENABLE, i));
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE_RED, i));
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE_GREEN, i));
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_SCALE_BLUE, i));
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_FLOAT, LUX_FILM_LG_TEMPERATURE, i));
-
-			header.params.push_back(FlmParameter(this, FLM_PARAMETER_TYPE_STRING, LUX_FILM_LG_NAME, i));
-		}
-
-		header.numParams = header.params.size();
-	} else {
-		header.numParams = 0;
-	}
+	header.Fill(this, transmitParams);
 	header.Write(fs, isLittleEndian);
+	// Start the pixel data on a new codec block so that the float planes
+	// are word aligned for the shuffling codec
+	fs.flush();
 
 	// Write each buffer group
 	double totNumberOfSamples = 0.;
@@ -2225,7 +2942,7 @@ bool Film::WriteFilmDataToStream(
 			Buffer* buffer = bufferGroup.getBuffer(j);
 
 			// Write pixels
-			const BlockedArray<Pixel>* pixelBuf = &(buffer->pixels);
+			const SparsePixelArray* pixelBuf = &(buffer->pixels);
 			for (u_int y = 0; y < pixelBuf->vSize(); ++y) {
 				for (u_int x = 0; x < pixelBuf->uSize(); ++x) {
 					const Pixel &pixel = (*pixelBuf)(x, y);
@@ -2266,15 +2983,22 @@ bool Film::LoadResumeFilm(const string &filename)
 	LOG(LUX_DEBUG,LUX_NOERROR) << "Loading film (little endian=" << boost::lexical_cast<std::string>(isLittleEndian) << ")";
 	std::ifstream is(filename.c_str(), std::ios_base::in | std::ios_base::binary);
 
-	// Enable compression
-	// TODO Move this below header when implementing FILM VERSION 2
-	boost::iostreams::filtering_stream<boost::iostreams::input> fs;
-	fs.push(boost::iostreams::gzip_decompressor());
-	fs.push(is);
-
 	FlmHeader header;
-	if (!header.Read(fs, isLittleEndian, NULL))
-		return false;
+	if (IsChunkedFilmFile(filename)) {
+		FlmChunkIndex index;
+		if (!index.ReadHeader(is, isLittleEndian, NULL))
+			return false;
+		header = index.header;
+	} else {
+		// Enable compression
+		// TODO Move this below header when implementing FILM VERSION 2
+		boost::iostreams::filtering_stream<boost::iostreams::input> fs;
+		PushFlmDecompressor(fs, is);
+		fs.push(is);
+
+		if (!header.Read(fs, isLittleEndian, NULL))
+			return false;
+	}
 	is.close();
 
 	xResolution = static_cast<int>(header.xResolution);
@@ -31,10 +31,14 @@
 #include "bsh.h"
 #include "luxrays/utils/convtest/convtest.h"
 #include "mcdistribution.h"
+#include "flmcodec.h"
+#include "osfunc.h"
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/xtime.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace lux {
 
@@ -102,6 +106,59 @@ struct FloatPixel {
 	float V, weightSum;
 };
 
+/**
+ * Pixels of a Buffer, stored in square pages that are only allocated once
+ * something is written to them. Buffers of light groups that never receive
+ * a contribution, or only on part of the image, take little memory.
+ * Reading an unallocated pixel returns a black pixel.
+ */
+class SparsePixelArray : public boost::noncopyable {
+public:
+	SparsePixelArray(u_int x, u_int y);
+	~SparsePixelArray();
+
+	size_t uSize() const { return uRes; }
+	size_t vSize() const { return vRes; }
+
+	// Write access, the page is allocated if needed. Different pixels
+	// may be written concurrently.
+	Pixel &operator()(u_int u, u_int v) {
+		Pixel *page = osAtomicReadPointer(&pages[PageIndex(u, v)]);
+		if (!page)
+			page = AllocatePage(PageIndex(u, v));
+		return page[PageOffset(u, v)];
+	}
+	const Pixel &operator()(u_int u, u_int v) const {
+		const Pixel *page = osAtomicReadPointer(&pages[PageIndex(u, v)]);
+		return page ? page[PageOffset(u, v)] : black;
+	}
+
+	// Resets the allocated pages to black, they are kept allocated
+	// since other threads may be writing to them
+	void Clear();
+	// Memory used by the allocated pages in bytes
+	size_t GetAllocatedBytes() const;
+
+private:
+	// Pages are 32x32 pixels
+	static const u_int logPageSize = 5;
+	static const u_int pageSize = 1 << logPageSize;
+
+	u_int PageIndex(u_int u, u_int v) const {
+		return (v >> logPageSize) * uPages + (u >> logPageSize);
+	}
+	static u_int PageOffset(u_int u, u_int v) {
+		return ((v & (pageSize - 1)) << logPageSize) + (u & (pageSize - 1));
+	}
+	Pixel *AllocatePage(u_int index);
+
+	u_int uRes, vRes, uPages, pageCount;
+	// Pages are published with osAtomicWritePointer once constructed
+	Pixel **pages;
+	boost::mutex allocationMutex;
+	static const Pixel black;
+};
+
 class Buffer {
 public:
 	Buffer(u_int x, u_int y) : pixels(x, y) {
@@ -126,22 +183,13 @@ public:
 	}
 
 	void Clear() {
-		for (u_int y = 0, offset = 0; y < yPixelCount; ++y) {
-			for (u_int x = 0; x < xPixelCount; ++x, ++offset) {
-				Pixel &pixel = pixels(x, y);
-				pixel.L.c[0] = 0.0f;
-				pixel.L.c[1] = 0.0f;
-				pixel.L.c[2] = 0.0f;
-				pixel.alpha = 0.0f;
-				pixel.weightSum = 0.0f;
-			}
-		}
+		pixels.Clear();
 	}
 
 	virtual void GetData(XYZColor *color, float *alpha) const = 0;
 	virtual float GetData(u_int x, u_int y, XYZColor *color, float *alpha) const = 0;
 	u_int xPixelCount, yPixelCount;
-	BlockedArray<Pixel> pixels;
+	SparsePixelArray pixels;
 	float scaleFactor;
 	bool isFramebuffer;
 };
@@ -602,8 +650,9 @@ public:
 	Film(u_int xres, u_int yres, Filter *filt, u_int filtRes, const float crop[4],
 		const string &filename1, bool premult, bool useZbuffer,
 		bool w_resume_FLM, bool restart_resume_FLM, bool write_FLM_direct,
+		bool write_FLM_chunked, FlmCompression flm_compression,
 		int haltspp, int halttime, float haltthreshold, bool debugmode, int outlierk,
-		int tilecount, const string &samplingmapfilename);
+		int tilecount, u_int tilesize, const string &samplingmapfilename);
 
 	virtual ~Film();
 
@@ -638,6 +687,24 @@ public:
 	virtual double MergeFilmFromFile(const std::string& filename);
 	virtual double MergeFilmFromStream(std::basic_istream<char> &stream);
 	virtual bool LoadResumeFilm(const string &filename);
+	/*
+	 * Chunked FLM files store each buffer tile independently compressed
+	 * behind an index, they are memory mapped and merged in parallel.
+	 */
+	virtual bool WriteChunkedFilmToStream(std::basic_ostream<char> &stream);
+	virtual double MergeChunkedFilmFromFile(const string &filename);
+	static bool IsChunkedFilmFile(const string &filename);
+	/*
+	 * Merges many FLM files at once. Chunked files are reduced tile by tile
+	 * across threads, streamed files are decoded concurrently, as many at a
+	 * time as fit in memoryBudget bytes (0 means no limit), and reduced row
+	 * by row across threads.
+	 * @param skippedCount Receives the number of unreadable files and of
+	 * files with corrupted tiles
+	 * @return the number of files merged without error
+	 */
+	virtual u_int MergeFilmsFromFiles(const vector<string> &filenames, u_int threadCount = 0,
+		size_t memoryBudget = 0, u_int *skippedCount = NULL);
 
 	virtual void RequestBufferGroups(const vector<string> &bg);
 	virtual u_int RequestBuffer(BufferType type, BufferOutputConfig output, const string& filePostfix);
@@ -651,12 +718,13 @@ public:
 
 	/**
 	 * Get the indexes that the current contribution spans.
-	 * Current implementation is limited to at most two tiles, ie the tiles are slabs.
-	 * @param tileIndex0 First tile index, always set.
-	 * @param tileIndex1 Second tile index if the contribution spans more than one tile, otherwise undefined.
-	 * @return Number of tiles that the contribution spans, 1 or 2.
+	 * The tiles are either horizontal slabs or, when a tile size is set,
+	 * square tiles. Tiles are never smaller than the filter footprint so a
+	 * contribution spans at most two tiles along each axis.
+	 * @param tiles Array of at least 4 elements receiving the tile indexes.
+	 * @return Number of tiles that the contribution spans, 1 to 4.
 	 */
-	virtual u_int GetTileIndexes(const Contribution &contrib, u_int *tile0, u_int *tile1) const;
+	virtual u_int GetTileIndexes(const Contribution &contrib, u_int *tiles) const;
 	/*
 	 * Returns the total number of tiles in the film.
 	 * @return Total number of tiles in the film.
@@ -755,6 +823,10 @@ public:
 
 	ContributionPool *contribPool;
 
+protected:
+	void AddPixelArrays(const vector<BlockedArray<Pixel>*> &pixelArrays);
+	double AddBufferGroupSamples(const vector<double> &numberOfSamples);
+
 protected: // Put it here for better data alignment
 	// Dade - (xResolution + filter->xWidth) * (yResolution + filter->yWidth)
 	double samplePerPass;
@@ -772,6 +844,9 @@ protected: // Put it here for better data alignment
 	u_int xPixelStart, yPixelStart, xPixelCount, yPixelCount;
 	u_int tileCount, tileHeight;
 	float invTileHeight, tileOffset, tileOffset2;
+	// Square tiles are split in columns too, slabs have a single column
+	u_int tileColumns, tileWidth;
+	float invTileWidth, tileOffsetX, tileOffset2X;
 	ColorSystem colorSpace; // needed here for ComputeGroupScale()
 
 	std::vector<BufferConfig> bufferConfigs;
@@ -810,7 +885,8 @@ protected: // Put it here for better data alignment
 
 
 	bool writeResumeFlm, restartResumeFlm;
-	bool writeFlmDirect;
+	bool writeFlmDirect, writeFlmChunked;
+	FlmCompression flmCompression;
 
 	// density-based outlier rejection
 	int outlierRejection_k;
@@ -840,6 +916,10 @@ private:
 	float GetCropWindow1() { return cropWindow[1]; }
 	float GetCropWindow2() { return cropWindow[2]; }
 	float GetCropWindow3() { return cropWindow[3]; }
+	string GetFlmCompression() { return FlmCompressionToString(flmCompression); }
+	void SetFlmCompression(string name) { flmCompression = FlmCompressionFromString(name); }
+	double GetSplattedContributions();
+	double GetSplattingLockWait();
 
 	// Gets a reference to the appropriate outlier row data for a given position and tile index.
 	std::vector<OutlierAccel>& GetOutlierAccelRow(u_int oY, u_int tileIndex, u_int tileStart, u_int tileEnd);
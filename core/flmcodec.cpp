@@ -0,0 +1,292 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+// flmcodec.cpp*
+#include "flmcodec.h"
+
+#include <cstring>
+#include <boost/iostreams/filter/gzip.hpp>
+
+using namespace lux;
+
+// The LZ codec is a byte oriented LZ77 variant with the same sequence
+// layout as LZ4: a token holding the literal length in the high nibble and
+// the match length minus LZ_MINMATCH in the low nibble, both extended with
+// 255 terminated byte runs, the literals and a 16 bit little endian offset.
+// The last sequence of a block only holds literals.
+static const u_int LZ_MINMATCH = 4;
+static const u_int LZ_LASTLITERALS = 5;
+static const u_int LZ_MAXOFFSET = 65535;
+static const u_int LZ_HASHLOG = 14;
+
+static inline u_int LZRead32(const char *p)
+{
+	u_int v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline u_int LZHash(u_int v)
+{
+	return (v * 2654435761U) >> (32 - LZ_HASHLOG);
+}
+
+static inline char *LZWriteLength(char *op, u_int len)
+{
+	while (len >= 255) {
+		*op++ = static_cast<char>(255);
+		len -= 255;
+	}
+	*op++ = static_cast<char>(len);
+	return op;
+}
+
+static char *LZWriteSequence(char *op, const char *literals, u_int litLen,
+	u_int offset, u_int matchLen)
+{
+	char *token = op++;
+	u_int t = (litLen >= 15 ? 15 : litLen) << 4;
+	if (litLen >= 15)
+		op = LZWriteLength(op, litLen - 15);
+	memcpy(op, literals, litLen);
+	op += litLen;
+	if (matchLen > 0) {
+		*op++ = static_cast<char>(offset & 0xff);
+		*op++ = static_cast<char>(offset >> 8);
+		const u_int m = matchLen - LZ_MINMATCH;
+		t |= m >= 15 ? 15 : m;
+		if (m >= 15)
+			op = LZWriteLength(op, m - 15);
+	}
+	*token = static_cast<char>(t);
+	return op;
+}
+
+static u_int LZCompress(const char *in, u_int size, char *out)
+{
+	char *op = out;
+	u_int anchor = 0;
+	if (size > LZ_MINMATCH + LZ_LASTLITERALS) {
+		vector<int> table(1 << LZ_HASHLOG, -1);
+		const u_int matchEnd = size - LZ_LASTLITERALS;
+		u_int ip = 0;
+		while (ip + LZ_MINMATCH <= matchEnd) {
+			const u_int seq = LZRead32(in + ip);
+			const u_int h = LZHash(seq);
+			const int ref = table[h];
+			table[h] = static_cast<int>(ip);
+			if (ref < 0 || ip - ref > LZ_MAXOFFSET ||
+				LZRead32(in + ref) != seq) {
+				// Skip faster through incompressible data
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			u_int len = LZ_MINMATCH;
+			while (ip + len < matchEnd && in[ref + len] == in[ip + len])
+				++len;
+			op = LZWriteSequence(op, in + anchor, ip - anchor, ip - ref, len);
+			ip += len;
+			anchor = ip;
+		}
+	}
+	op = LZWriteSequence(op, in + anchor, size - anchor, 0, 0);
+	return static_cast<u_int>(op - out);
+}
+
+static inline bool LZReadLength(const unsigned char *src, u_int packedSize,
+	u_int &ip, u_int &len)
+{
+	u_int b;
+	do {
+		if (ip >= packedSize)
+			return false;
+		b = src[ip++];
+		len += b;
+	} while (b == 255);
+	return true;
+}
+
+static bool LZDecompress(const char *in, u_int packedSize, char *out,
+	u_int rawSize)
+{
+	const unsigned char *src = reinterpret_cast<const unsigned char *>(in);
+	u_int ip = 0, op = 0;
+	while (ip < packedSize) {
+		const u_int token = src[ip++];
+		u_int litLen = token >> 4;
+		if (litLen == 15 && !LZReadLength(src, packedSize, ip, litLen))
+			return false;
+		if (litLen > packedSize - ip || litLen > rawSize - op)
+			return false;
+		memcpy(out + op, in + ip, litLen);
+		ip += litLen;
+		op += litLen;
+		// The last sequence has no match
+		if (ip == packedSize)
+			break;
+		if (packedSize - ip < 2)
+			return false;
+		const u_int offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op)
+			return false;
+		u_int matchLen = token & 15;
+		if (matchLen == 15 && !LZReadLength(src, packedSize, ip, matchLen))
+			return false;
+		matchLen += LZ_MINMATCH;
+		if (matchLen > rawSize - op)
+			return false;
+		// Matches may overlap their own output
+		const char *ref = out + op - offset;
+		if (offset >= matchLen)
+			memcpy(out + op, ref, matchLen);
+		else {
+			for (u_int i = 0; i < matchLen; ++i)
+				out[op + i] = ref[i];
+		}
+		op += matchLen;
+	}
+	return op == rawSize;
+}
+
+// Transposes the bytes of 4 byte elements so that all first bytes come
+// first, then all second bytes and so on. Trailing bytes are copied as is.
+static void ByteShuffle(const char *src, u_int size, char *dst)
+{
+	const u_int n = size / 4;
+	for (u_int i = 0; i < n; ++i) {
+		dst[i] = src[4 * i];
+		dst[n + i] = src[4 * i + 1];
+		dst[2 * n + i] = src[4 * i + 2];
+		dst[3 * n + i] = src[4 * i + 3];
+	}
+	memcpy(dst + 4 * n, src + 4 * n, size - 4 * n);
+}
+
+static void ByteUnshuffle(const char *src, u_int size, char *dst)
+{
+	const u_int n = size / 4;
+	for (u_int i = 0; i < n; ++i) {
+		dst[4 * i] = src[i];
+		dst[4 * i + 1] = src[n + i];
+		dst[4 * i + 2] = src[2 * n + i];
+		dst[4 * i + 3] = src[3 * n + i];
+	}
+	memcpy(dst + 4 * n, src + 4 * n, size - 4 * n);
+}
+
+namespace lux
+{
+
+u_int LZCompressBlock(const char *src, u_int size, bool shuffle,
+	vector<char> &scratch, vector<char> &out)
+{
+	const char *in = src;
+	if (shuffle) {
+		scratch.resize(size);
+		ByteShuffle(src, size, &scratch[0]);
+		in = &scratch[0];
+	}
+	out.resize(size + size / 255 + 16);
+	const u_int packedSize = LZCompress(in, size, &out[0]);
+	if (packedSize < size)
+		return packedSize;
+
+	// Incompressible, store the original data
+	memcpy(&out[0], src, size);
+	return size;
+}
+
+bool LZDecompressBlock(const char *src, u_int packedSize, u_int rawSize,
+	bool shuffle, vector<char> &scratch, char *out)
+{
+	if (packedSize == rawSize) {
+		memcpy(out, src, rawSize);
+		return true;
+	}
+	if (!shuffle)
+		return LZDecompress(src, packedSize, out, rawSize);
+
+	scratch.resize(rawSize);
+	if (!LZDecompress(src, packedSize, &scratch[0], rawSize))
+		return false;
+	ByteUnshuffle(&scratch[0], rawSize, out);
+	return true;
+}
+
+FlmCompression FlmCompressionFromString(const string &name)
+{
+	if (name == "gzip")
+		return FLM_COMPRESSION_GZIP;
+	if (name == "lz")
+		return FLM_COMPRESSION_LZ;
+	if (name == "lzshuffle")
+		return FLM_COMPRESSION_LZ_SHUFFLE;
+
+	LOG(LUX_WARNING, LUX_BADTOKEN) << "FLM compression '" << name <<
+		"' unknown. Using \"gzip\".";
+	return FLM_COMPRESSION_GZIP;
+}
+
+string FlmCompressionToString(FlmCompression compression)
+{
+	switch (compression) {
+		case FLM_COMPRESSION_LZ:
+			return "lz";
+		case FLM_COMPRESSION_LZ_SHUFFLE:
+			return "lzshuffle";
+		case FLM_COMPRESSION_GZIP:
+		default:
+			return "gzip";
+	}
+}
+
+void PushFlmCompressor(boost::iostreams::filtering_stream<boost::iostreams::output> &fs,
+	FlmCompression compression, int gzipLevel)
+{
+	switch (compression) {
+		case FLM_COMPRESSION_LZ:
+			fs.push(lz_compressor(false));
+			break;
+		case FLM_COMPRESSION_LZ_SHUFFLE:
+			fs.push(lz_compressor(true));
+			break;
+		case FLM_COMPRESSION_GZIP:
+		default:
+			fs.push(boost::iostreams::gzip_compressor(gzipLevel));
+			break;
+	}
+}
+
+FlmCompression PushFlmDecompressor(boost::iostreams::filtering_stream<boost::iostreams::input> &fs,
+	std::basic_istream<char> &raw)
+{
+	// gzip streams always start with 0x1f 0x8b
+	if (raw.peek() == LZCODEC_MAGIC[0]) {
+		fs.push(lz_decompressor());
+		return FLM_COMPRESSION_LZ;
+	}
+	fs.push(boost::iostreams::gzip_decompressor());
+	return FLM_COMPRESSION_GZIP;
+}
+
+}//namespace lux
@@ -0,0 +1,295 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+#ifndef LUX_FLMCODEC_H
+#define LUX_FLMCODEC_H
+// flmcodec.h*
+
+#include "lux.h"
+#include "error.h"
+
+#include <istream>
+#include <boost/iostreams/categories.hpp>
+#include <boost/iostreams/operations.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+namespace lux
+{
+
+/**
+ * Compression codecs available for FLM files and network films.
+ *
+ * FLM_COMPRESSION_GZIP is the historic format and is still the default so
+ * that older readers can load the files. FLM_COMPRESSION_LZ is a block based
+ * LZ77 codec trading compression ratio for throughput and
+ * FLM_COMPRESSION_LZ_SHUFFLE additionally transposes the bytes of each
+ * 32 bit word inside a block, grouping the exponents of the float planes so
+ * that they compress much better.
+ * The codec of a stream is detected from its first byte on read.
+ */
+enum FlmCompression {
+	FLM_COMPRESSION_GZIP = 0,
+	FLM_COMPRESSION_LZ = 1,
+	FLM_COMPRESSION_LZ_SHUFFLE = 2
+};
+
+/**
+ * Parses a codec name ("gzip", "lz" or "lzshuffle"), unknown names fall back
+ * to gzip with a warning.
+ */
+FlmCompression FlmCompressionFromString(const string &name);
+string FlmCompressionToString(FlmCompression compression);
+
+/**
+ * Pushes the compressor for the given codec on a filtering stream.
+ * The gzip level is only used by FLM_COMPRESSION_GZIP.
+ */
+void PushFlmCompressor(boost::iostreams::filtering_stream<boost::iostreams::output> &fs,
+	FlmCompression compression, int gzipLevel = 4);
+
+/**
+ * Detects the codec used by the raw stream by peeking at its first byte
+ * and pushes the matching decompressor on the filtering stream.
+ * The raw stream itself is not pushed.
+ * @return the detected codec
+ */
+FlmCompression PushFlmDecompressor(boost::iostreams::filtering_stream<boost::iostreams::input> &fs,
+	std::basic_istream<char> &raw);
+
+// Stream layout of the LZ codecs:
+//   'L' 'X' 'Z' version - 4 bytes
+//   flags               - 1 byte  - bit 0 set if blocks are byte shuffled
+//   for each block
+//     rawSize           - u_int   - uncompressed size, 0 marks the end
+//     packedSize        - u_int   - size of the payload, equal to rawSize
+//                                   if the block is stored uncompressed
+//     payload           - packedSize bytes
+static const char LZCODEC_MAGIC[3] = { 'L', 'X', 'Z' };
+static const char LZCODEC_VERSION = 1;
+static const u_int LZCODEC_BLOCK_SIZE = 1 << 20;
+
+/**
+ * Compresses a block, optionally byte shuffled with 4 byte elements.
+ * @return the payload size, equal to size if the block is stored raw
+ */
+u_int LZCompressBlock(const char *src, u_int size, bool shuffle,
+	vector<char> &scratch, vector<char> &out);
+/**
+ * Decompresses a payload into exactly rawSize bytes.
+ * @return false if the payload is corrupted
+ */
+bool LZDecompressBlock(const char *src, u_int packedSize, u_int rawSize,
+	bool shuffle, vector<char> &scratch, char *out);
+
+class lz_compressor {
+public:
+	typedef char char_type;
+	struct category : boost::iostreams::multichar_output_filter_tag,
+		boost::iostreams::closable_tag, boost::iostreams::flushable_tag { };
+
+	lz_compressor(bool shuffle = true) : shuffleBlocks(shuffle),
+		headerWritten(false) {
+		buffer.reserve(LZCODEC_BLOCK_SIZE);
+	}
+
+	template<typename Sink>
+	std::streamsize write(Sink &snk, const char *s, std::streamsize n) {
+		std::streamsize left = n;
+		while (left > 0) {
+			const std::streamsize chunk = min<std::streamsize>(left,
+				LZCODEC_BLOCK_SIZE - buffer.size());
+			buffer.insert(buffer.end(), s, s + chunk);
+			s += chunk;
+			left -= chunk;
+			if (buffer.size() == LZCODEC_BLOCK_SIZE &&
+				!WriteBlock(snk))
+				return -1;
+		}
+		return n;
+	}
+
+	// A flush terminates the current block so that the next write starts
+	// a new one, this keeps the float planes aligned for shuffling
+	template<typename Sink>
+	bool flush(Sink &snk) {
+		return WriteBlock(snk) && boost::iostreams::flush(snk);
+	}
+
+	template<typename Sink>
+	void close(Sink &snk) {
+		WriteBlock(snk);
+		// End marker
+		WriteHeader(snk);
+		char end[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		boost::iostreams::write(snk, end, 8);
+		headerWritten = false;
+	}
+
+private:
+	template<typename Sink>
+	bool WriteHeader(Sink &snk) {
+		if (headerWritten)
+			return true;
+		char header[5] = { LZCODEC_MAGIC[0], LZCODEC_MAGIC[1],
+			LZCODEC_MAGIC[2], LZCODEC_VERSION,
+			static_cast<char>(shuffleBlocks ? 1 : 0) };
+		headerWritten = true;
+		return boost::iostreams::write(snk, header, 5) == 5;
+	}
+
+	template<typename Sink>
+	bool WriteBlock(Sink &snk) {
+		if (!WriteHeader(snk))
+			return false;
+		if (buffer.empty())
+			return true;
+		const u_int rawSize = buffer.size();
+		const u_int packedSize = LZCompressBlock(&buffer[0], rawSize,
+			shuffleBlocks, scratch, packed);
+		char sizes[8];
+		StoreUInt(sizes, rawSize);
+		StoreUInt(sizes + 4, packedSize);
+		buffer.clear();
+		return boost::iostreams::write(snk, sizes, 8) == 8 &&
+			boost::iostreams::write(snk, &packed[0], packedSize) == packedSize;
+	}
+
+	static void StoreUInt(char *dst, u_int v) {
+		dst[0] = static_cast<char>(v & 0xff);
+		dst[1] = static_cast<char>((v >> 8) & 0xff);
+		dst[2] = static_cast<char>((v >> 16) & 0xff);
+		dst[3] = static_cast<char>((v >> 24) & 0xff);
+	}
+
+	bool shuffleBlocks, headerWritten;
+	vector<char> buffer, scratch, packed;
+};
+
+class lz_decompressor {
+public:
+	typedef char char_type;
+	struct category : boost::iostreams::multichar_input_filter_tag,
+		boost::iostreams::closable_tag { };
+
+	lz_decompressor() : headerRead(false), eof(false), shuffleBlocks(false),
+		pos(0) { }
+
+	template<typename Source>
+	std::streamsize read(Source &src, char *s, std::streamsize n) {
+		std::streamsize done = 0;
+		while (done < n) {
+			if (pos == block.size()) {
+				if (eof || !ReadBlock(src))
+					break;
+				continue;
+			}
+			const std::streamsize chunk = min<std::streamsize>(n - done,
+				block.size() - pos);
+			std::copy(block.begin() + pos, block.begin() + pos + chunk,
+				s + done);
+			pos += chunk;
+			done += chunk;
+		}
+		return (done == 0 && n > 0) ? -1 : done;
+	}
+
+	template<typename Source>
+	void close(Source &) {
+		headerRead = false;
+		eof = false;
+		block.clear();
+		pos = 0;
+	}
+
+private:
+	template<typename Source>
+	bool ReadFully(Source &src, char *s, std::streamsize n) {
+		while (n > 0) {
+			const std::streamsize r = boost::iostreams::read(src, s, n);
+			if (r <= 0)
+				return false;
+			s += r;
+			n -= r;
+		}
+		return true;
+	}
+
+	template<typename Source>
+	bool ReadBlock(Source &src) {
+		if (!headerRead) {
+			char header[5];
+			if (!ReadFully(src, header, 5) ||
+				header[0] != LZCODEC_MAGIC[0] ||
+				header[1] != LZCODEC_MAGIC[1] ||
+				header[2] != LZCODEC_MAGIC[2] ||
+				header[3] != LZCODEC_VERSION) {
+				LOG(LUX_ERROR, LUX_BADFILE) << "Invalid LZ stream header";
+				eof = true;
+				return false;
+			}
+			shuffleBlocks = (header[4] & 1) != 0;
+			headerRead = true;
+		}
+		char sizes[8];
+		if (!ReadFully(src, sizes, 8)) {
+			eof = true;
+			return false;
+		}
+		const u_int rawSize = LoadUInt(sizes);
+		const u_int packedSize = LoadUInt(sizes + 4);
+		if (rawSize == 0) {
+			eof = true;
+			return false;
+		}
+		if (rawSize > LZCODEC_BLOCK_SIZE || packedSize > rawSize) {
+			LOG(LUX_ERROR, LUX_BADFILE) << "Invalid LZ block size (raw=" <<
+				rawSize << ", packed=" << packedSize << ")";
+			eof = true;
+			return false;
+		}
+		packed.resize(packedSize);
+		block.resize(rawSize);
+		pos = 0;
+		if (!ReadFully(src, &packed[0], packedSize) ||
+			!LZDecompressBlock(&packed[0], packedSize, rawSize,
+				shuffleBlocks, scratch, &block[0])) {
+			LOG(LUX_ERROR, LUX_BADFILE) << "Corrupted LZ block";
+			block.clear();
+			eof = true;
+			return false;
+		}
+		return true;
+	}
+
+	static u_int LoadUInt(const char *src) {
+		const unsigned char *s = reinterpret_cast<const unsigned char *>(src);
+		return s[0] | (s[1] << 8) | (s[2] << 16) | (static_cast<u_int>(s[3]) << 24);
+	}
+
+	bool headerRead, eof, shuffleBlocks;
+	vector<char> block, packed, scratch;
+	size_t pos;
+};
+
+}//namespace lux
+
+#endif // LUX_FLMCODEC_H
@@ -68,6 +68,24 @@ public:
 		const Point &p, float u1, float u2, float u3,
 		BSDF **bsdf, float *pdf, float *pdfDirect,
 		SWCSpectrum *L) const = 0;
+	/**
+	 * Variant of SampleL for a point on a surface that only reflects
+	 * light on the side of n: the light may avoid directions below n.
+	 * LeHemisphere returns the matching pdfDirect for multiple
+	 * importance sampling, both default to the plain versions.
+	 */
+	virtual bool SampleLHemisphere(const Scene &scene, const Sample &sample,
+		const Point &p, const Normal &n, float u1, float u2, float u3,
+		BSDF **bsdf, float *pdf, float *pdfDirect,
+		SWCSpectrum *L) const {
+		return SampleL(scene, sample, p, u1, u2, u3, bsdf, pdf,
+			pdfDirect, L);
+	}
+	virtual bool LeHemisphere(const Scene &scene, const Sample &sample,
+		const Ray &r, const Normal &n, BSDF **bsdf, float *pdf,
+		float *pdfDirect, SWCSpectrum *L) const {
+		return Le(scene, sample, r, bsdf, pdf, pdfDirect, L);
+	}
 	const LightRenderingHints *GetRenderingHints() const { return &hints; }
 
 	void AddPortalShape(boost::shared_ptr<Primitive> &shape);
@@ -0,0 +1,121 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+// majorantgrid.cpp*
+#include "majorantgrid.h"
+#include "error.h"
+#include "osfunc.h"
+
+using namespace lux;
+
+// MajorantGrid Method Definitions
+MajorantGrid::MajorantGrid(const Transform &volumeToWorld, const BBox &e,
+	u_int resolution) : WorldToVolume(Inverse(volumeToWorld)), extent(e),
+	violations(0)
+{
+	const Vector size(extent.pMax - extent.pMin);
+	const float maxSize = max(size.x, max(size.y, size.z));
+	const float cellsPerUnit = maxSize > 0.f ? resolution / maxSize : 0.f;
+	nx = max(1U, Ceil2UInt(size.x * cellsPerUnit));
+	ny = max(1U, Ceil2UInt(size.y * cellsPerUnit));
+	nz = max(1U, Ceil2UInt(size.z * cellsPerUnit));
+	majorants.resize(nx * ny * nz, 0.f);
+}
+
+void MajorantGrid::ReportViolation(float density, float majorant) const
+{
+	if (osAtomicInc(&violations) == 0)
+		LOG(LUX_WARNING, LUX_CONSISTENCY) << "Volume density " <<
+			density << " exceeds its majorant " << majorant <<
+			", the volume tracking is biased";
+}
+
+BBox MajorantGrid::CellBound(u_int x, u_int y, u_int z) const
+{
+	const Vector size(extent.pMax - extent.pMin);
+	return BBox(
+		Point(extent.pMin.x + size.x * x / nx,
+			extent.pMin.y + size.y * y / ny,
+			extent.pMin.z + size.z * z / nz),
+		Point(extent.pMin.x + size.x * (x + 1) / nx,
+			extent.pMin.y + size.y * (y + 1) / ny,
+			extent.pMin.z + size.z * (z + 1) / nz));
+}
+
+MajorantGrid::Walker::Walker(const MajorantGrid &g, const Ray &ray) :
+	grid(g), done(true)
+{
+	// The volume space ray has the same parametrization
+	const Ray r(grid.WorldToVolume * ray);
+	if (!grid.extent.IntersectP(r, &t, &tMax) || !(tMax > t))
+		return;
+	done = false;
+
+	const int res[3] = { static_cast<int>(grid.nx),
+		static_cast<int>(grid.ny), static_cast<int>(grid.nz) };
+	const Point p(r(t));
+	for (u_int axis = 0; axis < 3; ++axis) {
+		const float size = (grid.extent.pMax[axis] -
+			grid.extent.pMin[axis]) / res[axis];
+		cell[axis] = Clamp(Floor2Int((p[axis] -
+			grid.extent.pMin[axis]) / size), 0, res[axis] - 1);
+		if (r.d[axis] > 0.f) {
+			step[axis] = 1;
+			end[axis] = res[axis];
+			tNext[axis] = t + (grid.extent.pMin[axis] +
+				(cell[axis] + 1) * size - p[axis]) / r.d[axis];
+			tDelta[axis] = size / r.d[axis];
+		} else if (r.d[axis] < 0.f) {
+			step[axis] = -1;
+			end[axis] = -1;
+			tNext[axis] = t + (grid.extent.pMin[axis] +
+				cell[axis] * size - p[axis]) / r.d[axis];
+			tDelta[axis] = -size / r.d[axis];
+		} else {
+			step[axis] = 0;
+			end[axis] = -1;
+			tNext[axis] = INFINITY;
+			tDelta[axis] = INFINITY;
+		}
+	}
+}
+
+bool MajorantGrid::Walker::Next(float *t0, float *t1, float *majorant)
+{
+	if (done)
+		return false;
+
+	// Find the axis of the next cell boundary
+	u_int axis = tNext[0] < tNext[1] ? 0 : 1;
+	if (tNext[2] < tNext[axis])
+		axis = 2;
+
+	*t0 = t;
+	*t1 = min(tNext[axis], tMax);
+	*majorant = grid.Majorant(cell[0], cell[1], cell[2]);
+
+	t = *t1;
+	cell[axis] += step[axis];
+	tNext[axis] += tDelta[axis];
+	done = t >= tMax || cell[axis] == end[axis];
+	return true;
+}
@@ -0,0 +1,134 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+#ifndef LUX_MAJORANTGRID_H
+#define LUX_MAJORANTGRID_H
+// majorantgrid.h*
+
+#include "lux.h"
+#include "geometry/transform.h"
+#include "luxrays/core/geometry/bbox.h"
+using luxrays::BBox;
+
+#include <cstring>
+
+namespace lux
+{
+
+/**
+ * Random numbers for the tracking decisions of Volume::Tau, which only
+ * receives one random offset. The ray origin and the salt decorrelate the
+ * rays tracked with the same offset.
+ */
+class TrackingRandom {
+public:
+	TrackingRandom(float offset, const Point &origin, const void *salt) {
+		state = Hash(static_cast<u_int>(reinterpret_cast<size_t>(salt)));
+		state = Hash(state ^ Bits(offset));
+		state = Hash(state ^ Bits(origin.x));
+		state = Hash(state ^ Bits(origin.y));
+		state = Hash(state ^ Bits(origin.z));
+	}
+	float floatValue() {
+		state = state * 1664525U + 1013904223U;
+		return (Hash(state) >> 8) * (1.f / 16777216.f);
+	}
+private:
+	static u_int Bits(float f) {
+		u_int bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+	static u_int Hash(u_int x) {
+		x ^= x >> 16;
+		x *= 0x7feb352dU;
+		x ^= x >> 15;
+		x *= 0x846ca68bU;
+		x ^= x >> 16;
+		return x;
+	}
+
+	u_int state;
+};
+
+/**
+ * Coarse grid of density upper bounds (majorants) over the extent of a
+ * density volume. The null collision tracking of DensityVolume walks the
+ * cells crossed by a ray and takes steps proportional to the inverse of
+ * the cell majorant, so empty and thin regions are crossed in a few steps.
+ */
+class MajorantGrid {
+public:
+	/**
+	 * @param extent Bounds of the grid in volume space
+	 * @param resolution Number of cells along the largest axis of the
+	 * extent, the other axes get proportionally less cells
+	 */
+	MajorantGrid(const Transform &volumeToWorld, const BBox &extent,
+		u_int resolution);
+
+	u_int XResolution() const { return nx; }
+	u_int YResolution() const { return ny; }
+	u_int ZResolution() const { return nz; }
+	// Volume space bounds of a cell
+	BBox CellBound(u_int x, u_int y, u_int z) const;
+	void SetMajorant(u_int x, u_int y, u_int z, float m) {
+		majorants[(z * ny + y) * nx + x] = m;
+	}
+	float Majorant(u_int x, u_int y, u_int z) const {
+		return majorants[(z * ny + y) * nx + x];
+	}
+	/**
+	 * Called by the tracking when a density exceeds the majorant of its
+	 * cell, the estimate is then biased. Only the first one is logged.
+	 */
+	void ReportViolation(float density, float majorant) const;
+
+	// Traversal of the cells crossed by a ray, in front to back order
+	class Walker {
+	public:
+		// The world space ray is walked between its mint and maxt
+		Walker(const MajorantGrid &g, const Ray &ray);
+		/**
+		 * Returns the next segment of the ray inside one cell.
+		 * @return false once the ray has left the grid
+		 */
+		bool Next(float *t0, float *t1, float *majorant);
+	private:
+		const MajorantGrid &grid;
+		int cell[3], step[3], end[3];
+		float tNext[3], tDelta[3];
+		float t, tMax;
+		bool done;
+	};
+
+private:
+	Transform WorldToVolume;
+	BBox extent;
+	u_int nx, ny, nz;
+	vector<float> majorants;
+	mutable u_int violations;
+};
+
+}//namespace lux
+
+#endif // LUX_MAJORANTGRID_H
@@ -80,6 +80,10 @@ public:
 
 /**
  * A utility class for sampling from a regularly sampled 1D distribution.
+ * Sampling either inverts the CDF with a binary search or uses an alias
+ * table in constant time. Both give the same pdfs, but the alias table
+ * doesn't map the random values monotonically to the samples, so it
+ * preserves less of the stratification of the random values.
  */
 class Distribution1D {
 public:
@@ -90,26 +94,38 @@ public:
 	 *
 	 * @param f The values of the function.
 	 * @param n The number of samples.
+	 * @param useAlias Whether to sample with an alias table instead of
+	 *                 the CDF.
 	 */
-	Distribution1D(const float *f, u_int n) {
+	Distribution1D(const float *f, u_int n, bool useAlias = false) :
+		cdf(NULL), prob(NULL), alias(NULL) {
 		func = new float[n];
-		cdf = new float[n + 1];
 		count = n;
 		invCount = 1.f / count;
 		memcpy(func, f, n * sizeof(float));
 		// funcInt is the sum of all f elements divided by the number
 		// of elements, ie the average value of f over [0;1)
-		ComputeStep1dCDF(func, n, &funcInt, cdf);
+		if (useAlias) {
+			vector<float> c(n + 1);
+			ComputeStep1dCDF(func, n, &funcInt, &c[0]);
+		} else {
+			cdf = new float[n + 1];
+			ComputeStep1dCDF(func, n, &funcInt, cdf);
+		}
 		if (funcInt > 0.f) {
 			const float invFuncInt = 1.f / funcInt;
 			// Normalize func to speed up computations
 			for (u_int i = 0; i < count; ++i)
 				func[i] *= invFuncInt;
 		}
+		if (useAlias)
+			ComputeAliasTable();
 	}
 	~Distribution1D() {
 		delete[] func;
 		delete[] cdf;
+		delete[] prob;
+		delete[] alias;
 	}
 
 	/**
@@ -124,6 +140,14 @@ public:
 	 * @return The x value of the sample (i.e. the x in f(x)).
 	 */ 
 	float SampleContinuous(float u, float *pdf, u_int *off = NULL) const {
+		if (alias) {
+			float du;
+			const u_int offset = SampleAlias(u, &du);
+			*pdf = func[offset];
+			if (off)
+				*off = offset;
+			return (offset + du) * invCount;
+		}
 		// Find surrounding CDF segments and _offset_
 		if (u <= cdf[0]) {
 			*pdf = func[0];
@@ -168,6 +192,14 @@ public:
 	 * @return The index of the sampled interval.
 	 */ 
 	u_int SampleDiscrete(float u, float *pdf, float *du = NULL) const {
+		if (alias) {
+			float r;
+			const u_int offset = SampleAlias(u, &r);
+			if (du)
+				*du = r;
+			*pdf = func[offset] * invCount;
+			return offset;
+		}
 		// Find surrounding CDF segments and _offset_
 		if (u <= cdf[0]) {
 			if (du)
@@ -213,13 +245,80 @@ public:
 	u_int Offset(float u) const {
 		return min(count - 1, Floor2UInt(u * count));
 	}
+	bool UsesAlias() const { return alias != NULL; }
 
 private:
+	/**
+	 * Builds the alias table from the normalized function with Vose's
+	 * method: each interval keeps the probability prob of being chosen
+	 * and gives the rest to its alias.
+	 */
+	void ComputeAliasTable() {
+		prob = new float[count];
+		alias = new u_int[count];
+		// Normalized func has an average of 1, or is 0 everywhere
+		// in which case sampling is uniform
+		vector<float> p(count);
+		vector<u_int> small, large;
+		for (u_int i = 0; i < count; ++i) {
+			p[i] = max(func[i], 0.f);
+			alias[i] = i;
+			if (p[i] < 1.f)
+				small.push_back(i);
+			else
+				large.push_back(i);
+		}
+		while (!small.empty() && !large.empty()) {
+			const u_int s = small.back();
+			small.pop_back();
+			const u_int l = large.back();
+			prob[s] = p[s];
+			alias[s] = l;
+			p[l] = (p[l] + p[s]) - 1.f;
+			if (p[l] < 1.f) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		// Leftovers are only due to rounding errors
+		for (u_int i = 0; i < small.size(); ++i)
+			prob[small[i]] = 1.f;
+		for (u_int i = 0; i < large.size(); ++i)
+			prob[large[i]] = 1.f;
+	}
+	/**
+	 * Samples an interval with the alias table.
+	 *
+	 * @param u  The random value used to sample.
+	 * @param du The remaining offset in the interval, in the [0,1) range.
+	 *
+	 * @return The index of the sampled interval.
+	 */
+	u_int SampleAlias(float u, float *du) const {
+		const float x = Clamp(u, 0.f, 1.f) * count;
+		const u_int i = min(count - 1, Floor2UInt(x));
+		// Keep r below 1, the largest float smaller than 1
+		const float r = min(x - i, 0.9999999403953552f);
+		if (r < prob[i]) {
+			*du = r / prob[i];
+			return i;
+		}
+		*du = (r - prob[i]) / (1.f - prob[i]);
+		return alias[i];
+	}
+
 	// Distribution1D Private Data
 	/*
-	 * The function and its cdf.
+	 * The function and its cdf, the cdf is NULL when the alias table is
+	 * used.
 	 */
 	float *func, *cdf;
+	/*
+	 * The alias table, the probability of keeping each interval and its
+	 * alias, NULL when the cdf is used.
+	 */
+	float *prob;
+	u_int *alias;
 	/**
 	 * The function integral (assuming it is regularly sampled with an interval of 1),
 	 * the inverted function integral and the inverted count.
@@ -234,17 +333,23 @@ private:
 class Distribution2D {
 public:
 	// Distribution2D Public Methods
-	Distribution2D(const float *data, u_int nu, u_int nv) {
+	/**
+	 * @param useAlias Whether the marginal and conditional distributions
+	 *                 are sampled with alias tables.
+	 */
+	Distribution2D(const float *data, u_int nu, u_int nv,
+		bool useAlias = false) {
 		pConditionalV.reserve(nv);
 		// Compute conditional sampling distribution for $\tilde{v}$
 		for (u_int v = 0; v < nv; ++v)
-			pConditionalV.push_back(new Distribution1D(data + v * nu, nu));
+			pConditionalV.push_back(new Distribution1D(data + v * nu, nu,
+				useAlias));
 		// Compute marginal sampling distribution $p[\tilde{v}]$
 		vector<float> marginalFunc;
 		marginalFunc.reserve(nv);
 		for (u_int v = 0; v < nv; ++v)
 			marginalFunc.push_back(pConditionalV[v]->Average());
-		pMarginal = new Distribution1D(&marginalFunc[0], nv);
+		pMarginal = new Distribution1D(&marginalFunc[0], nv, useAlias);
 	}
 	~Distribution2D() {
 		delete pMarginal;
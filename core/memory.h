@@ -44,6 +44,8 @@
 #include <boost/cstdint.hpp>
 using boost::int8_t;
 
+#include "profiler.h"
+
 namespace lux
 {
 // Memory Allocation Functions
@@ -217,6 +219,7 @@ public:
 #else
 		sz = ((sz + 7) & (~7U));
 #endif
+		PROFILE_COUNT(PROF_ARENA_BYTES, sz);
 		if (curBlockPos + sz > blockSize) {
 			// Get new block of memory for _MemoryArena_
 			currentBlockIdx++;
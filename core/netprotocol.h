@@ -0,0 +1,125 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+#ifndef LUX_NETPROTOCOL_H
+#define LUX_NETPROTOCOL_H
+// netprotocol.h*
+
+#include "lux.h"
+#include "osfunc.h"
+
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+
+namespace lux
+{
+
+// Binary command channel between RenderFarm and RenderServer.
+//
+// The master opens it by sending the text command NET_BINARY_COMMANDS, the
+// connection then carries length prefixed frames until an empty frame is
+// received or the connection is closed:
+//   size    - u_int   - size of the frame payload, 0 ends the channel
+//   payload - size bytes
+//     command - string  - same name as the text protocol command
+//     args    - command specific binary arguments
+// Strings are encoded as their u_int length followed by the characters and
+// all numbers are little endian. Commands are pipelined, the only replies
+// are the ones of luxGetFilm/luxGetLog and the file transfers of commands
+// referencing files, which use the same exchange as the text protocol.
+// The server messages are:
+//   kind    - string  - luxGetFilm, luxGetLog or luxPushFilm
+//   size    - u_int64 - size of the data
+//   data    - size bytes
+// After luxPushFilm (args: sid, float samples per pixel, u_int minimum
+// interval) the server sends luxPushFilm messages on its own, at any time
+// between replies. It holds back the next one until the master sends
+// luxFilmAck for the previous one.
+#define NET_BINARY_COMMANDS "luxBinaryCommands"
+
+// Largest accepted frame, guards against corrupted streams
+static const u_int NET_MAX_FRAME_SIZE = 1U << 30;
+
+inline void NetWriteString(bool isLittleEndian, std::basic_ostream<char> &os,
+	const string &s)
+{
+	osWriteLittleEndianUInt(isLittleEndian, os, s.size());
+	os.write(s.data(), s.size());
+}
+
+inline string NetReadString(bool isLittleEndian, std::basic_istream<char> &is)
+{
+	const u_int size = osReadLittleEndianUInt(isLittleEndian, is);
+	if (!is.good() || size > NET_MAX_FRAME_SIZE)
+		throw std::runtime_error("Invalid string in binary command");
+	string s(size, '\0');
+	if (size > 0)
+		is.read(&s[0], size);
+	return s;
+}
+
+inline void NetWriteSize(bool isLittleEndian, std::basic_ostream<char> &os,
+	boost::uint64_t size)
+{
+	osWriteLittleEndianUInt(isLittleEndian, os,
+		static_cast<u_int>(size & 0xffffffffU));
+	osWriteLittleEndianUInt(isLittleEndian, os,
+		static_cast<u_int>(size >> 32));
+}
+
+inline boost::uint64_t NetReadSize(bool isLittleEndian,
+	std::basic_istream<char> &is)
+{
+	const boost::uint64_t lo = osReadLittleEndianUInt(isLittleEndian, is);
+	const boost::uint64_t hi = osReadLittleEndianUInt(isLittleEndian, is);
+	return lo | (hi << 32);
+}
+
+inline void NetWriteFrame(bool isLittleEndian, std::basic_ostream<char> &os,
+	const string &payload)
+{
+	osWriteLittleEndianUInt(isLittleEndian, os, payload.size());
+	os.write(payload.data(), payload.size());
+}
+
+/**
+ * Reads the next frame of a binary channel.
+ * @return false at the end of the channel
+ */
+inline bool NetReadFrame(bool isLittleEndian, std::basic_istream<char> &is,
+	string &payload)
+{
+	const u_int size = osReadLittleEndianUInt(isLittleEndian, is);
+	if (!is.good() || size == 0)
+		return false;
+	if (size > NET_MAX_FRAME_SIZE)
+		throw std::runtime_error("Invalid binary command frame size");
+	payload.resize(size);
+	is.read(&payload[0], size);
+	return is.good();
+}
+
+}//namespace lux
+
+#endif // LUX_NETPROTOCOL_H
@@ -28,6 +28,11 @@
 
 #ifdef __linux__
 #include <sys/sysinfo.h>
+#include <sched.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
 #elif defined(__APPLE__) || defined(__FreeBSD__)
 #include <sys/types.h>
 #include <sys/sysctl.h>
@@ -135,6 +140,96 @@ uint32_t osReadLittleEndianUInt(bool isLittleEndian,
 	return osReadLittleEndian<uint32_t>(isLittleEndian, is);
 }
 
+#if defined(__linux__)
+// Reads a sysfs list of IDs, it looks like "0-7,16-23".
+// Returns false if the file doesn't exist.
+static bool osReadSysfsList(const std::string &path,
+	std::vector<unsigned int> *ids)
+{
+	std::ifstream in(path.c_str());
+	if (!in.good())
+		return false;
+	std::string list;
+	std::getline(in, list);
+
+	ids->clear();
+	std::istringstream ranges(list);
+	std::string range;
+	while (std::getline(ranges, range, ',')) {
+		unsigned int first, last;
+		const int n = sscanf(range.c_str(), "%u-%u", &first, &last);
+		if (n < 1)
+			continue;
+		if (n == 1)
+			last = first;
+		for (unsigned int id = first; id <= last; ++id)
+			ids->push_back(id);
+	}
+	return true;
+}
+
+// Reads the processors of a NUMA node from sysfs.
+// Returns false if the node doesn't exist.
+static bool osNumaNodeCPUs(unsigned int node, cpu_set_t *cpus)
+{
+	std::ostringstream path;
+	path << "/sys/devices/system/node/node" << node << "/cpulist";
+	std::vector<unsigned int> ids;
+	if (!osReadSysfsList(path.str(), &ids))
+		return false;
+
+	CPU_ZERO(cpus);
+	for (size_t i = 0; i < ids.size(); ++i) {
+		if (ids[i] < CPU_SETSIZE)
+			CPU_SET(ids[i], cpus);
+	}
+	return true;
+}
+#endif
+
+std::vector<unsigned int> osNumaNodes()
+{
+	std::vector<unsigned int> nodes;
+#if defined(WIN32)
+	ULONG highest;
+	if (GetNumaHighestNodeNumber(&highest)) {
+		for (ULONG node = 0; node <= highest; ++node) {
+			ULONGLONG mask;
+			if (GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) &&
+				mask != 0)
+				nodes.push_back(node);
+		}
+	}
+#elif defined(__linux__)
+	// Memory only nodes aren't in has_cpu, older kernels only have online
+	if (!osReadSysfsList("/sys/devices/system/node/has_cpu", &nodes))
+		osReadSysfsList("/sys/devices/system/node/online", &nodes);
+#endif
+	if (nodes.empty())
+		nodes.push_back(0);
+	return nodes;
+}
+
+bool osBindThreadToNumaNode(unsigned int node)
+{
+#if defined(WIN32)
+	ULONGLONG mask;
+	if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) ||
+		mask == 0)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(),
+		static_cast<DWORD_PTR>(mask)) != 0;
+#elif defined(__linux__)
+	cpu_set_t cpus;
+	if (!osNumaNodeCPUs(node, &cpus) || CPU_COUNT(&cpus) == 0)
+		return false;
+	// A pid of 0 is the calling thread
+	return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+	return false;
+#endif
+}
+
 namespace fpdebug
 {
 
@@ -29,6 +29,7 @@ using boost::int32_t;
 using boost::uint32_t;
 #include <istream>
 #include <ostream>
+#include <vector>
 
 #if defined(__linux__) || defined(__APPLE__) || defined(__CYGWIN__)
 #include <stddef.h>
@@ -84,6 +85,13 @@ extern void osWriteLittleEndianUInt(bool isLittleEndian,
 extern uint32_t osReadLittleEndianUInt(bool isLittleEndian,
 		std::basic_istream<char> &is);
 
+// IDs of the NUMA nodes of the machine with processors, they need not be
+// contiguous. Only node 0 when they can't be determined.
+extern std::vector<unsigned int> osNumaNodes();
+// Restricts the calling thread to the processors of a NUMA node,
+// returns false if the node has no processors or on failure
+extern bool osBindThreadToNumaNode(unsigned int node);
+
 inline double osWallClockTime() {
 #if defined(__linux__) || defined(__APPLE__) || defined(__CYGWIN__)
 	struct timeval t;
@@ -158,6 +166,40 @@ inline void osAtomicWrite(unsigned int *val, unsigned int newVal) {
 	atomic_write32(reinterpret_cast<boost::uint32_t*>(val), static_cast<boost::uint32_t>(newVal));
 }
 
+/**
+ * Reads a pointer with acquire semantics, the writes made before it was
+ * stored with osAtomicWritePointer are visible to the caller
+ * @return Pointer read
+ */
+template <class T> inline T *osAtomicReadPointer(T * const *ptr) {
+#if defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#elif defined(WIN32)
+	// Volatile reads have acquire semantics with MSVC
+	return *const_cast<T * const volatile *>(ptr);
+#else
+	T *value = *const_cast<T * const volatile *>(ptr);
+	__sync_synchronize();
+	return value;
+#endif
+}
+
+/**
+ * Writes a pointer with release semantics, the writes made before are
+ * visible to the threads reading it with osAtomicReadPointer
+ */
+template <class T> inline void osAtomicWritePointer(T **ptr, T *newVal) {
+#if defined(__ATOMIC_RELEASE)
+	__atomic_store_n(ptr, newVal, __ATOMIC_RELEASE);
+#elif defined(WIN32)
+	// Volatile writes have release semantics with MSVC
+	*const_cast<T * volatile *>(ptr) = newVal;
+#else
+	__sync_synchronize();
+	*const_cast<T * volatile *>(ptr) = newVal;
+#endif
+}
+
 // Floating point exception debuging
 // Currently only works on linux
 // You can use disable/enable at anypoint on your code, if DEBUGFP is defined,
@@ -0,0 +1,68 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+#ifndef LUX_PARALLEL_H
+#define LUX_PARALLEL_H
+// parallel.h*
+
+#include "lux.h"
+#include "osfunc.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace lux
+{
+
+inline void ParallelForBody(volatile boost::uint32_t *next, u_int count,
+	const boost::function<void (u_int)> *work)
+{
+	for (u_int i = atomic_inc32(next); i < count; i = atomic_inc32(next))
+		(*work)(i);
+}
+
+/**
+ * Runs work(i) for every i in [0, count[ on a set of short lived threads,
+ * the calling thread takes part in the work. Items are handed out one at a
+ * time so each item should be a reasonably large amount of work (a tile,
+ * a buffer, a mesh...).
+ * @param threadCount Number of threads to use, 0 for the hardware concurrency
+ */
+inline void ParallelFor(u_int count, const boost::function<void (u_int)> &work,
+	u_int threadCount = 0)
+{
+	if (threadCount == 0)
+		threadCount = max(1U, boost::thread::hardware_concurrency());
+	threadCount = min(threadCount, count);
+
+	volatile boost::uint32_t next = 0;
+	boost::thread_group threads;
+	for (u_int i = 1; i < threadCount; ++i)
+		threads.create_thread(boost::bind(&ParallelForBody, &next, count, &work));
+	ParallelForBody(&next, count, &work);
+	threads.join_all();
+}
+
+}//namespace lux
+
+#endif // LUX_PARALLEL_H
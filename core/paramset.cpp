@@ -25,7 +25,10 @@
 #include "error.h"
 #include "context.h"
 #include "textures/constant.h"
+#include "osfunc.h"
+#include "netprotocol.h"
 #include <sstream>
+#include <boost/scoped_array.hpp>
 #include <string>
 
 namespace lux {
@@ -1326,6 +1329,202 @@ string ParamSet::ToString() const {
 	return ret.str();
 }
 
+// Binary encoding of the parameter values, little endian like the FLM files
+static void WriteBinaryFloats(bool isLittleEndian, std::ostream &os,
+	const float *v, u_int n)
+{
+	if (isLittleEndian)
+		os.write(reinterpret_cast<const char *>(v), n * sizeof(float));
+	else {
+		for (u_int i = 0; i < n; ++i)
+			osWriteLittleEndianFloat(isLittleEndian, os, v[i]);
+	}
+}
+static void ReadBinaryFloats(bool isLittleEndian, std::istream &is,
+	float *v, u_int n)
+{
+	if (isLittleEndian)
+		is.read(reinterpret_cast<char *>(v), n * sizeof(float));
+	else {
+		for (u_int i = 0; i < n; ++i)
+			v[i] = osReadLittleEndianFloat(isLittleEndian, is);
+	}
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const int *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		osWriteLittleEndianInt(isLittleEndian, os, v[i]);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	int *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		v[i] = osReadLittleEndianInt(isLittleEndian, is);
+}
+// Booleans are single bytes, the byte order doesn't matter
+static void WriteBinaryValues(bool, std::ostream &os,
+	const bool *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		os.put(v[i] ? 1 : 0);
+}
+static void ReadBinaryValues(bool, std::istream &is,
+	bool *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		v[i] = is.get() != 0;
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const float *v, u_int n)
+{
+	WriteBinaryFloats(isLittleEndian, os, v, n);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	float *v, u_int n)
+{
+	ReadBinaryFloats(isLittleEndian, is, v, n);
+}
+// Point, Vector and Normal, stored as packed x y z triplets
+template <class T> static void WriteBinaryXYZ(bool isLittleEndian,
+	std::ostream &os, const T *v, u_int n)
+{
+	if (sizeof(T) == 3 * sizeof(float) && n > 0) {
+		WriteBinaryFloats(isLittleEndian, os, &v[0].x, 3 * n);
+		return;
+	}
+	for (u_int i = 0; i < n; ++i) {
+		osWriteLittleEndianFloat(isLittleEndian, os, v[i].x);
+		osWriteLittleEndianFloat(isLittleEndian, os, v[i].y);
+		osWriteLittleEndianFloat(isLittleEndian, os, v[i].z);
+	}
+}
+template <class T> static void ReadBinaryXYZ(bool isLittleEndian,
+	std::istream &is, T *v, u_int n)
+{
+	if (sizeof(T) == 3 * sizeof(float) && n > 0) {
+		ReadBinaryFloats(isLittleEndian, is, &v[0].x, 3 * n);
+		return;
+	}
+	for (u_int i = 0; i < n; ++i) {
+		v[i].x = osReadLittleEndianFloat(isLittleEndian, is);
+		v[i].y = osReadLittleEndianFloat(isLittleEndian, is);
+		v[i].z = osReadLittleEndianFloat(isLittleEndian, is);
+	}
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const Point *v, u_int n)
+{
+	WriteBinaryXYZ(isLittleEndian, os, v, n);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	Point *v, u_int n)
+{
+	ReadBinaryXYZ(isLittleEndian, is, v, n);
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const Vector *v, u_int n)
+{
+	WriteBinaryXYZ(isLittleEndian, os, v, n);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	Vector *v, u_int n)
+{
+	ReadBinaryXYZ(isLittleEndian, is, v, n);
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const Normal *v, u_int n)
+{
+	WriteBinaryXYZ(isLittleEndian, os, v, n);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	Normal *v, u_int n)
+{
+	ReadBinaryXYZ(isLittleEndian, is, v, n);
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const RGBColor *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		WriteBinaryFloats(isLittleEndian, os, v[i].c, 3);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	RGBColor *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		ReadBinaryFloats(isLittleEndian, is, v[i].c, 3);
+}
+static void WriteBinaryValues(bool isLittleEndian, std::ostream &os,
+	const string *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		NetWriteString(isLittleEndian, os, v[i]);
+}
+static void ReadBinaryValues(bool isLittleEndian, std::istream &is,
+	string *v, u_int n)
+{
+	for (u_int i = 0; i < n; ++i)
+		v[i] = NetReadString(isLittleEndian, is);
+}
+
+template <class T> static void WriteBinaryItems(bool isLittleEndian,
+	std::ostream &os, const vector<ParamSetItem<T> *> &vec)
+{
+	osWriteLittleEndianUInt(isLittleEndian, os, vec.size());
+	for (u_int i = 0; i < vec.size(); ++i) {
+		NetWriteString(isLittleEndian, os, vec[i]->name);
+		osWriteLittleEndianUInt(isLittleEndian, os, vec[i]->nItems);
+		WriteBinaryValues(isLittleEndian, os, vec[i]->data,
+			vec[i]->nItems);
+	}
+}
+template <class T> static bool ReadBinaryItems(bool isLittleEndian,
+	std::istream &is, vector<ParamSetItem<T> *> &vec)
+{
+	const u_int count = osReadLittleEndianUInt(isLittleEndian, is);
+	for (u_int i = 0; i < count && is.good(); ++i) {
+		const string name(NetReadString(isLittleEndian, is));
+		const u_int nItems = osReadLittleEndianUInt(isLittleEndian, is);
+		// Each value takes at least one byte
+		if (!is.good() || nItems > NET_MAX_FRAME_SIZE)
+			return false;
+		// Not a vector, vector<bool> doesn't store a bool array
+		boost::scoped_array<T> data(nItems > 0 ? new T[nItems] : NULL);
+		if (nItems > 0)
+			ReadBinaryValues(isLittleEndian, is, data.get(), nItems);
+		AddParamType(vec, name, data.get(), nItems);
+	}
+	return is.good();
+}
+
+void ParamSet::WriteBinary(std::ostream &os) const
+{
+	const bool isLittleEndian = osIsLittleEndian();
+	WriteBinaryItems(isLittleEndian, os, ints);
+	WriteBinaryItems(isLittleEndian, os, bools);
+	WriteBinaryItems(isLittleEndian, os, floats);
+	WriteBinaryItems(isLittleEndian, os, points);
+	WriteBinaryItems(isLittleEndian, os, vectors);
+	WriteBinaryItems(isLittleEndian, os, normals);
+	WriteBinaryItems(isLittleEndian, os, spectra);
+	WriteBinaryItems(isLittleEndian, os, strings);
+	WriteBinaryItems(isLittleEndian, os, textures);
+}
+
+bool ParamSet::ReadBinary(std::istream &is)
+{
+	const bool isLittleEndian = osIsLittleEndian();
+	return ReadBinaryItems(isLittleEndian, is, ints) &&
+		ReadBinaryItems(isLittleEndian, is, bools) &&
+		ReadBinaryItems(isLittleEndian, is, floats) &&
+		ReadBinaryItems(isLittleEndian, is, points) &&
+		ReadBinaryItems(isLittleEndian, is, vectors) &&
+		ReadBinaryItems(isLittleEndian, is, normals) &&
+		ReadBinaryItems(isLittleEndian, is, spectra) &&
+		ReadBinaryItems(isLittleEndian, is, strings) &&
+		ReadBinaryItems(isLittleEndian, is, textures);
+}
+
 boost::shared_ptr<Texture<SWCSpectrum> >
 	ParamSet::GetSWCSpectrumTexture(const string &n,
 	const RGBColor &def) const
@@ -157,6 +157,16 @@ public:
 	}
 	void Clear();
 	string ToString() const;
+	/**
+	 * Compact binary encoding of all the parameters, used by the network
+	 * rendering binary protocol.
+	 */
+	void WriteBinary(std::ostream &os) const;
+	/**
+	 * Adds the parameters encoded by WriteBinary to this set.
+	 * @return false if the stream is truncated or corrupted
+	 */
+	bool ReadBinary(std::istream &is);
 
 private:
 	// ParamSet Data
@@ -25,6 +25,7 @@
 #include "light.h"
 #include "material.h"
 #include "motionsystem.h"
+#include "profiler.h"
 
 using namespace lux;
 
@@ -71,6 +72,7 @@ float Primitive::Sample(float u1, float u2, float u3,
 BSDF *Intersection::GetBSDF(MemoryArena &arena, const SpectrumWavelengths &sw,
 	const Ray &ray) const
 {
+	PROFILE_SCOPE(PROF_MATERIAL);
 	DifferentialGeometry dgShading;
 	primitive->GetShadingGeometry(ObjectToWorld, dg,
 		&dgShading);
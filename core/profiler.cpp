@@ -0,0 +1,188 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+
+// profiler.cpp*
+#include "lux.h"
+#include "profiler.h"
+#include "queryable.h"
+#include "osfunc.h"
+
+#include <cstring>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+using namespace lux;
+
+static const char *timerNames[PROF_TIMER_COUNT][2] = {
+	{ "samplerTime", "Seconds spent generating and adding samples" },
+	{ "integratorTime", "Seconds spent in surface integrators, excluding the other timers" },
+	{ "intersectTime", "Seconds spent intersecting rays with the scene" },
+	{ "materialTime", "Seconds spent evaluating materials" },
+	{ "textureTime", "Seconds spent looking up image textures" },
+	{ "lightSamplingTime", "Seconds spent sampling light sources" },
+	{ "splatTime", "Seconds spent splatting contributions to the film, including lock waits" }
+};
+static const char *counterNames[PROF_COUNTER_COUNT][2] = {
+	{ "pathRays", "Number of camera and indirect rays" },
+	{ "shadowRays", "Number of shadow rays" },
+	{ "traversedRays", "Number of ray traversals of the acceleration structure" },
+	{ "samples", "Number of samples" },
+	{ "contributions", "Number of contributions splatted to the film" },
+	{ "arenaBytes", "Number of bytes allocated from the sample memory arenas" }
+};
+
+#ifdef LUX_PROFILER
+
+static boost::mutex profilerMutex;
+// Threads may end before the totals are read, their counters are kept
+static vector<ProfilerThread *> profilerThreads;
+static void NoCleanup(ProfilerThread *) { }
+static boost::thread_specific_ptr<ProfilerThread> profilerThread(NoCleanup);
+
+boost::uint64_t lux::ProfilerClockTicks()
+{
+	static const boost::posix_time::ptime epoch(
+		boost::posix_time::microsec_clock::universal_time());
+	return (boost::posix_time::microsec_clock::universal_time() -
+		epoch).total_microseconds();
+}
+
+ProfilerThread::ProfilerThread() : last(ProfilerTicks()),
+	current(PROF_TIMER_COUNT)
+{
+	memset(ticks, 0, sizeof(ticks));
+	memset(counters, 0, sizeof(counters));
+}
+
+ProfilerThread &ProfilerThread::Get()
+{
+	ProfilerThread *thread = profilerThread.get();
+	if (!thread) {
+		thread = new ProfilerThread();
+		boost::mutex::scoped_lock lock(profilerMutex);
+		profilerThreads.push_back(thread);
+		profilerThread.reset(thread);
+	}
+	return *thread;
+}
+
+void lux::ProfilerTotals(boost::uint64_t ticks[PROF_TIMER_COUNT],
+	boost::uint64_t counters[PROF_COUNTER_COUNT])
+{
+	memset(ticks, 0, PROF_TIMER_COUNT * sizeof(ticks[0]));
+	memset(counters, 0, PROF_COUNTER_COUNT * sizeof(counters[0]));
+	// The counters are read while being updated, the values are
+	// only approximately consistent with each other
+	boost::mutex::scoped_lock lock(profilerMutex);
+	for (u_int i = 0; i < profilerThreads.size(); ++i) {
+		for (u_int j = 0; j < PROF_TIMER_COUNT; ++j)
+			ticks[j] += profilerThreads[i]->ticks[j];
+		for (u_int j = 0; j < PROF_COUNTER_COUNT; ++j)
+			counters[j] += profilerThreads[i]->counters[j];
+	}
+}
+
+#else // LUX_PROFILER
+
+void lux::ProfilerTotals(boost::uint64_t ticks[PROF_TIMER_COUNT],
+	boost::uint64_t counters[PROF_COUNTER_COUNT])
+{
+	memset(ticks, 0, PROF_TIMER_COUNT * sizeof(ticks[0]));
+	memset(counters, 0, PROF_COUNTER_COUNT * sizeof(counters[0]));
+}
+
+#endif // LUX_PROFILER
+
+namespace lux
+{
+
+// Reports the totals accumulated since its creation
+class Profiler : public Queryable {
+public:
+	Profiler() : Queryable("profiler") {
+		ProfilerTotals(baseTicks, baseCounters);
+		baseTime = osWallClockTime();
+#ifdef LUX_PROFILER
+		baseClock = ProfilerTicks();
+		AddBoolConstant(*this, "enabled", "Profiling counters are compiled in", true);
+#else
+		baseClock = 0;
+		AddBoolConstant(*this, "enabled", "Profiling counters are compiled in", false);
+#endif
+		for (u_int i = 0; i < PROF_TIMER_COUNT; ++i) {
+			boost::shared_ptr<QueryableDoubleAttribute> attribute(
+				new QueryableDoubleAttribute(timerNames[i][0],
+				timerNames[i][1]));
+			attribute->getFunc = boost::bind(&Profiler::GetTime,
+				this, i);
+			AddAttribute(attribute);
+		}
+		for (u_int i = 0; i < PROF_COUNTER_COUNT; ++i) {
+			boost::shared_ptr<QueryableDoubleAttribute> attribute(
+				new QueryableDoubleAttribute(counterNames[i][0],
+				counterNames[i][1]));
+			attribute->getFunc = boost::bind(&Profiler::GetCount,
+				this, i);
+			AddAttribute(attribute);
+		}
+	}
+	virtual ~Profiler() { }
+
+private:
+	double GetTime(u_int timer) {
+#ifdef LUX_PROFILER
+		// Calibrate the ticks against the wall clock
+		const double elapsed = osWallClockTime() - baseTime;
+		const boost::uint64_t clock = ProfilerTicks() - baseClock;
+		if (!(elapsed > 0.) || clock == 0)
+			return 0.;
+		boost::uint64_t ticks[PROF_TIMER_COUNT];
+		boost::uint64_t counters[PROF_COUNTER_COUNT];
+		ProfilerTotals(ticks, counters);
+		return (ticks[timer] - baseTicks[timer]) * elapsed / clock;
+#else
+		return 0.;
+#endif
+	}
+	double GetCount(u_int counter) {
+		boost::uint64_t ticks[PROF_TIMER_COUNT];
+		boost::uint64_t counters[PROF_COUNTER_COUNT];
+		ProfilerTotals(ticks, counters);
+		return static_cast<double>(counters[counter] -
+			baseCounters[counter]);
+	}
+
+	boost::uint64_t baseTicks[PROF_TIMER_COUNT];
+	boost::uint64_t baseCounters[PROF_COUNTER_COUNT];
+	boost::uint64_t baseClock;
+	double baseTime;
+};
+
+}//namespace lux
+
+Queryable *lux::CreateProfiler()
+{
+	return new Profiler();
+}
@@ -0,0 +1,131 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+
+#ifndef LUX_PROFILER_H
+#define LUX_PROFILER_H
+// profiler.h*
+
+#include <boost/cstdint.hpp>
+
+#if defined(LUX_PROFILER) && defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+namespace lux
+{
+
+class Queryable;
+
+// Render time profiling, compiled in with the LUX_PROFILER build option.
+// Each thread accumulates into its own ProfilerThread so the hot paths
+// never share locks or cache lines. The totals are exposed through the
+// "profiler" Queryable object of the context.
+
+// Timers are exclusive: a nested scope pauses the enclosing one
+enum ProfilerTimer {
+	PROF_SAMPLER, PROF_INTEGRATOR, PROF_INTERSECT, PROF_MATERIAL,
+	PROF_TEXTURE, PROF_LIGHT_SAMPLING, PROF_SPLAT,
+	PROF_TIMER_COUNT
+};
+enum ProfilerCounter {
+	PROF_PATH_RAYS, PROF_SHADOW_RAYS, PROF_TRAVERSED_RAYS, PROF_SAMPLES,
+	PROF_CONTRIBUTIONS, PROF_ARENA_BYTES,
+	PROF_COUNTER_COUNT
+};
+
+#ifdef LUX_PROFILER
+
+// Microseconds of a portable clock
+boost::uint64_t ProfilerClockTicks();
+
+// Cycle counter where available, microseconds otherwise
+inline boost::uint64_t ProfilerTicks()
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	return __rdtsc();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	boost::uint32_t lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return (static_cast<boost::uint64_t>(hi) << 32) | lo;
+#else
+	return ProfilerClockTicks();
+#endif
+}
+
+class ProfilerThread {
+public:
+	// Counters of the calling thread, created on first use
+	static ProfilerThread &Get();
+
+	// The extra slot collects the time spent outside of any scope
+	boost::uint64_t ticks[PROF_TIMER_COUNT + 1];
+	boost::uint64_t counters[PROF_COUNTER_COUNT];
+	boost::uint64_t last;
+	unsigned int current;
+private:
+	ProfilerThread();
+	// Keep the counters of different threads on different cache lines
+	char padding[64];
+};
+
+class ProfilerScope {
+public:
+	ProfilerScope(ProfilerTimer timer) : thread(ProfilerThread::Get()),
+		parent(thread.current) {
+		const boost::uint64_t now = ProfilerTicks();
+		thread.ticks[parent] += now - thread.last;
+		thread.last = now;
+		thread.current = timer;
+	}
+	~ProfilerScope() {
+		const boost::uint64_t now = ProfilerTicks();
+		thread.ticks[thread.current] += now - thread.last;
+		thread.last = now;
+		thread.current = parent;
+	}
+private:
+	ProfilerThread &thread;
+	const unsigned int parent;
+};
+
+#define PROFILE_SCOPE(timer) lux::ProfilerScope luxProfilerScope(timer)
+#define PROFILE_COUNT(counter, n) \
+	(lux::ProfilerThread::Get().counters[counter] += (n))
+
+#else // LUX_PROFILER
+
+#define PROFILE_SCOPE(timer)
+#define PROFILE_COUNT(counter, n)
+
+#endif // LUX_PROFILER
+
+// Sums of the counters of all threads, zeros without LUX_PROFILER
+void ProfilerTotals(boost::uint64_t ticks[PROF_TIMER_COUNT],
+	boost::uint64_t counters[PROF_COUNTER_COUNT]);
+
+// Creates the "profiler" Queryable object, its values start at zero
+Queryable *CreateProfiler();
+
+}//namespace lux
+
+#endif // LUX_PROFILER_H
@@ -22,7 +22,8 @@
 
 // Tausworthe (taus113) random numbergenerator by radiance
 // Based on code from GSL (GNU Scientific Library)
-// MASK assures 64bit safety
+// The buffer is refilled by RAN_LANES independent generators stepped
+// together, the loop over the lanes is vectorized by the compiler.
 
 // Usage in luxrender:
 // lux::random::floatValue() returns a random float
@@ -37,11 +38,15 @@
 
 #include "memory.h"
 #include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
 
 #define MASK 0xffffffffUL
 #define FLOATMASK 0x00ffffffUL
 
 #define RAN_BUFFER_AMOUNT 2048
+// Number of interleaved taus113 generators, RAN_BUFFER_AMOUNT must be a
+// multiple of it
+#define RAN_LANES 8
 
 static const float invUI = (1.f / (FLOATMASK + 1UL));
 
@@ -52,11 +57,11 @@ class RandomGenerator : boost::noncopyable
 {
 public:
 	RandomGenerator() {
-		buf = lux::AllocAligned<unsigned long>(RAN_BUFFER_AMOUNT);
+		buf = lux::AllocAligned<unsigned int>(RAN_BUFFER_AMOUNT);
 		bufid = RAN_BUFFER_AMOUNT;
 	}
 	RandomGenerator(unsigned long tn) {
-		buf = lux::AllocAligned<unsigned long>(RAN_BUFFER_AMOUNT);
+		buf = lux::AllocAligned<unsigned int>(RAN_BUFFER_AMOUNT);
 		bufid = RAN_BUFFER_AMOUNT;
 		taus113_set(tn);
 	}
@@ -71,8 +76,8 @@ public:
 		// Repopulate buffer if necessary
 		const unsigned int offset = bufid; // for thread safety
 		if (offset >= RAN_BUFFER_AMOUNT) {
-			for(int i = 0; i < RAN_BUFFER_AMOUNT; ++i)
-				buf[i] = nobuf_generateUInt();
+			for(int i = 0; i < RAN_BUFFER_AMOUNT; i += RAN_LANES)
+				nobuf_generateUInts(buf + i);
 			bufid = 1;
 			return buf[0];
 		}
@@ -85,52 +90,106 @@ public:
 	}
 
 private:
-	inline unsigned long LCG(const unsigned long n) {
-		return 69069UL * n; // The result is clamped to 32 bits (long)
+	inline unsigned int LCG(const unsigned int n) {
+		return 69069U * n; // The result is clamped to 32 bits
 	}
 	void taus113_set(unsigned long s) {
 		if (!s)
 			s = 1UL; // default seed is 1
 
-		z1 = LCG(s);
-		if (z1 < 2UL)
-			z1 += 2UL;
-		z2 = LCG (z1);
-		if (z2 < 8UL)
-			z2 += 8UL;
-		z3 = LCG (z2);
-		if (z3 < 16UL)
-			z3 += 16UL;
-		z4 = LCG (z3);
-		if (z4 < 128UL)
-			z4 += 128UL;
+		// Each lane starts from its own point of the LCG sequence
+		unsigned int seed = static_cast<unsigned int>(s & MASK);
+		for (int l = 0; l < RAN_LANES; ++l) {
+			z1[l] = LCG(seed);
+			if (z1[l] < 2U)
+				z1[l] += 2U;
+			z2[l] = LCG(z1[l]);
+			if (z2[l] < 8U)
+				z2[l] += 8U;
+			z3[l] = LCG(z2[l]);
+			if (z3[l] < 16U)
+				z3[l] += 16U;
+			z4[l] = LCG(z3[l]);
+			if (z4[l] < 128U)
+				z4[l] += 128U;
+			seed = LCG(z4[l] ^ 0x9e3779b9U);
+		}
 
 		// Calling RNG ten times to satify recurrence condition
+		unsigned int tmp[RAN_LANES];
 		for(int i = 0; i < 10; ++i)
-			nobuf_generateUInt();
+			nobuf_generateUInts(tmp);
 	}
 
-	inline unsigned long nobuf_generateUInt() const {
-		const unsigned long b1 = ((((z1 << 6UL) & MASK) ^ z1) >> 13UL);
-		z1 = ((((z1 & 4294967294UL) << 18UL) & MASK) ^ b1);
+	// Steps all the lanes, one value per lane
+	inline void nobuf_generateUInts(unsigned int *values) const {
+		for (int l = 0; l < RAN_LANES; ++l) {
+			const unsigned int b1 = (((z1[l] << 6U) ^ z1[l]) >> 13U);
+			z1[l] = (((z1[l] & 4294967294U) << 18U) ^ b1);
 
-		const unsigned long b2 = ((((z2 << 2UL) & MASK) ^ z2) >> 27UL);
-		z2 = ((((z2 & 4294967288UL) << 2UL) & MASK) ^ b2);
+			const unsigned int b2 = (((z2[l] << 2U) ^ z2[l]) >> 27U);
+			z2[l] = (((z2[l] & 4294967288U) << 2U) ^ b2);
 
-		const unsigned long b3 = ((((z3 << 13UL) & MASK) ^ z3) >> 21UL);
-		z3 = ((((z3 & 4294967280UL) << 7UL) & MASK) ^ b3);
+			const unsigned int b3 = (((z3[l] << 13U) ^ z3[l]) >> 21U);
+			z3[l] = (((z3[l] & 4294967280U) << 7U) ^ b3);
 
-		const unsigned long b4 = ((((z4 << 3UL) & MASK) ^ z4) >> 12UL);
-		z4 = ((((z4 & 4294967168UL) << 13UL) & MASK) ^ b4);
+			const unsigned int b4 = (((z4[l] << 3U) ^ z4[l]) >> 12U);
+			z4[l] = (((z4[l] & 4294967168U) << 13U) ^ b4);
 
-		return (z1 ^ z2 ^ z3 ^ z4);
+			values[l] = z1[l] ^ z2[l] ^ z3[l] ^ z4[l];
+		}
 	}
 
-	mutable unsigned long z1, z2, z3, z4;
-	unsigned long *buf;
+	mutable unsigned int z1[RAN_LANES], z2[RAN_LANES], z3[RAN_LANES],
+		z4[RAN_LANES];
+	unsigned int *buf;
 	mutable int bufid;
 };
 
+/**
+ * Counter based random numbers (Philox 2x32 with 10 rounds, from Salmon et
+ * al. "Parallel Random Numbers: As Easy as 1, 2, 3"). The values only
+ * depend on the key and the counter, so a stream keyed by a pixel and a
+ * sample index gives the same numbers whichever thread computes it.
+ */
+class CounterRandomGenerator
+{
+public:
+	CounterRandomGenerator(unsigned int k0 = 0, unsigned int k1 = 0) :
+		key0(k0), key1(k1), counter(0) { }
+
+	void Reset(unsigned int k0, unsigned int k1) {
+		key0 = k0;
+		key1 = k1;
+		counter = 0;
+	}
+
+	inline unsigned long uintValue() const {
+		return Philox(key0, key1, counter++);
+	}
+	inline float floatValue() const {
+		return (uintValue() & FLOATMASK) * invUI;
+	}
+
+	// Philox 2x32-10 of the counter (ctr, k1) with the key k0,
+	// returns the first word
+	static inline unsigned int Philox(unsigned int k0, unsigned int k1,
+		unsigned int ctr) {
+		unsigned int x0 = ctr, x1 = k1, k = k0;
+		for (int i = 0; i < 10; ++i) {
+			const boost::uint64_t p = static_cast<boost::uint64_t>(0xd256d193U) * x0;
+			x0 = static_cast<unsigned int>(p >> 32) ^ k ^ x1;
+			x1 = static_cast<unsigned int>(p);
+			k += 0x9e3779b9U;
+		}
+		return x0;
+	}
+
+private:
+	unsigned int key0, key1;
+	mutable unsigned int counter;
+};
+
 namespace random {
 
 static RandomGenerator PGen(1);
@@ -37,6 +37,7 @@
 #include "streamio.h"
 #include "filedata.h"
 #include "tigerhash.h"
+#include "netprotocol.h"
 
 #include <algorithm>
 #include <fstream>
@@ -54,6 +55,7 @@
 #include <boost/iostreams/filter/bzip2.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/positioning.hpp>
+#include <boost/iostreams/device/array.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/xtime.hpp>
@@ -98,10 +100,61 @@ static std::string get_response(std::iostream &stream) {
 	return response;
 }
 
-double FilmUpdaterThread::getUpdateTimeRemaining()
-{
-	double timeLeft = (*renderFarm)["pollingInterval"].IntValue() - timer.Time();
-	return timeLeft < 0 ? 0 : timeLeft;
+// Number of bytes which can be read from the socket without blocking
+static size_t socket_available(tcp::iostream &stream) {
+#if (BOOST_VERSION < 106600)
+	return stream.rdbuf()->available();
+#else
+	return stream.rdbuf()->socket().available();
+#endif
+}
+
+static void set_keep_alive(tcp::iostream &stream) {
+	// Enable keep alive option
+	stream.rdbuf()->set_option(boost::asio::socket_base::keep_alive(true));
+#if defined(__linux__) || defined(__MACOSX__)
+	// Set keep alive parameters on *nix platforms
+	const int nativeSocket = static_cast<int>(stream.rdbuf()->native());
+	int optval = 3; // Retry count
+	const socklen_t optlen = sizeof(optval);
+	setsockopt(nativeSocket, SOL_TCP, TCP_KEEPCNT, &optval, optlen);
+	optval = 30; // Keep alive interval
+	setsockopt(nativeSocket, SOL_TCP, TCP_KEEPIDLE, &optval, optlen);
+	optval = 5; // Time between retries
+	setsockopt(nativeSocket, SOL_TCP, TCP_KEEPINTVL, &optval, optlen);
+#endif
+}
+
+// Sends a command on a binary channel, args must already be encoded
+static void write_binary_command(bool isLittleEndian, std::ostream &stream,
+	const std::string &command, const std::string &args) {
+	osWriteLittleEndianUInt(isLittleEndian, stream,
+		sizeof(u_int) + command.size() + args.size());
+	NetWriteString(isLittleEndian, stream, command);
+	stream.write(args.data(), args.size());
+}
+
+// Reads the size prefixed data of a message of a binary channel
+static boost::uint64_t read_binary_data(bool isLittleEndian, std::istream &stream,
+	std::ostream &out) {
+	const boost::uint64_t size = NetReadSize(isLittleEndian, stream);
+
+	vector<char> buffer(1 * 1024 * 1024, 0);
+	boost::uint64_t left = size;
+	while (left > 0) {
+		const std::streamsize rs = static_cast<std::streamsize>(min(static_cast<boost::uint64_t>(buffer.size()), left));
+		stream.read(&buffer[0], rs);
+		out.write(&buffer[0], rs);
+		left -= rs;
+	}
+
+	return size;
+}
+
+static std::string session_args(bool isLittleEndian, const std::string &sid) {
+	std::ostringstream args(std::ios_base::out | std::ios_base::binary);
+	NetWriteString(isLittleEndian, args, sid);
+	return args.str();
 }
 
 void FilmUpdaterThread::updateFilm(FilmUpdaterThread *filmUpdaterThread) {
@@ -109,16 +162,11 @@ void FilmUpdaterThread::updateFilm(FilmUpdaterThread *filmUpdaterThread) {
 
 	try {
 		while (true) {
-			// no-op if already started
-			filmUpdaterThread->timer.Start();
-
 			// sleep for 1 sec
 			boost::this_thread::sleep(boost::posix_time::seconds(1));
 
-			if (filmUpdaterThread->getUpdateTimeRemaining() == 0) {
-				filmUpdaterThread->renderFarm->updateFilm(filmUpdaterThread->scene);
-				filmUpdaterThread->timer.Reset();
-			}
+			// each server has its own update schedule
+			filmUpdaterThread->renderFarm->checkFilmUpdates(filmUpdaterThread->scene);
 		}
 	} catch (boost::thread_interrupted &) {
 		// we got interrupted, do nothing
@@ -259,17 +307,20 @@ bool RenderFarm::CompiledFiles::send(std::iostream &stream) const {
 }
 
 RenderFarm::CompiledCommand::CompiledCommand(const std::string &cmd) 
-	: command(cmd), hasParams(false), paramsBuf(std::stringstream::in | std::stringstream::out  | std::stringstream::binary) 
+	: command(cmd), hasParams(false), paramsBuf(std::stringstream::in | std::stringstream::out  | std::stringstream::binary),
+	binaryBuf(std::stringstream::in | std::stringstream::out  | std::stringstream::binary)
 {
 	// set precision for accurate transmission of floats
 	paramsBuf << std::scientific << std::setprecision(16);
 }
 
 RenderFarm::CompiledCommand::CompiledCommand(const RenderFarm::CompiledCommand &other) 
-	: command(other.command), hasParams(other.hasParams), paramsBuf(std::stringstream::in | std::stringstream::out  | std::stringstream::binary), files(other.files)
+	: command(other.command), hasParams(other.hasParams), paramsBuf(std::stringstream::in | std::stringstream::out  | std::stringstream::binary),
+	binaryBuf(std::stringstream::in | std::stringstream::out  | std::stringstream::binary), files(other.files)
 {
 	// set precision for accurate transmission of floats
 	paramsBuf << std::scientific << std::setprecision(16) << other.paramsBuf.str();
+	binaryBuf << other.binaryBuf.str();
 }
 
 RenderFarm::CompiledCommand& RenderFarm::CompiledCommand::operator=(const RenderFarm::CompiledCommand &other) {
@@ -279,6 +330,7 @@ RenderFarm::CompiledCommand& RenderFarm::CompiledCommand::operator=(const Render
 	command = other.command;
 	hasParams = other.hasParams;
 	paramsBuf.str(other.paramsBuf.str());
+	binaryBuf.str(other.binaryBuf.str());
 	files.clear();
 	files.assign(other.files.begin(), other.files.end());
 
@@ -289,6 +341,10 @@ std::ostream& RenderFarm::CompiledCommand::buffer() {
 	return paramsBuf;
 }
 
+std::ostream& RenderFarm::CompiledCommand::binaryBuffer() {
+	return binaryBuf;
+}
+
 void RenderFarm::CompiledCommand::addParams(const ParamSet &params) {
 	// Serialize the parameters
 	stringstream zos(stringstream::in | stringstream::out | stringstream::binary);
@@ -312,6 +368,7 @@ void RenderFarm::CompiledCommand::addParams(const ParamSet &params) {
 	osWriteLittleEndianUInt(osIsLittleEndian(), paramsBuf, size);
 	// Copy the compressed parameters to the newtwork buffer
 	paramsBuf << zos.str() << "\n";
+	params.WriteBinary(binaryBuf);
 	hasParams = true;
 }
 
@@ -329,6 +386,30 @@ bool RenderFarm::CompiledCommand::send(std::iostream &stream) const {
 	if (!hasParams)
 		return true;
 
+	return sendFileIndex(stream);
+}
+
+bool RenderFarm::CompiledCommand::sendBinary(std::iostream &stream) const {
+	const bool isLittleEndian = osIsLittleEndian();
+	const string args = binaryBuf.str();
+
+	// the command frame, followed by the number of referenced files
+	// for commands with params
+	osWriteLittleEndianUInt(isLittleEndian, stream, sizeof(u_int) +
+		command.size() + args.size() + (hasParams ? sizeof(u_int) : 0));
+	NetWriteString(isLittleEndian, stream, command);
+	stream.write(args.data(), args.size());
+	if (hasParams)
+		osWriteLittleEndianUInt(isLittleEndian, stream, files.size());
+
+	// commands are pipelined unless the server has to fetch files
+	if (!sendFiles())
+		return true;
+
+	return sendFileIndex(stream);
+}
+
+bool RenderFarm::CompiledCommand::sendFileIndex(std::iostream &stream) const {
 	if (files.empty()) {
 		stream << "FILE INDEX EMPTY" << "\n";
 		return true;
@@ -365,10 +446,18 @@ RenderFarm::CompiledCommand& RenderFarm::CompiledCommands::add(const std::string
 
 RenderFarm::RenderFarm() : Queryable("render_farm"),
 		filmUpdateThread(NULL), flushThread(NULL), netBufferComplete(false), doneRendering(false),
-		isLittleEndian(osIsLittleEndian()), pollingInterval(3 * 60), defaultTcpPort(18018)
+		isLittleEndian(osIsLittleEndian()), binaryProtocol(true), pushFilm(false),
+		pollingInterval(3 * 60), minPollingInterval(0), updateSamplesPerPixel(0.f),
+		maxUpdateBandwidth(0), nextReconnect(second_clock::local_time()),
+		nextUpdate(second_clock::local_time()), defaultTcpPort(18018)
 {
+	AddBoolAttribute(*this, "binaryProtocol", "Use the persistent binary protocol for servers connected from now on", &RenderFarm::binaryProtocol, ReadWriteAccess);
+	AddBoolAttribute(*this, "pushFilm", "Let binary protocol servers push their film, requires updateSamplesPerPixel", &RenderFarm::pushFilm, ReadWriteAccess);
 	AddIntAttribute(*this, "defaultTcpPort", "Default TCP port", &RenderFarm::defaultTcpPort, ReadWriteAccess);
 	AddIntAttribute(*this, "pollingInterval", "Polling interval", &RenderFarm::pollingInterval, ReadWriteAccess);
+	AddIntAttribute(*this, "minPollingInterval", "Minimum polling interval when polling by samples per pixel, 0 for no minimum", &RenderFarm::minPollingInterval, ReadWriteAccess);
+	AddFloatAttribute(*this, "updateSamplesPerPixel", "Samples per pixel a server should add between film updates, 0 for fixed interval polling", &RenderFarm::updateSamplesPerPixel, ReadWriteAccess);
+	AddIntAttribute(*this, "maxUpdateBandwidth", "Maximum film update bandwidth per server (KB/s), 0 for unlimited", &RenderFarm::maxUpdateBandwidth, ReadWriteAccess);
 	AddIntAttribute(*this, "slaveNodeCount", "Number of network slave nodes", &RenderFarm::getSlaveNodeCount);
 	AddDoubleAttribute(*this, "updateTimeRemaining", "Time remaining until next update", &RenderFarm::getUpdateTimeRemaining);
 }
@@ -455,6 +544,7 @@ bool RenderFarm::connect(ExtRenderingServerInfo &serverInfo) {
 	serverInfo.sid = "";
 	serverInfo.active = false;
 	serverInfo.flushed = false;
+	dropChannel(serverInfo);
 
 	stringstream ss;
 	string serverName = serverInfo.name + ":" + serverInfo.port;
@@ -582,7 +672,7 @@ bool RenderFarm::connect(const string &serverName) {
 			if (!decodeServerName(serverName, name, port))
 				return false;			
 
-			ExtRenderingServerInfo serverInfo(name, port);
+			ExtRenderingServerInfo serverInfo(name, port, "", binaryProtocol);
 			if (!connect(serverInfo)) {
 				if (serverInfo.active)
 					disconnect(serverInfo);
@@ -629,6 +719,14 @@ void RenderFarm::disconnect(const string &serverName) {
 }
 
 void RenderFarm::disconnect(const RenderingServerInfo &serverInfo) {
+	// the server only listens to the binary channel while it is open
+	for (vector<ExtRenderingServerInfo>::iterator it = serverInfoList.begin(); it < serverInfoList.end(); it++ ) {
+		if (it->sameServer(serverInfo.name, serverInfo.port) && it->channel) {
+			disconnect(*it);
+			return;
+		}
+	}
+
 	stringstream ss;
 	try {
 		LOG( LUX_INFO,LUX_NOERROR)
@@ -643,18 +741,88 @@ void RenderFarm::disconnect(const RenderingServerInfo &serverInfo) {
 	}
 }
 
-void RenderFarm::disconnect(const ExtRenderingServerInfo &serverInfo) {
+void RenderFarm::disconnect(ExtRenderingServerInfo &serverInfo) {
 	stringstream ss;
 	try {
 		LOG( LUX_INFO,LUX_NOERROR)
 			<< "Disconnect from server: "
 			<< serverInfo.name << ":" << serverInfo.port;
 
+		if (serverInfo.channel) {
+			write_binary_command(isLittleEndian, *serverInfo.channel,
+				"ServerDisconnect", session_args(isLittleEndian, serverInfo.sid));
+			closeChannel(serverInfo);
+			return;
+		}
+
 		tcp::iostream stream(serverInfo.name, serverInfo.port);
 		stream << "ServerDisconnect" << endl;
 		stream << serverInfo.sid << endl;
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
+		dropChannel(serverInfo);
+	}
+}
+
+std::iostream &RenderFarm::openChannel(ExtRenderingServerInfo &serverInfo) {
+	if (serverInfo.channel)
+		return *serverInfo.channel;
+
+	LOG( LUX_DEBUG,LUX_NOERROR) << "Opening binary channel to server: " <<
+			serverInfo.name << ":" << serverInfo.port;
+
+	boost::shared_ptr<tcp::iostream> stream(new tcp::iostream());
+	stream->exceptions(tcp::iostream::failbit | tcp::iostream::badbit);
+	stream->connect(serverInfo.name, serverInfo.port);
+	stream->rdbuf()->set_option(tcp::no_delay(true));
+	set_keep_alive(*stream);
+
+	*stream << NET_BINARY_COMMANDS << "\n";
+
+	serverInfo.channel = stream;
+	return *stream;
+}
+
+void RenderFarm::closeChannel(ExtRenderingServerInfo &serverInfo) {
+	if (!serverInfo.channel)
+		return;
+
+	try {
+		// an empty frame sends the server back to accepting connections
+		osWriteLittleEndianUInt(isLittleEndian, *serverInfo.channel, 0);
+		serverInfo.channel->flush();
+	} catch (exception& e) {
+		LOG(LUX_DEBUG,LUX_SYSTEM) << "Error closing binary channel: " << e.what();
+	}
+	dropChannel(serverInfo);
+}
+
+void RenderFarm::dropChannel(ExtRenderingServerInfo &serverInfo) {
+	// the server forgets the film push subscription with the channel
+	serverInfo.channel.reset();
+	serverInfo.pushSubscribed = false;
+	serverInfo.ackPending = false;
+	serverInfo.pushedFilms.clear();
+}
+
+boost::uint64_t RenderFarm::readBinaryReply(ExtRenderingServerInfo &serverInfo,
+	const std::string &command, std::ostream &out) {
+	std::iostream &channel(*serverInfo.channel);
+	while (true) {
+		// server messages are tagged with the command they answer
+		const string reply(NetReadString(isLittleEndian, channel));
+		if (reply == "luxPushFilm") {
+			// keep it for the next film update
+			std::ostringstream film(std::ios_base::out | std::ios_base::binary);
+			read_binary_data(isLittleEndian, channel, film);
+			serverInfo.pushedFilms.push_back(film.str());
+			continue;
+		}
+
+		if (reply != command)
+			throw std::runtime_error("Unexpected reply '" + reply + "' to command '" + command + "'");
+
+		return read_binary_data(isLittleEndian, channel, out);
 	}
 }
 
@@ -673,6 +841,7 @@ bool RenderFarm::sessionReset(const string &serverName, const string &password)
 	for (vector<ExtRenderingServerInfo>::iterator it = serverInfoList.begin(); it < serverInfoList.end(); it++ ) {
 		if (it->sameServer(name, port)) {			
 			LOG( LUX_DEBUG,LUX_NOERROR) << "Attempting to recover existing session with server: " << formattedServerName;
+			closeChannel(*it);
 			if (reconnect(*it) == reconnect_status::success) {
 				LOG( LUX_INFO,LUX_NOERROR) << "Server reconnected successfully, aborting reset of server: " << formattedServerName;
 				return true;
@@ -750,25 +919,43 @@ void RenderFarm::flushImpl() {
 				LOG( LUX_INFO,LUX_NOERROR) << "Sending commands to server: " <<
 						serverInfoList[i].name << ":" << serverInfoList[i].port;
 
-				tcp::iostream stream(serverInfoList[i].name, serverInfoList[i].port);
-				stream.rdbuf()->set_option(tcp::no_delay(true));
-				//stream << commands << endl;
-				for (size_t j = 0; j < compiledCommands.size(); j++) {
-					// send command
-					if (!compiledCommands[j].send(stream))
-						break;
-
-					// and then send any requested files
-					if (!compiledCommands[j].sendFiles())
-						continue;
-
-					if (!compiledFiles.send(stream))
-						break;
+				if (serverInfoList[i].binaryProtocol) {
+					std::iostream &channel(openChannel(serverInfoList[i]));
+					for (size_t j = 0; j < compiledCommands.size(); j++) {
+						// send command
+						if (!compiledCommands[j].sendBinary(channel))
+							break;
+
+						// and then send any requested files
+						if (!compiledCommands[j].sendFiles())
+							continue;
+
+						if (!compiledFiles.send(channel))
+							break;
+					}
+					channel.flush();
+				} else {
+					tcp::iostream stream(serverInfoList[i].name, serverInfoList[i].port);
+					stream.rdbuf()->set_option(tcp::no_delay(true));
+					//stream << commands << endl;
+					for (size_t j = 0; j < compiledCommands.size(); j++) {
+						// send command
+						if (!compiledCommands[j].send(stream))
+							break;
+
+						// and then send any requested files
+						if (!compiledCommands[j].sendFiles())
+							continue;
+
+						if (!compiledFiles.send(stream))
+							break;
+					}
 				}
 
 				serverInfoList[i].flushed = true;
 			} catch (exception& e) {
 				LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
+				dropChannel(serverInfoList[i]);
 			}
 		}
 	}
@@ -838,77 +1025,230 @@ void RenderFarm::updateFilm(Scene *scene) {
 			continue;
 
 		try {
-			LOG( LUX_INFO,LUX_NOERROR) << "Getting samples from: " <<
-					serverInfoList[i].name << ":" << serverInfoList[i].port;
+			updateServerFilm(film, serverInfoList[i]);
+		} catch (string s) {
+			LOG(LUX_ERROR,LUX_SYSTEM)<< s.c_str();
+			// Mark as failed (inactive)
+			serverInfoList[i].active = false;
+			dropChannel(serverInfoList[i]);
+		} catch (std::exception& e) {
+			LOG( LUX_ERROR,LUX_SYSTEM) << "Error while communicating with server: " <<
+					serverInfoList[i].name << ":" << serverInfoList[i].port << " ( " << e.what() << ")";
+			// Mark as failed (inactive)
+			serverInfoList[i].active = false;
+			dropChannel(serverInfoList[i]);
+		}
+	}
 
-			tcp::iostream stream;
-			stream.exceptions(tcp::iostream::failbit | tcp::iostream::badbit);
+	// attempt to reconnect
+	reconnectFailed();
+}
 
-			stream.connect(serverInfoList[i].name, serverInfoList[i].port);
+void RenderFarm::updateServerFilm(Film *film, ExtRenderingServerInfo &serverInfo) {
+	LOG( LUX_INFO,LUX_NOERROR) << "Getting samples from: " <<
+			serverInfo.name << ":" << serverInfo.port;
 
-			// Enable keep alive option
-			stream.rdbuf()->set_option(boost::asio::socket_base::keep_alive(true));
-#if defined(__linux__) || defined(__MACOSX__)
-			// Set keep alive parameters on *nix platforms
-			const int nativeSocket = static_cast<int>(stream.rdbuf()->native());
-			int optval = 3; // Retry count
-			const socklen_t optlen = sizeof(optval);
-			setsockopt(nativeSocket, SOL_TCP, TCP_KEEPCNT, &optval, optlen);
-			optval = 30; // Keep alive interval
-			setsockopt(nativeSocket, SOL_TCP, TCP_KEEPIDLE, &optval, optlen);
-			optval = 5; // Time between retries
-			setsockopt(nativeSocket, SOL_TCP, TCP_KEEPINTVL, &optval, optlen);
-#endif
+	// Receive the film in a compressed format
+	multibuffer_device mbdev;
+	boost::iostreams::stream<multibuffer_device> compressedStream(mbdev);
+
+	// Get the time here before we fetch the stream in case it takes
+	// a very long time to transfer the data. This time will be used
+	// to calculate the slave nodes samples per second.
+	boost::posix_time::ptime samplesRetrievedTime = second_clock::local_time();
+
+	if (serverInfo.binaryProtocol) {
+		std::iostream &channel(openChannel(serverInfo));
 
-			// Send the command to get the film
-			stream << "luxGetFilm" << std::endl;
-			stream << serverInfoList[i].sid << std::endl;
+		// Send the command to get the film
+		write_binary_command(isLittleEndian, channel, "luxGetFilm",
+			session_args(isLittleEndian, serverInfo.sid));
+		channel.flush();
 
-			// Receive the film in a compressed format
-			multibuffer_device mbdev;
-			boost::iostreams::stream<multibuffer_device> compressedStream(mbdev);
+		readBinaryReply(serverInfo, "luxGetFilm", compressedStream);
+	} else {
+		tcp::iostream stream;
+		stream.exceptions(tcp::iostream::failbit | tcp::iostream::badbit);
 
-			// Get the time here before we fetch the stream in case it takes
-			// a very long time to transfer the data. This time will be used
-			// to calculate the slave nodes samples per second.
-			boost::posix_time::ptime samplesRetrievedTime = second_clock::local_time();
+		stream.connect(serverInfo.name, serverInfo.port);
 
-			compressedStream << stream.rdbuf();
+		set_keep_alive(stream);
 
-			stream.close();
+		// Send the command to get the film
+		stream << "luxGetFilm" << std::endl;
+		stream << serverInfo.sid << std::endl;
 
-			std::streampos compressedSize = compressedStream.tellp();
+		compressedStream << stream.rdbuf();
 
-			compressedStream.seekg(0, BOOST_IOS::beg);
+		stream.close();
+	}
 
-			// Decopress and merge the film
-			const double sampleCount = film->MergeFilmFromStream(compressedStream);
-			if (sampleCount == 0.)
-				throw string("Received 0 samples from server");
-			film->numberOfSamplesFromNetwork += sampleCount;
-			serverInfoList[i].numberOfSamplesReceived += sampleCount;
-			serverInfoList[i].calculatedSamplesPerSecond = sampleCount / (samplesRetrievedTime - serverInfoList[i].timeLastSamples).total_seconds();
-			serverInfoList[i].timeLastSamples = samplesRetrievedTime;
+	std::streampos compressedSize = compressedStream.tellp();
 
-			LOG( LUX_INFO,LUX_NOERROR) << "Samples received from '" <<
-					serverInfoList[i].name << ":" << serverInfoList[i].port << "' (" <<
-					(compressedSize / 1024) << " Kbytes)";
+	compressedStream.seekg(0, BOOST_IOS::beg);
 
-			serverInfoList[i].timeLastContact = second_clock::local_time();
+	mergeServerFilm(film, serverInfo, compressedStream, compressedSize,
+		samplesRetrievedTime);
+
+	// and the films pushed meanwhile
+	receivePushedFilms(film, serverInfo);
+}
+
+void RenderFarm::mergeServerFilm(Film *film, ExtRenderingServerInfo &serverInfo,
+	std::basic_istream<char> &compressedStream, boost::uint64_t size,
+	const boost::posix_time::ptime &samplesRetrievedTime) {
+	// Decopress and merge the film
+	const double sampleCount = film->MergeFilmFromStream(compressedStream);
+	if (sampleCount == 0.)
+		throw string("Received 0 samples from server");
+	film->numberOfSamplesFromNetwork += sampleCount;
+	serverInfo.numberOfSamplesReceived += sampleCount;
+	const long elapsed = (samplesRetrievedTime - serverInfo.timeLastSamples).total_seconds();
+	if (elapsed > 0)
+		serverInfo.calculatedSamplesPerSecond = sampleCount / elapsed;
+	serverInfo.timeLastSamples = samplesRetrievedTime;
+
+	LOG( LUX_INFO,LUX_NOERROR) << "Samples received from '" <<
+			serverInfo.name << ":" << serverInfo.port << "' (" <<
+			(size / 1024) << " Kbytes)";
+
+	serverInfo.timeLastContact = second_clock::local_time();
+
+	scheduleFilmUpdate(film, serverInfo, size);
+}
+
+void RenderFarm::receivePushedFilms(Film *film, ExtRenderingServerInfo &serverInfo) {
+	// films received while waiting for other replies
+	while (!serverInfo.pushedFilms.empty()) {
+		const string data(serverInfo.pushedFilms.front());
+		serverInfo.pushedFilms.erase(serverInfo.pushedFilms.begin());
+
+		boost::iostreams::stream<boost::iostreams::array_source> compressedStream(data.data(), data.size());
+		mergeServerFilm(film, serverInfo, compressedStream, data.size(),
+			second_clock::local_time());
+		serverInfo.ackPending = serverInfo.pushSubscribed;
+	}
+
+	if (!serverInfo.channel)
+		return;
+
+	// films waiting on the channel, without blocking
+	tcp::iostream &channel(*serverInfo.channel);
+	while (channel.rdbuf()->in_avail() > 0 || socket_available(channel) > 0) {
+		const string message(NetReadString(isLittleEndian, channel));
+		if (message != "luxPushFilm")
+			throw std::runtime_error("Unexpected message '" + message + "' from server");
+
+		const boost::posix_time::ptime samplesRetrievedTime = second_clock::local_time();
+		multibuffer_device mbdev;
+		boost::iostreams::stream<multibuffer_device> compressedStream(mbdev);
+		const boost::uint64_t size = read_binary_data(isLittleEndian, channel, compressedStream);
+		compressedStream.seekg(0, BOOST_IOS::beg);
+
+		mergeServerFilm(film, serverInfo, compressedStream, size,
+			samplesRetrievedTime);
+		serverInfo.ackPending = true;
+	}
+}
+
+void RenderFarm::scheduleFilmUpdate(Film *film, ExtRenderingServerInfo &serverInfo,
+	boost::uint64_t transferSize) {
+	double interval = pollingInterval;
+
+	// poll each server when it should have rendered enough new samples,
+	// servers pushing their film check this on their side
+	if (serverInfo.pushSubscribed)
+		interval = 0.;
+	else if (updateSamplesPerPixel > 0.f && serverInfo.calculatedSamplesPerSecond > 0.) {
+		const double pixelCount = static_cast<double>(film->GetXPixelCount()) *
+			film->GetYPixelCount();
+		interval = updateSamplesPerPixel * pixelCount /
+			serverInfo.calculatedSamplesPerSecond;
+		interval = max(min(interval, static_cast<double>(pollingInterval)),
+			static_cast<double>(minPollingInterval));
+	}
+
+	// limit the bandwidth used by each server, for pushing servers this
+	// delays the acknowledgement and thus the next push
+	if (maxUpdateBandwidth > 0)
+		interval = max(interval, transferSize / (1024. * maxUpdateBandwidth));
+
+	serverInfo.nextFilmUpdate = second_clock::local_time() +
+		boost::posix_time::milliseconds(static_cast<boost::int64_t>(interval * 1000.));
+}
+
+void RenderFarm::checkFilmUpdates(Scene *scene) {
+	boost::mutex::scoped_lock lock(serverListMutex);
+
+	Film *film = scene->camera()->film;
+
+	// try to reconnect to failed servers at the polling interval
+	ptime now = second_clock::local_time();
+	if (now >= nextReconnect) {
+		reconnectFailed();
+		nextReconnect = now + boost::posix_time::seconds(pollingInterval);
+	}
+
+	ptime next = nextReconnect;
+	for (size_t i = 0; i < serverInfoList.size(); i++) {
+		ExtRenderingServerInfo &serverInfo(serverInfoList[i]);
+		if (!serverInfo.active || !serverInfo.flushed)
+			continue;
+
+		try {
+			if (serverInfo.binaryProtocol && pushFilm &&
+				updateSamplesPerPixel > 0.f && !serverInfo.pushSubscribed) {
+				// ask the server to push its film when it has rendered
+				// enough samples, it may push once before each ack
+				std::iostream &channel(openChannel(serverInfo));
+
+				std::ostringstream args(std::ios_base::out | std::ios_base::binary);
+				NetWriteString(isLittleEndian, args, serverInfo.sid);
+				osWriteLittleEndianFloat(isLittleEndian, args, updateSamplesPerPixel);
+				osWriteLittleEndianUInt(isLittleEndian, args, max(minPollingInterval, 0));
+				write_binary_command(isLittleEndian, channel, "luxPushFilm", args.str());
+				channel.flush();
+
+				LOG( LUX_DEBUG,LUX_NOERROR) << "Film push requested from: " <<
+					serverInfo.name << ":" << serverInfo.port;
+				serverInfo.pushSubscribed = true;
+				serverInfo.ackPending = false;
+			}
+
+			now = second_clock::local_time();
+			if (serverInfo.pushSubscribed) {
+				receivePushedFilms(film, serverInfo);
+
+				now = second_clock::local_time();
+				if (serverInfo.ackPending && now >= serverInfo.nextFilmUpdate) {
+					write_binary_command(isLittleEndian, *serverInfo.channel,
+						"luxFilmAck", "");
+					serverInfo.channel->flush();
+					serverInfo.ackPending = false;
+				}
+				// the next push can't come before the acknowledgement
+				if (serverInfo.ackPending)
+					next = min(next, serverInfo.nextFilmUpdate);
+			} else {
+				if (now >= serverInfo.nextFilmUpdate)
+					updateServerFilm(film, serverInfo);
+				next = min(next, serverInfo.nextFilmUpdate);
+			}
 		} catch (string s) {
 			LOG(LUX_ERROR,LUX_SYSTEM)<< s.c_str();
 			// Mark as failed (inactive)
-			serverInfoList[i].active = false;
+			serverInfo.active = false;
+			dropChannel(serverInfo);
 		} catch (std::exception& e) {
 			LOG( LUX_ERROR,LUX_SYSTEM) << "Error while communicating with server: " <<
-					serverInfoList[i].name << ":" << serverInfoList[i].port << " ( " << e.what() << ")";
+					serverInfo.name << ":" << serverInfo.port << " ( " << e.what() << ")";
 			// Mark as failed (inactive)
-			serverInfoList[i].active = false;
+			serverInfo.active = false;
+			dropChannel(serverInfo);
 		}
 	}
 
-	// attempt to reconnect
-	reconnectFailed();
+	nextUpdate = next;
 }
 
 void RenderFarm::updateLog() {
@@ -928,23 +1268,35 @@ void RenderFarm::updateLog() {
 			LOG( LUX_DEBUG,LUX_NOERROR) << "Getting log from: " <<
 					serverInfoList[i].name << ":" << serverInfoList[i].port;
 
-			// Connect to the server
-			tcp::iostream stream;
-			stream.exceptions(tcp::iostream::failbit | tcp::iostream::badbit);
+			// Receive the log
+			std::stringstream log;
 
-			stream.connect(serverInfoList[i].name, serverInfoList[i].port);
+			if (serverInfoList[i].binaryProtocol) {
+				std::iostream &channel(openChannel(serverInfoList[i]));
 
-			LOG( LUX_DEBUG,LUX_NOERROR) << "Connected to: " << stream.rdbuf()->remote_endpoint();
+				// Send the command to get the log
+				write_binary_command(isLittleEndian, channel, "luxGetLog",
+					session_args(isLittleEndian, serverInfoList[i].sid));
+				channel.flush();
 
-			// Send the command to get the log
-			stream << "luxGetLog" << std::endl;
-			stream << serverInfoList[i].sid << std::endl;
+				readBinaryReply(serverInfoList[i], "luxGetLog", log);
+			} else {
+				// Connect to the server
+				tcp::iostream stream;
+				stream.exceptions(tcp::iostream::failbit | tcp::iostream::badbit);
 
-			// Receive the log
-			std::stringstream log;
-			log << stream.rdbuf();
+				stream.connect(serverInfoList[i].name, serverInfoList[i].port);
+
+				LOG( LUX_DEBUG,LUX_NOERROR) << "Connected to: " << stream.rdbuf()->remote_endpoint();
 
-			stream.close();
+				// Send the command to get the log
+				stream << "luxGetLog" << std::endl;
+				stream << serverInfoList[i].sid << std::endl;
+
+				log << stream.rdbuf();
+
+				stream.close();
+			}
 
 			int severityFilter = luxGetErrorFilter();
 
@@ -973,12 +1325,14 @@ void RenderFarm::updateLog() {
 			LOG(LUX_ERROR,LUX_SYSTEM)<< s.c_str();
 			// Mark as failed (inactive)
 			serverInfoList[i].active = false;
+			dropChannel(serverInfoList[i]);
 		} catch (std::exception& e) {
 			LOG( LUX_ERROR,LUX_SYSTEM) << "Error while communicating with server: " <<
 					serverInfoList[i].name << ":" << serverInfoList[i].port << " ( " << e.what() << ")";
 			LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 			// Mark as failed (inactive)
 			serverInfoList[i].active = false;
+			dropChannel(serverInfoList[i]);
 		}
 	}
 
@@ -1003,6 +1357,24 @@ void RenderFarm::updateUserSamplingMap(const u_int size, const float *map) {
 			LOG( LUX_DEBUG,LUX_NOERROR) << "Sending user sampling map to: " <<
 					serverInfoList[i].name << ":" << serverInfoList[i].port;
 
+			if (serverInfoList[i].binaryProtocol) {
+				std::iostream &channel(openChannel(serverInfoList[i]));
+
+				std::ostringstream args(std::ios_base::out | std::ios_base::binary);
+				NetWriteString(isLittleEndian, args, serverInfoList[i].sid);
+				osWriteLittleEndianUInt(isLittleEndian, args, size);
+				for (u_int j = 0; j < size; ++j)
+					osWriteLittleEndianFloat(isLittleEndian, args, map[j]);
+
+				// Send the command to update the map
+				write_binary_command(isLittleEndian, channel,
+					"luxSetUserSamplingMap", args.str());
+				channel.flush();
+
+				serverInfoList[i].timeLastContact = second_clock::local_time();
+				continue;
+			}
+
 			// Connect to the server
 			tcp::iostream stream;
 			stream.exceptions(tcp::iostream::failbit | tcp::iostream::badbit);
@@ -1034,12 +1406,14 @@ void RenderFarm::updateUserSamplingMap(const u_int size, const float *map) {
 			LOG(LUX_ERROR,LUX_SYSTEM)<< s.c_str();
 			// Mark as failed (inactive)
 			serverInfoList[i].active = false;
+			dropChannel(serverInfoList[i]);
 		} catch (std::exception& e) {
 			LOG( LUX_ERROR,LUX_SYSTEM) << "Error while communicating with server: " <<
 					serverInfoList[i].name << ":" << serverInfoList[i].port << " ( " << e.what() << ")";
 			LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 			// Mark as failed (inactive)
 			serverInfoList[i].active = false;
+			dropChannel(serverInfoList[i]);
 		}
 	}
 
@@ -1049,7 +1423,11 @@ void RenderFarm::updateUserSamplingMap(const u_int size, const float *map) {
 
 double RenderFarm::getUpdateTimeRemaining()
 {
-	return filmUpdateThread ? filmUpdateThread->getUpdateTimeRemaining() : 0;
+	if (!filmUpdateThread)
+		return 0;
+
+	const double timeLeft = (nextUpdate - second_clock::local_time()).total_seconds();
+	return timeLeft < 0 ? 0 : timeLeft;
 }
 
 // to catch the interrupted exception
@@ -1079,6 +1457,7 @@ void RenderFarm::send(const string &command, const string &name,
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << name << endl;
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), name);
 
 		ccmd.addParams(params);
 
@@ -1119,6 +1498,8 @@ void RenderFarm::send(const string &command, const string &id,
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << id << endl << name << endl;
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), id);
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), name);
 		ccmd.addParams(params);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
@@ -1130,6 +1511,7 @@ void RenderFarm::send(const string &command, const string &name) {
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << name << endl;
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), name);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 	}
@@ -1140,6 +1522,9 @@ void RenderFarm::send(const string &command, float x, float y, float z) {
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << x << ' ' << y << ' ' << z << endl;
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), x);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), y);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), z);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 	}
@@ -1150,6 +1535,8 @@ void RenderFarm::send(const string &command, float x, float y) {
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << x << ' ' << y << ' ' << endl;
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), x);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), y);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 	}
@@ -1161,6 +1548,10 @@ void RenderFarm::send(const string &command, float a, float x, float y,
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << a << ' ' << x << ' ' << y << ' ' << z << endl;
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), a);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), x);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), y);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), z);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 	}
@@ -1172,6 +1563,9 @@ void RenderFarm::send(const string &command, float ex, float ey, float ez,
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << ex << ' ' << ey << ' ' << ez << ' ' << lx << ' ' << ly << ' ' << lz << ' ' << ux << ' ' << uy << ' ' << uz << endl;
+		const float v[9] = { ex, ey, ez, lx, ly, lz, ux, uy, uz };
+		for (int i = 0; i < 9; i++)
+			osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), v[i]);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 	}
@@ -1181,8 +1575,10 @@ void RenderFarm::send(const string &command, float tr[16]) {
 	try {
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
-		for (int i = 0; i < 16; i++)
+		for (int i = 0; i < 16; i++) {
 			ccmd.buffer() << tr[i] << ' ';
+			osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), tr[i]);
+		}
 		ccmd.buffer() << endl;
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
@@ -1194,8 +1590,11 @@ void RenderFarm::send(const string &command, u_int n, float *d) {
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << n << ' ';
-		for (u_int i = 0; i < n; i++)
+		osWriteLittleEndianUInt(isLittleEndian, ccmd.binaryBuffer(), n);
+		for (u_int i = 0; i < n; i++) {
 			ccmd.buffer() << d[i] << ' ';
+			osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), d[i]);
+		}
 		ccmd.buffer() << endl;
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
@@ -1208,6 +1607,9 @@ void RenderFarm::send(const string &command, const string &name,
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << name << endl << type << endl << texname << endl;
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), name);
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), type);
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), texname);
 		ccmd.addParams(params);
 
 		const std::string paramName("filename");
@@ -1228,6 +1630,10 @@ void RenderFarm::send(const string &command, const string &name, float a, float
 		CompiledCommand &ccmd(compiledCommands.add(command));
 
 		ccmd.buffer() << name << endl << a << " " << b << endl << transform << endl;
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), name);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), a);
+		osWriteLittleEndianFloat(isLittleEndian, ccmd.binaryBuffer(), b);
+		NetWriteString(isLittleEndian, ccmd.binaryBuffer(), transform);
 	} catch (exception& e) {
 		LOG(LUX_ERROR,LUX_SYSTEM)<< e.what();
 	}
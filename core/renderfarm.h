@@ -25,12 +25,14 @@
 
 #include "osfunc.h"
 #include "queryable.h"
-#include "timer.h"
 
 #include <vector>
 #include <string>
 #include <sstream>
+#include <iostream>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -48,8 +50,6 @@ public:
         delete thread;
     }
 
-	double getUpdateTimeRemaining();
-
     void stop() {
         thread->interrupt();
         thread->join();
@@ -62,7 +62,6 @@ private:
     RenderFarm *renderFarm;
     Scene *scene;
     boost::thread *thread; // keep pointer to delete the thread object
-	Timer timer;
 };
 
 class RenderFarm : public Queryable {
@@ -116,6 +115,10 @@ public:
 	//!<Gets the films from the network, and merge them to the film given in parameter
 	void updateFilm(Scene *scene);
 
+	//!<Merges the films of the servers which are due for an update or
+	//!<have pushed one, called periodically by the film updater thread
+	void checkFilmUpdates(Scene *scene);
+
 	//!<Gets the log from the network
 	void updateLog();
 
@@ -125,11 +128,14 @@ public:
 
 private:
 	struct ExtRenderingServerInfo {
-		ExtRenderingServerInfo(string n, string p, string id = "") :
+		ExtRenderingServerInfo(string n, string p, string id = "",
+			bool binary = false) :
 			timeLastContact(boost::posix_time::second_clock::local_time()),
 			timeLastSamples(boost::posix_time::second_clock::local_time()),
 			numberOfSamplesReceived(0.0), calculatedSamplesPerSecond(0.0),
-			name(n), port(p), sid(id), active(false), flushed(false) { }
+			nextFilmUpdate(boost::posix_time::second_clock::local_time()),
+			name(n), port(p), sid(id), active(false), flushed(false),
+			binaryProtocol(binary), pushSubscribed(false), ackPending(false) { }
 
 		// returns true if "other" has the same name and port
 		bool sameServer(const std::string &name, const std::string &port) const;
@@ -141,6 +147,9 @@ private:
 		// all buffer groups in the film
 		double numberOfSamplesReceived;
 		double calculatedSamplesPerSecond;
+		// time of the next film poll, or of the next push
+		// acknowledgement for servers pushing their film
+		boost::posix_time::ptime nextFilmUpdate;
 
 		string name;
 		string port;
@@ -149,6 +158,18 @@ private:
 		bool active;
 
 		bool flushed;
+
+		// true if the commands are sent over the persistent binary
+		// channel (see netprotocol.h) instead of the text protocol
+		bool binaryProtocol;
+		// the open binary channel, if any
+		boost::shared_ptr<boost::asio::ip::tcp::iostream> channel;
+		// true if the server pushes its film over the channel, it may
+		// only push again once the previous film has been acknowledged
+		bool pushSubscribed;
+		bool ackPending;
+		// films pushed while waiting for the reply to another command
+		std::vector<std::string> pushedFilms;
 	};
 
 	typedef std::string filehash_t;
@@ -210,14 +231,22 @@ private:
 
 		bool send(std::iostream &stream) const;
 
+		// binary encoding of the arguments, mirrors buffer()
+		std::ostream& binaryBuffer();
+
+		bool sendBinary(std::iostream &stream) const;
+
 		bool sendFiles() const {
 			return hasParams && !files.empty();
 		}
 
 	private:
+		bool sendFileIndex(std::iostream &stream) const;
+
 		std::string command;
 		bool hasParams;
 		std::stringstream paramsBuf;
+		std::stringstream binaryBuf;
 		std::vector<std::pair<std::string, CompiledFile> > files;
 	};
 
@@ -250,7 +279,19 @@ private:
 	bool connect(ExtRenderingServerInfo &serverInfo);
 	reconnect_status_t reconnect(ExtRenderingServerInfo &serverInfo);
 	void flushImpl();
-	void disconnect(const ExtRenderingServerInfo &serverInfo);
+	void disconnect(ExtRenderingServerInfo &serverInfo);
+	std::iostream &openChannel(ExtRenderingServerInfo &serverInfo);
+	void closeChannel(ExtRenderingServerInfo &serverInfo);
+	void dropChannel(ExtRenderingServerInfo &serverInfo);
+	boost::uint64_t readBinaryReply(ExtRenderingServerInfo &serverInfo,
+		const std::string &command, std::ostream &out);
+	void updateServerFilm(Film *film, ExtRenderingServerInfo &serverInfo);
+	void mergeServerFilm(Film *film, ExtRenderingServerInfo &serverInfo,
+		std::basic_istream<char> &compressedStream, boost::uint64_t size,
+		const boost::posix_time::ptime &samplesRetrievedTime);
+	void receivePushedFilms(Film *film, ExtRenderingServerInfo &serverInfo);
+	void scheduleFilmUpdate(Film *film, ExtRenderingServerInfo &serverInfo,
+		boost::uint64_t transferSize);
 	void reconnectFailed();
 	void stopImpl();
 
@@ -273,7 +314,14 @@ private:
 	bool netBufferComplete; // Raise this flag if the scene is complete
 	bool doneRendering; // true if rendering is done
 	bool isLittleEndian;
-	int pollingInterval;
+	bool binaryProtocol; // protocol used by newly connected servers
+	bool pushFilm; // let binary protocol servers push their film
+	int pollingInterval; // maximum interval between film updates
+	int minPollingInterval; // in seconds, 0 for no minimum
+	float updateSamplesPerPixel; // target new samples per pixel per update, 0 for fixed interval polling
+	int maxUpdateBandwidth; // in KB/s, 0 for unlimited
+	boost::posix_time::ptime nextReconnect;
+	boost::posix_time::ptime nextUpdate;
 	int defaultTcpPort;
 };
 
@@ -29,6 +29,7 @@
 #include "bxdf.h"
 #include "sampling.h"
 #include "paramset.h"
+#include "profiler.h"
 
 #include <boost/assert.hpp>
 
@@ -183,6 +184,11 @@ LSSOneImportance::~LSSOneImportance()
 	delete lightDistribution;
 }
 
+void LSSOneImportance::InitParam(const ParamSet &params) {
+	// Constant time light selection, useful with many lights
+	aliasSampling = params.FindOneBool("lightaliassampling", false);
+}
+
 void LSSOneImportance::Init(const Scene &scene) {
 	// Compute light importance CDF
 	const u_int nLights = scene.lights.size();
@@ -191,7 +197,8 @@ void LSSOneImportance::Init(const Scene &scene) {
 	for (u_int i = 0; i < nLights; ++i)
 		lightImportance[i] = scene.lights[i]->GetRenderingHints()->GetImportance();
 
-	lightDistribution = new Distribution1D(lightImportance, nLights);
+	lightDistribution = new Distribution1D(lightImportance, nLights,
+		aliasSampling);
 	delete[] lightImportance;
 }
 
@@ -232,7 +239,8 @@ void LSSOnePowerImportance::Init(const Scene &scene) {
 		lightPower[i] = l->GetRenderingHints()->GetImportance() * l->Power(scene);
 	}
 
-	lightDistribution = new Distribution1D(lightPower, nLights);
+	lightDistribution = new Distribution1D(lightPower, nLights,
+		aliasSampling);
 	delete[] lightPower;
 }
 
@@ -287,7 +295,8 @@ void LSSOneLogPowerImportance::Init(const Scene &scene) {
 		lightPower[i] = logf(l->GetRenderingHints()->GetImportance() * l->Power(scene));
 	}
 
-	lightDistribution = new Distribution1D(lightPower, nLights);
+	lightDistribution = new Distribution1D(lightPower, nLights,
+		aliasSampling);
 	delete[] lightPower;
 }
 
@@ -344,6 +353,11 @@ u_int SurfaceIntegratorRenderingHints::SampleLights(const Scene &scene,
 	// Use multiple importance sampling if the surface is not diffuse
 	const BxDFType noDiffuse = BxDFType(BSDF_ALL & ~(BSDF_DIFFUSE));
 	const bool mis = bsdf->NumComponents(noDiffuse) > 0;
+	// Surfaces without transmission only receive light from the side
+	// of the geometric normal facing wo
+	const bool hemisphere = !bsdf->dgShading.scattered &&
+		bsdf->NumComponents(BSDF_ALL_TRANSMISSION) == 0;
+	const Normal nf(Dot(wo, bsdf->ng) > 0.f ? bsdf->ng : -bsdf->ng);
 	if (mis) {
 		// Trace a second shadow ray by sampling the BSDF
 		Vector wi;
@@ -371,9 +385,14 @@ u_int SurfaceIntegratorRenderingHints::SampleLights(const Scene &scene,
 						if (!light->IsEnvironmental())
 							continue;
 						Li = Lt;
-						if (!light->Le(scene, sample, ray,
+						const bool lit = hemisphere ?
+							light->LeHemisphere(scene,
+							sample, ray, nf, &lightBsdf,
+							NULL, &lightPdf, &Li) :
+							light->Le(scene, sample, ray,
 							&lightBsdf, NULL, &lightPdf,
-							&Li))
+							&Li);
+						if (!lit)
 							continue;
 						const float d2 = DistanceSquared(p,
 							lightBsdf->dgShading.p);
@@ -436,9 +455,20 @@ u_int SurfaceIntegratorRenderingHints::SampleLights(const Scene &scene,
 			float lightPdf;
 			SWCSpectrum Li;
 			BSDF *lightBsdf;
-			if (!light->SampleL(scene, sample, p, data[offset2],
-				data[offset2 + 1], data[offset2 + 2],
-				&lightBsdf, NULL, &lightPdf, &Li))
+			bool sampled;
+			{
+				PROFILE_SCOPE(PROF_LIGHT_SAMPLING);
+				sampled = hemisphere ?
+					light->SampleLHemisphere(scene, sample,
+					p, nf, data[offset2], data[offset2 + 1],
+					data[offset2 + 2], &lightBsdf, NULL,
+					&lightPdf, &Li) :
+					light->SampleL(scene, sample, p,
+					data[offset2], data[offset2 + 1],
+					data[offset2 + 2], &lightBsdf, NULL,
+					&lightPdf, &Li);
+			}
+			if (!sampled)
 				continue;
 			const Point &pL(lightBsdf->dgShading.p);
 			const Vector wi0(pL - p);
@@ -154,8 +154,10 @@ private:
 class LSSOneImportance : public LightsSamplingStrategy {
 public:
 	LSSOneImportance() :
-		LightsSamplingStrategy(), lightDistribution(NULL) { }
+		LightsSamplingStrategy(), lightDistribution(NULL),
+		aliasSampling(false) { }
 	virtual ~LSSOneImportance();
+	virtual void InitParam(const ParamSet &params);
 	virtual void Init(const Scene &scene);
 
 	virtual const Light *SampleLight(const Scene &scene, u_int index,
@@ -166,6 +168,8 @@ public:
 
 protected:
 	Distribution1D *lightDistribution;
+	// Whether lightDistribution uses an alias table
+	bool aliasSampling;
 };
 
 class LSSOnePowerImportance : public LSSOneImportance {
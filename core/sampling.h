@@ -29,6 +29,7 @@
 #include "spectrumwavelengths.h"
 #include "film.h"
 #include "queryable.h"
+#include "fastmutex.h"
 
 namespace lux
 {
@@ -129,6 +130,57 @@ public:
 	bool renderingDone;
 };
 
+/**
+ * Hands out the pixel positions of a PixelSampler to the rendering threads.
+ * A thread claims a batch of consecutive positions (a Hilbert segment, a
+ * part of a tile...) and walks it on its own, each pass over the positions
+ * still covers every position exactly once.
+ */
+class PixelBatches {
+public:
+	// Per thread position in the current batch
+	class Cursor {
+	public:
+		Cursor() : pos(0), end(0), pass(0) { }
+		u_int pos, end;
+		// Number of complete passes over the positions before the batch
+		u_int pass;
+	};
+
+	PixelBatches(u_int totalPixels) : total(max(totalPixels, 1U)),
+		// Small images get small batches to keep the threads balanced
+		batchSize(Clamp(total / 1024U, 1U, 64U)),
+		batchCount((total + batchSize - 1) / batchSize), nextBatch(0),
+		pass(0) { }
+
+	// Returns the next position to use in [0, totalPixels[
+	u_int Next(Cursor &cursor) {
+		if (cursor.pos == cursor.end) {
+			// The batch and the pass are tracked separately so that
+			// a long render never wraps a claim counter around and
+			// restarts the sequences of the first pass
+			u_int batch;
+			{
+				fast_mutex::scoped_lock lock(claimMutex);
+				batch = nextBatch;
+				cursor.pass = pass;
+				if (++nextBatch == batchCount) {
+					nextBatch = 0;
+					++pass;
+				}
+			}
+			cursor.pos = batch * batchSize;
+			cursor.end = min(cursor.pos + batchSize, total);
+		}
+		return cursor.pos++;
+	}
+
+private:
+	u_int total, batchSize, batchCount;
+	fast_mutex claimMutex;
+	u_int nextBatch, pass;
+};
+
 void StratifiedSample1D(const RandomGenerator &rng, float *samples, u_int nsamples, bool jitter = true);
 void StratifiedSample2D(const RandomGenerator &rng, float *samples, u_int nx, u_int ny, bool jitter = true);
 // The following 2 Shuffle() should be replaced by a template
@@ -165,16 +217,34 @@ inline double FoldedRadicalInverse(u_int n, u_int base)
 	}
 	return val;
 }
-inline float VanDerCorput(u_int n, u_int scramble = 0)
+inline u_int ReverseBits(u_int n)
 {
 	n = (n << 16) | (n >> 16);
 	n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
 	n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
 	n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
 	n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
-	n ^= scramble;
+	return n;
+}
+inline float VanDerCorput(u_int n, u_int scramble = 0)
+{
+	n = ReverseBits(n) ^ scramble;
 	return static_cast<float>(static_cast<double>(n) / static_cast<double>(0x100000000LL));
 }
+// Nested uniform (Owen) scrambling of the binary digits of n, the
+// permutation of each digit depends on the seed and on all the digits
+// above it. Uses the hash based permutation of Burley's "Practical
+// Hash-based Owen Scrambling".
+inline u_int OwenScramble(u_int n, u_int seed)
+{
+	n = ReverseBits(n);
+	n ^= n * 0x3d20adeaU;
+	n += seed;
+	n *= (seed >> 16) | 1;
+	n ^= n * 0x05526c56U;
+	n ^= n * 0x53a22864U;
+	return ReverseBits(n);
+}
 inline float Sobol2(u_int n, u_int scramble = 0)
 {
 	for (u_int v = 1u << 31; n != 0; n >>= 1, v ^= v >> 1)
@@ -28,6 +28,7 @@
 #include "primitive.h"
 #include "transport.h"
 #include "camera.h"
+#include "profiler.h"
 
 #include <boost/thread/thread.hpp>
 #include <boost/noncopyable.hpp>
@@ -49,6 +50,8 @@ public:
 	Scene(Camera *c);
 	~Scene();
 	bool Intersect(const Ray &ray, Intersection *isect) const {
+		PROFILE_SCOPE(PROF_INTERSECT);
+		PROFILE_COUNT(PROF_TRAVERSED_RAYS, 1);
 		return aggregate->Intersect(ray, isect);
 	}
 	bool Intersect(const luxrays::RayHit &rayHit, Intersection *isect) const {
@@ -69,6 +72,7 @@ public:
 		bool scatteredStart, const Ray &ray, float u,
 		Intersection *isect, BSDF **bsdf, float *pdf, float *pdfBack,
 		SWCSpectrum *f) const {
+		PROFILE_COUNT(PROF_PATH_RAYS, 1);
 		return volumeIntegrator->Intersect(*this, sample, volume,
 			scatteredStart, ray, u, isect, bsdf, pdf, pdfBack, f);
 	}
@@ -77,6 +81,7 @@ public:
 		bool scatteredStart, const Ray &ray,
 		const luxrays::RayHit &rayHit, float u, Intersection *isect,
 		BSDF **bsdf, float *pdf, float *pdfBack, SWCSpectrum *f) const {
+		PROFILE_COUNT(PROF_PATH_RAYS, 1);
 		return volumeIntegrator->Intersect(*this, sample, volume,
 			scatteredStart, ray, rayHit, u, isect, bsdf, pdf,
 			pdfBack, f);
@@ -85,6 +90,7 @@ public:
 		bool scatteredStart, bool scatteredEnd, const Point &p0,
 		const Point &p1, bool clip, SWCSpectrum *f, float *pdf,
 		float *pdfR) const {
+		PROFILE_COUNT(PROF_SHADOW_RAYS, 1);
 		return volumeIntegrator->Connect(*this, sample, volume,
 			scatteredStart, scatteredEnd, p0, p1, clip, f, pdf,
 			pdfR);
@@ -94,11 +100,14 @@ public:
 		bool scatteredStart, bool scatteredEnd, const Ray &ray,
 		const luxrays::RayHit &rayHit, SWCSpectrum *f, float *pdf,
 		float *pdfR) const {
+		PROFILE_COUNT(PROF_SHADOW_RAYS, 1);
 		return volumeIntegrator->Connect(*this, sample, volume,
 			scatteredStart, scatteredEnd, ray, rayHit, f, pdf,
 			pdfR);
 	}
 	bool IntersectP(const Ray &ray) const {
+		PROFILE_SCOPE(PROF_INTERSECT);
+		PROFILE_COUNT(PROF_TRAVERSED_RAYS, 1);
 		return aggregate->IntersectP(ray);
 	}
 	const BBox &WorldBound() const { return bound; }
@@ -41,6 +41,8 @@ public:
 	virtual void MapDuv(const DifferentialGeometry &dg,
 		float *s, float *t, float *dsdu, float *dtdu,
 		float *dsdv, float *dtdv) const = 0;
+	// True if the mapping only depends on the uv coordinates
+	virtual bool IsUV() const { return false; }
 	static TextureMapping2D *Create(const Transform &tex2world, const ParamSet &tp);
 };
 class  UVMapping2D : public TextureMapping2D {
@@ -54,6 +56,7 @@ public:
 	virtual void MapDuv(const DifferentialGeometry &dg,
 		float *s, float *t, float *dsdu, float *dtdu,
 		float *dsdv, float *dtdv) const;
+	virtual bool IsUV() const { return true; }
 
 	const float GetUScale() const { return su; }
 	const float GetVScale() const { return sv; }
@@ -127,6 +130,8 @@ public:
 	virtual Point Map(const DifferentialGeometry &dg) const = 0;
 	virtual Point MapDuv(const DifferentialGeometry &dg,
 		Vector *dpdu, Vector *dpdv) const = 0;
+	// True if the mapping only depends on the uv coordinates
+	virtual bool IsUV() const { return false; }
 	void Apply3DTextureMappingOptions(const ParamSet &tp);
 //private:
 	Transform WorldToTexture;
@@ -154,6 +159,7 @@ public:
 	virtual Point Map(const DifferentialGeometry &dg) const;
 	virtual Point MapDuv(const DifferentialGeometry &dg,
 		Vector *dpdu, Vector *dpdv) const;
+	virtual bool IsUV() const { return true; }
 };
 class GlobalNormalMapping3D : public TextureMapping3D {
 public:
@@ -228,6 +234,9 @@ public:
 		*minValue = -1.f;
 		*maxValue = 1.f;
 	}
+	// True if the texture only depends on the uv coordinates, including
+	// its sub-textures, such textures can be baked
+	virtual bool IsUVMapped() const { return false; }
 	virtual ~Texture() { }
 };
 
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+// texturebake.cpp*
+#include "texturebake.h"
+#include "paramset.h"
+#include "parallel.h"
+#include "error.h"
+
+#include <boost/lexical_cast.hpp>
+
+using namespace lux;
+
+template <class T, class R>
+static void BakeRow(u_int row, u_int resolution,
+	const boost::function<R (float, float)> *f, T *texels)
+{
+	const float v = (row + .5f) / resolution;
+	for (u_int i = 0; i < resolution; ++i)
+		texels[row * resolution + i] = T((*f)((i + .5f) / resolution, v));
+}
+
+namespace lux
+{
+
+boost::shared_ptr<MIPMap> BakeFloatUV(u_int resolution,
+	const boost::function<float (float, float)> &f)
+{
+	resolution = RoundUpPow2(max(resolution, 1U));
+	vector<TextureColor<float, 1> > texels(resolution * resolution);
+	ParallelFor(resolution, boost::bind(&BakeRow<TextureColor<float, 1>, float>,
+		_1, resolution, &f, &texels[0]));
+	return boost::shared_ptr<MIPMap>(new MIPMapFastImpl<TextureColor<float, 1> >(
+		MIPMAP_TRILINEAR, resolution, resolution, &texels[0]));
+}
+
+boost::shared_ptr<MIPMap> BakeRGBUV(u_int resolution,
+	const boost::function<RGBColor (float, float)> &f)
+{
+	resolution = RoundUpPow2(max(resolution, 1U));
+	vector<RGBColor> colors(resolution * resolution);
+	ParallelFor(resolution, boost::bind(&BakeRow<RGBColor, RGBColor>,
+		_1, resolution, &f, &colors[0]));
+	vector<TextureColor<float, 3> > texels(resolution * resolution);
+	for (u_int i = 0; i < texels.size(); ++i) {
+		for (u_int j = 0; j < 3; ++j)
+			texels[i].c[j] = colors[i].c[j];
+	}
+	return boost::shared_ptr<MIPMap>(new MIPMapFastImpl<TextureColor<float, 3> >(
+		MIPMAP_TRILINEAR, resolution, resolution, &texels[0]));
+}
+
+boost::shared_ptr<Texture<float> > BakeFloatTexture(
+	const boost::shared_ptr<Texture<float> > &tex, const ParamSet &tp)
+{
+	const int resolution = tp.FindOneInt("bake", 0);
+	if (!tex || resolution <= 0)
+		return tex;
+
+	// The texture and all its sub-textures must be mapped by uv
+	if (!tex->IsUVMapped()) {
+		LOG(LUX_WARNING, LUX_BADTOKEN) << "Only uv mapped textures can be baked, ignoring \"bake\" for '" << tex->GetName() << "'";
+		return tex;
+	}
+
+	return boost::shared_ptr<Texture<float> >(new BakedFloatTexture(tex,
+		resolution));
+}
+
+}//namespace lux
+
+// BakedFloatTexture Method Definitions
+BakedFloatTexture::BakedFloatTexture(const boost::shared_ptr<Texture<float> > &tex,
+	u_int resolution) :
+	Texture("BakedFloatTexture-" + boost::lexical_cast<string>(this)),
+	texture(tex)
+{
+	mipmap = BakeFloatUV(resolution,
+		boost::bind(&BakedFloatTexture::EvaluateUV, this, _1, _2));
+
+	LOG(LUX_INFO, LUX_NOERROR) << "Baked texture '" << texture->GetName() <<
+		"' (" << (mipmap->GetMemoryUsed() / 1024) << "Kbytes)";
+}
+
+float BakedFloatTexture::EvaluateUV(float u, float v) const
+{
+	DifferentialGeometry dg;
+	dg.p = Point(u, v, 0.f);
+	dg.nn = Normal(0.f, 0.f, 1.f);
+	dg.dpdu = Vector(1.f, 0.f, 0.f);
+	dg.dpdv = Vector(0.f, 1.f, 0.f);
+	dg.u = u;
+	dg.v = v;
+	SpectrumWavelengths sw;
+	return texture->Evaluate(sw, dg);
+}
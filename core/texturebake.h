@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+#ifndef LUX_TEXTUREBAKE_H
+#define LUX_TEXTUREBAKE_H
+// texturebake.h*
+
+#include "lux.h"
+#include "texture.h"
+#include "mipmap.h"
+#include "color.h"
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace lux
+{
+
+// Procedural texture baking.
+//
+// Procedural textures looked up through uv coordinates can be rasterized
+// once over the [0,1]x[0,1] uv square into a MIP map, lookups then cost a
+// bilinear interpolation instead of several octaves of noise. Outside of
+// the square the baked tile repeats. The texels are evaluated in parallel.
+
+/**
+ * Bakes f(u, v) into a resolution x resolution MIP map, the resolution is
+ * rounded up to a power of 2.
+ */
+boost::shared_ptr<MIPMap> BakeFloatUV(u_int resolution,
+	const boost::function<float (float, float)> &f);
+boost::shared_ptr<MIPMap> BakeRGBUV(u_int resolution,
+	const boost::function<RGBColor (float, float)> &f);
+
+/**
+ * Returns the baked version of a float texture if its "bake" parameter is
+ * set to the bake resolution and it only depends on the uv coordinates
+ * (see Texture::IsUVMapped), the texture itself otherwise. The whole
+ * texture is baked, sub-textures included.
+ */
+boost::shared_ptr<Texture<float> > BakeFloatTexture(
+	const boost::shared_ptr<Texture<float> > &tex, const ParamSet &tp);
+
+// Float texture served from its baked MIP map
+class BakedFloatTexture : public Texture<float> {
+public:
+	BakedFloatTexture(const boost::shared_ptr<Texture<float> > &tex,
+		u_int resolution);
+	virtual ~BakedFloatTexture() { }
+	virtual float Evaluate(const SpectrumWavelengths &sw,
+		const DifferentialGeometry &dg) const {
+		return mipmap->LookupFloat(CHANNEL_MEAN, dg.u, dg.v);
+	}
+	virtual float Y() const {
+		return mipmap->LookupFloat(CHANNEL_MEAN, .5f, .5f, .5f);
+	}
+	virtual void GetDuv(const SpectrumWavelengths &sw,
+		const DifferentialGeometry &dg, float delta,
+		float *du, float *dv) const {
+		mipmap->GetDifferentials(CHANNEL_MEAN, dg.u, dg.v, du, dv);
+	}
+	virtual void GetMinMaxFloat(float *minValue, float *maxValue) const {
+		mipmap->GetMinMaxFloat(CHANNEL_MEAN, minValue, maxValue);
+	}
+	virtual bool IsUVMapped() const { return true; }
+private:
+	float EvaluateUV(float u, float v) const;
+
+	// The original texture, used while baking
+	boost::shared_ptr<Texture<float> > texture;
+	boost::shared_ptr<MIPMap> mipmap;
+};
+
+}//namespace lux
+
+#endif // LUX_TEXTUREBAKE_H
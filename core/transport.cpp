@@ -30,6 +30,7 @@
 #include "camera.h"
 #include "sampling.h"
 #include "material.h"
+#include "profiler.h"
 
 namespace lux
 {
@@ -231,12 +232,24 @@ SWCSpectrum EstimateDirect(const Scene &scene, const Light &light,
 	const BxDFType noDiffuse = BxDFType(BSDF_ALL & ~(BSDF_DIFFUSE));
 	const bool mis = !(light.IsDeltaLight()) &&
 		(bsdf->NumComponents(noDiffuse) > 0);
+	// Surfaces without transmission only receive light from the side
+	// of the geometric normal facing wo
+	const bool hemisphere = !bsdf->dgShading.scattered &&
+		bsdf->NumComponents(BSDF_ALL_TRANSMISSION) == 0;
+	const Normal nf(Dot(wo, bsdf->ng) > 0.f ? bsdf->ng : -bsdf->ng);
 	// Trace a shadow ray by sampling the light source
 	float lightPdf;
 	SWCSpectrum Li;
 	BSDF *lightBsdf;
-	if (light.SampleL(scene, sample, p, ls1, ls2, ls3,
-		&lightBsdf, NULL, &lightPdf, &Li)) {
+	bool sampled;
+	{
+		PROFILE_SCOPE(PROF_LIGHT_SAMPLING);
+		sampled = hemisphere ? light.SampleLHemisphere(scene, sample,
+			p, nf, ls1, ls2, ls3, &lightBsdf, NULL, &lightPdf, &Li) :
+			light.SampleL(scene, sample, p, ls1, ls2, ls3,
+			&lightBsdf, NULL, &lightPdf, &Li);
+	}
+	if (sampled) {
 		const Point &pL(lightBsdf->dgShading.p);
 		const Vector wi0(pL - p);
 		const Volume *volume = bsdf->GetVolume(wi0);
@@ -279,7 +292,10 @@ SWCSpectrum EstimateDirect(const Scene &scene, const Light &light,
 			if (!scene.Intersect(sample, volume,
 				bsdf->dgShading.scattered, ray, 1.f,
 				&lightIsect, &ibsdf, NULL, NULL, &Li))
-				lit = light.Le(scene, sample, ray, &lightBsdf,
+				lit = hemisphere ?
+					light.LeHemisphere(scene, sample, ray,
+					nf, &lightBsdf, NULL, &lightPdf, &Li) :
+					light.Le(scene, sample, ray, &lightBsdf,
 					NULL, &lightPdf, &Li);
 			else if (lightIsect.arealight == &light)
 				lit = lightIsect.Le(sample, ray, &lightBsdf,
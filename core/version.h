@@ -31,7 +31,7 @@
 #define LUX_VERSION 1.2
 #define LUX_VERSION_POSTFIX "RC1"
 
-#define LUX_SERVER_PROTOCOL_VERSION 1010
+#define LUX_SERVER_PROTOCOL_VERSION 1012
 
 
 #define LUX_VERSION_STRING    VERSION_STR(LUX_VERSION) LUX_VERSION_POSTFIX
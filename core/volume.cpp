@@ -183,6 +183,20 @@ bool AggregateRegion::Scatter(const Sample &sample, bool scatteredStart,
 			ray, u, isect, pdf, pdfBack, L);
 	return scatter;
 }
+bool AggregateRegion::CanTrack(const SpectrumWavelengths &sw) const
+{
+	// The tracking of overlapping regions would need the majorant of
+	// their sum, such aggregates are ray marched
+	return regions.size() == 1 && regions[0]->CanTrack(sw);
+}
+bool AggregateRegion::SampleCollision(const SpectrumWavelengths &sw,
+	const Ray &ray, const RandomGenerator &rng, float *t,
+	SWCSpectrum *weight) const
+{
+	if (!CanTrack(sw))
+		return false;
+	return regions[0]->SampleCollision(sw, ray, rng, t, weight);
+}
 
 }//namespace lux
 
@@ -33,6 +33,10 @@ using luxrays::BBox;
 #include "color.h"
 #include "materials/scattermaterial.h"
 #include "queryable.h"
+#include "majorantgrid.h"
+#include "randomgen.h"
+
+#include <boost/shared_ptr.hpp>
 
 namespace lux
 {
@@ -70,6 +74,22 @@ public:
 	virtual bool Scatter(const Sample &sample, bool scatteredStart,
 		const Ray &ray, float u, Intersection *isect, float *pdf,
 		float *pdfBack, SWCSpectrum *L) const = 0;
+	// True if SampleCollision is supported for these wavelengths
+	virtual bool CanTrack(const SpectrumWavelengths &sw) const {
+		return false;
+	}
+	/**
+	 * Samples the first real collision along the ray with null collision
+	 * tracking.
+	 * @param t Set to the ray parameter of the collision
+	 * @param weight Set to the weight of the collision, the weight times
+	 * f(collision) estimates the integral along the ray (in world units)
+	 * of the transmittance times f
+	 * @return false if the ray leaves the volume without collision
+	 */
+	virtual bool SampleCollision(const SpectrumWavelengths &sw,
+		const Ray &ray, const RandomGenerator &rng, float *t,
+		SWCSpectrum *weight) const { return false; }
 };
 
 class RGBVolume : public Volume {
@@ -201,6 +221,17 @@ public:
 		isect->dg *= VolumeToWorld;
 		return true;
 	}
+	virtual bool CanTrack(const SpectrumWavelengths &sw) const {
+		return volume.CanTrack(sw);
+	}
+	virtual bool SampleCollision(const SpectrumWavelengths &sw,
+		const Ray &r, const RandomGenerator &rng, float *t,
+		SWCSpectrum *weight) const {
+		Ray rn(r);
+		if (!IntersectP(rn, &rn.mint, &rn.maxt))
+			return false;
+		return volume.SampleCollision(sw, rn, rng, t, weight);
+	}
 protected:
 	Transform VolumeToWorld;
 	BBox region;
@@ -213,6 +244,46 @@ public:
 	DensityVolume(const string &name, const T &v) : Volume(name), volume(v) { }
 	virtual ~DensityVolume() { }
 	virtual float Density(const Point &Pobj) const = 0;
+	/**
+	 * Returns an upper bound of the density inside a volume space box,
+	 * or a negative value if the volume can't bound its density.
+	 * Sampled maxima aren't bounds, they would bias the tracking.
+	 */
+	virtual float MaxDensity(const Transform &VolumeToWorld,
+		const BBox &b) const {
+		return -1.f;
+	}
+	/**
+	 * Builds the majorant grid over the volume space extent, Tau and
+	 * SampleCollision then use null collision tracking instead of ray
+	 * marching. The base volume must be homogeneous. Volumes without a
+	 * density bound keep ray marching.
+	 * @param resolution Number of cells along the largest axis, 0 disables
+	 * the tracking
+	 */
+	void SetMajorantGrid(const Transform &VolumeToWorld, const BBox &extent,
+		u_int resolution) {
+		if (resolution == 0) {
+			majorants.reset();
+			return;
+		}
+		majorants.reset(new MajorantGrid(VolumeToWorld, extent,
+			resolution));
+		for (u_int z = 0; z < majorants->ZResolution(); ++z) {
+			for (u_int y = 0; y < majorants->YResolution(); ++y) {
+				for (u_int x = 0; x < majorants->XResolution(); ++x) {
+					const float m = MaxDensity(VolumeToWorld,
+						majorants->CellBound(x, y, z));
+					if (m < 0.f) {
+						LOG(LUX_WARNING, LUX_UNIMPLEMENT) << "No density bound for '" << GetName() << "', ray marching it";
+						majorants.reset();
+						return;
+					}
+					majorants->SetMajorant(x, y, z, m);
+				}
+			}
+		}
+	}
 	virtual SWCSpectrum SigmaA(const SpectrumWavelengths &sw,
 		const DifferentialGeometry &dg) const {
 		return Density(dg.p) * volume.SigmaA(sw, dg);
@@ -239,6 +310,8 @@ public:
 		const float length = r.d.Length();
 		if (!(length > 0.f))
 			return SWCSpectrum(0.f);
+		if (majorants)
+			return -Ln(RatioTracking(sw, r, offset));
 		const u_int N = Ceil2UInt((r.maxt - r.mint) * length / stepSize);
 		const float step = (r.maxt - r.mint) / N;
 		DifferentialGeometry dg;
@@ -283,9 +356,99 @@ public:
 		ray.mint = mint;
 		return false; //FIXME scattering disabled for now
 	}
+	virtual bool CanTrack(const SpectrumWavelengths &sw) const {
+		if (!majorants)
+			return false;
+		// Without extinction there is no collision to sample,
+		// emission only volumes are ray marched
+		DifferentialGeometry dg;
+		return volume.SigmaT(sw, dg).Filter(sw) > 0.f;
+	}
+	virtual bool SampleCollision(const SpectrumWavelengths &sw,
+		const Ray &r, const RandomGenerator &rng, float *tHit,
+		SWCSpectrum *weight) const {
+		if (!majorants)
+			return false;
+		DifferentialGeometry dg;
+		dg.p = r.o;
+		dg.nn = Normal(-r.d);
+		const SWCSpectrum sigma(volume.SigmaT(sw, dg));
+		const float sigmaMax = sigma.Max();
+		const float sigmaAvg = sigma.Filter(sw);
+		const float length = r.d.Length();
+		if (!(sigmaAvg > 0.f) || !(length > 0.f))
+			return false;
+		// Spectral tracking: the collisions are real with a probability
+		// based on the average extinction, the other wavelengths are
+		// corrected by the weight
+		SWCSpectrum w(1.f);
+		MajorantGrid::Walker walker(*majorants, r);
+		float t0, t1, m;
+		while (walker.Next(&t0, &t1, &m)) {
+			const float mu = m * sigmaMax;
+			if (!(mu > 0.f))
+				continue;
+			const float muT = mu * length;
+			for (float t = t0 - logf(1.f - rng.floatValue()) / muT; t < t1;
+				t -= logf(1.f - rng.floatValue()) / muT) {
+				const float d = Density(r(t));
+				if (d > m)
+					majorants->ReportViolation(d, m);
+				const float pReal = min(d * sigmaAvg / mu, 1.f);
+				if (rng.floatValue() < pReal) {
+					*tHit = t;
+					*weight = w / (mu * pReal);
+					return true;
+				}
+				w *= (SWCSpectrum(mu) - d * sigma).Clamp() /
+					(mu * (1.f - pReal));
+			}
+		}
+		return false;
+	}
 protected:
+	// Estimates the transmittance along the ray with ratio tracking
+	SWCSpectrum RatioTracking(const SpectrumWavelengths &sw, const Ray &r,
+		float offset) const {
+		DifferentialGeometry dg;
+		dg.p = r.o;
+		dg.nn = Normal(-r.d);
+		const SWCSpectrum sigma(volume.SigmaT(sw, dg));
+		const float sigmaMax = sigma.Max();
+		if (!(sigmaMax > 0.f))
+			return SWCSpectrum(1.f);
+		const float length = r.d.Length();
+		TrackingRandom rng(offset, r.o, this);
+		SWCSpectrum Tr(1.f);
+		MajorantGrid::Walker walker(*majorants, r);
+		float t0, t1, m;
+		while (walker.Next(&t0, &t1, &m)) {
+			const float mu = m * sigmaMax;
+			if (!(mu > 0.f))
+				continue;
+			const float muT = mu * length;
+			for (float t = t0 - logf(1.f - rng.floatValue()) / muT; t < t1;
+				t -= logf(1.f - rng.floatValue()) / muT) {
+				const float d = Density(r(t));
+				if (d > m)
+					majorants->ReportViolation(d, m);
+				Tr *= (SWCSpectrum(1.f) -
+					sigma * (d / mu)).Clamp(0.f, 1.f);
+				// Russian roulette once little light goes through
+				if (Tr.Max() < .1f) {
+					if (rng.floatValue() >= .5f)
+						return SWCSpectrum(0.f);
+					Tr *= 2.f;
+				}
+			}
+		}
+		return Tr;
+	}
+
 	// DensityVolume Protected Data
 	T volume;
+	// Shared by the copies of the volume
+	boost::shared_ptr<MajorantGrid> majorants;
 };
 
 class  AggregateRegion : public Region {
@@ -315,6 +478,10 @@ public:
 	virtual bool Scatter(const Sample &sample, bool scatteredStart,
 		const Ray &ray, float u, Intersection *isect, float *pdf,
 		float *pdfBack, SWCSpectrum *L) const;
+	virtual bool CanTrack(const SpectrumWavelengths &sw) const;
+	virtual bool SampleCollision(const SpectrumWavelengths &sw,
+		const Ray &ray, const RandomGenerator &rng, float *t,
+		SWCSpectrum *weight) const;
 private:
 	// AggregateRegion Private Data
 	vector<Region *> regions;
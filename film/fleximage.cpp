@@ -54,14 +54,14 @@ FlexImageFilm::FlexImageFilm(u_int xres, u_int yres, Filter *filt, u_int filtRes
 	bool cw_EXR_gamutclamp, bool cw_EXR_ZBuf, ZBufNormalization cw_EXR_ZBuf_normalizationtype, bool cw_EXR_straight_colors,
 	bool cw_PNG, OutputChannels cw_PNG_channels, bool cw_PNG_16bit, bool cw_PNG_gamutclamp, bool cw_PNG_ZBuf, ZBufNormalization cw_PNG_ZBuf_normalizationtype,
 	bool cw_TGA, OutputChannels cw_TGA_channels, bool cw_TGA_gamutclamp, bool cw_TGA_ZBuf, ZBufNormalization cw_TGA_ZBuf_normalizationtype, 
-	bool w_resume_FLM, bool restart_resume_FLM, bool write_FLM_direct, int haltspp, int halttime, float haltthreshold,
+	bool w_resume_FLM, bool restart_resume_FLM, bool write_FLM_direct, bool write_FLM_chunked, FlmCompression flm_compression, int haltspp, int halttime, float haltthreshold,
 	int p_TonemapKernel, float p_ReinhardPreScale, float p_ReinhardPostScale,
 	float p_ReinhardBurn, float p_LinearSensitivity, float p_LinearExposure, float p_LinearFStop, float p_LinearGamma,
 	float p_ContrastYwa, const string &p_response, float p_Gamma,
 	const float cs_red[2], const float cs_green[2], const float cs_blue[2], const float whitepoint[2],
-	bool debugmode, int outlierk, int tilec, const double convstep, const string &samplingmapfilename) :
+	bool debugmode, int outlierk, int tilec, u_int tilesize, const double convstep, const string &samplingmapfilename) :
 	Film(xres, yres, filt, filtRes, crop, filename1, premult, cw_EXR_ZBuf || cw_PNG_ZBuf || cw_TGA_ZBuf, w_resume_FLM, 
-		restart_resume_FLM, write_FLM_direct, haltspp, halttime, haltthreshold, debugmode, outlierk, tilec, samplingmapfilename), 
+		restart_resume_FLM, write_FLM_direct, write_FLM_chunked, flm_compression, haltspp, halttime, haltthreshold, debugmode, outlierk, tilec, tilesize, samplingmapfilename), 
 	framebuffer(NULL), float_framebuffer(NULL), alpha_buffer(NULL), z_buffer(NULL),
 	writeInterval(wI), flmWriteInterval(fwI), displayInterval(dI), convUpdateThread(NULL), convUpdateStep(convstep)
 {
@@ -1747,6 +1747,8 @@ Film* FlexImageFilm::CreateFilm(const ParamSet &params, Filter *filter)
     bool w_resume_FLM = params.FindOneBool("write_resume_flm", false);
 	bool restart_resume_FLM = params.FindOneBool("restart_resume_flm", false);
 	bool w_FLM_direct = params.FindOneBool("write_flm_direct", false);
+	bool w_FLM_chunked = params.FindOneBool("write_flm_chunked", false);
+	FlmCompression flm_compression = FlmCompressionFromString(params.FindOneString("flm_compression", "gzip"));
 
 	// output filenames
 	string filename = params.FindOneString("filename", "luxout");
@@ -1815,16 +1817,22 @@ Film* FlexImageFilm::CreateFilm(const ParamSet &params, Filter *filter)
 	float s_Gamma = params.FindOneFloat("gamma", 2.2f);
 
 	int tilecount = params.FindOneInt("tilecount", 0);
+	// Side of square film tiles in pixels, 0 splits the film in slabs
+	int tilesize = params.FindOneInt("tilesize", 0);
+	if (tilesize < 0) {
+		LOG(LUX_WARNING, LUX_BADTOKEN) << "Film tile size must be positive, using slabs";
+		tilesize = 0;
+	}
 
 	return new FlexImageFilm(xres, yres, filter, filtRes, crop,
 		filename, premultiplyAlpha, writeInterval, flmWriteInterval, displayInterval, clampMethod, 
 		w_EXR, w_EXR_channels, w_EXR_halftype, w_EXR_compressiontype, w_EXR_applyimaging, w_EXR_gamutclamp, w_EXR_ZBuf, w_EXR_ZBuf_normalizationtype, w_EXR_straightcolors,
 		w_PNG, w_PNG_channels, w_PNG_16bit, w_PNG_gamutclamp, w_PNG_ZBuf, w_PNG_ZBuf_normalizationtype,
 		w_TGA, w_TGA_channels, w_TGA_gamutclamp, w_TGA_ZBuf, w_TGA_ZBuf_normalizationtype, 
-		w_resume_FLM, restart_resume_FLM, w_FLM_direct, haltspp, halttime, haltthreshold,
+		w_resume_FLM, restart_resume_FLM, w_FLM_direct, w_FLM_chunked, flm_compression, haltspp, halttime, haltthreshold,
 		s_TonemapKernel, s_ReinhardPreScale, s_ReinhardPostScale, s_ReinhardBurn, s_LinearSensitivity,
 		s_LinearExposure, s_LinearFStop, s_LinearGamma, s_ContrastYwa, response, s_Gamma,
-		red, green, blue, white, debug_mode, outlierrejection_k, tilecount, convUpdateStep, samplingmapfilename);
+		red, green, blue, white, debug_mode, outlierrejection_k, tilecount, static_cast<u_int>(tilesize), convUpdateStep, samplingmapfilename);
 }
 
 
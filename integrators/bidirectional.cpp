@@ -29,6 +29,7 @@
 #include "scene.h"
 #include "paramset.h"
 #include "dynload.h"
+#include "profiler.h"
 #include "luxrays/core/geometry/raybuffer.h"
 #include "core/partialcontribution.h"
 
@@ -351,8 +352,16 @@ bool BidirIntegrator::GetDirectLight(const Scene &scene, const Sample &sample,
 	BidirVertex &vL(lightPath[0]);
 	float ePdfDirect;
 	// Sample the chosen light
-	if (!light->SampleL(scene, sample, vE.p, u0, u1, portal,
-		&vL.bsdf, &vL.dAWeight, &ePdfDirect, Ld))
+	// SampleLHemisphere can't be used: the path weights also need the
+	// direct pdf of light subpath vertices, from Light::Pdf(), which
+	// has no hemisphere variant
+	bool sampled;
+	{
+		PROFILE_SCOPE(PROF_LIGHT_SAMPLING);
+		sampled = light->SampleL(scene, sample, vE.p, u0, u1, portal,
+			&vL.bsdf, &vL.dAWeight, &ePdfDirect, Ld);
+	}
+	if (!sampled)
 		return false;
 	vL.p = vL.bsdf->dgShading.p;
 	vL.wi = Vector(vL.bsdf->dgShading.nn);
@@ -1855,8 +1864,13 @@ bool BidirIntegrator::GenerateRays(const Scene &scene,
 			float lightPdf, lightDirectPdf;
 			SWCSpectrum Li;
 			BSDF *lightBsdf;
-			if (!light->SampleL(scene, sample, p, sampleData[0], sampleData[1], portal,
-				&lightBsdf, &lightPdf, &lightDirectPdf, &Li))
+			bool sampled;
+			{
+				PROFILE_SCOPE(PROF_LIGHT_SAMPLING);
+				sampled = light->SampleL(scene, sample, p, sampleData[0], sampleData[1], portal,
+					&lightBsdf, &lightPdf, &lightDirectPdf, &Li);
+			}
+			if (!sampled)
 				continue;
 
 			Li *= lightSelectionInvPdf; // ONE_UNIFORM Strategy inv. Pdf
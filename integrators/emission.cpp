@@ -56,6 +56,21 @@ u_int EmissionIntegrator::Li(const Scene &scene, const Ray &ray,
 	float t0, t1;
 	if (!vr || !vr->IntersectP(ray, &t0, &t1))
 		return 0;
+	if (vr->CanTrack(sample.swl)) {
+		// Collision estimator, the cost depends on the density along
+		// the ray instead of its length
+		float t;
+		SWCSpectrum weight;
+		const Ray rt(ray.o, ray.d, t0, t1, ray.time);
+		if (vr->SampleCollision(sample.swl, rt, *(sample.rng), &t,
+			&weight)) {
+			DifferentialGeometry dg;
+			dg.p = ray(t);
+			dg.nn = Normal(-ray.d);
+			*Lv = weight * vr->Lve(sample.swl, dg);
+		}
+		return group;
+	}
 	// Do emission-only volume integration in _vr_
 	// Prepare for volume integration stepping
 	const u_int N = Ceil2Int((t1 - t0) / stepSize);
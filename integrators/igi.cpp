@@ -33,6 +33,8 @@
 #include "dynload.h"
 #include "paramset.h"
 
+#include <algorithm>
+
 using namespace lux;
 
 SWCSpectrum VirtualLight::GetSWCSpectrum(const SpectrumWavelengths &sw) const
@@ -54,14 +56,34 @@ SWCSpectrum VirtualLight::GetSWCSpectrum(const SpectrumWavelengths &sw) const
 }
 
 // IGIIntegrator Implementation
-IGIIntegrator::IGIIntegrator(u_int nl, u_int ns, u_int d, float gl) : SurfaceIntegrator()
+IGIIntegrator::IGIIntegrator(u_int nl, u_int ns, u_int d, float gl, bool lc,
+	float ce, u_int mc) : SurfaceIntegrator()
 {
 	nLightPaths = RoundUpPow2(nl);
 	nLightSets = RoundUpPow2(ns);
 	gLimit = gl;
 	maxSpecularDepth = d;
 	virtualLights.resize(nLightSets);
+	lightCuts = lc;
+	cutError = ce;
+	maxCutSize = max(1U, mc);
+	cutCount = 0.;
+	cutTotal = 0.;
+	cutMax = 0;
+	if (lightCuts)
+		lightTrees.resize(nLightSets);
 	AddStringConstant(*this, "name", "Name of current surface integrator", "igi");
+	AddFloatAttribute(*this, "cutsize.mean", "Mean number of virtual lights evaluated per shading point", &IGIIntegrator::GetMeanCutSize);
+	AddIntAttribute(*this, "cutsize.max", "Largest number of virtual lights evaluated at a shading point", &IGIIntegrator::GetMaxCutSize);
+}
+IGIIntegrator::~IGIIntegrator()
+{
+	delete[] lightSampleOffset;
+	delete[] bsdfSampleOffset;
+	delete[] bsdfComponentOffset;
+	if (lightCuts && cutCount > 0.)
+		LOG(LUX_DEBUG, LUX_NOERROR) << "IGI light cuts: mean size " <<
+			GetMeanCutSize() << ", max size " << cutMax;
 }
 void IGIIntegrator::RequestSamples(Sampler *sampler, const Scene &scene)
 {
@@ -185,6 +207,182 @@ void IGIIntegrator::Preprocess(const RandomGenerator &rng, const Scene &scene)
 	delete[] lightSamp0b; // NOBOOK
 	delete[] lightSamp1; // NOBOOK
 	delete[] lightSamp1b; // NOBOOK
+
+	if (!lightCuts)
+		return;
+	for (u_int s = 0; s < nLightSets; ++s) {
+		vector<u_int> indices;
+		for (u_int i = 0; i < virtualLights[s].size(); ++i) {
+			if (!virtualLights[s][i].Le.Black())
+				indices.push_back(i);
+		}
+		if (indices.empty())
+			continue;
+		lightTrees[s].reserve(2 * indices.size() - 1);
+		BuildLightTree(lightTrees[s], virtualLights[s], indices,
+			0, indices.size(), rng);
+	}
+	LOG(LUX_DEBUG, LUX_NOERROR) << "IGI light trees built";
+}
+// Orders virtual lights along an axis for the light tree construction
+struct VirtualLightCompare {
+	VirtualLightCompare(const vector<VirtualLight> &l, int a) :
+		lights(l), axis(a) { }
+	bool operator()(u_int a, u_int b) const {
+		return lights[a].p[axis] < lights[b].p[axis];
+	}
+	const vector<VirtualLight> &lights;
+	int axis;
+};
+u_int IGIIntegrator::BuildLightTree(vector<VirtualLightNode> &tree,
+	const vector<VirtualLight> &lights, vector<u_int> &indices,
+	u_int start, u_int end, const RandomGenerator &rng) const
+{
+	const u_int index = tree.size();
+	tree.push_back(VirtualLightNode());
+	if (end - start == 1) {
+		const VirtualLight &vl(lights[indices[start]]);
+		VirtualLightNode &node(tree[index]);
+		node.bounds = BBox(vl.p);
+		// The spectrum of a virtual light is only known at the
+		// wavelengths it was traced with, average them
+		node.intensity = 0.f;
+		for (u_int i = 0; i < WAVELENGTH_SAMPLES; ++i)
+			node.intensity += vl.Le.c[i];
+		node.intensity /= WAVELENGTH_SAMPLES;
+		node.scale = 1.f;
+		node.light = indices[start];
+		node.children[0] = node.children[1] = 0;
+		return index;
+	}
+	// Split at the median position along the largest axis
+	BBox bounds;
+	for (u_int i = start; i < end; ++i)
+		bounds = Union(bounds, lights[indices[i]].p);
+	const int axis = bounds.MaximumExtent();
+	const u_int mid = (start + end) / 2;
+	std::nth_element(indices.begin() + start, indices.begin() + mid,
+		indices.begin() + end, VirtualLightCompare(lights, axis));
+	const u_int c0 = BuildLightTree(tree, lights, indices, start, mid, rng);
+	const u_int c1 = BuildLightTree(tree, lights, indices, mid, end, rng);
+	// tree may have been reallocated
+	const VirtualLightNode &n0(tree[c0]), &n1(tree[c1]);
+	VirtualLightNode &node(tree[index]);
+	node.bounds = Union(n0.bounds, n1.bounds);
+	node.intensity = n0.intensity + n1.intensity;
+	// Choose the representative light proportionally to the intensity
+	// so the cluster estimate is unbiased
+	const VirtualLightNode &rep(rng.floatValue() * node.intensity <
+		n0.intensity ? n0 : n1);
+	node.light = rep.light;
+	node.scale = rep.scale * node.intensity / rep.intensity;
+	node.children[0] = c0;
+	node.children[1] = c1;
+	return index;
+}
+SWCSpectrum IGIIntegrator::NodeContribution(const SpectrumWavelengths &sw,
+	const BSDF *bsdf, const Point &p, const Vector &wo,
+	const vector<VirtualLight> &lights, const VirtualLightNode &node) const
+{
+	const VirtualLight &vl(lights[node.light]);
+	const float d2 = DistanceSquared(p, vl.p);
+	const Vector wi(Normalize(vl.p - p));
+	const float G = min(AbsDot(wi, vl.n) / d2, gLimit);
+	const SWCSpectrum f(bsdf->F(sw, wi, wo, true,
+		BxDFType(~BSDF_SPECULAR)));
+	if (!(G > 0.f) || f.Black())
+		return SWCSpectrum(0.f);
+	return f * vl.GetSWCSpectrum(sw) * (G * node.scale / nLightPaths);
+}
+
+// Node of a light cut with the error of its estimate
+struct LightCutEntry {
+	LightCutEntry(float e, u_int n, const SWCSpectrum &c) :
+		error(e), node(n), contribution(c) { }
+	bool operator<(const LightCutEntry &e) const { return error < e.error; }
+	float error;
+	u_int node;
+	SWCSpectrum contribution;
+};
+
+SWCSpectrum IGIIntegrator::LightCut(const Scene &scene, const Sample &sample,
+	u_int lSet, const BSDF *bsdf, const Point &p, const Vector &wo,
+	bool scattered) const
+{
+	const vector<VirtualLightNode> &tree(lightTrees[lSet]);
+	if (tree.empty())
+		return SWCSpectrum(0.f);
+	const vector<VirtualLight> &lights(virtualLights[lSet]);
+	const SpectrumWavelengths &sw(sample.swl);
+	// The BSDF can't be bounded in general, the errors use the diffuse
+	// albedo and the estimate toward the representative light instead
+	const float fBound = bsdf->rho(sw, wo,
+		BxDFType(~BSDF_SPECULAR)).Filter(sw) * INV_PI;
+
+	// Refine the node with the largest error until every error is below
+	// the relative threshold or the cut is too large
+	vector<LightCutEntry> heap, cut;
+	float total = 0.f;
+	u_int pending[2] = { 0, 0 };
+	u_int nPending = 1;
+	while (true) {
+		for (u_int i = 0; i < nPending; ++i) {
+			const VirtualLightNode &node(tree[pending[i]]);
+			const SWCSpectrum contribution(NodeContribution(sw, bsdf,
+				p, wo, lights, node));
+			const float estimate = contribution.Filter(sw);
+			total += estimate;
+			if (node.IsLeaf()) {
+				cut.push_back(LightCutEntry(0.f, pending[i],
+					contribution));
+				continue;
+			}
+			float d2 = 0.f;
+			for (u_int axis = 0; axis < 3; ++axis) {
+				const float d = max(0.f, max(node.bounds.pMin[axis] -
+					p[axis], p[axis] - node.bounds.pMax[axis]));
+				d2 += d * d;
+			}
+			const float G = d2 > 0.f ? min(1.f / d2, gLimit) : gLimit;
+			const float error = max(estimate,
+				node.intensity * G * fBound / nLightPaths);
+			heap.push_back(LightCutEntry(error, pending[i],
+				contribution));
+			std::push_heap(heap.begin(), heap.end());
+		}
+		if (heap.empty() || heap.size() + cut.size() >= maxCutSize ||
+			heap.front().error <= cutError * total)
+			break;
+		std::pop_heap(heap.begin(), heap.end());
+		const VirtualLightNode &node(tree[heap.back().node]);
+		total -= heap.back().contribution.Filter(sw);
+		heap.pop_back();
+		pending[0] = node.children[0];
+		pending[1] = node.children[1];
+		nPending = 2;
+	}
+	cut.insert(cut.end(), heap.begin(), heap.end());
+
+	const u_int cutSize = cut.size();
+	{
+		fast_mutex::scoped_lock lock(cutStatsMutex);
+		cutCount += 1.;
+		cutTotal += cutSize;
+		cutMax = max(cutMax, cutSize);
+	}
+
+	// Only the final cut is tested for visibility
+	SWCSpectrum L(0.f);
+	for (u_int i = 0; i < cut.size(); ++i) {
+		SWCSpectrum Llight(cut[i].contribution);
+		if (Llight.Black())
+			continue;
+		const Point &pl(lights[tree[cut[i].node].light].p);
+		if (scene.Connect(sample, bsdf->GetVolume(pl - p), scattered,
+			false, p, pl, false, &Llight, NULL, NULL))
+			L += Llight;
+	}
+	return L;
 }
 u_int IGIIntegrator::Li(const Scene &scene, const Sample &sample) const
 {
@@ -244,25 +442,30 @@ u_int IGIIntegrator::Li(const Scene &scene, const Sample &sample) const
 		// Compute indirect illumination with virtual lights
 		size_t lSet = min<size_t>(Floor2UInt(sample.sampler->GetOneD(sample,
 			vlSetOffset, 0) * nLightSets), nLightSets - 1U);
-		for (u_int i = 0; i < virtualLights[lSet].size(); ++i) {
-			const VirtualLight &vl = virtualLights[lSet][i];
-			// Add contribution from _VirtualLight_ _vl_
-			// Ignore light if it's too close
-			float d2 = DistanceSquared(p, vl.p);
-			Vector wi = Normalize(vl.p - p);
-			float G = AbsDot(wi, vl.n) / d2;
-			G = min(G, gLimit);
-			// Compute virtual light's tentative contribution _Llight_
-			SWCSpectrum f(bsdf->F(sw, wi, wo, true,
-				BxDFType(~BSDF_SPECULAR)));
-			if (!(G > 0.f) || f.Black())
-				continue;
-			SWCSpectrum Llight = f * vl.GetSWCSpectrum(sw) *
-				(G / nLightPaths);
-			if (scene.Connect(sample, bsdf->GetVolume(wi),
-				scattered, false, p, vl.p, false, &Llight, NULL,
-				NULL)) {
-				L += pathThroughput * Llight;
+		if (lightCuts) {
+			L += pathThroughput * LightCut(scene, sample, lSet, bsdf,
+				p, wo, scattered);
+		} else {
+			for (u_int i = 0; i < virtualLights[lSet].size(); ++i) {
+				const VirtualLight &vl = virtualLights[lSet][i];
+				// Add contribution from _VirtualLight_ _vl_
+				// Ignore light if it's too close
+				float d2 = DistanceSquared(p, vl.p);
+				Vector wi = Normalize(vl.p - p);
+				float G = AbsDot(wi, vl.n) / d2;
+				G = min(G, gLimit);
+				// Compute virtual light's tentative contribution _Llight_
+				SWCSpectrum f(bsdf->F(sw, wi, wo, true,
+					BxDFType(~BSDF_SPECULAR)));
+				if (!(G > 0.f) || f.Black())
+					continue;
+				SWCSpectrum Llight = f * vl.GetSWCSpectrum(sw) *
+					(G / nLightPaths);
+				if (scene.Connect(sample, bsdf->GetVolume(wi),
+					scattered, false, p, vl.p, false, &Llight, NULL,
+					NULL)) {
+					L += pathThroughput * Llight;
+				}
 			}
 		}
 		if (depth >= maxSpecularDepth)
@@ -291,7 +494,13 @@ SurfaceIntegrator* IGIIntegrator::CreateSurfaceIntegrator(const ParamSet &params
 	int maxDepth = params.FindOneInt("maxdepth", 5);
 	float maxG = params.FindOneFloat("glimit",
 		1.f / params.FindOneFloat("mindist", .1f));
-	return new IGIIntegrator(max(nLightPaths, 0), max(nLightSets, 0), max(maxDepth, 0), maxG);
+	// Shade clusters of virtual lights organized in a tree instead of
+	// every light, the cut is refined until the estimated error of each
+	// cluster is below cuterror times the total
+	bool lightCuts = params.FindOneBool("lightcuts", false);
+	float cutError = params.FindOneFloat("cuterror", .02f);
+	int maxCutSize = params.FindOneInt("maxcutsize", 128);
+	return new IGIIntegrator(max(nLightPaths, 0), max(nLightSets, 0), max(maxDepth, 0), maxG, lightCuts, max(cutError, 0.f), max(maxCutSize, 1));
 }
 
 static DynamicLoader::RegisterSurfaceIntegrator<IGIIntegrator> r("igi");
@@ -27,7 +27,10 @@
 using luxrays::Point;
 #include "luxrays/core/geometry/normal.h"
 using luxrays::Normal;
+#include "luxrays/core/geometry/bbox.h"
+using luxrays::BBox;
 #include "spectrumwavelengths.h"
+#include "fastmutex.h"
 
 namespace lux
 {
@@ -48,23 +51,63 @@ struct VirtualLight {
 	Normal n;
 };
 
+// Node of the light tree built over a set of virtual lights, a cluster is
+// shaded with its representative light scaled to the cluster intensity
+struct VirtualLightNode {
+	bool IsLeaf() const { return children[0] == 0; }
+	BBox bounds;
+	float intensity;
+	// Cluster intensity over representative light intensity
+	float scale;
+	u_int light;
+	// Root is node 0 so 0 marks leaves
+	u_int children[2];
+};
+
 class IGIIntegrator : public SurfaceIntegrator {
 public:
 	// IGIIntegrator Public Methods
-	IGIIntegrator(u_int nl, u_int ns, u_int d, float md);
-	virtual ~IGIIntegrator () {
-		delete[] lightSampleOffset;
-		delete[] bsdfSampleOffset;
-		delete[] bsdfComponentOffset;
-	}
+	IGIIntegrator(u_int nl, u_int ns, u_int d, float md, bool lc,
+		float ce, u_int mc);
+	virtual ~IGIIntegrator ();
 	virtual u_int Li(const Scene &scene, const Sample &sample) const;
 	virtual void RequestSamples(Sampler *sampler, const Scene &scene);
 	virtual void Preprocess(const RandomGenerator &rng, const Scene &scene);
 	static SurfaceIntegrator *CreateSurfaceIntegrator(const ParamSet &params);
 private:
+	u_int BuildLightTree(vector<VirtualLightNode> &tree,
+		const vector<VirtualLight> &lights, vector<u_int> &indices,
+		u_int start, u_int end, const RandomGenerator &rng) const;
+	// Unoccluded contribution of a light tree node at a shading point
+	SWCSpectrum NodeContribution(const SpectrumWavelengths &sw,
+		const BSDF *bsdf, const Point &p, const Vector &wo,
+		const vector<VirtualLight> &lights,
+		const VirtualLightNode &node) const;
+	SWCSpectrum LightCut(const Scene &scene, const Sample &sample,
+		u_int lSet, const BSDF *bsdf, const Point &p, const Vector &wo,
+		bool scattered) const;
+	// Used by Queryable interface
+	float GetMeanCutSize() {
+		fast_mutex::scoped_lock lock(cutStatsMutex);
+		return cutCount > 0. ? static_cast<float>(cutTotal / cutCount) :
+			0.f;
+	}
+	int GetMaxCutSize() {
+		fast_mutex::scoped_lock lock(cutStatsMutex);
+		return static_cast<int>(cutMax);
+	}
+
 	// IGI Private Data
 	u_int nLightPaths, nLightSets;
 	vector<vector<VirtualLight> > virtualLights;
+	vector<vector<VirtualLightNode> > lightTrees;
+	bool lightCuts;
+	float cutError;
+	u_int maxCutSize;
+	// Cut size statistics, in double so that long renders can't overflow
+	mutable fast_mutex cutStatsMutex;
+	mutable double cutCount, cutTotal;
+	mutable u_int cutMax;
 	u_int maxSpecularDepth;
 	float gLimit;
 	u_int vlSetOffset, bufferId, sampleOffset;
@@ -31,6 +31,7 @@
 #include "path.h"
 #include "mc.h"
 #include "context.h"
+#include "profiler.h"
 #include "core/partialcontribution.h"
 
 #include "luxrays/core/geometry/raybuffer.h"
@@ -39,6 +40,14 @@ using namespace lux;
 
 static const u_int passThroughLimit = 10000;
 
+// Surfaces without transmission only receive light from the side of the
+// geometric normal facing wo
+static bool HemisphereOnly(const BSDF *bsdf)
+{
+	return !bsdf->dgShading.scattered &&
+		bsdf->NumComponents(BSDF_ALL_TRANSMISSION) == 0;
+}
+
 // PathIntegrator Method Definitions
 void PathIntegrator::RequestSamples(Sampler *sampler, const Scene &scene)
 {
@@ -407,6 +416,9 @@ void PathIntegrator::BuildShadowRays(const Scene &scene, PathState *pathState, B
 		hybridRendererLightSampleOffset, pathState->pathLength);
 
 	const u_int shadowRaysCount = hints.GetShadowRaysCount();
+	const Vector wo(-pathState->pathRay.d);
+	const bool hemisphere = HemisphereOnly(bsdf);
+	const Normal nf(Dot(wo, bsdf->ng) > 0.f ? bsdf->ng : -bsdf->ng);
 
 	for (u_int j = 0; j < samplingCount; ++j) {
 		const u_int offset = j * (1 + shadowRaysCount * 3);
@@ -429,10 +441,21 @@ void PathIntegrator::BuildShadowRays(const Scene &scene, PathState *pathState, B
 			float lightPdf;
 			SWCSpectrum Li;
 			BSDF *lightBsdf;
-			if (!light->SampleL(scene, pathState->sample, p,
-				lightSample[0], lightSample[1],
-				lightPortal, &lightBsdf, NULL,
-				&lightPdf, &Li))
+			bool sampled;
+			{
+				PROFILE_SCOPE(PROF_LIGHT_SAMPLING);
+				sampled = hemisphere ?
+					light->SampleLHemisphere(scene,
+					pathState->sample, p, nf,
+					lightSample[0], lightSample[1],
+					lightPortal, &lightBsdf, NULL,
+					&lightPdf, &Li) :
+					light->SampleL(scene, pathState->sample,
+					p, lightSample[0], lightSample[1],
+					lightPortal, &lightBsdf, NULL,
+					&lightPdf, &Li);
+			}
+			if (!sampled)
 				continue;
 			lightPdf *= lightSelectionPdf;
 
@@ -448,7 +471,6 @@ void PathIntegrator::BuildShadowRays(const Scene &scene, PathState *pathState, B
 			const Vector wi(wi0 / length);
 
 			const SpectrumWavelengths &sw(pathState->sample.swl);
-			Vector wo(-pathState->pathRay.d);
 
 			Li *= lightBsdf->F(sw, Vector(lightBsdf->dgShading.nn),
 				-wi, false) / (d2 * lightSelectionPdf);
@@ -551,8 +573,15 @@ bool PathIntegrator::NextState(const Scene &scene, SurfaceIntegratorState *s, lu
 					continue;
 				float pdf;
 				SWCSpectrum Le(pathState->pathThroughput);
-				if (!light->Le(scene, pathState->sample,
-					pathState->pathRay, &ibsdf, NULL, &pdf, &Le))
+				// Use the pdf of the sampling done at the last
+				// bounce for multiple importance sampling
+				const bool lit = pathState->GetHemisphere() ?
+					light->LeHemisphere(scene, pathState->sample,
+					pathState->pathRay, pathState->bounceNormal,
+					&ibsdf, NULL, &pdf, &Le) :
+					light->Le(scene, pathState->sample,
+					pathState->pathRay, &ibsdf, NULL, &pdf, &Le);
+				if (!lit)
 					continue;
 				if (enableDirectLightSampling &&
 					!pathState->GetSpecularBounce())
@@ -641,6 +670,9 @@ bool PathIntegrator::NextState(const Scene &scene, SurfaceIntegratorState *s, lu
 		}
 		pathState->lastBounce = p;
 		pathState->bouncePdf = pdf;
+		pathState->SetHemisphere(HemisphereOnly(bsdf));
+		pathState->bounceNormal = Dot(wo, bsdf->ng) > 0.f ? bsdf->ng :
+			-bsdf->ng;
 		pathState->SetSpecularBounce((flags & BSDF_SPECULAR) != 0);
 		pathState->SetSpecular(pathState->GetSpecular() && pathState->GetSpecularBounce());
 	}
@@ -57,6 +57,7 @@ private:
 #define PATHSTATE_FLAGS_SPECULARBOUNCE (1<<0)
 #define PATHSTATE_FLAGS_SPECULAR (1<<1)
 #define PATHSTATE_FLAGS_SCATTERED (1<<2)
+#define PATHSTATE_FLAGS_HEMISPHERE (1<<3)
 
 	bool GetSpecularBounce() const {
 		return (flags & PATHSTATE_FLAGS_SPECULARBOUNCE) != 0;
@@ -82,6 +83,14 @@ private:
 		flags = v ? (flags | PATHSTATE_FLAGS_SCATTERED) : (flags & ~PATHSTATE_FLAGS_SCATTERED);
 	}
 
+	bool GetHemisphere() const {
+		return (flags & PATHSTATE_FLAGS_HEMISPHERE) != 0;
+	}
+
+	void SetHemisphere(const bool v) {
+		flags = v ? (flags | PATHSTATE_FLAGS_HEMISPHERE) : (flags & ~PATHSTATE_FLAGS_HEMISPHERE);
+	}
+
 	// NOTE: the size of this class is extremely important for the total
 	// amount of memory required for hybrid rendering.
 
@@ -112,6 +121,8 @@ private:
 
 	float bouncePdf;
 	Point lastBounce;
+	// Side of the last bounce the lights were sampled on
+	Normal bounceNormal;
 
 	u_short pathLength;
 	// Use Get/SetState to access this
@@ -121,6 +132,7 @@ private:
 	//  specularBounce (1bit)
 	//  specular (1bit)
 	//  scattered (1bit)
+	//  hemisphere (1bit)
 	// Use Get/SetState to access this
 	u_short flags;
 	float xi, yi; // Hold the image coordinates of the sample
@@ -66,13 +66,53 @@ u_int SingleScattering::Li(const Scene &scene, const Ray &ray,
 	const SpectrumWavelengths &sw(sample.swl);
 	SWCSpectrum Tr(1.f);
 	const Vector w(-ray.d / length);
-	t0 += sample.sampler->GetOneD(sample, tauSampleOffset, 0) * step;
-	Ray r(ray(t0), ray.d, 0.f, step, ray.time);
 	const u_int nLights = scene.lights.size();
 	const u_int lightNum = min(nLights - 1,
 		Floor2UInt(sample.sampler->GetOneD(sample, scatterSampleOffset, 0) * nLights));
 	Light *light = scene.lights[lightNum];
 
+	if (vr->CanTrack(sw)) {
+		// Collision estimator, the cost depends on the density along
+		// the ray instead of its length
+		float t;
+		SWCSpectrum weight;
+		const Ray rt(ray.o, ray.d, t0, t1, ray.time);
+		if (!vr->SampleCollision(sw, rt, *(sample.rng), &t, &weight))
+			return light->group;
+		DifferentialGeometry dg;
+		dg.p = ray(t);
+		dg.nn = Normal(w);
+		*Lv = vr->Lve(sw, dg);
+		const SWCSpectrum ss(vr->SigmaS(sw, dg));
+		if (nLights > 0 && !ss.Black()) {
+			// Add contribution of _light_ due to scattering at _p_
+			float pdf;
+			const float u1 = sample.rng->floatValue();
+			const float u2 = sample.rng->floatValue();
+			const float u3 = sample.rng->floatValue();
+			BSDF *ibsdf;
+			SWCSpectrum L;
+			if (light->SampleL(scene, sample, dg.p, u1, u2, u3,
+				&ibsdf, NULL, &pdf, &L)) {
+				if (Connect(scene, sample, vr, true, false,
+					dg.p, ibsdf->dgShading.p, false, &L,
+					NULL, NULL)) {
+					const Vector wo(Normalize(dg.p - ibsdf->dgShading.p));
+					*Lv += ss * L *
+						ibsdf->F(sw, Vector(ibsdf->dgShading.nn), wo, false) *
+						(vr->P(sw, dg, w, wo) * nLights);
+				}
+			}
+		}
+		*Lv *= weight;
+		return light->group;
+	}
+
+	// Only the ray marching is jittered, the tracking starts at the
+	// volume boundary
+	t0 += sample.sampler->GetOneD(sample, tauSampleOffset, 0) * step;
+	Ray r(ray(t0), ray.d, 0.f, step, ray.time);
+
 	// Compute sample patterns for single scattering samples
 	// FIXME - use real samples
 	float *samp = static_cast<float *>(alloca(3 * N * sizeof(float)));
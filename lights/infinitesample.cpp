@@ -108,15 +108,253 @@ protected:
 	const Transform &LightToWorld;
 };
 
+// Pyramid over the importance map where every node also bounds the
+// directions it covers with a cone, so the part of the map below the
+// horizon of a shading point can be culled while walking down to a leaf
+namespace lux
+{
+class EnvironmentHierarchy {
+public:
+	enum Mode { CLIP, COSINE };
+	EnvironmentHierarchy(const float *img, u_int nu, u_int nv,
+		const EnvironmentMapping &mapping, Mode mode);
+
+	// n is the light space normal of the receiving surface
+	bool Sample(const Vector &n, float u1, float u2, float uv[2],
+		float *pdf) const;
+	float Pdf(const Vector &n, float s, float t) const;
+private:
+	struct Node {
+		float weight;
+		Vector axis;
+		float cosAngle, sinAngle;
+	};
+	u_int Index(u_int level, u_int x, u_int y) const {
+		return offset[level] + y * width[level] + x;
+	}
+	void SetCone(Node &node, float angle) const {
+		node.cosAngle = angle < M_PI ? cosf(angle) : -1.f;
+		node.sinAngle = angle < M_PI ? sinf(angle) : 0.f;
+	}
+	// Upper bound of the node weight seen from n
+	float Weight(u_int level, u_int x, u_int y, const Vector &n) const;
+	// Weights of the 2x2 children of node (x, y) of the given level
+	void Children(u_int level, u_int x, u_int y, const Vector &n,
+		float w[4]) const {
+		for (u_int j = 0; j < 2; ++j)
+			for (u_int i = 0; i < 2; ++i)
+				w[2 * j + i] = Weight(level - 1,
+					2 * x + i, 2 * y + j, n);
+	}
+
+	Mode mode;
+	u_int nu, nv;
+	vector<u_int> width, height, offset;
+	vector<Node> nodes;
+};
+}//namespace lux
+
+EnvironmentHierarchy::EnvironmentHierarchy(const float *img, u_int nu_,
+	u_int nv_, const EnvironmentMapping &mapping, Mode m) :
+	mode(m), nu(nu_), nv(nv_)
+{
+	width.push_back(nu);
+	height.push_back(nv);
+	offset.push_back(0);
+	while (width.back() > 1 || height.back() > 1) {
+		offset.push_back(offset.back() + width.back() * height.back());
+		width.push_back((width.back() + 1) / 2);
+		height.push_back((height.back() + 1) / 2);
+	}
+	nodes.resize(offset.back() + 1);
+
+	// Directions at the corners, edge centers and centers of the leaves
+	const u_int gu = 2 * nu + 1, gv = 2 * nv + 1;
+	vector<Vector> dirs(gu * gv);
+	vector<bool> valid(gu * gv);
+	for (u_int y = 0; y < gv; ++y) {
+		for (u_int x = 0; x < gu; ++x) {
+			float pdf;
+			mapping.Map(x * .5f / nu, y * .5f / nv, &dirs[y * gu + x],
+				&pdf);
+			valid[y * gu + x] = pdf > 0.f;
+			if (valid[y * gu + x])
+				dirs[y * gu + x] = Normalize(dirs[y * gu + x]);
+		}
+	}
+	for (u_int y = 0; y < nv; ++y) {
+		for (u_int x = 0; x < nu; ++x) {
+			Node &node(nodes[Index(0, x, y)]);
+			node.weight = img[y * nu + x];
+			node.axis = Vector(0.f, 0.f, 1.f);
+			SetCone(node, M_PI);
+			if (!(node.weight > 0.f))
+				continue;
+			Vector axis(0.f);
+			for (u_int j = 0; j < 3; ++j)
+				for (u_int i = 0; i < 3; ++i)
+					if (valid[(2 * y + j) * gu + 2 * x + i])
+						axis += dirs[(2 * y + j) * gu + 2 * x + i];
+			if (!(axis.LengthSquared() > 1e-6f))
+				continue;
+			node.axis = Normalize(axis);
+			// The cone reaches the sample directions, padded with
+			// the distance between neighbouring samples to cover
+			// the directions in between
+			float angle = 0.f, pad = 0.f;
+			for (u_int j = 0; j < 3; ++j) {
+				for (u_int i = 0; i < 3; ++i) {
+					const u_int k = (2 * y + j) * gu + 2 * x + i;
+					if (!valid[k])
+						continue;
+					angle = max(angle, acosf(Clamp(Dot(node.axis,
+						dirs[k]), -1.f, 1.f)));
+					if (i < 2 && j < 2 && valid[k + gu + 1])
+						pad = max(pad, acosf(Clamp(Dot(dirs[k],
+							dirs[k + gu + 1]), -1.f, 1.f)));
+					if (i > 0 && j < 2 && valid[k + gu - 1])
+						pad = max(pad, acosf(Clamp(Dot(dirs[k],
+							dirs[k + gu - 1]), -1.f, 1.f)));
+				}
+			}
+			SetCone(node, angle + .5f * pad + 1e-3f);
+		}
+	}
+
+	// Bound the leaf cones of every node directly, merging the cones
+	// of the children instead would loosen them at each level
+	for (u_int l = 1; l < width.size(); ++l) {
+		vector<Vector> axes(width[l] * height[l], Vector(0.f));
+		vector<bool> full(width[l] * height[l], false);
+		vector<float> angles(width[l] * height[l], 0.f);
+		for (u_int y = 0; y < nv; ++y) {
+			for (u_int x = 0; x < nu; ++x) {
+				const Node &leaf(nodes[Index(0, x, y)]);
+				if (!(leaf.weight > 0.f))
+					continue;
+				const u_int k = (y >> l) * width[l] + (x >> l);
+				nodes[offset[l] + k].weight += leaf.weight;
+				axes[k] += leaf.axis;
+				full[k] = full[k] || leaf.cosAngle <= -1.f;
+			}
+		}
+		for (u_int k = 0; k < axes.size(); ++k) {
+			Node &node(nodes[offset[l] + k]);
+			node.axis = Vector(0.f, 0.f, 1.f);
+			if (!full[k] && axes[k].LengthSquared() > 1e-6f)
+				node.axis = Normalize(axes[k]);
+			else
+				full[k] = true;
+		}
+		for (u_int y = 0; y < nv; ++y) {
+			for (u_int x = 0; x < nu; ++x) {
+				const Node &leaf(nodes[Index(0, x, y)]);
+				const u_int k = (y >> l) * width[l] + (x >> l);
+				if (!(leaf.weight > 0.f) || full[k])
+					continue;
+				angles[k] = max(angles[k], acosf(Clamp(Dot(
+					nodes[offset[l] + k].axis, leaf.axis),
+					-1.f, 1.f)) + acosf(leaf.cosAngle));
+			}
+		}
+		for (u_int k = 0; k < axes.size(); ++k)
+			SetCone(nodes[offset[l] + k], full[k] ? M_PI : angles[k]);
+	}
+}
+
+float EnvironmentHierarchy::Weight(u_int level, u_int x, u_int y,
+	const Vector &n) const
+{
+	if (x >= width[level] || y >= height[level])
+		return 0.f;
+	const Node &node(nodes[Index(level, x, y)]);
+	if (!(node.weight > 0.f))
+		return 0.f;
+	// Largest cosine between n and a direction of the cone
+	const float c = Dot(node.axis, n);
+	const float bound = c >= node.cosAngle ? 1.f : c * node.cosAngle +
+		sqrtf(max(0.f, 1.f - c * c)) * node.sinAngle;
+	if (mode == CLIP)
+		return bound > 0.f ? node.weight : 0.f;
+	return node.weight * max(bound, 0.f);
+}
+
+bool EnvironmentHierarchy::Sample(const Vector &n, float u1, float u2,
+	float uv[2], float *pdf) const
+{
+	const u_int top = width.size() - 1;
+	if (!(Weight(top, 0, 0, n) > 0.f))
+		return false;
+	u_int x = 0, y = 0;
+	float prob = 1.f;
+	for (u_int l = top; l > 0; --l) {
+		float w[4];
+		Children(l, x, y, n, w);
+		// Choose the row with u2 then the column with u1
+		const float row0 = w[0] + w[1], row1 = w[2] + w[3];
+		const float total = row0 + row1;
+		if (!(total > 0.f))
+			return false;
+		u_int j;
+		if (u2 * total < row0 || !(row1 > 0.f)) {
+			j = 0;
+			u2 = u2 * total / row0;
+		} else {
+			j = 1;
+			u2 = (u2 * total - row0) / row1;
+		}
+		u2 = min(u2, OneMinusEpsilon);
+		const float rowTotal = w[2 * j] + w[2 * j + 1];
+		u_int i;
+		if (u1 * rowTotal < w[2 * j] || !(w[2 * j + 1] > 0.f)) {
+			i = 0;
+			u1 = u1 * rowTotal / w[2 * j];
+		} else {
+			i = 1;
+			u1 = (u1 * rowTotal - w[2 * j]) / w[2 * j + 1];
+		}
+		u1 = min(u1, OneMinusEpsilon);
+		prob *= w[2 * j + i] / total;
+		x = 2 * x + i;
+		y = 2 * y + j;
+	}
+	uv[0] = (x + u1) / nu;
+	uv[1] = (y + u2) / nv;
+	*pdf = prob * nu * nv;
+	return true;
+}
+
+float EnvironmentHierarchy::Pdf(const Vector &n, float s, float t) const
+{
+	const u_int top = width.size() - 1;
+	if (!(Weight(top, 0, 0, n) > 0.f))
+		return 0.f;
+	const u_int x = min(Floor2UInt(max(0.f, s) * nu), nu - 1);
+	const u_int y = min(Floor2UInt(max(0.f, t) * nv), nv - 1);
+	float prob = 1.f;
+	for (u_int l = top; l > 0; --l) {
+		float w[4];
+		Children(l, x >> l, y >> l, n, w);
+		const float total = w[0] + w[1] + w[2] + w[3];
+		if (!(total > 0.f))
+			return 0.f;
+		prob *= w[2 * ((y >> (l - 1)) & 1) + ((x >> (l - 1)) & 1)] /
+			total;
+	}
+	return prob * nu * nv;
+}
+
 // InfiniteAreaLightIS Method Definitions
 InfiniteAreaLightIS::~InfiniteAreaLightIS() {
+	delete hierarchy;
 	delete uvDistrib;
 	delete radianceMap;
 	delete mapping;
 }
 InfiniteAreaLightIS::InfiniteAreaLightIS(const Transform &light2world,
 	const RGBColor &l, u_int ns, const string &texmap, u_int immaxres,
-	EnvironmentMapping *m, float g, float gm)
+	EnvironmentMapping *m, float g, float gm, bool aliasSampling,
+	const string &hemisphereSampling)
 	: Light("InfiniteAreaLightIS-" + boost::lexical_cast<string>(this), light2world, ns), SPDbase(l)
 {
 	lightColor = l;
@@ -129,6 +367,7 @@ InfiniteAreaLightIS::InfiniteAreaLightIS(const Transform &light2world,
 	mapping = m;
 	radianceMap = NULL;
 	uvDistrib = NULL;
+	hierarchy = NULL;
 	u_int nu = 0, nv = 0;
 	if (texmap != "") {
 		std::auto_ptr<ImageData> imgdata(ReadImage(texmap));
@@ -182,7 +421,17 @@ InfiniteAreaLightIS::InfiniteAreaLightIS(const Transform &light2world,
 	}
 	mean_y /= dnu*samples * dnv*samples;
 	LOG(LUX_DEBUG, LUX_NOERROR) << "Finished computing importance sampling map";
-	uvDistrib = new Distribution2D(&img[0], dnu, dnv);
+	uvDistrib = new Distribution2D(&img[0], dnu, dnv, aliasSampling);
+	if (hemisphereSampling == "clip")
+		hierarchy = new EnvironmentHierarchy(&img[0], dnu, dnv,
+			*mapping, EnvironmentHierarchy::CLIP);
+	else if (hemisphereSampling == "cosine")
+		hierarchy = new EnvironmentHierarchy(&img[0], dnu, dnv,
+			*mapping, EnvironmentHierarchy::COSINE);
+	else if (hemisphereSampling != "none")
+		LOG(LUX_WARNING, LUX_BADTOKEN) <<
+			"Hemisphere sampling mode '" << hemisphereSampling <<
+			"' unknown. Using \"none\".";
 
 	AddFloatAttribute(*this, "gain", "InfiniteAreaLightIS gain", &InfiniteAreaLightIS::gain);
 	AddFloatAttribute(*this, "gamma", "InfiniteAreaLightIS gamma", &InfiniteAreaLightIS::gamma);
@@ -194,6 +443,20 @@ InfiniteAreaLightIS::InfiniteAreaLightIS(const Transform &light2world,
 bool InfiniteAreaLightIS::Le(const Scene &scene, const Sample &sample,
 	const Ray &r, BSDF **bsdf, float *pdf, float *pdfDirect,
 	SWCSpectrum *L) const
+{
+	return LeNormal(scene, sample, r, NULL, bsdf, pdf, pdfDirect, L);
+}
+
+bool InfiniteAreaLightIS::LeHemisphere(const Scene &scene,
+	const Sample &sample, const Ray &r, const Normal &n, BSDF **bsdf,
+	float *pdf, float *pdfDirect, SWCSpectrum *L) const
+{
+	return LeNormal(scene, sample, r, &n, bsdf, pdf, pdfDirect, L);
+}
+
+bool InfiniteAreaLightIS::LeNormal(const Scene &scene, const Sample &sample,
+	const Ray &r, const Normal *n, BSDF **bsdf, float *pdf,
+	float *pdfDirect, SWCSpectrum *L) const
 {
 	Point worldCenter;
 	float worldRadius;
@@ -221,9 +484,15 @@ bool InfiniteAreaLightIS::Le(const Scene &scene, const Sample &sample,
 		*L *= radianceMap->LookupSpectrum(sample.swl, s, t);
 	if (pdf)
 		*pdf = 1.f / (4.f * M_PI * worldRadius * worldRadius);
-	if (pdfDirect)
-		*pdfDirect = uvDistrib->Pdf(s, t) * pdfMap *
-			AbsDot(r.d, ns) / DistanceSquared(r.o, ps);
+	if (pdfDirect) {
+		if (n && hierarchy)
+			*pdfDirect = hierarchy->Pdf(Vector(Normalize(
+				Inverse(LightToWorld) * *n)), s, t);
+		else
+			*pdfDirect = uvDistrib->Pdf(s, t);
+		*pdfDirect *= pdfMap * AbsDot(r.d, ns) /
+			DistanceSquared(r.o, ps);
+	}
 	return true;
 }
 
@@ -263,13 +532,36 @@ bool InfiniteAreaLightIS::SampleL(const Scene &scene, const Sample &sample,
 bool InfiniteAreaLightIS::SampleL(const Scene &scene, const Sample &sample,
 	const Point &p, float u1, float u2, float u3, BSDF **bsdf, float *pdf,
 	float *pdfDirect, SWCSpectrum *Le) const
+{
+	return SampleLNormal(scene, sample, p, NULL, u1, u2, u3, bsdf, pdf,
+		pdfDirect, Le);
+}
+
+bool InfiniteAreaLightIS::SampleLHemisphere(const Scene &scene,
+	const Sample &sample, const Point &p, const Normal &n,
+	float u1, float u2, float u3, BSDF **bsdf, float *pdf,
+	float *pdfDirect, SWCSpectrum *Le) const
+{
+	return SampleLNormal(scene, sample, p, &n, u1, u2, u3, bsdf, pdf,
+		pdfDirect, Le);
+}
+
+bool InfiniteAreaLightIS::SampleLNormal(const Scene &scene,
+	const Sample &sample, const Point &p, const Normal *n,
+	float u1, float u2, float u3, BSDF **bsdf, float *pdf,
+	float *pdfDirect, SWCSpectrum *Le) const
 {
 	Point worldCenter;
 	float worldRadius;
 	scene.WorldBound().BoundingSphere(&worldCenter, &worldRadius);
 	// Find floating-point $(u,v)$ sample coordinates
 	float uv[2];
-	uvDistrib->SampleContinuous(u1, u2, uv, pdfDirect);
+	if (n && hierarchy) {
+		if (!hierarchy->Sample(Vector(Normalize(Inverse(LightToWorld) *
+			*n)), u1, u2, uv, pdfDirect))
+			return false;
+	} else
+		uvDistrib->SampleContinuous(u1, u2, uv, pdfDirect);
 	// Convert sample point to direction on the unit sphere
 	Vector wi;
 	float pdfMap;
@@ -321,8 +613,16 @@ Light* InfiniteAreaLightIS::CreateLight(const Transform &light2world,
 	// Initialize _ImageTexture_ parameters
 	float gain = paramSet.FindOneFloat("gain", 1.0f);
 	float gamma = paramSet.FindOneFloat("gamma", 1.0f);
+	// Constant time sampling of the importance map, faster with large
+	// maps but less stratified
+	bool aliasSampling = paramSet.FindOneBool("aliassampling", false);
+	// Direct lighting of surfaces that don't transmit light skips the
+	// part of the map below their horizon ("clip") and can also favor
+	// the directions close to their normal ("cosine")
+	string hemisphereSampling = paramSet.FindOneString("hemispheresampling",
+		"none");
 
-	InfiniteAreaLightIS *l = new InfiniteAreaLightIS(light2world, L, nSamples, texmap, imapmaxres, map, gain, gamma);
+	InfiniteAreaLightIS *l = new InfiniteAreaLightIS(light2world, L, nSamples, texmap, imapmaxres, map, gain, gamma, aliasSampling, hemisphereSampling);
 	l->hints.InitParam(paramSet);
 	return l;
 }
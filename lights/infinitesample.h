@@ -29,13 +29,16 @@
 
 namespace lux
 {
+class EnvironmentHierarchy;
+
 // InfiniteAreaLightIS Definitions
 class InfiniteAreaLightIS : public Light {
 public:
 	// InfiniteAreaLightIS Public Methods
 	InfiniteAreaLightIS(const Transform &light2world, const RGBColor &l,
 		u_int ns, const string &texmap, u_int imr, EnvironmentMapping *m,
-		float gain, float gamma);
+		float gain, float gamma, bool aliasSampling = false,
+		const string &hemisphereSampling = "none");
 	virtual ~InfiniteAreaLightIS();
 	virtual float Power(const Scene &scene) const {
 		Point worldCenter;
@@ -55,6 +58,13 @@ public:
 	virtual bool SampleL(const Scene &scene, const Sample &sample,
 		const Point &p, float u1, float u2, float u3, BSDF **bsdf,
 		float *pdf, float *pdfDirect, SWCSpectrum *Le) const;
+	virtual bool SampleLHemisphere(const Scene &scene, const Sample &sample,
+		const Point &p, const Normal &n, float u1, float u2, float u3,
+		BSDF **bsdf, float *pdf, float *pdfDirect,
+		SWCSpectrum *Le) const;
+	virtual bool LeHemisphere(const Scene &scene, const Sample &sample,
+		const Ray &r, const Normal &n, BSDF **bsdf, float *pdf,
+		float *pdfDirect, SWCSpectrum *L) const;
 
 	MIPMap *GetRadianceMap() { return radianceMap; }
 
@@ -69,12 +79,24 @@ private:
 	float GetColorG() { return lightColor.c[1]; }
 	float GetColorB() { return lightColor.c[2]; }
 
+	// n is the world space normal of the receiving surface, NULL if
+	// the whole sphere of directions has to be sampled
+	bool LeNormal(const Scene &scene, const Sample &sample, const Ray &r,
+		const Normal *n, BSDF **bsdf, float *pdf, float *pdfDirect,
+		SWCSpectrum *L) const;
+	bool SampleLNormal(const Scene &scene, const Sample &sample,
+		const Point &p, const Normal *n, float u1, float u2, float u3,
+		BSDF **bsdf, float *pdf, float *pdfDirect,
+		SWCSpectrum *Le) const;
+
 	RGBColor lightColor;
 	float gain, gamma;
 
 	// InfiniteAreaLightIS Private Data
 	RGBIllumSPD SPDbase;
 	Distribution2D *uvDistrib;
+	// Only built when hemisphere sampling is enabled
+	EnvironmentHierarchy *hierarchy;
 	float mean_y;
 };
 
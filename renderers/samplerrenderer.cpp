@@ -28,6 +28,9 @@
 #include "samplerrenderer.h"
 #include "randomgen.h"
 #include "context.h"
+#include "profiler.h"
+#include "osfunc.h"
+#include "paramset.h"
 #include "renderers/statistics/samplerstatistics.h"
 
 using namespace lux;
@@ -74,9 +77,17 @@ SRHostDescription::~SRHostDescription() {
 // SamplerRenderer
 //------------------------------------------------------------------------------
 
-SamplerRenderer::SamplerRenderer() : Renderer() {
+SamplerRenderer::SamplerRenderer(bool numa) : Renderer() {
 	state = INIT;
 
+	numaAware = numa;
+	if (numaAware) {
+		numaNodes = osNumaNodes();
+		LOG(LUX_INFO, LUX_NOERROR) << "Spreading render threads over " <<
+			numaNodes.size() << " NUMA nodes";
+	} else
+		numaNodes.push_back(0);
+
 	SRHostDescription *host = new SRHostDescription(this, "Localhost");
 	hosts.push_back(host);
 
@@ -260,7 +271,11 @@ void SamplerRenderer::CreateRenderThread() {
 	// Avoid to create the thread in case signal is EXIT. For instance, it
 	// can happen when the rendering is done.
 	if ((state == RUN) || (state == PAUSE)) {
-		RenderThread *rt = new  RenderThread(renderThreads.size(), this);
+		// Consecutive threads go to different nodes so that all the
+		// nodes are used with less threads than processors
+		const u_int index = renderThreads.size();
+		RenderThread *rt = new  RenderThread(index,
+			index % numaNodes.size(), this);
 
 		renderThreads.push_back(rt);
 		rt->thread = new boost::thread(boost::bind(RenderThread::RenderImpl, rt));
@@ -282,8 +297,8 @@ void SamplerRenderer::RemoveRenderThread() {
 //------------------------------------------------------------------------------
 
 
-SamplerRenderer::RenderThread::RenderThread(u_int index, SamplerRenderer *r) :
-	n(index), renderer(r), thread(NULL), samples(0.), blackSamples(0.), blackSamplePaths(0.) {
+SamplerRenderer::RenderThread::RenderThread(u_int index, u_int numaNode,
+	SamplerRenderer *r) : n(index), node(numaNode), renderer(r), thread(NULL), samples(0.), blackSamples(0.), blackSamplePaths(0.) {
 }
 
 SamplerRenderer::RenderThread::~RenderThread() {
@@ -299,6 +314,15 @@ void SamplerRenderer::RenderThread::RenderImpl(RenderThread *myThread) {
 	// To avoid interrupt exception
 	boost::this_thread::disable_interruption di;
 
+	// Pin the thread before anything gets allocated so that its
+	// sampler data, arena and contribution buffers are first touched,
+	// and thus placed, on its node
+	if (renderer->numaAware &&
+		!osBindThreadToNumaNode(renderer->numaNodes[myThread->node]))
+		LOG(LUX_WARNING, LUX_SYSTEM) << "Unable to bind thread " <<
+			myThread->n << " to NUMA node " <<
+			renderer->numaNodes[myThread->node];
+
 	Sampler *sampler = scene.sampler;
 	Sample sample;
 	sampler->InitSample(&sample);
@@ -311,7 +335,8 @@ void SamplerRenderer::RenderThread::RenderImpl(RenderThread *myThread) {
 	// ContribBuffer has to wait until the end of the preprocessing
 	// It depends on the fact that the film buffers have been created
 	// This is done during the preprocessing phase
-	sample.contribBuffer = new ContributionBuffer(scene.camera()->film->contribPool);
+	sample.contribBuffer = new ContributionBuffer(scene.camera()->film->contribPool,
+		myThread->node);
 
 	// initialize the thread's rangen
 	u_long seed = scene.seedBase + myThread->n;
@@ -325,7 +350,12 @@ void SamplerRenderer::RenderThread::RenderImpl(RenderThread *myThread) {
 
 	// Trace rays: The main loop
 	while (true) {
-		if (!sampler->GetNextSample(&sample)) {
+		bool sampled;
+		{
+			PROFILE_SCOPE(PROF_SAMPLER);
+			sampled = sampler->GetNextSample(&sample);
+		}
+		if (!sampled) {
 			// Dade - we have done, check what we have to do now
 			if (renderer->suspendThreadsWhenDone) {
 				// Dade - wait for a resume rendering or exit
@@ -361,7 +391,13 @@ void SamplerRenderer::RenderThread::RenderImpl(RenderThread *myThread) {
 		// Evaluate radiance along camera ray
 		// Jeanphi - Hijack statistics until volume integrator revamp
 		{
-			const u_int nContribs = scene.surfaceIntegrator->Li(scene, sample);
+			u_int nContribs;
+			{
+				PROFILE_SCOPE(PROF_INTEGRATOR);
+				nContribs = scene.surfaceIntegrator->Li(scene,
+					sample);
+			}
+			PROFILE_COUNT(PROF_SAMPLES, 1);
 			// update samples statistics
 			fast_mutex::scoped_lock lockStats(myThread->statLock);
 			myThread->blackSamples += nContribs;
@@ -370,7 +406,10 @@ void SamplerRenderer::RenderThread::RenderImpl(RenderThread *myThread) {
 			++(myThread->samples);
 		}
 
-		sampler->AddSample(sample);
+		{
+			PROFILE_SCOPE(PROF_SAMPLER);
+			sampler->AddSample(sample);
+		}
 
 		// Free BSDF memory from computing image sample value
 		sample.arena.FreeAll();
@@ -389,7 +428,8 @@ void SamplerRenderer::RenderThread::RenderImpl(RenderThread *myThread) {
 }
 
 Renderer *SamplerRenderer::CreateRenderer(const ParamSet &params) {
-	return new SamplerRenderer();
+	const bool numa = params.FindOneBool("numa", false);
+	return new SamplerRenderer(numa);
 }
 
 static DynamicLoader::RegisterRenderer<SamplerRenderer> r("sampler");
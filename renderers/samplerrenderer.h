@@ -92,7 +92,11 @@ private:
 
 class SamplerRenderer : public Renderer {
 public:
-	SamplerRenderer();
+	/**
+	 * @param numa Spread the render threads over the NUMA nodes and pin
+	 * them to the processors of their node
+	 */
+	SamplerRenderer(bool numa = false);
 	~SamplerRenderer();
 
 	RendererType GetType() const;
@@ -120,12 +124,13 @@ private:
 
 	class RenderThread : public boost::noncopyable {
 	public:
-		RenderThread(u_int index, SamplerRenderer *renderer);
+		RenderThread(u_int index, u_int node, SamplerRenderer *renderer);
 		~RenderThread();
 
 		static void RenderImpl(RenderThread *r);
 
 		u_int  n;
+		u_int node; // index in numaNodes of the NUMA node the thread runs on
 		SamplerRenderer *renderer;
 		boost::thread *thread; // keep pointer to delete the thread object
 		double samples, blackSamples, blackSamplePaths;
@@ -148,10 +153,16 @@ private:
 	fast_mutex sampPosMutex;
 	u_int sampPos;
 
+	// IDs of the NUMA nodes the threads are spread over, the threads and
+	// the contribution pool use indices in this list. Only node 0 when the
+	// threads are not spread over the nodes.
+	vector<u_int> numaNodes;
+
 	// Put them last for better data alignment
 	// used to suspend render threads until the preprocessing phase is done
 	bool preprocessDone;
 	bool suspendThreadsWhenDone;
+	bool numaAware;
 };
 
 }//namespace lux
@@ -34,6 +34,7 @@
 #include "film.h"
 #include "sampling.h"
 #include "context.h"
+#include "parallel.h"
 #include "slgrenderer.h"
 #include "renderers/statistics/slgstatistics.h"
 #include "cameras/perspective.h"
@@ -1175,29 +1176,35 @@ void SLGRenderer::ConvertEnvLights(luxrays::sdl::Scene *slgScene) {
 	}
 }
 
-vector<luxrays::ExtTriangleMesh *> SLGRenderer::DefinePrimitive(luxrays::sdl::Scene *slgScene, const Primitive *prim) {
+void SLGRenderer::TesselatePrimitive(const Primitive *prim,
+		map<const Primitive *, vector<luxrays::ExtTriangleMesh *> > *primMeshLists,
+		vector<luxrays::ExtTriangleMesh *> *meshes) {
+	// Check if I have already tesselated the primitive
+	if (primMeshLists->count(prim) > 0)
+		return;
 	//LOG(LUX_DEBUG, LUX_NOERROR) << "Define primitive type: " << ToClassName(prim);
 
-	vector<luxrays::ExtTriangleMesh *> meshList;
+	vector<luxrays::ExtTriangleMesh *> &meshList((*primMeshLists)[prim]);
 	prim->ExtTesselate(&meshList, &scene->tesselatedPrimitives);
+	meshes->insert(meshes->end(), meshList.begin(), meshList.end());
+}
 
-	for (vector<luxrays::ExtTriangleMesh *>::const_iterator mesh = meshList.begin(); mesh != meshList.end(); ++mesh) {
-		if (!(*mesh)->HasNormals()) {
-			// SLG requires shading normals
-			Normal *normals = (*mesh)->ComputeNormals();
-
-			if (normals) {
-				// I have to keep track of memory allocated for normals so, later, it
-				// can be deleted
-				alloctedMeshNormals.push_back(normals);
-			}
-		}
-
-		const string meshName = "Mesh-" + ToString(*mesh);
-		slgScene->DefineObject(meshName, *mesh);
-	}
+static void ComputeSLGMeshNormals(u_int index,
+		luxrays::ExtTriangleMesh * const *meshes, Normal **normals) {
+	// SLG requires shading normals
+	if (!meshes[index]->HasNormals())
+		normals[index] = meshes[index]->ComputeNormals();
+}
 
-	return meshList;
+// Formats a transformation for the SLG scene properties, with enough
+// digits to get back the same floats
+static string SLGTransformString(const Transform &trans) {
+	std::ostringstream ss;
+	ss << std::setprecision(9);
+	for (int j = 0; j < 4; ++j)
+		for (int i = 0; i < 4; ++i)
+			ss << trans.m.m[i][j] << " ";
+	return ss.str();
 }
 
 void SLGRenderer::ConvertGeometry(luxrays::sdl::Scene *slgScene, ColorSystem &colorSpace) {
@@ -1206,6 +1213,37 @@ void SLGRenderer::ConvertGeometry(luxrays::sdl::Scene *slgScene, ColorSystem &co
 	// To keep track of all primitive mesh lists
 	map<const Primitive *, vector<luxrays::ExtTriangleMesh *> > primMeshLists;
 
+	// Tesselate each primitive and instance source once, in scene order.
+	// ExtTesselate only wraps the primitive data, the costly part is the
+	// computation of the missing shading normals which is done in parallel
+	vector<luxrays::ExtTriangleMesh *> meshes;
+	for (size_t i = 0; i < scene->primitives.size(); ++i) {
+		const Primitive *prim = scene->primitives[i].get();
+		const InstancePrimitive *instance = dynamic_cast<const InstancePrimitive *>(prim);
+		if (instance) {
+			const vector<boost::shared_ptr<Primitive> > &instanceSources = instance->GetInstanceSources();
+			for (u_int j = 0; j < instanceSources.size(); ++j)
+				TesselatePrimitive(instanceSources[j].get(), &primMeshLists, &meshes);
+		} else
+			TesselatePrimitive(prim, &primMeshLists, &meshes);
+	}
+
+	vector<Normal *> meshNormals(meshes.size(), NULL);
+	if (meshes.size() > 0)
+		ParallelFor(meshes.size(), boost::bind(&ComputeSLGMeshNormals, _1,
+			&meshes[0], &meshNormals[0]));
+
+	for (u_int i = 0; i < meshes.size(); ++i) {
+		if (meshNormals[i]) {
+			// I have to keep track of memory allocated for normals so, later, it
+			// can be deleted
+			alloctedMeshNormals.push_back(meshNormals[i]);
+		}
+
+		const string meshName = "Mesh-" + ToString(meshes[i]);
+		slgScene->DefineObject(meshName, meshes[i]);
+	}
+
 	for (size_t i = 0; i < scene->primitives.size(); ++i) {
 		const Primitive *prim = scene->primitives[i].get();
 		//LOG(LUX_DEBUG, LUX_NOERROR) << "Primitive type: " << ToClassName(prim);
@@ -1217,28 +1255,14 @@ void SLGRenderer::ConvertGeometry(luxrays::sdl::Scene *slgScene, ColorSystem &co
 
 			const vector<boost::shared_ptr<Primitive> > &instanceSources = instance->GetInstanceSources();
 
-			for (u_int i = 0; i < instanceSources.size(); ++i) {
-				const Primitive *instancedSource = instanceSources[i].get();
+			// Build transformation string, shared by all the sources
+			const string transString = SLGTransformString(instance->GetTransform());
 
-				vector<luxrays::ExtTriangleMesh *> meshList;
-				// Check if I have already defined one of the original primitive
-				if (primMeshLists.count(instancedSource) < 1) {
-					// I have to define the instanced primitive
-					meshList = DefinePrimitive(slgScene, instancedSource);
-					primMeshLists[instancedSource] = meshList;
-				} else
-					meshList = primMeshLists[instancedSource];
+			for (u_int i = 0; i < instanceSources.size(); ++i) {
+				const vector<luxrays::ExtTriangleMesh *> &meshList(primMeshLists[instanceSources[i].get()]);
 
 				if (meshList.size() == 0)
 					continue;
-
-				// Build transformation string
-				const Transform trans = instance->GetTransform();
-				std::ostringstream ss;
-				for (int j = 0; j < 4; ++j)
-					for (int i = 0; i < 4; ++i)
-						ss << trans.m.m[i][j] << " ";
-				string transString = ss.str();
 	
 				// Add the object
 				for (vector<luxrays::ExtTriangleMesh *>::const_iterator mesh = meshList.begin(); mesh != meshList.end(); ++mesh) {
@@ -1259,12 +1283,7 @@ void SLGRenderer::ConvertGeometry(luxrays::sdl::Scene *slgScene, ColorSystem &co
 				}
 			}
 		} else {
-			vector<luxrays::ExtTriangleMesh *> meshList;
-			if (primMeshLists.count(prim) < 1) {
-				meshList = DefinePrimitive(slgScene, prim);
-				primMeshLists[prim] = meshList;
-			} else
-				meshList = primMeshLists[prim];
+			const vector<luxrays::ExtTriangleMesh *> &meshList(primMeshLists[prim]);
 
 			if (meshList.size() == 0)
 				continue;
@@ -1504,46 +1523,43 @@ luxrays::Properties SLGRenderer::CreateSLGConfig() {
 	return config;
 }
 
-void SLGRenderer::UpdateLuxFilm(slg::RenderSession *session) {
-	luxrays::utils::Film *slgFilm = session->film;
+// Size of the square tiles merged in parallel by UpdateLuxFilm()
+#define SLG_FILM_UPDATE_TILE_SIZE 64
 
+void SLGRenderer::UpdateLuxFilmTile(luxrays::utils::Film *slgFilm,
+		const ColorSystem *colorSpace, u_int eyeBufferId, u_int lightBufferId,
+		u_int tile) {
 	Film *film = scene->camera()->film;
-	ColorSystem colorSpace = film->GetColorSpace();
 	const u_int width = film->GetXPixelCount();
 	const u_int height = film->GetYPixelCount();
 
-	// Recover the ID of buffers
-	const PathIntegrator *path = dynamic_cast<const PathIntegrator *>(scene->surfaceIntegrator);
-	const BidirIntegrator *bidir = dynamic_cast<const BidirIntegrator *>(scene->surfaceIntegrator);
-	u_int eyeBufferId, lightBufferId;
-	if (path) {
-		eyeBufferId = path->bufferId;
-		lightBufferId = eyeBufferId;
-	} else if (bidir) {
-		eyeBufferId = bidir->eyeBufferId;
-		lightBufferId = bidir->lightBufferId;		
-	} else
-		throw std::runtime_error("Internal error: surfaceIntegretor is not PathIntegrator or BidirIntegrator");
-
-	// Lock the contribution pool in order to have exclusive
-	// access to the film
-	ScopedPoolLock poolLock(film->contribPool);
+	const u_int tilesX = (width + SLG_FILM_UPDATE_TILE_SIZE - 1) / SLG_FILM_UPDATE_TILE_SIZE;
+	const u_int xStart = (tile % tilesX) * SLG_FILM_UPDATE_TILE_SIZE;
+	const u_int yStart = (tile / tilesX) * SLG_FILM_UPDATE_TILE_SIZE;
+	const u_int xEnd = min(xStart + SLG_FILM_UPDATE_TILE_SIZE, width);
+	const u_int yEnd = min(yStart + SLG_FILM_UPDATE_TILE_SIZE, height);
 
 	if (slgFilm->HasPerPixelNormalizedBuffer()) {
 		// Copy the information from PER_PIXEL_NORMALIZED buffer
+		const bool alphaEnabled = slgFilm->IsAlphaChannelEnabled();
 
-		for (u_int pixelY = 0; pixelY < height; ++pixelY) {
-			for (u_int pixelX = 0; pixelX < width; ++pixelX) {
+		for (u_int pixelY = yStart; pixelY < yEnd; ++pixelY) {
+			for (u_int pixelX = xStart; pixelX < xEnd; ++pixelX) {
 				const luxrays::utils::SamplePixel *spNew = slgFilm->GetSamplePixel(
 					luxrays::utils::PER_PIXEL_NORMALIZED, pixelX, pixelY);
 
-				luxrays::Spectrum deltaRadiance = spNew->radiance - (*previousEyeBufferRadiance)(pixelX, pixelY);
+				// Most pixels don't change between two updates once
+				// the rendering has converged in some areas
 				const float deltaWeight = spNew->weight - (*previousEyeWeight)(pixelX, pixelY);
+				if (deltaWeight == 0.f)
+					continue;
+
+				luxrays::Spectrum deltaRadiance = spNew->radiance - (*previousEyeBufferRadiance)(pixelX, pixelY);
 
 				(*previousEyeBufferRadiance)(pixelX, pixelY) = spNew->radiance;
 				(*previousEyeWeight)(pixelX, pixelY) = spNew->weight;
 
-				const float alphaNew = slgFilm->IsAlphaChannelEnabled() ?
+				const float alphaNew = alphaEnabled ?
 					(slgFilm->GetAlphaPixel(pixelX, pixelY)->alpha) : 0.f;
 				float deltaAlpha = alphaNew - (*previousAlphaBuffer)(pixelX, pixelY);
 
@@ -1553,7 +1569,7 @@ void SLGRenderer::UpdateLuxFilm(slg::RenderSession *session) {
 					deltaRadiance /= deltaWeight;
 					deltaAlpha /= deltaWeight;
 
-					XYZColor xyz = colorSpace.ToXYZ(RGBColor(deltaRadiance.r, deltaRadiance.g, deltaRadiance.b));
+					XYZColor xyz = colorSpace->ToXYZ(RGBColor(deltaRadiance.r, deltaRadiance.g, deltaRadiance.b));
 					// Flip the image upside down
 					Contribution contrib(pixelX, height - 1 - pixelY, xyz, deltaAlpha, 0.f, deltaWeight, eyeBufferId);
 					film->AddSampleNoFiltering(&contrib);
@@ -1565,13 +1581,16 @@ void SLGRenderer::UpdateLuxFilm(slg::RenderSession *session) {
 	if (slgFilm->HasPerScreenNormalizedBuffer()) {
 		// Copy the information from PER_SCREEN_NORMALIZED buffer
 
-		for (u_int pixelY = 0; pixelY < height; ++pixelY) {
-			for (u_int pixelX = 0; pixelX < width; ++pixelX) {
+		for (u_int pixelY = yStart; pixelY < yEnd; ++pixelY) {
+			for (u_int pixelX = xStart; pixelX < xEnd; ++pixelX) {
 				const luxrays::utils::SamplePixel *spNew = slgFilm->GetSamplePixel(
 					luxrays::utils::PER_SCREEN_NORMALIZED, pixelX, pixelY);
 
-				luxrays::Spectrum deltaRadiance = spNew->radiance - (*previousLightBufferRadiance)(pixelX, pixelY);
 				const float deltaWeight = spNew->weight - (*previousLightWeight)(pixelX, pixelY);
+				if (deltaWeight == 0.f)
+					continue;
+
+				luxrays::Spectrum deltaRadiance = spNew->radiance - (*previousLightBufferRadiance)(pixelX, pixelY);
 
 				(*previousLightBufferRadiance)(pixelX, pixelY) = spNew->radiance;
 				(*previousLightWeight)(pixelX, pixelY) = spNew->weight;
@@ -1580,7 +1599,7 @@ void SLGRenderer::UpdateLuxFilm(slg::RenderSession *session) {
 					// This is required to cancel the "* weight" inside AddSampleNoFiltering()
 					deltaRadiance /= deltaWeight;
 
-					XYZColor xyz = colorSpace.ToXYZ(RGBColor(deltaRadiance.r, deltaRadiance.g, deltaRadiance.b));
+					XYZColor xyz = colorSpace->ToXYZ(RGBColor(deltaRadiance.r, deltaRadiance.g, deltaRadiance.b));
 					// Flip the image upside down
 					Contribution contrib(pixelX, height - 1 - pixelY, xyz, 1.f, 0.f, deltaWeight, lightBufferId);
 					film->AddSampleNoFiltering(&contrib);
@@ -1588,8 +1607,49 @@ void SLGRenderer::UpdateLuxFilm(slg::RenderSession *session) {
 			}
 		}
 	}
+}
+
+void SLGRenderer::UpdateLuxFilm(slg::RenderSession *session) {
+	luxrays::utils::Film *slgFilm = session->film;
+
+	Film *film = scene->camera()->film;
+	const ColorSystem colorSpace = film->GetColorSpace();
+	const u_int width = film->GetXPixelCount();
+	const u_int height = film->GetYPixelCount();
 
+	// Nothing to merge if no sample has been added since the last update
 	const float newSampleCount = session->renderEngine->GetTotalSampleCount(); 
+	if (newSampleCount == previousSampleCount)
+		return;
+
+	// Recover the ID of buffers
+	const PathIntegrator *path = dynamic_cast<const PathIntegrator *>(scene->surfaceIntegrator);
+	const BidirIntegrator *bidir = dynamic_cast<const BidirIntegrator *>(scene->surfaceIntegrator);
+	u_int eyeBufferId, lightBufferId;
+	if (path) {
+		eyeBufferId = path->bufferId;
+		lightBufferId = eyeBufferId;
+	} else if (bidir) {
+		eyeBufferId = bidir->eyeBufferId;
+		lightBufferId = bidir->lightBufferId;		
+	} else
+		throw std::runtime_error("Internal error: surfaceIntegretor is not PathIntegrator or BidirIntegrator");
+
+	// Lock the contribution pool in order to have exclusive
+	// access to the film
+	ScopedPoolLock poolLock(film->contribPool);
+
+	// The tiles are merged in parallel, each pixel of the film and of the
+	// previous values buffers is only written by the thread of its tile.
+	// The flipped tiles don't match the pages of the film buffers, so two
+	// threads may allocate the same page: SparsePixelArray publishes
+	// pages with release/acquire ordering under its allocation mutex.
+	const u_int tileCount =
+		((width + SLG_FILM_UPDATE_TILE_SIZE - 1) / SLG_FILM_UPDATE_TILE_SIZE) *
+		((height + SLG_FILM_UPDATE_TILE_SIZE - 1) / SLG_FILM_UPDATE_TILE_SIZE);
+	ParallelFor(tileCount, boost::bind(&SLGRenderer::UpdateLuxFilmTile, this,
+		slgFilm, &colorSpace, eyeBufferId, lightBufferId, _1));
+
 	film->AddSampleCount(newSampleCount - previousSampleCount);
 	previousSampleCount = newSampleCount;
 }
@@ -23,6 +23,7 @@
 #ifndef LUX_SLGRENDERER_H
 #define LUX_SLGRENDERER_H
 
+#include <map>
 #include <vector>
 #include <boost/thread.hpp>
 
@@ -127,12 +128,18 @@ public:
 private:
 	void ConvertCamera(luxrays::sdl::Scene *slgScene);
 	void ConvertEnvLights(luxrays::sdl::Scene *slgScene);
-	vector<luxrays::ExtTriangleMesh *> DefinePrimitive(luxrays::sdl::Scene *slgScene, const Primitive *prim);
+	void TesselatePrimitive(const Primitive *prim,
+		map<const Primitive *, vector<luxrays::ExtTriangleMesh *> > *primMeshLists,
+		vector<luxrays::ExtTriangleMesh *> *meshes);
 	void ConvertGeometry(luxrays::sdl::Scene *slgScene, ColorSystem &colorSpace);
 	luxrays::sdl::Scene *CreateSLGScene(const luxrays::Properties &slgConfigProps, ColorSystem &colorSpace);
 	luxrays::Properties CreateSLGConfig();
 
 	void UpdateLuxFilm(slg::RenderSession *session);
+	// Merges the changes of a tile of the SLG film into the Lux film
+	void UpdateLuxFilmTile(luxrays::utils::Film *slgFilm,
+		const ColorSystem *colorSpace, u_int eyeBufferId,
+		u_int lightBufferId, u_int tile);
 
 	mutable boost::mutex classWideMutex;
 
@@ -65,6 +65,8 @@ SRStatistics::SRStatistics(SamplerRenderer* renderer)
 	AddDoubleAttribute(*this, "totalSamplesPerPixel", "Average number of samples per pixel", &SRStatistics::getTotalAverageSamplesPerPixel);
 	AddDoubleAttribute(*this, "totalSamplesPerSecond", "Average number of samples per second", &SRStatistics::getTotalAverageSamplesPerSecond);
 	AddDoubleAttribute(*this, "totalSamplesPerSecondWindow", "Average number of samples per second in current time window", &SRStatistics::getTotalAverageSamplesPerSecondWindow);
+
+	AddStringAttribute(*this, "numaSamplesPerSecond", "Average number of samples per second by the threads of each NUMA node, space separated", &SRStatistics::getNumaSamplesPerSecondList);
 }
 
 SRStatistics::~SRStatistics()
@@ -266,6 +268,33 @@ double SRStatistics::getNetworkSampleCount(bool estimate) {
 	return networkSampleCount;
 }
 
+vector<double> SRStatistics::getNumaSamplesPerSecond() {
+	vector<double> nodeSamples(renderer->numaNodes.size(), 0.0);
+	{
+		boost::mutex::scoped_lock lock(renderer->renderThreadsMutex);
+		for (u_int i = 0; i < renderer->renderThreads.size(); ++i) {
+			fast_mutex::scoped_lock lockStats(renderer->renderThreads[i]->statLock);
+			nodeSamples[renderer->renderThreads[i]->node] += renderer->renderThreads[i]->samples;
+		}
+	}
+
+	const double et = getElapsedTime();
+	for (u_int i = 0; i < nodeSamples.size(); ++i)
+		nodeSamples[i] = (et == 0.0) ? 0.0 : nodeSamples[i] / et;
+	return nodeSamples;
+}
+
+std::string SRStatistics::getNumaSamplesPerSecondList() {
+	const vector<double> nsps(getNumaSamplesPerSecond());
+	std::string list;
+	for (u_int i = 0; i < nsps.size(); ++i) {
+		if (i > 0)
+			list += " ";
+		list += boost::str(boost::format("%1%") % nsps[i]);
+	}
+	return list;
+}
+
 SRStatistics::FormattedLong::FormattedLong(SRStatistics* rs)
 	: RendererStatistics::FormattedLong(rs), rs(rs)
 {
@@ -291,6 +320,8 @@ SRStatistics::FormattedLong::FormattedLong(SRStatistics* rs)
 	AddStringAttribute(*this, "totalSamplesPerPixel", "Average number of samples per pixel", &FL::getTotalAverageSamplesPerPixel);
 	AddStringAttribute(*this, "totalSamplesPerSecond", "Average number of samples per second", &FL::getTotalAverageSamplesPerSecond);
 	AddStringAttribute(*this, "totalSamplesPerSecondWindow", "Average number of samples per second in current time window", &FL::getTotalAverageSamplesPerSecondWindow);
+
+	AddStringAttribute(*this, "numaSamplesPerSecond", "Average number of samples per second by the threads of each NUMA node", &FL::getNumaSamplesPerSecond);
 }
 
 std::string SRStatistics::FormattedLong::getRecommendedStringTemplate()
@@ -314,6 +345,9 @@ std::string SRStatistics::FormattedLong::getRecommendedStringTemplate()
 	else if (rs->getResumedSampleCount() != 0.0)
 		stringTemplate += " | Tot: %totalSamplesPerPixel% %totalSamplesPerSecondWindow%";
 
+	if (rs->getNumaNodeCount() > 1)
+		stringTemplate += " | %numaSamplesPerSecond%";
+
 	return stringTemplate;
 }
 
@@ -393,6 +427,17 @@ std::string SRStatistics::FormattedLong::getTotalAverageSamplesPerSecondWindow()
 	return boost::str(boost::format("%1$0.2f %2%S/s") % MagnitudeReduce(spsw) % MagnitudePrefix(spsw));
 }
 
+std::string SRStatistics::FormattedLong::getNumaSamplesPerSecond() {
+	const vector<double> nsps(rs->getNumaSamplesPerSecond());
+	std::string nodes;
+	for (u_int i = 0; i < nsps.size(); ++i) {
+		if (i > 0)
+			nodes += " ";
+		nodes += boost::str(boost::format("Node %1%: %2$0.2f %3%S/s") % i % MagnitudeReduce(nsps[i]) % MagnitudePrefix(nsps[i]));
+	}
+	return nodes;
+}
+
 SRStatistics::FormattedShort::FormattedShort(SRStatistics* rs)
 	: RendererStatistics::FormattedShort(rs), rs(rs)
 {
@@ -67,6 +67,8 @@ public:
 		std::string getTotalAverageSamplesPerSecond();
 		std::string getTotalAverageSamplesPerSecondWindow();
 
+		std::string getNumaSamplesPerSecond();
+
 		friend class SRStatistics;
 		friend class SRStatistics::FormattedShort;
 	};
@@ -129,6 +131,11 @@ private:
 	double getResumedSampleCount();
 	double getSampleCount();
 	double getNetworkSampleCount(bool estimate = true);
+
+	// Samples per second of the render threads of each NUMA node
+	u_int getNumaNodeCount() { return renderer->numaNodes.size(); }
+	vector<double> getNumaSamplesPerSecond();
+	std::string getNumaSamplesPerSecondList();
 };
 
 }//namespace lux
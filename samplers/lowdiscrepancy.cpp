@@ -86,12 +86,13 @@ LDSampler::LDSampler(int xstart, int xend,
 		pixelSamples = RoundUpPow2(ps);
 	} else
 		pixelSamples = ps;
-	sampPixelPos = 0;
+	pixelBatches = new PixelBatches(totalPixels);
 
 	AddStringConstant(*this, "name", "Name of current sampler", "lowdiscrepancy");
 }
 
 LDSampler::~LDSampler() {
+	delete pixelBatches;
 }
 
 // return TotalPixels so scene shared thread increment knows total sample positions
@@ -131,13 +132,8 @@ bool LDSampler::GetNextSample(Sample *sample) {
 		if ((data->noiseAwareMapVersion == 0) && (data->userSamplingMapVersion == 0)) {
 			// Standard sampler using pixel sampler
 
-			u_int sampPixelPosToUse;
 			// Move to the next pixel
-			{
-				fast_mutex::scoped_lock lock(sampPixelPosMutex);
-				sampPixelPosToUse = sampPixelPos;
-				sampPixelPos = (sampPixelPos + 1) % totalPixels;
-			}
+			const u_int sampPixelPosToUse = pixelBatches->Next(data->pixelCursor);
 
 			// fetch next pixel from pixelsampler
 			if(!pixelSampler->GetNextPixel(&data->xPos, &data->yPos, sampPixelPosToUse)) {
@@ -47,6 +47,7 @@ public:
 		u_int noiseAwareMapVersion;
 		u_int userSamplingMapVersion;
 		boost::shared_ptr<Distribution2D> samplingDistribution2D;
+		PixelBatches::Cursor pixelCursor;
 	};
 	// LDSampler Public Methods
 	LDSampler(int xstart, int xend,
@@ -78,10 +79,8 @@ private:
 	// LDSampler Private Data
 	u_int pixelSamples, totalPixels;
 	PixelSampler* pixelSampler;
+	PixelBatches *pixelBatches;
 
-	fast_mutex sampPixelPosMutex;
-	u_int sampPixelPos;
-	
 	bool useNoiseAware;
 };
 
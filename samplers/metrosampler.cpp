@@ -30,17 +30,27 @@
 #include "dynload.h"
 #include "timer.h"
 
+#include <sstream>
+
 using namespace lux;
 
 #define SAMPLE_FLOATS 6
 static const u_int rngN = 8191;
 static const u_int rngA = 884;
 
-MetropolisSampler::MetropolisData::MetropolisData(const MetropolisSampler &sampler) :
+// Number of large steps accumulated by a chain before it publishes them
+// to the shared luminance estimate
+#define METRO_PUBLISH_STEPS 64
+
+MetropolisSampler::MetropolisData::MetropolisData(MetropolisSampler &sampler) :
+	owner(sampler),
 	consecRejects(0), stamp(0), currentStamp(0), weight(0.f),
 	LY(0.f), alpha(0.f), totalLY(0.f), sampleCount(0.f),
 	samplingMap(NULL), noiseAwareMapVersion(0), userSamplingMapVersion(0),
-	large(true), cooldown(sampler.cooldownTime > 0)
+	large(true), cooldown(sampler.cooldownTime > 0),
+	pendingLY(0.), pendingCount(0.), sharedLY(0.), sharedCount(0.),
+	stepsToExchange(sampler.exchangeInterval),
+	largeSteps(0.), smallSteps(0.), acceptedSteps(0.), exchanges(0.)
 {
 	u_int i;
 	// Compute number of non lazy samples
@@ -79,10 +89,23 @@ MetropolisSampler::MetropolisData::MetropolisData(const MetropolisSampler &sampl
 	rngBase = rngN - rngOffset;
 	// Allocate memory for the Cranley-Paterson rotation vector
 	rngRotation = AllocAligned<float>(totalSamples);
+
+	boost::mutex::scoped_lock lock(owner.chainsMutex);
+	owner.chains.push_back(this);
 }
 
 MetropolisSampler::MetropolisData::~MetropolisData()
 {
+	{
+		boost::mutex::scoped_lock lock(owner.chainsMutex);
+		owner.chains.erase(std::find(owner.chains.begin(),
+			owner.chains.end(), this));
+		owner.retiredLargeSteps += largeSteps;
+		owner.retiredSmallSteps += smallSteps;
+		owner.retiredAcceptedSteps += acceptedSteps;
+		owner.retiredExchanges += exchanges;
+	}
+
 	FreeAligned(rngRotation);
 	FreeAligned(currentTimeImage);
 	FreeAligned(timeImage);
@@ -133,10 +156,16 @@ static float fracf(const float &v) {
 
 // Metropolis method definitions
 MetropolisSampler::MetropolisSampler(int xStart, int xEnd, int yStart, int yEnd,
-	u_int maxRej, float largeProb, float rng, bool useV, bool useC, bool useNoise) :
+	u_int maxRej, float largeProb, float rng, bool useV, bool useC, bool useNoise,
+	bool parallel, u_int exchange) :
 	Sampler(xStart, xEnd, yStart, yEnd, 1), maxRejects(maxRej),
 	pLarge(largeProb), range(rng),
-	useVariance(useV), useNoiseAware(useNoise)
+	useVariance(useV), useNoiseAware(useNoise),
+	parallelChains(parallel), exchangeInterval(parallel ? exchange : 0),
+	retiredLargeSteps(0.), retiredSmallSteps(0.), retiredAcceptedSteps(0.),
+	retiredExchanges(0.), globalLY(0.), globalSampleCount(0.),
+	globalMapVersion(0), replicaValid(false), replicaMapVersion(0),
+	replicaLY(0.f), replicaStamp(0)
 {
 	// Allocate and compute all values of the rng
 	rngSamples = AllocAligned<float>(rngN);
@@ -161,6 +190,13 @@ MetropolisSampler::MetropolisSampler(int xStart, int xEnd, int yStart, int yEnd,
 	AddIntAttribute(*this, "maxRejects", "Metropolis max. rejections", &MetropolisSampler::GetMaxRejects);
 	AddFloatAttribute(*this, "pLarge", "Metropolis probability of a large mutation", &MetropolisSampler::pLarge);
 	AddFloatAttribute(*this, "range", "Metropolis image mutation range", &MetropolisSampler::range);
+	AddBoolAttribute(*this, "parallelChains", "Metropolis chains share their normalization and exchange states", &MetropolisSampler::parallelChains);
+	AddIntAttribute(*this, "chains", "Number of Metropolis chains", &MetropolisSampler::GetChainCount);
+	AddDoubleAttribute(*this, "acceptanceRate", "Fraction of accepted Metropolis mutations", &MetropolisSampler::GetAcceptanceRate);
+	AddDoubleAttribute(*this, "largeSteps", "Number of Metropolis large mutations", &MetropolisSampler::GetLargeSteps);
+	AddDoubleAttribute(*this, "smallSteps", "Number of Metropolis small mutations", &MetropolisSampler::GetSmallSteps);
+	AddDoubleAttribute(*this, "exchanges", "Number of Metropolis chain state exchanges", &MetropolisSampler::GetExchanges);
+	AddStringAttribute(*this, "chainStatistics", "Acceptance rate, large steps, small steps and exchanges of each Metropolis chain", &MetropolisSampler::GetChainStatistics);
 }
 
 MetropolisSampler::~MetropolisSampler() {
@@ -220,6 +256,10 @@ bool MetropolisSampler::GetNextSample(Sample *sample)
 				data->consecRejects = 0;
 				data->LY = 0.f;
 				data->weight = 0.f;
+				data->pendingLY = 0.;
+				data->pendingCount = 0.;
+				data->sharedLY = 0.;
+				data->sharedCount = 0.;
 			}
 		}
 
@@ -385,9 +425,23 @@ void MetropolisSampler::AddSample(const Sample &sample)
 	if (data->large) {
 		data->totalLY += newLY;
 		++(data->sampleCount);
-	}
+		data->largeSteps += 1.;
+		if (parallelChains) {
+			data->pendingLY += newLY;
+			data->pendingCount += 1.;
+			if (data->pendingCount >= METRO_PUBLISH_STEPS)
+				PublishLuminance(data);
+		}
+	} else
+		data->smallSteps += 1.;
 
-	const float meanIntensity = data->totalLY > 0. ? static_cast<float>(data->totalLY / data->sampleCount) : 1.f;
+	float meanIntensity;
+	if (parallelChains && data->sharedCount > 0.) {
+		// Estimate shared by all the chains
+		const double totalLY = data->sharedLY + data->pendingLY;
+		meanIntensity = totalLY > 0. ? static_cast<float>(totalLY / (data->sharedCount + data->pendingCount)) : 1.f;
+	} else
+		meanIntensity = data->totalLY > 0. ? static_cast<float>(data->totalLY / data->sampleCount) : 1.f;
 
 	sample.contribBuffer->AddSampleCount(1.f);
 
@@ -420,6 +474,7 @@ void MetropolisSampler::AddSample(const Sample &sample)
 		data->stamp = data->currentStamp;
 
 		data->consecRejects = 0;
+		data->acceptedSteps += 1.;
 	} else {
 		// Add contribution of new sample before rejecting it
 		const float norm = newWeight / (newLY / meanIntensity + largeMutationProb);
@@ -434,6 +489,11 @@ void MetropolisSampler::AddSample(const Sample &sample)
 	}
 	newContributions.clear();
 
+	if (exchangeInterval > 0 && --(data->stepsToExchange) == 0) {
+		data->stepsToExchange = exchangeInterval;
+		ExchangeReplica(data, sample, meanIntensity, largeMutationProb);
+	}
+
 	const float mutationSelector = sample.rng->floatValue();
 	if (data->cooldown) {
 		if (data->sampleCount >= cooldownTime) {
@@ -446,6 +506,138 @@ void MetropolisSampler::AddSample(const Sample &sample)
 		data->large = (mutationSelector < pLarge);
 }
 
+void MetropolisSampler::PublishLuminance(MetropolisData *data)
+{
+	const u_int mapVersion = data->noiseAwareMapVersion + data->userSamplingMapVersion;
+
+	boost::mutex::scoped_lock lock(chainsMutex);
+	if (mapVersion > globalMapVersion) {
+		// The luminance of the samples depends on the sampling map,
+		// restart the estimate with the new map
+		globalMapVersion = mapVersion;
+		globalLY = 0.;
+		globalSampleCount = 0.;
+	}
+	// Samples of chains still using an old map are dropped
+	if (mapVersion == globalMapVersion) {
+		globalLY += data->pendingLY;
+		globalSampleCount += data->pendingCount;
+	}
+	data->sharedLY = globalLY;
+	data->sharedCount = globalSampleCount;
+	data->pendingLY = 0.;
+	data->pendingCount = 0.;
+}
+
+void MetropolisSampler::ExchangeReplica(MetropolisData *data,
+	const Sample &sample, float meanIntensity, float largeMutationProb)
+{
+	// Add the accumulated contribution of the current reference sample,
+	// as when a mutation is accepted
+	const float norm = data->weight / (data->LY / meanIntensity + largeMutationProb);
+	if (norm > 0.f) {
+		for(u_int i = 0; i < data->oldContributions.size(); ++i)
+			sample.contribBuffer->Add(data->oldContributions[i], norm);
+	}
+	data->weight = 0.f;
+
+	const u_int mapVersion = data->noiseAwareMapVersion + data->userSamplingMapVersion;
+
+	boost::mutex::scoped_lock lock(chainsMutex);
+	// The luminance of the parked state depends on the sampling map,
+	// drop it once a newer map is used
+	if (replicaValid && replicaMapVersion < mapVersion)
+		replicaValid = false;
+	// This chain still uses an old map, its state can't be exchanged
+	if (replicaValid && replicaMapVersion > mapVersion)
+		return;
+	if (!replicaValid) {
+		// Park a copy of the state for the next chain
+		replicaImage.assign(data->sampleImage, data->sampleImage + data->totalSamples);
+		replicaTimeImage.assign(data->timeImage, data->timeImage + data->totalTimes);
+		replicaContributions = data->oldContributions;
+		replicaLY = data->LY;
+		replicaStamp = data->stamp;
+		replicaMapVersion = mapVersion;
+		replicaValid = true;
+		return;
+	}
+
+	// All the chains sample the same distribution so the exchange is
+	// always accepted. The chain which parked the state kept running from
+	// it, so the state is a copy: this chain continues from it and parks
+	// its own state for the next exchange. It lets a chain stuck in a dark
+	// region continue from a state found by another chain.
+	std::swap_ranges(data->sampleImage, data->sampleImage + data->totalSamples,
+		replicaImage.begin());
+	std::swap_ranges(data->timeImage, data->timeImage + data->totalTimes,
+		replicaTimeImage.begin());
+	data->oldContributions.swap(replicaContributions);
+	swap(data->LY, replicaLY);
+	swap(data->stamp, replicaStamp);
+	data->consecRejects = 0;
+	data->exchanges += 1.;
+}
+
+u_int MetropolisSampler::GetChainCount()
+{
+	boost::mutex::scoped_lock lock(chainsMutex);
+	return chains.size();
+}
+
+double MetropolisSampler::GetAcceptanceRate()
+{
+	boost::mutex::scoped_lock lock(chainsMutex);
+	double accepted = retiredAcceptedSteps;
+	double steps = retiredLargeSteps + retiredSmallSteps;
+	for (u_int i = 0; i < chains.size(); ++i) {
+		accepted += chains[i]->acceptedSteps;
+		steps += chains[i]->largeSteps + chains[i]->smallSteps;
+	}
+	return steps > 0. ? accepted / steps : 0.;
+}
+
+double MetropolisSampler::GetLargeSteps()
+{
+	boost::mutex::scoped_lock lock(chainsMutex);
+	double steps = retiredLargeSteps;
+	for (u_int i = 0; i < chains.size(); ++i)
+		steps += chains[i]->largeSteps;
+	return steps;
+}
+
+double MetropolisSampler::GetSmallSteps()
+{
+	boost::mutex::scoped_lock lock(chainsMutex);
+	double steps = retiredSmallSteps;
+	for (u_int i = 0; i < chains.size(); ++i)
+		steps += chains[i]->smallSteps;
+	return steps;
+}
+
+double MetropolisSampler::GetExchanges()
+{
+	boost::mutex::scoped_lock lock(chainsMutex);
+	double count = retiredExchanges;
+	for (u_int i = 0; i < chains.size(); ++i)
+		count += chains[i]->exchanges;
+	return count;
+}
+
+string MetropolisSampler::GetChainStatistics()
+{
+	boost::mutex::scoped_lock lock(chainsMutex);
+	std::ostringstream ss;
+	for (u_int i = 0; i < chains.size(); ++i) {
+		const MetropolisData &chain(*chains[i]);
+		const double steps = chain.largeSteps + chain.smallSteps;
+		ss << (steps > 0. ? chain.acceptedSteps / steps : 0.) << " " <<
+			chain.largeSteps << " " << chain.smallSteps << " " <<
+			chain.exchanges << "\n";
+	}
+	return ss.str();
+}
+
 Sampler* MetropolisSampler::CreateSampler(const ParamSet &params, Film *film)
 {
 	int xStart, xEnd, yStart, yEnd;
@@ -456,6 +648,8 @@ Sampler* MetropolisSampler::CreateSampler(const ParamSet &params, Film *film)
 	bool useCooldown = params.FindOneBool("usecooldown", true);
 	bool useNoiseAware = params.FindOneBool("noiseaware", false);
 	float range = params.FindOneFloat("mutationrange", (xEnd - xStart + yEnd - yStart) / 32.f);	// maximum distance in pixel for a small mutation
+	bool parallelChains = params.FindOneBool("parallelchains", false);	// share the normalization between the chains and exchange their states
+	int exchangeInterval = params.FindOneInt("exchangeinterval", 4096);	// number of mutations between two exchanges of a chain, 0 disables them
 
 	if (useNoiseAware) {
 		// Enable Film noise-aware map generation
@@ -463,7 +657,8 @@ Sampler* MetropolisSampler::CreateSampler(const ParamSet &params, Film *film)
 	}
 
 	return new MetropolisSampler(xStart, xEnd, yStart, yEnd, max(maxConsecRejects, 0),
-		largeMutationProb, range, useVariance, useCooldown, useNoiseAware);
+		largeMutationProb, range, useVariance, useCooldown, useNoiseAware,
+		parallelChains, max(exchangeInterval, 0));
 }
 
 static DynamicLoader::RegisterSampler<MetropolisSampler> r("metropolis");
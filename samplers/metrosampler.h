@@ -26,6 +26,7 @@
 #define LUX_METROSAMPLER_H
 
 #include <boost/shared_array.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "sampling.h"
 #include "paramset.h"
@@ -39,9 +40,11 @@ class MetropolisSampler : public Sampler {
 public:
 	class MetropolisData {
 	public:
-		MetropolisData(const MetropolisSampler &sampler);
+		MetropolisData(MetropolisSampler &sampler);
 		~MetropolisData();
 
+		MetropolisSampler &owner;
+
 		u_int normalSamples, totalSamples, totalTimes, consecRejects;
 		float *sampleImage, *currentImage;
 		int *timeImage, *currentTimeImage;
@@ -59,16 +62,25 @@ public:
 		boost::shared_ptr<Distribution2D> samplingDistribution2D;
 
 		bool large, cooldown;
+
+		// Parallel chains: large step luminance not yet published
+		// to the sampler and last known totals of all the chains
+		double pendingLY, pendingCount, sharedLY, sharedCount;
+		u_int stepsToExchange;
+
+		// Chain statistics
+		double largeSteps, smallSteps, acceptedSteps, exchanges;
 	};
 
 	MetropolisSampler(int xStart, int xEnd, int yStart, int yEnd,
 		u_int maxRej, float largeProb, float rng,
-		bool useV, bool useC, bool useNoise);
+		bool useV, bool useC, bool useNoise,
+		bool parallel, u_int exchange);
 	virtual ~MetropolisSampler();
 
 	virtual void InitSample(Sample *sample) const {
 		sample->sampler = const_cast<MetropolisSampler *>(this);
-		sample->samplerData = new MetropolisData(*this);
+		sample->samplerData = new MetropolisData(*const_cast<MetropolisSampler *>(this));
 	}
 	virtual void FreeSample(Sample *sample) const {
 		delete static_cast<MetropolisData *>(sample->samplerData);
@@ -84,6 +96,14 @@ public:
 
 	// Used by Queryable interface
 	u_int GetMaxRejects() { return maxRejects; }
+	u_int GetChainCount();
+	double GetAcceptanceRate();
+	double GetLargeSteps();
+	double GetSmallSteps();
+	double GetExchanges();
+	// One line per chain: acceptance rate, large steps, small steps
+	// and exchanges
+	string GetChainStatistics();
 
 	static Sampler *CreateSampler(const ParamSet &params, Film *film);
 
@@ -92,6 +112,40 @@ public:
 	u_int cooldownTime;
 	float *rngSamples;
 	bool useVariance, useNoiseAware;
+
+	/**
+	 * With parallel chains the chains of all the threads share their
+	 * estimate of the mean image luminance used to normalize the
+	 * contributions, and swap their states every exchangeInterval steps.
+	 */
+	bool parallelChains;
+	u_int exchangeInterval;
+
+private:
+	void PublishLuminance(MetropolisData *data);
+	void ExchangeReplica(MetropolisData *data, const Sample &sample,
+		float meanIntensity, float largeMutationProb);
+
+	// Protects everything below
+	boost::mutex chainsMutex;
+	vector<MetropolisData *> chains;
+	// Statistics of the chains that have been destroyed
+	double retiredLargeSteps, retiredSmallSteps, retiredAcceptedSteps,
+		retiredExchanges;
+	// Shared luminance estimate, reset for each sampling map version
+	double globalLY, globalSampleCount;
+	u_int globalMapVersion;
+	// State parked by the last chain that went through an exchange, with
+	// the sampling map version its luminance was computed with
+	bool replicaValid;
+	u_int replicaMapVersion;
+	vector<float> replicaImage;
+	vector<int> replicaTimeImage;
+	vector<Contribution> replicaContributions;
+	float replicaLY;
+	int replicaStamp;
+
+	friend class MetropolisData;
 };
 
 }//namespace lux
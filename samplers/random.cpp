@@ -28,9 +28,16 @@
 
 using namespace lux;
 
+static u_int ReproduciblePixelKey(u_int seed, int x, int y)
+{
+	return CounterRandomGenerator::Philox(seed, static_cast<u_int>(y),
+		static_cast<u_int>(x));
+}
+
 RandomSampler::RandomData::RandomData(const Sampler &sampler, int xPixelStart,
 	int yPixelStart, u_int pixelSamples) :
-	samplingMap(NULL), noiseAwareMapVersion(0), userSamplingMapVersion(0)
+	samplingMap(NULL), noiseAwareMapVersion(0), userSamplingMapVersion(0),
+	pixelKey(0)
 {
 	xPos = xPixelStart;
 	yPos = yPixelStart;
@@ -48,8 +55,10 @@ RandomSampler::RandomData::~RandomData()
 }
 
 RandomSampler::RandomSampler(int xstart, int xend, int ystart, int yend,
-	u_int ps, string pixelsampler, bool useNoise) :
-	Sampler(xstart, xend, ystart, yend, ps), useNoiseAware(useNoise)
+	u_int ps, string pixelsampler, bool useNoise,
+	bool reproducibleSamples, u_int seed) :
+	Sampler(xstart, xend, ystart, yend, ps), useNoiseAware(useNoise),
+	reproducible(reproducibleSamples), reproducibleSeed(seed)
 {
 	pixelSamples = ps;
 
@@ -57,13 +66,14 @@ RandomSampler::RandomSampler(int xstart, int xend, int ystart, int yend,
 	pixelSampler = MakePixelSampler(pixelsampler, xstart, xend, ystart, yend);
 
 	totalPixels = pixelSampler->GetTotalPixels();
-	sampPixelPos = 0;
+	pixelBatches = new PixelBatches(totalPixels);
 
 	AddStringConstant(*this, "name", "Name of current sampler", "random");
 }
 
 RandomSampler::~RandomSampler()
 {
+	delete pixelBatches;
 }
 
 // return TotalPixels so scene shared thread increment knows total sample positions
@@ -81,6 +91,12 @@ bool RandomSampler::GetNextSample(Sample *sample)
 	if (useNoiseAware || film->HasUserSamplingMap()) {
 		// Noise-aware and/or user driven sampler
 
+		// The sampling maps change while rendering, the thread
+		// generator is used with them even for reproducible samples
+		if (reproducible)
+			data->counterRng.Reset(reproducibleSeed,
+				sample->rng->uintValue());
+
 		// Check if there is a new version of the noise map and/or user-sampling map
 		if (useNoiseAware) {
 			if (film->HasUserSamplingMap()) {
@@ -110,13 +126,8 @@ bool RandomSampler::GetNextSample(Sample *sample)
 		} else {
 			// Maps aren't yet ready, use pixel sampler
 
-			u_int sampPixelPosToUse;
 			// Move to the next pixel
-			{
-				fast_mutex::scoped_lock lock(sampPixelPosMutex);
-				sampPixelPosToUse = sampPixelPos;
-				sampPixelPos = (sampPixelPos + 1) % totalPixels;
-			}
+			const u_int sampPixelPosToUse = pixelBatches->Next(data->pixelCursor);
 
 			pixelSampler->GetNextPixel(&data->xPos, &data->yPos, sampPixelPosToUse);
 			sample->imageX = data->xPos + sample->rng->floatValue();
@@ -129,13 +140,8 @@ bool RandomSampler::GetNextSample(Sample *sample)
 		// Standard sampler using pixel sampler
 
 		if (data->samplePos == pixelSamples) {
-			u_int sampPixelPosToUse;
 			// Move to the next pixel
-			{
-				fast_mutex::scoped_lock lock(sampPixelPosMutex);
-				sampPixelPosToUse = sampPixelPos;
-				sampPixelPos = (sampPixelPos + 1) % totalPixels;
-			}
+			const u_int sampPixelPosToUse = pixelBatches->Next(data->pixelCursor);
 
 			// fetch next pixel from pixelsampler
 			if(!pixelSampler->GetNextPixel(&data->xPos, &data->yPos, sampPixelPosToUse)) {
@@ -150,31 +156,40 @@ bool RandomSampler::GetNextSample(Sample *sample)
 				haveMoreSamples = (!pixelSampler->renderingDone);
 
 			data->samplePos = 0;
+			if (reproducible)
+				data->pixelKey = ReproduciblePixelKey(reproducibleSeed,
+					data->xPos, data->yPos);
 		}
 
-		sample->imageX = data->xPos + sample->rng->floatValue();
-		sample->imageY = data->yPos + sample->rng->floatValue();
+		// The pass over the pixel and the sample number in the pass
+		// identify the sample
+		if (reproducible)
+			data->counterRng.Reset(data->pixelKey,
+				data->pixelCursor.pass * pixelSamples + data->samplePos);
+
+		sample->imageX = data->xPos + Value(*sample);
+		sample->imageY = data->yPos + Value(*sample);
 		++(data->samplePos);
 	}
 
 	// Return next \mono{RandomSampler} sample point
-	sample->lensU = sample->rng->floatValue();
-	sample->lensV = sample->rng->floatValue();
-	sample->time = sample->rng->floatValue();
-	sample->wavelengths = sample->rng->floatValue();
+	sample->lensU = Value(*sample);
+	sample->lensV = Value(*sample);
+	sample->time = Value(*sample);
+	sample->wavelengths = Value(*sample);
 
 	return haveMoreSamples;
 }
 
 float RandomSampler::GetOneD(const Sample &sample, u_int num, u_int pos)
 {
-	return sample.rng->floatValue();
+	return Value(sample);
 }
 
 void RandomSampler::GetTwoD(const Sample &sample, u_int num, u_int pos, float u[2])
 {
-	u[0] = sample.rng->floatValue();
-	u[1] = sample.rng->floatValue();
+	u[0] = Value(sample);
+	u[1] = Value(sample);
 }
 
 float *RandomSampler::GetLazyValues(const Sample &sample, u_int num, u_int pos)
@@ -182,7 +197,7 @@ float *RandomSampler::GetLazyValues(const Sample &sample, u_int num, u_int pos)
 	RandomData *data = (RandomData *)(sample.samplerData);
 	float *sd = data->xD[num];
 	for (u_int i = 0; i < dxD[num]; ++i)
-		sd[i] = sample.rng->floatValue();
+		sd[i] = Value(sample);
 	return sd;
 }
 
@@ -205,12 +220,23 @@ Sampler* RandomSampler::CreateSampler(const ParamSet &params, Film *film)
 		film->EnableNoiseAwareMap();
 	}
 
+	// Sample values computed from the pixel and the pass instead of the
+	// thread random generator. Only the values handed out by the sampler
+	// are reproducible: the sampling maps, volume tracking, Russian
+	// roulette, Latin hypercube sampling and layered materials still draw
+	// from the thread generator.
+	bool reproducible = params.FindOneBool("reproducible", false);
+	int seed = params.FindOneInt("seed", 0);
+	if (reproducible && (useNoiseAware || film->HasUserSamplingMap()))
+		LOG(LUX_WARNING, LUX_CONSISTENCY) << "The samples of the random sampler aren't reproducible with sampling maps";
+
 	string pixelsampler = params.FindOneString("pixelsampler", "vegas");
     int xstart, xend, ystart, yend;
     film->GetSampleExtent(&xstart, &xend, &ystart, &yend);
     return new RandomSampler(xstart, xend,
                              ystart, yend,
-                             max(nsamp, 1), pixelsampler, useNoiseAware);
+                             max(nsamp, 1), pixelsampler, useNoiseAware,
+                             reproducible, static_cast<u_int>(seed));
 }
 
 static DynamicLoader::RegisterSampler<RandomSampler> r("random");
@@ -44,10 +44,14 @@ public:
 		u_int noiseAwareMapVersion;
 		u_int userSamplingMapVersion;
 		boost::shared_ptr<Distribution2D> samplingDistribution2D;
-
+		PixelBatches::Cursor pixelCursor;
+		// Used instead of the thread generator by reproducible samplers
+		CounterRandomGenerator counterRng;
+		u_int pixelKey;
 	};
 	RandomSampler(int xstart, int xend, int ystart, int yend,
-		u_int ps, string pixelsampler, bool useNoise);
+		u_int ps, string pixelsampler, bool useNoise,
+		bool reproducibleSamples, u_int seed);
 	virtual ~RandomSampler();
 
 	virtual void InitSample(Sample *sample) const {
@@ -69,14 +73,23 @@ public:
 
 	static Sampler *CreateSampler(const ParamSet &params, Film *film);
 private:
+	float Value(const Sample &sample) const {
+		if (reproducible)
+			return static_cast<RandomData *>(sample.samplerData)->counterRng.floatValue();
+		return sample.rng->floatValue();
+	}
+
 	// RandomSampler Private Data
 	bool jitterSamples, useNoiseAware;
+	// With reproducible samples the values of a pixel sample given by the
+	// sampler only depend on the pixel, the pass and the seed, not on the
+	// thread. The code drawing from Sample::rng directly isn't covered.
+	bool reproducible;
+	u_int reproducibleSeed;
 	u_int pixelSamples;
 	u_int totalPixels;
 	PixelSampler* pixelSampler;
-
-	fast_mutex sampPixelPosMutex;
-	u_int sampPixelPos;
+	PixelBatches *pixelBatches;
 };
 
 }//namespace lux
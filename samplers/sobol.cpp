@@ -0,0 +1,279 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+// sobol.cpp*
+#include "sobol.h"
+#include "scene.h"
+#include "dynload.h"
+#include "error.h"
+
+using namespace lux;
+
+// Dimension kinds, combined with the request number to seed the dimensions
+enum SobolDimension { SOBOL_IMAGE = 0, SOBOL_LENS, SOBOL_TIME,
+	SOBOL_WAVELENGTHS, SOBOL_ONED, SOBOL_TWOD, SOBOL_XD };
+
+static inline u_int SobolHash(u_int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+static inline u_int DimensionSeed(u_int pixelSeed, u_int kind, u_int num,
+	u_int sub = 0)
+{
+	return SobolHash(pixelSeed ^ SobolHash((kind << 24) ^ (num << 8) ^ sub));
+}
+
+static inline float SobolFloat(u_int n)
+{
+	// Keep the 24 bits that a float can hold so that the value is < 1
+	return (n >> 8) * (1.f / 16777216.f);
+}
+
+SobolSampler::SobolData::SobolData(const Sampler &sampler, int xPixelStart,
+	int yPixelStart, u_int pixelSamples) :
+	samplingMap(NULL), noiseAwareMapVersion(0), userSamplingMapVersion(0)
+{
+	xPos = xPixelStart;
+	yPos = yPixelStart;
+	samplePos = pixelSamples;
+	seed = 0;
+	pixelIndex = 0;
+	sampleIndex = 0;
+	xD = new float *[sampler.nxD.size()];
+	nxD = sampler.nxD.size();
+	for (u_int i = 0; i < sampler.nxD.size(); ++i)
+		xD[i] = new float[sampler.dxD[i]];
+}
+SobolSampler::SobolData::~SobolData()
+{
+	for (u_int i = 0; i < nxD; ++i)
+		delete[] xD[i];
+	delete[] xD;
+}
+
+SobolSampler::SobolSampler(int xstart, int xend, int ystart, int yend,
+	u_int ps, string pixelsampler, bool useNoise) :
+	Sampler(xstart, xend, ystart, yend, ps), useNoiseAware(useNoise),
+	globalSeed(0)
+{
+	pixelSamples = ps;
+
+	// Initialize PixelSampler
+	pixelSampler = MakePixelSampler(pixelsampler, xstart, xend, ystart, yend);
+
+	totalPixels = pixelSampler->GetTotalPixels();
+	pixelBatches = new PixelBatches(totalPixels);
+
+	AddStringConstant(*this, "name", "Name of current sampler", "sobol");
+}
+
+SobolSampler::~SobolSampler()
+{
+	delete pixelBatches;
+}
+
+// return TotalPixels so scene shared thread increment knows total sample positions
+u_int SobolSampler::GetTotalSamplePos()
+{
+	return totalPixels;
+}
+
+float SobolSampler::SampleOneD(u_int seed, u_int index) const
+{
+	// The index is shuffled so that the dimensions aren't correlated
+	const u_int i = OwenScramble(index, SobolHash(seed ^ 0x9e3779b9U));
+	return SobolFloat(OwenScramble(ReverseBits(i), seed));
+}
+
+void SobolSampler::SampleTwoD(u_int seed, u_int index, float u[2]) const
+{
+	const u_int i = OwenScramble(index, SobolHash(seed ^ 0x9e3779b9U));
+	// Second Sobol dimension
+	u_int s = 0;
+	for (u_int v = 1u << 31, n = i; n != 0; n >>= 1, v ^= v >> 1)
+		if (n & 0x1) s ^= v;
+	u[0] = SobolFloat(OwenScramble(ReverseBits(i), seed));
+	u[1] = SobolFloat(OwenScramble(s, SobolHash(seed)));
+}
+
+bool SobolSampler::GetNextSample(Sample *sample)
+{
+	SobolData *data = (SobolData *)(sample->samplerData);
+
+	if (globalSeed == 0) {
+		// Different seeds for different renderings (network slaves...),
+		// but the same for all threads so that a pixel keeps its
+		// sequence whatever the thread sampling it
+		atomic_cas32(reinterpret_cast<boost::uint32_t *>(&globalSeed),
+			sample->rng->uintValue() | 1U, 0);
+	}
+
+	bool haveMoreSamples = true;
+	if (data->samplePos == pixelSamples) {
+		if (useNoiseAware || film->HasUserSamplingMap()) {
+			// Noise-aware and/or user driven sampler
+
+			// Check if there is a new version of the noise map and/or user-sampling map
+			if (useNoiseAware) {
+				if (film->HasUserSamplingMap()) {
+					film->GetSamplingMap(data->noiseAwareMapVersion, data->userSamplingMapVersion,
+							data->samplingMap, data->samplingDistribution2D);
+				} else
+					film->GetNoiseAwareMap(data->noiseAwareMapVersion,
+							data->samplingMap, data->samplingDistribution2D);
+			} else {
+				if (film->HasUserSamplingMap()) {
+					film->GetUserSamplingMap(data->userSamplingMapVersion,
+							data->samplingMap, data->samplingDistribution2D);
+				} else {
+					// This should never happen
+					LOG(LUX_ERROR, LUX_SYSTEM) << "Internal error in SobolSampler::GetNextSample()";
+				}
+			}
+		}
+
+		if ((data->noiseAwareMapVersion == 0) && (data->userSamplingMapVersion == 0)) {
+			// Standard sampler using pixel sampler
+
+			// Move to the next pixel
+			const u_int sampPixelPosToUse = pixelBatches->Next(data->pixelCursor);
+
+			// fetch next pixel from pixelsampler
+			if(!pixelSampler->GetNextPixel(&data->xPos, &data->yPos, sampPixelPosToUse)) {
+				// Dade - we are at a valid checkpoint where we can stop the
+				// rendering. Check if we have enough samples per pixel in the film.
+				if (film->enoughSamplesPerPixel) {
+					// Dade - pixelSampler->renderingDone is shared among all rendering threads
+					pixelSampler->renderingDone = true;
+					haveMoreSamples = false;
+				}
+			} else
+				haveMoreSamples = (!pixelSampler->renderingDone);
+
+			// Each pass over the pixel continues its sequence
+			data->seed = SobolHash(globalSeed ^
+				SobolHash(static_cast<u_int>(data->xPos) ^
+				SobolHash(static_cast<u_int>(data->yPos))));
+			data->pixelIndex = data->pixelCursor.pass * pixelSamples;
+		} else {
+			// The sampling map chooses the image position, each set
+			// of pixelSamples samples is an independent sequence
+			data->seed = SobolHash(globalSeed ^ sample->rng->uintValue());
+			data->pixelIndex = 0;
+		}
+
+		data->samplePos = 0;
+	}
+	data->sampleIndex = data->pixelIndex + data->samplePos;
+	++(data->samplePos);
+
+	float u[2];
+	SampleTwoD(DimensionSeed(data->seed, SOBOL_IMAGE, 0), data->sampleIndex, u);
+	if ((data->noiseAwareMapVersion > 0) || (data->userSamplingMapVersion > 0)) {
+		float uv[2], pdf;
+		data->samplingDistribution2D->SampleContinuous(u[0], u[1], uv, &pdf);
+		sample->imageX = uv[0] * (xPixelEnd - xPixelStart) + xPixelStart;
+		sample->imageY = uv[1] * (yPixelEnd - yPixelStart) + yPixelStart;
+
+		if (film->enoughSamplesPerPixel)
+			haveMoreSamples = false;
+	} else {
+		sample->imageX = data->xPos + u[0];
+		sample->imageY = data->yPos + u[1];
+	}
+
+	SampleTwoD(DimensionSeed(data->seed, SOBOL_LENS, 0), data->sampleIndex, u);
+	sample->lensU = u[0];
+	sample->lensV = u[1];
+	sample->time = SampleOneD(DimensionSeed(data->seed, SOBOL_TIME, 0),
+		data->sampleIndex);
+	sample->wavelengths = SampleOneD(DimensionSeed(data->seed,
+		SOBOL_WAVELENGTHS, 0), data->sampleIndex);
+
+	return haveMoreSamples;
+}
+
+float SobolSampler::GetOneD(const Sample &sample, u_int num, u_int pos)
+{
+	SobolData *data = (SobolData *)(sample.samplerData);
+	return SampleOneD(DimensionSeed(data->seed, SOBOL_ONED, num),
+		n1D[num] * data->sampleIndex + pos);
+}
+
+void SobolSampler::GetTwoD(const Sample &sample, u_int num, u_int pos, float u[2])
+{
+	SobolData *data = (SobolData *)(sample.samplerData);
+	SampleTwoD(DimensionSeed(data->seed, SOBOL_TWOD, num),
+		n2D[num] * data->sampleIndex + pos, u);
+}
+
+float *SobolSampler::GetLazyValues(const Sample &sample, u_int num, u_int pos)
+{
+	SobolData *data = (SobolData *)(sample.samplerData);
+	float *sd = data->xD[num];
+	const u_int index = nxD[num] * data->sampleIndex + pos;
+	u_int offset = 0;
+	for (u_int i = 0; i < sxD[num].size(); ++i) {
+		const u_int seed = DimensionSeed(data->seed, SOBOL_XD, num, i);
+		if (sxD[num][i] == 1)
+			sd[offset] = SampleOneD(seed, index);
+		else if (sxD[num][i] == 2)
+			SampleTwoD(seed, index, sd + offset);
+		else {
+			// Higher dimensions are filled pair by pair
+			for (u_int j = 0; j < sxD[num][i]; j += 2) {
+				float u[2];
+				SampleTwoD(SobolHash(seed + j), index, u);
+				sd[offset + j] = u[0];
+				if (j + 1 < sxD[num][i])
+					sd[offset + j + 1] = u[1];
+			}
+		}
+		offset += sxD[num][i];
+	}
+	return sd;
+}
+
+Sampler* SobolSampler::CreateSampler(const ParamSet &params, Film *film)
+{
+	int nsamp = params.FindOneInt("pixelsamples", 4);
+
+	bool useNoiseAware = params.FindOneBool("noiseaware", false);
+	if (useNoiseAware) {
+		// Enable Film noise-aware map generation
+		film->EnableNoiseAwareMap();
+	}
+
+	string pixelsampler = params.FindOneString("pixelsampler", "vegas");
+	int xstart, xend, ystart, yend;
+	film->GetSampleExtent(&xstart, &xend, &ystart, &yend);
+	return new SobolSampler(xstart, xend, ystart, yend,
+		max(nsamp, 1), pixelsampler, useNoiseAware);
+}
+
+static DynamicLoader::RegisterSampler<SobolSampler> r("sobol");
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+
+// sobol.h*
+#include "sampling.h"
+#include "paramset.h"
+#include "film.h"
+
+namespace lux
+{
+
+/**
+ * Owen scrambled Sobol sampler. The points are generated on demand from
+ * the sample index in the pixel, there are no per pixel tables. Each
+ * dimension (or pair of dimensions) uses the first two Sobol dimensions
+ * with its own index shuffling and scrambling, the scrambling seeds are
+ * derived from the pixel so that the successive passes over a pixel
+ * continue the same sequence. Any number of samples per pixel is
+ * supported, powers of 2 are the best stratified.
+ */
+class SobolSampler : public Sampler
+{
+public:
+	class SobolData {
+	public:
+		SobolData(const Sampler &sampler, int xPixelStart,
+			int yPixelStart, u_int pixelSamples);
+		~SobolData();
+		int xPos, yPos;
+		u_int samplePos, nxD;
+		// Scrambling seed of the current pixel and index of its
+		// first sample
+		u_int seed, pixelIndex;
+		// Index of the current sample in the pixel sequence
+		u_int sampleIndex;
+		float **xD;
+
+		boost::shared_array<float> samplingMap;
+		u_int noiseAwareMapVersion;
+		u_int userSamplingMapVersion;
+		boost::shared_ptr<Distribution2D> samplingDistribution2D;
+		PixelBatches::Cursor pixelCursor;
+	};
+	SobolSampler(int xstart, int xend, int ystart, int yend,
+		u_int ps, string pixelsampler, bool useNoise);
+	virtual ~SobolSampler();
+
+	virtual void InitSample(Sample *sample) const {
+		sample->sampler = const_cast<SobolSampler *>(this);
+		sample->samplerData = new SobolData(*this, xPixelStart,
+			yPixelStart, pixelSamples);
+	}
+	virtual void FreeSample(Sample *sample) const {
+		delete static_cast<SobolData *>(sample->samplerData);
+	}
+	virtual u_int GetTotalSamplePos();
+	virtual bool GetNextSample(Sample *sample);
+	virtual float GetOneD(const Sample &sample, u_int num, u_int pos);
+	virtual void GetTwoD(const Sample &sample, u_int num, u_int pos,
+		float u[2]);
+	virtual float *GetLazyValues(const Sample &sample, u_int num, u_int pos);
+	virtual u_int RoundSize(u_int sz) const { return sz; }
+	virtual void GetBufferType(BufferType *type) {*type = BUF_TYPE_PER_PIXEL;}
+
+	static Sampler *CreateSampler(const ParamSet &params, Film *film);
+private:
+	float SampleOneD(u_int seed, u_int index) const;
+	void SampleTwoD(u_int seed, u_int index, float u[2]) const;
+
+	// SobolSampler Private Data
+	bool useNoiseAware;
+	u_int pixelSamples;
+	u_int totalPixels;
+	// Common scrambling seed, drawn by the first rendering thread
+	u_int globalSeed;
+	PixelSampler* pixelSampler;
+	PixelBatches *pixelBatches;
+};
+
+}//namespace lux
@@ -34,6 +34,7 @@
 #include "tigerhash.h"
 #include "streamio.h"
 #include "asyncstream.h"
+#include "netprotocol.h"
 
 #include <boost/version.hpp>
 #include <boost/filesystem.hpp>
@@ -48,9 +49,12 @@
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/restrict.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/lexical_cast.hpp>
@@ -402,22 +406,38 @@ static void processFiles(ParamSet &params, socket_stream_t &stream) {
 		return;
 }
 
+static void startFilm(void (Context::*f)(const string &, const ParamSet &),
+	const string &type, ParamSet &params);
+
+static bool isSupportedFilm(const string &type)
+{
+	if((type != "fleximage") && (type != "multiimage")) {
+		LOG( LUX_ERROR,LUX_SYSTEM) << "Unsupported film type for server rendering: " << type;
+		return false;
+	}
+	return true;
+}
+
 static void processCommandFilm(bool isLittleEndian,
 		void (Context::*f)(const string &, const ParamSet &), socket_stream_t &stream)
 {
 	string type;
 	getline(stream, type);
 
-	if((type != "fleximage") && (type != "multiimage")) {
-		LOG( LUX_ERROR,LUX_SYSTEM) << "Unsupported film type for server rendering: " << type;
+	if (!isSupportedFilm(type))
 		return;
-	}
 
 	ParamSet params;
 	processCommandParams(isLittleEndian, params, stream);
 
 	processFiles(params, stream);
 
+	startFilm(f, type, params);
+}
+
+static void startFilm(void (Context::*f)(const string &, const ParamSet &),
+	const string &type, ParamSet &params)
+{
 	// Dade - overwrite some option for the servers
 
 	params.EraseBool("write_exr");
@@ -521,6 +541,8 @@ static void processCommand(void (Context::*f)(const string &, float, float, cons
 
 
 static void cleanupSession(NetworkRenderServerThread *serverThread, vector<string> &tmpFileList) {
+	serverThread->stopFilmPush();
+
 	// Dade - stop the rendering and cleanup
 	luxExit();
 	luxWait();
@@ -543,6 +565,10 @@ bool RenderServer::validateAccess(basic_istream<char> &stream) const {
 	if (!getline(stream, sidstr))
 		return false;
 
+	return validateAccess(sidstr);
+}
+
+bool RenderServer::validateAccess(const string &sidstr) const {
 	if (serverThread->renderServer->state != RenderServer::BUSY) {
 		LOG( LUX_INFO,LUX_NOERROR)<< "Server does not have an active session";
 		return false;
@@ -1002,6 +1028,510 @@ void cmd_luxSetUserSamplingMap(bool isLittleEndian, NetworkRenderServerThread *s
 	}
 }
 
+//------------------------------------------------------------------------------
+// Binary protocol command handlers, see netprotocol.h
+//------------------------------------------------------------------------------
+
+static void processBinaryCommandParams(bool isLittleEndian,
+	ParamSet &params, istream &args, socket_stream_t &stream)
+{
+	if (!params.ReadBinary(args))
+		throw std::runtime_error("Error processing binary paramset");
+
+	// The master only starts the file exchange when files are referenced
+	if (osReadLittleEndianUInt(isLittleEndian, args) > 0)
+		processFiles(params, stream);
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(const string &, const ParamSet &),
+	istream &args, socket_stream_t &stream)
+{
+	const string type(NetReadString(isLittleEndian, args));
+
+	ParamSet params;
+	processBinaryCommandParams(isLittleEndian, params, args, stream);
+
+	(Context::GetActive()->*f)(type, params);
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(const string &), istream &args)
+{
+	(Context::GetActive()->*f)(NetReadString(isLittleEndian, args));
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(float, float), istream &args)
+{
+	const float x = osReadLittleEndianFloat(isLittleEndian, args);
+	const float y = osReadLittleEndianFloat(isLittleEndian, args);
+	(Context::GetActive()->*f)(x, y);
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(float, float, float), istream &args)
+{
+	float v[3];
+	for (int i = 0; i < 3; ++i)
+		v[i] = osReadLittleEndianFloat(isLittleEndian, args);
+	(Context::GetActive()->*f)(v[0], v[1], v[2]);
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(float[16]), istream &args)
+{
+	float t[16];
+	for (int i = 0; i < 16; ++i)
+		t[i] = osReadLittleEndianFloat(isLittleEndian, args);
+	(Context::GetActive()->*f)(t);
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(u_int, float*), istream &args)
+{
+	const u_int n = osReadLittleEndianUInt(isLittleEndian, args);
+	if (!args.good() || n > NET_MAX_FRAME_SIZE / sizeof(float))
+		throw std::runtime_error("Invalid float array in binary command");
+	vector<float> data(max(n, 1U));
+	for (u_int i = 0; i < n; ++i)
+		data[i] = osReadLittleEndianFloat(isLittleEndian, args);
+	(Context::GetActive()->*f)(n, &data[0]);
+}
+
+static void processBinaryCommand(bool isLittleEndian,
+	void (Context::*f)(const string &, float, float, const string &),
+	istream &args)
+{
+	const string name(NetReadString(isLittleEndian, args));
+	const float a = osReadLittleEndianFloat(isLittleEndian, args);
+	const float b = osReadLittleEndianFloat(isLittleEndian, args);
+	const string transform(NetReadString(isLittleEndian, args));
+
+	(Context::GetActive()->*f)(name, a, b, transform);
+}
+
+// Messages sent over a binary channel are tagged with the command they
+// answer, the master can tell replies and pushed films apart. The caller
+// must hold the channel write mutex.
+static void writeBinaryMessage(bool isLittleEndian, socket_stream_t &stream,
+	const string &kind, const string &data)
+{
+	NetWriteString(isLittleEndian, stream, kind);
+	NetWriteSize(isLittleEndian, stream, data.size());
+	stream.write(data.data(), data.size());
+	stream.flush();
+}
+
+// Writes the samples added to the film since it was last transmitted,
+// going through the resume file if the server keeps one
+static void writeBinaryFilm(NetworkRenderServerThread *serverThread,
+	const string &resumeFile, std::ostream &film)
+{
+	boost::mutex::scoped_lock lock(serverThread->filmWriteMutex);
+
+	if (serverThread->renderServer->getWriteFlmFile()) {
+		string file = resumeFile;
+		// writeTransmitFilm may modify file if temp file can't be renamed
+		if (writeTransmitFilm(file)) {
+			ifstream in(file.c_str(), ios::in | ios::binary);
+			film << in.rdbuf();
+		}
+	} else {
+		Context::GetActive()->WriteFilmToStream(film);
+	}
+}
+
+static string resumeFileName(const vector<string> &tmpFileList)
+{
+	string file = "server_resume";
+	if (tmpFileList.size())
+		file += "_" + tmpFileList[0];
+	return file + ".flm";
+}
+
+static void pushFilmThread(bool isLittleEndian,
+	NetworkRenderServerThread *serverThread, socket_stream_t *stream,
+	string resumeFile)
+{
+	boost::posix_time::ptime lastPush(boost::posix_time::second_clock::local_time());
+	// read along with the first poll of the film
+	double lastSamples = -1.;
+
+	try {
+		while (true) {
+			boost::this_thread::sleep(boost::posix_time::seconds(1));
+
+			if (osAtomicRead(&serverThread->pushCredits) == 0)
+				continue;
+
+			const boost::posix_time::ptime now(boost::posix_time::second_clock::local_time());
+			if ((now - lastPush).total_seconds() < static_cast<long>(serverThread->pushMinInterval))
+				continue;
+
+			// push only once enough new samples are available, the film is
+			// polled between the commands of the binary channel thread, which
+			// may be joining this thread while holding the command lock
+			double samples, pixels;
+			{
+				boost::mutex::scoped_try_lock lock(serverThread->commandMutex);
+				if (!lock || !luxStatistics("sceneIsReady"))
+					continue;
+				samples = luxGetDoubleAttribute("film", "numberOfLocalSamples");
+				pixels = static_cast<double>(luxGetIntAttribute("film", "xPixelCount")) *
+					luxGetIntAttribute("film", "yPixelCount");
+			}
+			if (lastSamples < 0.)
+				lastSamples = samples;
+			if (samples - lastSamples < serverThread->pushSamplesPerPixel * pixels)
+				continue;
+
+			LOG( LUX_DEBUG,LUX_NOERROR)<< "Pushing film samples";
+
+			// serialize the film first, the replies to the master's
+			// commands shouldn't wait for it
+			std::stringstream film(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
+			writeBinaryFilm(serverThread, resumeFile, film);
+
+			boost::mutex::scoped_lock lock(serverThread->channelWriteMutex);
+			writeBinaryMessage(isLittleEndian, *stream, "luxPushFilm", film.str());
+
+			// one credit less until the master acknowledges the film
+			osAtomicAdd(&serverThread->pushCredits, static_cast<u_int>(-1));
+			lastPush = now;
+			lastSamples = samples;
+		}
+	} catch (boost::thread_interrupted &) {
+		// we got interrupted, do nothing
+	} catch (std::exception &e) {
+		// the master will notice the broken channel
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Error while pushing film samples: " << e.what();
+	}
+}
+
+void bincmd_ServerDisconnect(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	if (!serverThread->renderServer->validateAccess(NetReadString(isLittleEndian, args)))
+		return;
+
+	LOG( LUX_INFO,LUX_NOERROR) << "Master ended session, cleaning up";
+
+	cleanupSession(serverThread, tmpFileList);
+}
+void bincmd_luxTranslate(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Translate, args);
+}
+void bincmd_luxRotate(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	float v[4];
+	for (int i = 0; i < 4; ++i)
+		v[i] = osReadLittleEndianFloat(isLittleEndian, args);
+	luxRotate(v[0], v[1], v[2], v[3]);
+}
+void bincmd_luxScale(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Scale, args);
+}
+void bincmd_luxLookAt(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	float v[9];
+	for (int i = 0; i < 9; ++i)
+		v[i] = osReadLittleEndianFloat(isLittleEndian, args);
+	luxLookAt(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+}
+void bincmd_luxConcatTransform(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::ConcatTransform, args);
+}
+void bincmd_luxTransform(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Transform, args);
+}
+void bincmd_luxCoordinateSystem(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::CoordinateSystem, args);
+}
+void bincmd_luxCoordSysTransform(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::CoordSysTransform, args);
+}
+void bincmd_luxPixelFilter(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::PixelFilter, args, stream);
+}
+void bincmd_luxFilm(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	const string type(NetReadString(isLittleEndian, args));
+
+	// the params are always read to keep the channel in sync
+	ParamSet params;
+	processBinaryCommandParams(isLittleEndian, params, args, stream);
+
+	if (isSupportedFilm(type))
+		startFilm(&Context::Film, type, params);
+}
+void bincmd_luxSampler(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Sampler, args, stream);
+}
+void bincmd_luxAccelerator(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Accelerator, args, stream);
+}
+void bincmd_luxSurfaceIntegrator(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::SurfaceIntegrator, args, stream);
+}
+void bincmd_luxVolumeIntegrator(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::VolumeIntegrator, args, stream);
+}
+void bincmd_luxCamera(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Camera, args, stream);
+}
+void bincmd_luxTexture(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	const string name(NetReadString(isLittleEndian, args));
+	const string type(NetReadString(isLittleEndian, args));
+	const string texname(NetReadString(isLittleEndian, args));
+
+	ParamSet params;
+	processBinaryCommandParams(isLittleEndian, params, args, stream);
+
+	Context::GetActive()->Texture(name, type, texname, params);
+}
+void bincmd_luxMaterial(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Material, args, stream);
+}
+void bincmd_luxMakeNamedMaterial(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::MakeNamedMaterial, args, stream);
+}
+void bincmd_luxNamedMaterial(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::NamedMaterial, args);
+}
+void bincmd_luxLightGroup(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::LightGroup, args, stream);
+}
+void bincmd_luxLightSource(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::LightSource, args, stream);
+}
+void bincmd_luxAreaLightSource(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::AreaLightSource, args, stream);
+}
+void bincmd_luxPortalShape(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::PortalShape, args, stream);
+}
+void bincmd_luxShape(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Shape, args, stream);
+}
+void bincmd_luxMakeNamedVolume(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	const string id(NetReadString(isLittleEndian, args));
+	const string name(NetReadString(isLittleEndian, args));
+
+	ParamSet params;
+	processBinaryCommandParams(isLittleEndian, params, args, stream);
+
+	Context::GetActive()->MakeNamedVolume(id, name, params);
+}
+void bincmd_luxVolume(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Volume, args, stream);
+}
+void bincmd_luxExterior(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Exterior, args);
+}
+void bincmd_luxInterior(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Interior, args);
+}
+void bincmd_luxObjectBegin(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::ObjectBegin, args);
+}
+void bincmd_luxObjectInstance(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::ObjectInstance, args);
+}
+void bincmd_luxPortalInstance(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::PortalInstance, args);
+}
+void bincmd_luxMotionBegin(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::MotionBegin, args);
+}
+void bincmd_luxMotionInstance(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::MotionInstance, args);
+}
+void bincmd_luxGetFilm(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	// A reply is always sent, an empty one if the film isn't available
+	std::stringstream film(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
+
+	if (serverThread->renderServer->getServerState() != RenderServer::BUSY) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Received a GetFilm command after a ServerDisconnect";
+	} else if (!serverThread->renderServer->validateAccess(NetReadString(isLittleEndian, args))) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Unknown session ID";
+	} else {
+		LOG( LUX_INFO,LUX_NOERROR)<< "Transmitting film samples";
+
+		writeBinaryFilm(serverThread, resumeFileName(tmpFileList), film);
+	}
+
+	// the film pusher writes to the channel too
+	boost::mutex::scoped_lock lock(serverThread->channelWriteMutex);
+	writeBinaryMessage(isLittleEndian, stream, "luxGetFilm", film.str());
+
+	LOG( LUX_INFO,LUX_NOERROR)<< "Finished film samples transmission";
+}
+void bincmd_luxGetLog(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	std::stringstream log("");
+
+	if (serverThread->renderServer->getServerState() != RenderServer::BUSY) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Received a GetLog command after a ServerDisconnect";
+	} else if (!serverThread->renderServer->validateAccess(NetReadString(isLittleEndian, args))) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Unknown session ID";
+	} else {
+		// ensure no logging is performed while we hold the lock
+		boost::mutex::scoped_lock lock(serverThread->renderServer->errorMessageMutex);
+
+		for (vector<RenderServer::ErrorMessage>::iterator it = serverThread->renderServer->errorMessages.begin(); it != serverThread->renderServer->errorMessages.end(); ++it)
+			log << it->severity << " " << it->code << " " << it->message << "\n";
+
+		serverThread->renderServer->errorMessages.clear();
+	}
+
+	boost::mutex::scoped_lock lock(serverThread->channelWriteMutex);
+	writeBinaryMessage(isLittleEndian, stream, "luxGetLog", log.str());
+}
+void bincmd_luxPushFilm(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	if (serverThread->renderServer->getServerState() != RenderServer::BUSY) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Received a PushFilm command after a ServerDisconnect";
+		return;
+	}
+	if (!serverThread->renderServer->validateAccess(NetReadString(isLittleEndian, args))) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Unknown session ID";
+		return;
+	}
+
+	serverThread->stopFilmPush();
+
+	serverThread->pushSamplesPerPixel = osReadLittleEndianFloat(isLittleEndian, args);
+	serverThread->pushMinInterval = osReadLittleEndianUInt(isLittleEndian, args);
+	osAtomicWrite(&serverThread->pushCredits, 1);
+
+	LOG( LUX_INFO,LUX_NOERROR)<< "Pushing film samples every " <<
+		serverThread->pushSamplesPerPixel << " samples per pixel";
+
+	serverThread->pushThread = new boost::thread(boost::bind(pushFilmThread,
+		isLittleEndian, serverThread, &stream, resumeFileName(tmpFileList)));
+}
+void bincmd_luxFilmAck(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	// only the outstanding push can be acknowledged, a stray
+	// acknowledgement must not let films queue up
+	if (atomic_cas32(reinterpret_cast<boost::uint32_t *>(&serverThread->pushCredits), 1, 0) != 0)
+		LOG( LUX_WARNING,LUX_SYSTEM)<< "Ignoring a film acknowledgement without a pending pushed film";
+}
+void bincmd_luxSetEpsilon(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::SetEpsilon, args);
+}
+void bincmd_luxRenderer(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	processBinaryCommand(isLittleEndian, &Context::Renderer, args, stream);
+}
+void bincmd_luxSetUserSamplingMap(bool isLittleEndian, NetworkRenderServerThread *serverThread, istream &args, socket_stream_t &stream, vector<string> &tmpFileList) {
+	if (serverThread->renderServer->getServerState() != RenderServer::BUSY) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Received a SetUserSamplingMap command after a ServerDisconnect";
+		return;
+	}
+	if (!serverThread->renderServer->validateAccess(NetReadString(isLittleEndian, args))) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Unknown session ID";
+		return;
+	}
+
+	const u_int size = osReadLittleEndianUInt(isLittleEndian, args);
+	if (!args.good() || size > NET_MAX_FRAME_SIZE / sizeof(float)) {
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Error while receiving user sampling map";
+		return;
+	}
+	vector<float> map(size);
+	for (u_int i = 0; i < size; ++i)
+		map[i] = osReadLittleEndianFloat(isLittleEndian, args);
+
+	if (!args.good() || size == 0)
+		LOG( LUX_ERROR,LUX_SYSTEM)<< "Error while receiving user sampling map";
+	else
+		Context::GetActive()->SetUserSamplingMap(&map[0]);
+}
+
+typedef boost::function<void (istream&, socket_stream_t&)> bincmdfunc_t;
+
+// An accepted client connection, shared with the binary channel thread
+// once the accept loop hands the connection over
+struct ServerConnection : public boost::noncopyable {
+	ServerConnection(boost::asio::io_service &io_service)
+#ifdef USE_SOCKET_DEVICE
+		: socket(io_service), sd(socket), stream(sd, 1 << 16)
+#endif
+	{ }
+
+#ifdef USE_SOCKET_DEVICE
+	tcp::socket socket;
+	socket_device sd;
+#endif
+	socket_stream_t stream;
+};
+
+// Processes the frames of a binary channel until the master closes it
+static void processBinaryCommands(bool isLittleEndian,
+	NetworkRenderServerThread *serverThread,
+	const map<string, bincmdfunc_t> &cmds, socket_stream_t &stream)
+{
+	LOG( LUX_DEBUG,LUX_NOERROR) << "Server receiving binary commands...";
+
+	// The channel stays open for the whole session, detect dead masters
+	stream.rdbuf()->set_option(boost::asio::socket_base::keep_alive(true));
+
+	try {
+		string frame;
+		while (serverThread->signal == NetworkRenderServerThread::SIG_NONE &&
+			NetReadFrame(isLittleEndian, stream, frame)) {
+			boost::iostreams::stream<boost::iostreams::array_source> args(frame.data(), frame.size());
+			const string command(NetReadString(isLittleEndian, args));
+
+			LOG(LUX_DEBUG,LUX_NOERROR) << "... processing binary command: '" << command << "'";
+
+			map<string, bincmdfunc_t>::const_iterator it = cmds.find(command);
+			if (it == cmds.end())
+				throw std::runtime_error("Unknown binary command '" + command + "'");
+			boost::mutex::scoped_lock lock(serverThread->commandMutex);
+			it->second(args, stream);
+		}
+	} catch (...) {
+		// the film pusher uses the channel
+		serverThread->stopFilmPush();
+		throw;
+	}
+	serverThread->stopFilmPush();
+
+	LOG( LUX_DEBUG,LUX_NOERROR) << "Binary channel closed";
+}
+
+// Binary channel thread, keeps the connection alive until the master
+// closes the channel or the server stops
+static void serveBinaryChannel(bool isLittleEndian,
+	NetworkRenderServerThread *serverThread,
+	const map<string, bincmdfunc_t> &cmds,
+	boost::shared_ptr<ServerConnection> connection,
+	vector<string> &tmpFileList)
+{
+	try {
+		processBinaryCommands(isLittleEndian, serverThread, cmds,
+			connection->stream);
+	} catch (std::runtime_error& e) {
+		LOG(LUX_SEVERE,LUX_BUG) << "Exception processing binary commands: " << e.what();
+		LOG(LUX_INFO,LUX_NOERROR) << "Ending session, cleaning up";
+
+		boost::mutex::scoped_lock lock(serverThread->commandMutex);
+		cleanupSession(serverThread, tmpFileList);
+	} catch (exception& e) {
+		LOG(LUX_SEVERE,LUX_BUG) << "Internal error: " << e.what();
+	}
+}
+
+// Closes the binary channel, if any, and waits for its thread to end
+static void stopBinaryChannel(boost::scoped_ptr<boost::thread> &binaryThread,
+	boost::shared_ptr<ServerConnection> &binaryConnection)
+{
+	if (!binaryThread)
+		return;
+
+	// Wake up the thread if it is waiting for a frame
+	boost::system::error_code error;
+	binaryConnection->stream.rdbuf()->shutdown(tcp::socket::shutdown_both, error);
+	binaryThread->join();
+
+	binaryThread.reset();
+	binaryConnection.reset();
+}
+
 // Dade - TODO: support signals
 void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *serverThread)
 {
@@ -1012,6 +1542,11 @@ void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *se
 
 	vector<string> tmpFileList;
 
+	// The binary channel of the current master, served by its own thread
+	// so that the accept loop keeps serving the other clients
+	boost::shared_ptr<ServerConnection> binaryConnection;
+	boost::scoped_ptr<boost::thread> binaryThread;
+
 	typedef boost::function<void (socket_stream_t&)> cmdfunc_t;
 	#define INSERT_CMD(CmdName) cmds.insert(std::pair<string, cmdfunc_t>(#CmdName, boost::bind(cmd_##CmdName, isLittleEndian, serverThread, _1, boost::ref(tmpFileList))))
 
@@ -1080,6 +1615,69 @@ void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *se
 
 	#undef INSERT_CMD
 
+	// Binary protocol command handlers, commands without arguments share
+	// the text protocol handlers
+	#define INSERT_BINCMD(CmdName) binCmds.insert(std::pair<string, bincmdfunc_t>(#CmdName, boost::bind(bincmd_##CmdName, isLittleEndian, serverThread, _1, _2, boost::ref(tmpFileList))))
+	#define INSERT_BINCMD_NOARGS(CmdName) binCmds.insert(std::pair<string, bincmdfunc_t>(#CmdName, boost::bind(cmd_##CmdName, isLittleEndian, serverThread, _2, boost::ref(tmpFileList))))
+
+	map<string, bincmdfunc_t> binCmds;
+
+	INSERT_BINCMD(ServerDisconnect);
+	INSERT_BINCMD_NOARGS(luxInit);
+	INSERT_BINCMD(luxTranslate);
+	INSERT_BINCMD(luxRotate);
+	INSERT_BINCMD(luxScale);
+	INSERT_BINCMD(luxLookAt);
+	INSERT_BINCMD(luxConcatTransform);
+	INSERT_BINCMD(luxTransform);
+	INSERT_BINCMD_NOARGS(luxIdentity);
+	INSERT_BINCMD(luxCoordinateSystem);
+	INSERT_BINCMD(luxCoordSysTransform);
+	INSERT_BINCMD(luxPixelFilter);
+	INSERT_BINCMD(luxFilm);
+	INSERT_BINCMD(luxSampler);
+	INSERT_BINCMD(luxAccelerator);
+	INSERT_BINCMD(luxSurfaceIntegrator);
+	INSERT_BINCMD(luxVolumeIntegrator);
+	INSERT_BINCMD(luxCamera);
+	INSERT_BINCMD_NOARGS(luxWorldBegin);
+	INSERT_BINCMD_NOARGS(luxAttributeBegin);
+	INSERT_BINCMD_NOARGS(luxAttributeEnd);
+	INSERT_BINCMD_NOARGS(luxTransformBegin);
+	INSERT_BINCMD_NOARGS(luxTransformEnd);
+	INSERT_BINCMD(luxTexture);
+	INSERT_BINCMD(luxMaterial);
+	INSERT_BINCMD(luxMakeNamedMaterial);
+	INSERT_BINCMD(luxNamedMaterial);
+	INSERT_BINCMD(luxLightGroup);
+	INSERT_BINCMD(luxLightSource);
+	INSERT_BINCMD(luxAreaLightSource);
+	INSERT_BINCMD(luxPortalShape);
+	INSERT_BINCMD(luxShape);
+	INSERT_BINCMD_NOARGS(luxReverseOrientation);
+	INSERT_BINCMD(luxMakeNamedVolume);
+	INSERT_BINCMD(luxVolume);
+	INSERT_BINCMD(luxExterior);
+	INSERT_BINCMD(luxInterior);
+	INSERT_BINCMD(luxObjectBegin);
+	INSERT_BINCMD_NOARGS(luxObjectEnd);
+	INSERT_BINCMD(luxObjectInstance);
+	INSERT_BINCMD(luxPortalInstance);
+	INSERT_BINCMD(luxMotionBegin);
+	INSERT_BINCMD_NOARGS(luxMotionEnd);
+	INSERT_BINCMD(luxMotionInstance);
+	INSERT_BINCMD_NOARGS(luxWorldEnd);
+	INSERT_BINCMD(luxGetFilm);
+	INSERT_BINCMD(luxGetLog);
+	INSERT_BINCMD(luxPushFilm);
+	INSERT_BINCMD(luxFilmAck);
+	INSERT_BINCMD(luxSetEpsilon);
+	INSERT_BINCMD(luxRenderer);
+	INSERT_BINCMD(luxSetUserSamplingMap);
+
+	#undef INSERT_BINCMD_NOARGS
+	#undef INSERT_BINCMD
+
 	try {
 		const bool reuse_addr = true;
 
@@ -1102,20 +1700,14 @@ void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *se
 
 		while (serverThread->signal == SIG_NONE) {
 			//tcp::iostream stream2;
+			boost::shared_ptr<ServerConnection> connection(new ServerConnection(io_service));
+			socket_stream_t &stream(connection->stream);
 #ifdef USE_SOCKET_DEVICE
-			tcp::socket socket(io_service);
-
-			acceptor.accept(socket);
-
-			socket_device sd(socket);
-			//socket_stream_t stream(sd, 0, 0);
-			//device_streambuf<socket_device> dsb(sd, 1 << 16);
-			socket_stream_t stream(sd, 1 << 16);
+			acceptor.accept(connection->socket);
 
 			stream->timeout(boost::posix_time::seconds(30));
 			stream->get_socket().set_option(boost::asio::ip::tcp::no_delay(true));
 #else
-			tcp::iostream stream;
 			acceptor.accept(*stream.rdbuf());
 			stream.rdbuf()->set_option(boost::asio::ip::tcp::no_delay(true));
 #endif
@@ -1132,8 +1724,20 @@ void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *se
 						LOG(LUX_DEBUG,LUX_NOERROR) << "... processing command: '" << command << "'";
 					}
 
+					// the rest of the connection is a binary channel
+					if (command == NET_BINARY_COMMANDS) {
+						// a master only has one binary channel
+						stopBinaryChannel(binaryThread, binaryConnection);
+						binaryConnection = connection;
+						binaryThread.reset(new boost::thread(boost::bind(serveBinaryChannel,
+							isLittleEndian, serverThread, binCmds,
+							connection, boost::ref(tmpFileList))));
+						break;
+					}
+
 					if (cmds.find(command) != cmds.end()) {
 						cmdfunc_t cmdhandler = cmds.find(command)->second;
+						boost::mutex::scoped_lock lock(serverThread->commandMutex);
 						cmdhandler(stream);
 					} else {
 						throw std::runtime_error("Unknown command");
@@ -1145,6 +1749,7 @@ void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *se
 				LOG(LUX_SEVERE,LUX_BUG) << "Exception processing command '" << command << "': " << e.what();
 				LOG(LUX_INFO,LUX_NOERROR) << "Ending session, cleaning up";
 
+				boost::mutex::scoped_lock lock(serverThread->commandMutex);
 				cleanupSession(serverThread, tmpFileList);
 			}
 		}
@@ -1156,4 +1761,7 @@ void NetworkRenderServerThread::run(int ipversion, NetworkRenderServerThread *se
 	} catch (exception& e) {
 		LOG(LUX_SEVERE,LUX_BUG) << "Internal error: " << e.what();
 	}
+
+	// the binary channel uses tmpFileList
+	stopBinaryChannel(binaryThread, binaryConnection);
 }
@@ -45,9 +45,12 @@ class NetworkRenderServerThread : public boost::noncopyable {
 public:
 	NetworkRenderServerThread(RenderServer *server) :
 		renderServer(server), serverThread4(NULL), serverThread6(NULL), engineThread(NULL),
-		infoThread(NULL), signal(SIG_NONE) { }
+		infoThread(NULL), pushThread(NULL), pushSamplesPerPixel(0.f),
+		pushMinInterval(0), pushCredits(0), signal(SIG_NONE) { }
 
 	~NetworkRenderServerThread() {
+		stopFilmPush();
+
 		if (engineThread)
 			delete engineThread;
 
@@ -70,6 +73,17 @@ public:
 		serverThread6->join();
 	}
 
+	// stops pushing the film to the master, if it was
+	void stopFilmPush() {
+		if (!pushThread)
+			return;
+
+		pushThread->interrupt();
+		pushThread->join();
+		delete pushThread;
+		pushThread = NULL;
+	}
+
 	static void run(int ipversion, NetworkRenderServerThread *serverThread);
 	friend class RenderServer;
 
@@ -78,6 +92,23 @@ public:
 	boost::thread *serverThread6;
 	boost::thread *engineThread;
 	boost::thread *infoThread;
+	// pushes the film over the binary channel (see netprotocol.h)
+	boost::thread *pushThread;
+	// used to serialize the messages sent over the binary channel
+	boost::mutex channelWriteMutex;
+	// used to serialize the film serializations of the binary channel,
+	// the transmitted samples are cleared
+	boost::mutex filmWriteMutex;
+	// used to serialize the commands of the text and binary channels,
+	// the binary channel is served by its own thread
+	boost::mutex commandMutex;
+	// push when that many new samples per pixel are available,
+	// but no more than once every pushMinInterval seconds
+	float pushSamplesPerPixel;
+	u_int pushMinInterval;
+	// number of films which can be pushed before the master acknowledges
+	// one of them, keeps slow links from queuing up films
+	u_int pushCredits;
 	// used to prevent simultaneous initialization
 	boost::mutex initMutex;
 
@@ -128,6 +159,7 @@ public:
 	void createNewSessionID();
 
 	bool validateAccess(std::basic_istream<char> &stream) const;
+	bool validateAccess(const std::string &sid) const;
 
 	class ErrorMessage {
 	public:
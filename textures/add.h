@@ -87,6 +87,10 @@ public:
 		*maxValue = max(max(minmin, minmax), max(maxmin, maxmax));
 	}
 	
+	virtual bool IsUVMapped() const {
+		return tex1->IsUVMapped() && tex2->IsUVMapped();
+	}
+	
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		tex1->SetIlluminant();
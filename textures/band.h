@@ -105,6 +105,13 @@ public:
 			*maxValue = max(*maxValue, maxv);
 		}
 	}
+	virtual bool IsUVMapped() const {
+		for (u_int i = 0; i < tex.size(); ++i) {
+			if (!tex[i]->IsUVMapped())
+				return false;
+		}
+		return amount->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		for (u_int i = 0; i < tex.size(); ++i)
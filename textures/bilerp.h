@@ -72,6 +72,7 @@ public:
 		*minValue = min(min(v00, v01), min(v10, v11));
 		*maxValue = max(max(v00, v01), max(v10, v11));
 	}	
+	virtual bool IsUVMapped() const { return mapping->IsUV(); }
 
 	static Texture<float> * CreateFloatTexture(const Transform &tex2world, const ParamSet &tp);
 
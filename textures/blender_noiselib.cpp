@@ -35,6 +35,10 @@
 
 #include "blender_noiselib.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
 namespace blender
 {
 
@@ -1288,6 +1292,491 @@ void cellNoiseV(float x, float y, float z, float *ca)
 /* end cellnoise */
 /*****************/
 
+/****************/
+/* SIMD NOISE   */
+/****************/
+
+/* The noise bases are also implemented with SSE2, evaluating 4 points at
+   once. The musgrave and turbulence functions use them to evaluate 4
+   octaves together. Table lookups are still done one lane at a time, the
+   interpolation, gradient and distance arithmetic is vectorized. The
+   results match the scalar code within float rounding (the scalar code
+   computes some terms in double precision); voronoi and cell noise
+   results are identical.
+   The SIMD code is compiled in when the compiler targets SSE2, every CPU
+   running such a build supports it, there is no run time dispatch. */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NOISE_SSE2
+#endif
+
+#ifdef NOISE_SSE2
+
+static bool noiseSSE2 = true;
+
+typedef void (*NoiseFunc4)(const float *x, const float *y, const float *z, float *out);
+
+static inline __m128 floor4(__m128 x)
+{
+	const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.f)));
+}
+
+static inline __m128 lerp4(__m128 t, __m128 a, __m128 b)
+{
+	return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/* 32 bit multiplication, SSE2 only has the unsigned 32x32->64 one */
+static inline __m128i mullo4(__m128i a, __m128i b)
+{
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/* improved perlin gradient, same directions as grad() */
+static inline __m128 grad4(__m128i hash4, __m128 x, __m128 y, __m128 z)
+{
+	const __m128i h = _mm_and_si128(hash4, _mm_set1_epi32(15));
+	const __m128 u = select4(_mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8))), x, y);
+	const __m128 hx = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+		_mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+	const __m128 v = select4(_mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4))), y,
+		select4(hx, x, z));
+	/* move bits 0 and 1 of h to the sign bit to negate u and v */
+	const __m128 su = _mm_castsi128_ps(_mm_slli_epi32(h, 31));
+	const __m128 sv = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, 1), 31));
+	return _mm_add_ps(_mm_xor_ps(u, su), _mm_xor_ps(v, sv));
+}
+
+static inline __m128i gatherHash4(const int *index)
+{
+	return _mm_setr_epi32(hash[index[0]], hash[index[1]], hash[index[2]], hash[index[3]]);
+}
+
+static __m128 newPerlin4(__m128 x, __m128 y, __m128 z)
+{
+	const __m128 fx = floor4(x), fy = floor4(y), fz = floor4(z);
+	const __m128i m = _mm_set1_epi32(255);
+	int X[4], Y[4], Z[4];
+	_mm_storeu_si128((__m128i *)X, _mm_and_si128(_mm_cvttps_epi32(fx), m));
+	_mm_storeu_si128((__m128i *)Y, _mm_and_si128(_mm_cvttps_epi32(fy), m));
+	_mm_storeu_si128((__m128i *)Z, _mm_and_si128(_mm_cvttps_epi32(fz), m));
+	x = _mm_sub_ps(x, fx);
+	y = _mm_sub_ps(y, fy);
+	z = _mm_sub_ps(z, fz);
+	const __m128 c6 = _mm_set1_ps(6.f), c15 = _mm_set1_ps(15.f), c10 = _mm_set1_ps(10.f);
+#define npfade4(t) _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), \
+	_mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, c6), c15)), c10))
+	const __m128 u = npfade4(x), v = npfade4(y), w = npfade4(z);
+#undef npfade4
+
+	int AA[4], AB[4], BA[4], BB[4], AA1[4], AB1[4], BA1[4], BB1[4];
+	for (int i = 0; i < 4; i++) {
+		const int A = hash[X[i]] + Y[i], B = hash[X[i] + 1] + Y[i];
+		AA[i] = hash[A] + Z[i];  AB[i] = hash[A + 1] + Z[i];
+		BA[i] = hash[B] + Z[i];  BB[i] = hash[B + 1] + Z[i];
+		AA1[i] = AA[i] + 1;  AB1[i] = AB[i] + 1;
+		BA1[i] = BA[i] + 1;  BB1[i] = BB[i] + 1;
+	}
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one), z1 = _mm_sub_ps(z, one);
+	return lerp4(w, lerp4(v, lerp4(u, grad4(gatherHash4(AA), x, y, z),
+				grad4(gatherHash4(BA), x1, y, z)),
+			lerp4(u, grad4(gatherHash4(AB), x, y1, z),
+				grad4(gatherHash4(BB), x1, y1, z))),
+		lerp4(v, lerp4(u, grad4(gatherHash4(AA1), x, y, z1),
+				grad4(gatherHash4(BA1), x1, y, z1)),
+			lerp4(u, grad4(gatherHash4(AB1), x, y1, z1),
+				grad4(gatherHash4(BB1), x1, y1, z1))));
+}
+
+static __m128 orgBlenderNoise4(__m128 x, __m128 y, __m128 z)
+{
+	const __m128 fx = floor4(x), fy = floor4(y), fz = floor4(z);
+	int ix[4], iy[4], iz[4];
+	_mm_storeu_si128((__m128i *)ix, _mm_cvttps_epi32(fx));
+	_mm_storeu_si128((__m128i *)iy, _mm_cvttps_epi32(fy));
+	_mm_storeu_si128((__m128i *)iz, _mm_cvttps_epi32(fz));
+
+	const __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f), three = _mm_set1_ps(3.f);
+	const __m128 ox = _mm_sub_ps(x, fx), oy = _mm_sub_ps(y, fy), oz = _mm_sub_ps(z, fz);
+	const __m128 jx = _mm_sub_ps(ox, one), jy = _mm_sub_ps(oy, one), jz = _mm_sub_ps(oz, one);
+#define cnpos4(o) _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(three, _mm_mul_ps(o, o))), \
+	_mm_mul_ps(_mm_mul_ps(two, _mm_mul_ps(o, o)), o))
+#define cnneg4(j) _mm_sub_ps(_mm_sub_ps(one, _mm_mul_ps(three, _mm_mul_ps(j, j))), \
+	_mm_mul_ps(_mm_mul_ps(two, _mm_mul_ps(j, j)), j))
+	const __m128 cn1 = cnpos4(ox), cn2 = cnpos4(oy), cn3 = cnpos4(oz);
+	const __m128 cn4 = cnneg4(jx), cn5 = cnneg4(jy), cn6 = cnneg4(jz);
+#undef cnpos4
+#undef cnneg4
+
+	/* corner gradients, in the order of the scalar code */
+	float h[8][3][4];
+	for (int i = 0; i < 4; i++) {
+		const int b00 = hash[hash[ix[i] & 255] + (iy[i] & 255)];
+		const int b10 = hash[hash[(ix[i] + 1) & 255] + (iy[i] & 255)];
+		const int b01 = hash[hash[ix[i] & 255] + ((iy[i] + 1) & 255)];
+		const int b11 = hash[hash[(ix[i] + 1) & 255] + ((iy[i] + 1) & 255)];
+		const int b20 = iz[i] & 255, b21 = (iz[i] + 1) & 255;
+		const int corner[8] = { b20 + b00, b21 + b00, b20 + b01, b21 + b01,
+			b20 + b10, b21 + b10, b20 + b11, b21 + b11 };
+		for (int c = 0; c < 8; c++) {
+			const float *v = hashvectf + 3 * hash[corner[c]];
+			h[c][0][i] = v[0];
+			h[c][1][i] = v[1];
+			h[c][2][i] = v[2];
+		}
+	}
+
+	__m128 n = _mm_set1_ps(0.5f);
+#define corner4(c, wx, wy, wz, dx, dy, dz) \
+	n = _mm_add_ps(n, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(wx, wy), wz), \
+		_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(h[c][0]), dx), \
+			_mm_mul_ps(_mm_loadu_ps(h[c][1]), dy)), _mm_mul_ps(_mm_loadu_ps(h[c][2]), dz))))
+	corner4(0, cn1, cn2, cn3, ox, oy, oz);
+	corner4(1, cn1, cn2, cn6, ox, oy, jz);
+	corner4(2, cn1, cn5, cn3, ox, jy, oz);
+	corner4(3, cn1, cn5, cn6, ox, jy, jz);
+	corner4(4, cn4, cn2, cn3, jx, oy, oz);
+	corner4(5, cn4, cn2, cn6, jx, oy, jz);
+	corner4(6, cn4, cn5, cn3, jx, jy, oz);
+	corner4(7, cn4, cn5, cn6, jx, jy, jz);
+#undef corner4
+
+	return _mm_min_ps(_mm_max_ps(n, _mm_setzero_ps()), one);
+}
+
+static __m128 noise3_perlin4(__m128 x, __m128 y, __m128 z)
+{
+	const __m128 offset = _mm_set1_ps(10000.f);
+	const __m128 tx = _mm_add_ps(x, offset), ty = _mm_add_ps(y, offset), tz = _mm_add_ps(z, offset);
+	const __m128i itx = _mm_cvttps_epi32(tx), ity = _mm_cvttps_epi32(ty), itz = _mm_cvttps_epi32(tz);
+	int bx[4], by[4], bz[4];
+	const __m128i m = _mm_set1_epi32(255);
+	_mm_storeu_si128((__m128i *)bx, _mm_and_si128(itx, m));
+	_mm_storeu_si128((__m128i *)by, _mm_and_si128(ity, m));
+	_mm_storeu_si128((__m128i *)bz, _mm_and_si128(itz, m));
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 rx0 = _mm_sub_ps(tx, _mm_cvtepi32_ps(itx));
+	const __m128 ry0 = _mm_sub_ps(ty, _mm_cvtepi32_ps(ity));
+	const __m128 rz0 = _mm_sub_ps(tz, _mm_cvtepi32_ps(itz));
+	const __m128 rx1 = _mm_sub_ps(rx0, one), ry1 = _mm_sub_ps(ry0, one), rz1 = _mm_sub_ps(rz0, one);
+
+	/* gradients of the 8 corners */
+	float q[8][3][4];
+	for (int l = 0; l < 4; l++) {
+		const int bx1 = (bx[l] + 1) & 255, by1 = (by[l] + 1) & 255, bz1 = (bz[l] + 1) & 255;
+		const int i = p[bx[l]], j = p[bx1];
+		const int b00 = p[i + by[l]], b10 = p[j + by[l]];
+		const int b01 = p[i + by1], b11 = p[j + by1];
+		const int corner[8] = { b00 + bz[l], b10 + bz[l], b01 + bz[l], b11 + bz[l],
+			b00 + bz1, b10 + bz1, b01 + bz1, b11 + bz1 };
+		for (int c = 0; c < 8; c++) {
+			q[c][0][l] = g[corner[c]][0];
+			q[c][1][l] = g[corner[c]][1];
+			q[c][2][l] = g[corner[c]][2];
+		}
+	}
+
+	const __m128 two = _mm_set1_ps(2.f), three = _mm_set1_ps(3.f);
+#define surve4(t) _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(three, _mm_mul_ps(two, t)))
+	const __m128 sx = surve4(rx0), sy = surve4(ry0), sz = surve4(rz0);
+#undef surve4
+#define at4(c, rx, ry, rz) _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, _mm_loadu_ps(q[c][0])), \
+	_mm_mul_ps(ry, _mm_loadu_ps(q[c][1]))), _mm_mul_ps(rz, _mm_loadu_ps(q[c][2])))
+	const __m128 c = lerp4(sy, lerp4(sx, at4(0, rx0, ry0, rz0), at4(1, rx1, ry0, rz0)),
+		lerp4(sx, at4(2, rx0, ry1, rz0), at4(3, rx1, ry1, rz0)));
+	const __m128 d = lerp4(sy, lerp4(sx, at4(4, rx0, ry0, rz1), at4(5, rx1, ry0, rz1)),
+		lerp4(sx, at4(6, rx0, ry1, rz1), at4(7, rx1, ry1, rz1)));
+#undef at4
+	return _mm_mul_ps(_mm_set1_ps(1.5f), lerp4(sz, c, d));
+}
+
+/* voronoi with the real distance, returns the 4 sorted feature distances */
+static void voronoi4(__m128 x, __m128 y, __m128 z, __m128 *da)
+{
+	int xi[4], yi[4], zi[4];
+	_mm_storeu_si128((__m128i *)xi, _mm_cvttps_epi32(floor4(x)));
+	_mm_storeu_si128((__m128i *)yi, _mm_cvttps_epi32(floor4(y)));
+	_mm_storeu_si128((__m128i *)zi, _mm_cvttps_epi32(floor4(z)));
+	da[0] = da[1] = da[2] = da[3] = _mm_set1_ps(1e10f);
+	for (int xx = -1; xx <= 1; xx++) {
+		for (int yy = -1; yy <= 1; yy++) {
+			for (int zz = -1; zz <= 1; zz++) {
+				float px[4], py[4], pz[4];
+				for (int l = 0; l < 4; l++) {
+					const int cx = xi[l] + xx, cy = yi[l] + yy, cz = zi[l] + zz;
+					const float *pnt = HASHPNT(cx, cy, cz);
+					px[l] = pnt[0] + cx;
+					py[l] = pnt[1] + cy;
+					pz[l] = pnt[2] + cz;
+				}
+				const __m128 xd = _mm_sub_ps(x, _mm_loadu_ps(px));
+				const __m128 yd = _mm_sub_ps(y, _mm_loadu_ps(py));
+				const __m128 zd = _mm_sub_ps(z, _mm_loadu_ps(pz));
+				__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(xd, xd),
+					_mm_mul_ps(yd, yd)), _mm_mul_ps(zd, zd)));
+				/* insert in the sorted distances */
+				for (int k = 0; k < 4; k++) {
+					const __m128 lo = _mm_min_ps(da[k], d);
+					d = _mm_max_ps(da[k], d);
+					da[k] = lo;
+				}
+			}
+		}
+	}
+}
+
+static __m128 cellNoiseU4(__m128 x, __m128 y, __m128 z)
+{
+	const __m128i xi = _mm_cvttps_epi32(floor4(x));
+	const __m128i yi = _mm_cvttps_epi32(floor4(y));
+	const __m128i zi = _mm_cvttps_epi32(floor4(z));
+	__m128i n = _mm_add_epi32(_mm_add_epi32(xi, mullo4(yi, _mm_set1_epi32(1301))),
+		mullo4(zi, _mm_set1_epi32(314159)));
+	n = _mm_xor_si128(n, _mm_slli_epi32(n, 13));
+	n = _mm_add_epi32(mullo4(n, _mm_add_epi32(mullo4(mullo4(n, n), _mm_set1_epi32(15731)),
+		_mm_set1_epi32(789221))), _mm_set1_epi32(1376312589));
+	/* unsigned to float conversion, correctly rounded */
+	const __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(n, 16));
+	const __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(n, _mm_set1_epi32(0xffff)));
+	return _mm_mul_ps(_mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.f)), lo),
+		_mm_set1_ps(1.f / 4294967296.f));
+}
+
+static inline __m128 unsignedToSigned4(__m128 n)
+{
+	return _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.f), n), _mm_set1_ps(1.f));
+}
+
+static inline __m128 signedToUnsigned4(__m128 n)
+{
+	return _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_set1_ps(0.5f), n));
+}
+
+static inline __m128 crackle4(__m128 *da)
+{
+	return _mm_min_ps(_mm_mul_ps(_mm_set1_ps(10.f), _mm_sub_ps(da[1], da[0])), _mm_set1_ps(1.f));
+}
+
+/* 4 point versions of the noise bases used by BLI_gNoise() and the musgrave functions */
+#define NOISE4(name, body) \
+static void name##4(const float *px, const float *py, const float *pz, float *out) \
+{ \
+	const __m128 x = _mm_loadu_ps(px), y = _mm_loadu_ps(py), z = _mm_loadu_ps(pz); \
+	body \
+}
+#define VORONOI4(name, expr) NOISE4(name, __m128 da[4]; voronoi4(x, y, z, da); \
+	_mm_storeu_ps(out, expr);)
+
+NOISE4(newPerlin, _mm_storeu_ps(out, newPerlin4(x, y, z));)
+NOISE4(newPerlinU, _mm_storeu_ps(out, signedToUnsigned4(newPerlin4(x, y, z)));)
+NOISE4(orgBlenderNoise, _mm_storeu_ps(out, orgBlenderNoise4(x, y, z));)
+NOISE4(orgBlenderNoiseS, _mm_storeu_ps(out, unsignedToSigned4(orgBlenderNoise4(x, y, z)));)
+NOISE4(orgPerlinNoise, _mm_storeu_ps(out, noise3_perlin4(x, y, z));)
+NOISE4(orgPerlinNoiseU, _mm_storeu_ps(out, signedToUnsigned4(noise3_perlin4(x, y, z)));)
+NOISE4(cellNoise, _mm_storeu_ps(out, unsignedToSigned4(cellNoiseU4(x, y, z)));)
+NOISE4(cellNoiseU, _mm_storeu_ps(out, cellNoiseU4(x, y, z));)
+VORONOI4(voronoi_F1, da[0])
+VORONOI4(voronoi_F2, da[1])
+VORONOI4(voronoi_F3, da[2])
+VORONOI4(voronoi_F4, da[3])
+VORONOI4(voronoi_F1F2, _mm_sub_ps(da[1], da[0]))
+VORONOI4(voronoi_Cr, crackle4(da))
+VORONOI4(voronoi_F1S, unsignedToSigned4(da[0]))
+VORONOI4(voronoi_F2S, unsignedToSigned4(da[1]))
+VORONOI4(voronoi_F3S, unsignedToSigned4(da[2]))
+VORONOI4(voronoi_F4S, unsignedToSigned4(da[3]))
+VORONOI4(voronoi_F1F2S, unsignedToSigned4(_mm_sub_ps(da[1], da[0])))
+VORONOI4(voronoi_CrS, unsignedToSigned4(crackle4(da)))
+#undef VORONOI4
+#undef NOISE4
+
+/* minLanes is the smallest number of useful points for which the 4 point
+   version is faster than that many scalar calls (measured with SSE2) */
+static const struct {
+	float (*noisefunc)(float, float, float);
+	NoiseFunc4 noisefunc4;
+	int minLanes;
+} noiseFuncs4[] = {
+	{ newPerlin, newPerlin4, 2 }, { newPerlinU, newPerlinU4, 2 },
+	{ orgBlenderNoise, orgBlenderNoise4, 3 }, { orgBlenderNoiseS, orgBlenderNoiseS4, 3 },
+	{ orgPerlinNoise, orgPerlinNoise4, 3 }, { orgPerlinNoiseU, orgPerlinNoiseU4, 3 },
+	{ cellNoise, cellNoise4, 4 }, { cellNoiseU, cellNoiseU4, 4 },
+	{ voronoi_F1, voronoi_F14, 2 }, { voronoi_F2, voronoi_F24, 2 },
+	{ voronoi_F3, voronoi_F34, 2 }, { voronoi_F4, voronoi_F44, 2 },
+	{ voronoi_F1F2, voronoi_F1F24, 2 }, { voronoi_Cr, voronoi_Cr4, 2 },
+	{ voronoi_F1S, voronoi_F1S4, 2 }, { voronoi_F2S, voronoi_F2S4, 2 },
+	{ voronoi_F3S, voronoi_F3S4, 2 }, { voronoi_F4S, voronoi_F4S4, 2 },
+	{ voronoi_F1F2S, voronoi_F1F2S4, 2 }, { voronoi_CrS, voronoi_CrS4, 2 },
+};
+
+/* returns the SIMD version of a noise basis, NULL if it has none or SIMD is disabled */
+static NoiseFunc4 getNoiseFunc4(float (*noisefunc)(float, float, float), int *minLanes)
+{
+	*minLanes = 4;
+	if (!noiseSSE2)
+		return NULL;
+	for (unsigned int i = 0; i < sizeof(noiseFuncs4) / sizeof(noiseFuncs4[0]); i++) {
+		if (noiseFuncs4[i].noisefunc == noisefunc) {
+			*minLanes = noiseFuncs4[i].minLanes;
+			return noiseFuncs4[i].noisefunc4;
+		}
+	}
+	return NULL;
+}
+
+#else
+
+typedef void (*NoiseFunc4)(const float *x, const float *y, const float *z, float *out);
+
+static NoiseFunc4 getNoiseFunc4(float (*noisefunc)(float, float, float), int *minLanes)
+{
+	*minLanes = 4;
+	return NULL;
+}
+
+#endif
+
+bool BLI_noiseSIMDSupported()
+{
+#ifdef NOISE_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool BLI_noiseSIMD()
+{
+#ifdef NOISE_SSE2
+	return noiseSSE2;
+#else
+	return false;
+#endif
+}
+
+void BLI_setNoiseSIMD(bool enable)
+{
+#ifdef NOISE_SSE2
+	noiseSSE2 = enable;
+#endif
+}
+
+/* Successive octaves of a noise basis: the point is scaled by lacunarity
+   after each octave. With SIMD, up to 4 octaves are evaluated at once but
+   only the octaves still to be used are computed: when fewer remain than
+   the noise basis needs to beat the scalar code, they are evaluated one at
+   a time. */
+class OctaveNoise {
+public:
+	OctaveNoise(float (*f)(float, float, float), float x, float y, float z,
+		float l, int octaves) : noisefunc(f),
+		noisefunc4(getNoiseFunc4(f, &minLanes)), lacunarity(l),
+		remaining(octaves), index(0), lanes(0) {
+		point[0] = x;
+		point[1] = y;
+		point[2] = z;
+	}
+	float next() {
+		if (index < lanes)
+			return values[index++];
+		const int n = remaining < 4 ? remaining : 4;
+		if (!noisefunc4 || n < minLanes) {
+			--remaining;
+			const float v = noisefunc(point[0], point[1], point[2]);
+			advance();
+			return v;
+		}
+		remaining -= n;
+		/* the unused lanes repeat the last octave */
+		float x[4], y[4], z[4];
+		for (int i = 0; i < 4; i++) {
+			x[i] = point[0];
+			y[i] = point[1];
+			z[i] = point[2];
+			if (i < n - 1)
+				advance();
+		}
+		advance();
+		noisefunc4(x, y, z, values);
+		lanes = n;
+		index = 1;
+		return values[0];
+	}
+private:
+	void advance() {
+		point[0] *= lacunarity;
+		point[1] *= lacunarity;
+		point[2] *= lacunarity;
+	}
+
+	float (*noisefunc)(float, float, float);
+	NoiseFunc4 noisefunc4;
+	float point[3], lacunarity, values[4];
+	int minLanes, remaining, index, lanes;
+};
+
+void BLI_noiseBasis4(const float *x, const float *y, const float *z, float *out, int noisebasis, bool isSigned)
+{
+	float (*noisefunc)(float, float, float);
+
+	switch (noisebasis) {
+		case 1:
+			noisefunc = isSigned ? orgPerlinNoise : orgPerlinNoiseU;
+			break;
+		case 2:
+			noisefunc = isSigned ? newPerlin : newPerlinU;
+			break;
+		case 3:
+			noisefunc = isSigned ? voronoi_F1S : voronoi_F1;
+			break;
+		case 4:
+			noisefunc = isSigned ? voronoi_F2S : voronoi_F2;
+			break;
+		case 5:
+			noisefunc = isSigned ? voronoi_F3S : voronoi_F3;
+			break;
+		case 6:
+			noisefunc = isSigned ? voronoi_F4S : voronoi_F4;
+			break;
+		case 7:
+			noisefunc = isSigned ? voronoi_F1F2S : voronoi_F1F2;
+			break;
+		case 8:
+			noisefunc = isSigned ? voronoi_CrS : voronoi_Cr;
+			break;
+		case 14:
+			noisefunc = isSigned ? cellNoise : cellNoiseU;
+			break;
+		case 0:
+		default:
+			noisefunc = isSigned ? orgBlenderNoiseS : orgBlenderNoise;
+	}
+	int minLanes;
+	NoiseFunc4 noisefunc4 = getNoiseFunc4(noisefunc, &minLanes);
+	if (noisefunc4)
+		noisefunc4(x, y, z, out);
+	else {
+		for (int i = 0; i < 4; i++)
+			out[i] = noisefunc(x[i], y[i], z[i]);
+	}
+}
+
+/*******************/
+/* end SIMD noise  */
+/*******************/
+
 /* newnoise: generic noise function for use with different noisebases */
 float BLI_gNoise(float noisesize, float x, float y, float z, int hard, int noisebasis)
 {
@@ -1346,7 +1835,7 @@ float BLI_gNoise(float noisesize, float x, float y, float z, int hard, int noise
 float BLI_gTurbulence(float noisesize, float x, float y, float z, int oct, int hard, int noisebasis)
 {
 	float (*noisefunc)(float, float, float);
-	float sum, t, amp=1, fscale=1;
+	float sum, t, amp=1;
 	int i;
 	
 	switch (noisebasis) {
@@ -1392,9 +1881,10 @@ float BLI_gTurbulence(float noisesize, float x, float y, float z, int oct, int h
 		z *= noisesize;
 	}
 
+	OctaveNoise noise(noisefunc, x, y, z, 2, oct + 1);
 	sum = 0;
-	for (i=0;i<=oct;i++, amp*=0.5, fscale*=2) {
-		t = noisefunc(fscale*x, fscale*y, fscale*z);
+	for (i=0;i<=oct;i++, amp*=0.5) {
+		t = noise.next();
 		if (hard) t = fabs(2.0*t-1.0);
 		sum += t * amp;
 	}
@@ -1459,16 +1949,14 @@ float mg_fBm(float x, float y, float z, float H, float lacunarity, float octaves
 		}
 	}
 	
+	OctaveNoise noise(noisefunc, x, y, z, lacunarity, (int)ceil(octaves));
 	for (i=0; i<(int)octaves; i++) {
-		value += noisefunc(x, y, z) * pwr;
+		value += noise.next() * pwr;
 		pwr *= pwHL;
-		x *= lacunarity;
-		y *= lacunarity;
-		z *= lacunarity;
 	}
 
 	rmd = octaves - floor(octaves);
-	if (rmd!=0.f) value += rmd * noisefunc(x, y, z) * pwr;
+	if (rmd!=0.f) value += rmd * noise.next() * pwr;
 
 	return value;
 
@@ -1528,15 +2016,13 @@ float mg_MultiFractal(float x, float y, float z, float H, float lacunarity, floa
 		}
 	}
 
+	OctaveNoise noise(noisefunc, x, y, z, lacunarity, (int)ceil(octaves));
 	for (i=0; i<(int)octaves; i++) {
-		value *= (pwr * noisefunc(x, y, z) + 1.0);
+		value *= (pwr * noise.next() + 1.0);
 		pwr *= pwHL;
-		x *= lacunarity;
-		y *= lacunarity;
-		z *= lacunarity;
 	}
 	rmd = octaves - floor(octaves);
-	if (rmd!=0.0) value *= (rmd * noisefunc(x, y, z) * pwr + 1.0);
+	if (rmd!=0.0) value *= (rmd * noise.next() * pwr + 1.0);
 
 	return value;
 
@@ -1595,23 +2081,18 @@ float mg_HeteroTerrain(float x, float y, float z, float H, float lacunarity, flo
 	}
 
 	/* first unscaled octave of function; later octaves are scaled */
-	value = offset + noisefunc(x, y, z);
-	x *= lacunarity;
-	y *= lacunarity;
-	z *= lacunarity;
+	OctaveNoise noise(noisefunc, x, y, z, lacunarity, (int)ceil(octaves));
+	value = offset + noise.next();
 
 	for (i=1; i<(int)octaves; i++) {
-		increment = (noisefunc(x, y, z) + offset) * pwr * value;
+		increment = (noise.next() + offset) * pwr * value;
 		value += increment;
 		pwr *= pwHL;
-		x *= lacunarity;
-		y *= lacunarity;
-		z *= lacunarity;
 	}
 
 	rmd = octaves - floor(octaves);
 	if (rmd!=0.0) {
-		increment = (noisefunc(x, y, z) + offset) * pwr * value;
+		increment = (noise.next() + offset) * pwr * value;
 		value += rmd * increment;
 	}
 	return value;
@@ -1667,25 +2148,20 @@ float mg_HybridMultiFractal(float x, float y, float z, float H, float lacunarity
 		}
 	}
 
-	result = noisefunc(x, y, z) + offset;
+	OctaveNoise noise(noisefunc, x, y, z, lacunarity, (int)ceil(octaves));
+	result = noise.next() + offset;
 	weight = gain * result;
-	x *= lacunarity;
-	y *= lacunarity;
-	z *= lacunarity;
 
 	for (i=1; (weight>0.001) && (i<(int)octaves); i++) {
 		if (weight>1.0)  weight=1.0;
-		signal = (noisefunc(x, y, z) + offset) * pwr;
+		signal = (noise.next() + offset) * pwr;
 		pwr *= pwHL;
 		result += weight * signal;
 		weight *= gain * signal;
-		x *= lacunarity;
-		y *= lacunarity;
-		z *= lacunarity;
 	}
 
 	rmd = octaves - floor(octaves);
-	if (rmd!=0.f) result += rmd * ((noisefunc(x, y, z) + offset) * pwr);
+	if (rmd!=0.f) result += rmd * ((noise.next() + offset) * pwr);
 
 	return result;
 
@@ -1742,18 +2218,16 @@ float mg_RidgedMultiFractal(float x, float y, float z, float H, float lacunarity
 		}
 	}
 
-	signal = offset - fabs(noisefunc(x, y, z));
+	OctaveNoise noise(noisefunc, x, y, z, lacunarity, (int)octaves);
+	signal = offset - fabs(noise.next());
 	signal *= signal;
 	result = signal;
 	weight = 1.f;
 
 	for( i=1; i<(int)octaves; i++ ) {
-		x *= lacunarity;
-		y *= lacunarity;
-		z *= lacunarity;
 		weight = signal * gain;
 		if (weight>1.0) weight=1.0; else if (weight<0.0) weight=0.0;
-		signal = offset - fabs(noisefunc(x, y, z));
+		signal = offset - fabs(noise.next());
 		signal *= signal;
 		signal *= weight;
 		result += signal * pwr;
@@ -1841,9 +2315,23 @@ float mg_VLNoise(float x, float y, float z, float distortion, int nbas1, int nba
 	}
 
 	/* get a random vector and scale the randomization */
-	rv[0] = noisefunc1(x+13.5, y+13.5, z+13.5) * distortion;
-	rv[1] = noisefunc1(x, y, z) * distortion;
-	rv[2] = noisefunc1(x-13.5, y-13.5, z-13.5) * distortion;
+	int minLanes;
+	NoiseFunc4 noisefunc4 = getNoiseFunc4(noisefunc1, &minLanes);
+	if (noisefunc4 && minLanes <= 3) {
+		/* the 3 lookups are done at once, the last lane is unused */
+		const float px[4] = { x+13.5f, x, x-13.5f, x };
+		const float py[4] = { y+13.5f, y, y-13.5f, y };
+		const float pz[4] = { z+13.5f, z, z-13.5f, z };
+		float n[4];
+		noisefunc4(px, py, pz, n);
+		rv[0] = n[0] * distortion;
+		rv[1] = n[1] * distortion;
+		rv[2] = n[2] * distortion;
+	} else {
+		rv[0] = noisefunc1(x+13.5, y+13.5, z+13.5) * distortion;
+		rv[1] = noisefunc1(x, y, z) * distortion;
+		rv[2] = noisefunc1(x-13.5, y-13.5, z-13.5) * distortion;
+	}
 	return noisefunc2(x+rv[0], y+rv[1], z+rv[2]);	/* distorted-domain noise */
 }
 
@@ -49,4 +49,13 @@ void cellNoiseV(float x, float y, float z, float *ca);
 
 float newPerlin(float x, float y, float z);
 
+/* SIMD backend: the musgrave and turbulence functions evaluate 4 octaves at
+   once with it. It is compiled in for SSE2 targets and enabled by default. */
+bool BLI_noiseSIMDSupported();
+bool BLI_noiseSIMD();
+void BLI_setNoiseSIMD(bool enable);
+/* evaluates a noise basis at 4 points, signed as used by the musgrave
+   functions or unsigned as used by BLI_gNoise() */
+void BLI_noiseBasis4(const float *x, const float *y, const float *z, float *out, int noisebasis, bool isSigned);
+
 } // namespace blender
@@ -201,6 +201,10 @@ public:
 		*minValue = min(min(min(minmin13, minmax13), min(maxmin13, maxmax13)), min2);
 		*maxValue = max(max(max(minmin13, minmax13), max(maxmin13, maxmax13)), max2);
 	}
+	virtual bool IsUVMapped() const {
+		return mapping->IsUV() && tex1->IsUVMapped() &&
+			tex2->IsUVMapped() && tex3->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		// Don't update tex3 as it's a filtering texture
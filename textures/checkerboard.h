@@ -201,6 +201,10 @@ public:
 		*minValue = min(min1, min2);
 		*maxValue = max(max1, max2);
 	}
+	virtual bool IsUVMapped() const {
+		return mapping->IsUV() && tex1->IsUVMapped() &&
+			tex2->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		tex1->SetIlluminant();
@@ -357,6 +361,10 @@ public:
 		*minValue = min(min1, min2);
 		*maxValue = max(max1, max2);
 	}
+	virtual bool IsUVMapped() const {
+		return mapping->IsUV() && tex1->IsUVMapped() &&
+			tex2->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		tex1->SetIlluminant();
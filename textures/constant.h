@@ -52,6 +52,7 @@ public:
 		*minValue = value;
 		*maxValue = value;
 	}
+	virtual bool IsUVMapped() const { return true; }
 private:
 	float value;
 };
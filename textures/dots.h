@@ -127,6 +127,10 @@ public:
 		*minValue = min(min1, min2);
 		*maxValue = max(max1, max2);
 	}
+	virtual bool IsUVMapped() const {
+		return mapping->IsUV() && insideDot->IsUVMapped() &&
+			outsideDot->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		outsideDot->SetIlluminant();
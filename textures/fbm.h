@@ -85,6 +85,7 @@ public:
 		*maxValue = max(1.f, geomsum/2.f);
 		*minValue = -*maxValue;
 	}
+	virtual bool IsUVMapped() const { return mapping->IsUV(); }
 
 	static Texture<float> * CreateFloatTexture(const Transform &tex2world, const ParamSet &tp);
 	
@@ -29,6 +29,7 @@
 #include "paramset.h"
 #include "error.h"
 #include "rgbillum.h"
+#include "profiler.h"
 #include <map>
 using std::map;
 
@@ -119,6 +120,7 @@ public:
 
 	virtual float Evaluate(const SpectrumWavelengths &sw,
 		const DifferentialGeometry &dg) const {
+		PROFILE_SCOPE(PROF_TEXTURE);
 		float s, t;
 		mapping->Map(dg, &s, &t);
 		return mipmap->LookupFloat(channel, s, t);
@@ -140,6 +142,7 @@ public:
 	virtual void GetMinMaxFloat(float *minValue, float *maxValue) const {
 		mipmap->GetMinMaxFloat(channel, minValue, maxValue);
 	}
+	virtual bool IsUVMapped() const { return mapping->IsUV(); }
 
 	static Texture<float> * CreateFloatTexture(const Transform &tex2world, const ParamSet &tp);
 
@@ -159,6 +162,7 @@ public:
 
 	virtual SWCSpectrum Evaluate(const SpectrumWavelengths &sw,
 		const DifferentialGeometry &dg) const {
+		PROFILE_SCOPE(PROF_TEXTURE);
 		float s, t;
 		mapping->Map(dg, &s, &t);
 		if (isIlluminant)
@@ -23,6 +23,10 @@
 // marble.cpp*
 #include "marble.h"
 #include "dynload.h"
+#include "texturebake.h"
+#include "error.h"
+
+#include <boost/bind.hpp>
 
 using namespace lux;
 
@@ -47,11 +51,37 @@ Texture<SWCSpectrum> * MarbleTexture::CreateSWCSpectrumTexture(const Transform &
 		imap = new GlobalMapping3D(tex2world);
 	// Apply texture specified transformation option for 3D mapping
 	imap->Apply3DTextureMappingOptions(tp);
-	return new MarbleTexture(tp.FindOneInt("octaves", 8),
+	MarbleTexture *tex = new MarbleTexture(tp.FindOneInt("octaves", 8),
 		tp.FindOneFloat("roughness", .5f),
 		tp.FindOneFloat("scale", 1.f),
 		tp.FindOneFloat("variation", .2f),
 		imap);
+	// Optionally bake uv mapped marble at the given resolution
+	const int bake = tp.FindOneInt("bake", 0);
+	if (bake > 0) {
+		if (coords == "uv")
+			tex->Bake(bake);
+		else
+			LOG(LUX_WARNING, LUX_BADTOKEN) << "Only uv mapped marble can be baked, ignoring \"bake\"";
+	}
+	return tex;
+}
+
+void MarbleTexture::Bake(u_int resolution)
+{
+	baked = BakeRGBUV(resolution,
+		boost::bind(&MarbleTexture::BakedColor, this, _1, _2));
+	LOG(LUX_INFO, LUX_NOERROR) << "Baked marble texture (" <<
+		(baked->GetMemoryUsed() / 1024) << "Kbytes)";
+}
+
+RGBColor MarbleTexture::BakedColor(float u, float v) const
+{
+	DifferentialGeometry dg;
+	dg.u = u;
+	dg.v = v;
+	// Extra scale of 1.5 to increase variation among colors
+	return 1.5f * Color(mapping->Map(dg));
 }
 
 static DynamicLoader::RegisterSWCSpectrumTexture<MarbleTexture> r2("marble");
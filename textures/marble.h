@@ -27,6 +27,7 @@
 #include "color.h"
 #include "geometry/raydifferential.h"
 #include "paramset.h"
+#include "mipmap.h"
 
 // TODO - radiance - add methods for Power and Illuminant propagation
 
@@ -48,46 +49,28 @@ public:
 	}
 	virtual SWCSpectrum Evaluate(const SpectrumWavelengths &sw,
 		const DifferentialGeometry &dg) const {
-		Point P(mapping->Map(dg));
-		P *= scale;
-		float marble = P.y + variation * FBm(P, 0.f, 0.f, omega,
-			octaves);
-		float t = .5f + .5f * sinf(marble);
-		// Evaluate marble spline at _t_
-		static float c[][3] = { { .58f, .58f, .6f }, { .58f, .58f, .6f }, { .58f, .58f, .6f },
-			{ .5f, .5f, .5f }, { .6f, .59f, .58f }, { .58f, .58f, .6f },
-			{ .58f, .58f, .6f }, {.2f, .2f, .33f }, { .58f, .58f, .6f }, };
-		#define NC  sizeof(c) / sizeof(c[0])
-		#define NSEG (NC-3)
-		int first = Floor2Int(t * NSEG);
-		t = (t * NSEG - first);
-		RGBColor c0(c[first]), c1(c[first+1]), c2(c[first+2]), c3(c[first+3]);
-		// Bezier spline evaluated with de Castilejau's algorithm
-		RGBColor s0(Lerp(t, c0, c1));
-		RGBColor s1(Lerp(t, c1, c2));
-		RGBColor s2(Lerp(t, c2, c3));
-		s0 = Lerp(t, s0, s1);
-		s1 = Lerp(t, s1, s2);
+		if (baked)
+			return baked->LookupSpectrum(sw, dg.u, dg.v);
 		// Extra scale of 1.5 to increase variation among colors
-		return SWCSpectrum(sw, 1.5f * Lerp(t, s0, s1));
+		return SWCSpectrum(sw, 1.5f * Color(mapping->Map(dg)));
 	}
 	virtual float Y() const {
 		static float c[][3] = { { .58f, .58f, .6f }, { .58f, .58f, .6f }, { .58f, .58f, .6f },
 			{ .5f, .5f, .5f }, { .6f, .59f, .58f }, { .58f, .58f, .6f },
 			{ .58f, .58f, .6f }, {.2f, .2f, .33f }, { .58f, .58f, .6f }, };
 		RGBColor cs(0.f);
-		for (u_int i = 0; i < NC; ++i)
+		for (u_int i = 0; i < nColors; ++i)
 			cs += RGBColor(c[i]);
-		return cs.Y() / NC;
+		return cs.Y() / nColors;
 	}
 	virtual float Filter() const {
 		static float c[][3] = { { .58f, .58f, .6f }, { .58f, .58f, .6f }, { .58f, .58f, .6f },
 			{ .5f, .5f, .5f }, { .6f, .59f, .58f }, { .58f, .58f, .6f },
 			{ .58f, .58f, .6f }, {.2f, .2f, .33f }, { .58f, .58f, .6f }, };
 		RGBColor cs(0.f);
-		for (u_int i = 0; i < NC; ++i)
+		for (u_int i = 0; i < nColors; ++i)
 			cs += RGBColor(c[i]);
-		return cs.Filter() / NC;
+		return cs.Filter() / nColors;
 	}
 	virtual void GetDuv(const SpectrumWavelengths &sw,
 		const DifferentialGeometry &dg, float delta,
@@ -119,11 +102,44 @@ public:
 	}
 	
 	static Texture<SWCSpectrum> * CreateSWCSpectrumTexture(const Transform &tex2world, const ParamSet &tp);
+	/**
+	 * Rasterizes the uv mapped marble into a MIP map of the given
+	 * resolution, later evaluations look it up instead of computing the
+	 * noise.
+	 */
+	void Bake(u_int resolution);
+
 private:
+	RGBColor Color(Point P) const {
+		P *= scale;
+		float marble = P.y + variation * FBm(P, 0.f, 0.f, omega,
+			octaves);
+		float t = .5f + .5f * sinf(marble);
+		// Evaluate marble spline at _t_
+		static float c[][3] = { { .58f, .58f, .6f }, { .58f, .58f, .6f }, { .58f, .58f, .6f },
+			{ .5f, .5f, .5f }, { .6f, .59f, .58f }, { .58f, .58f, .6f },
+			{ .58f, .58f, .6f }, {.2f, .2f, .33f }, { .58f, .58f, .6f }, };
+		int first = Floor2Int(t * nSegments);
+		t = (t * nSegments - first);
+		RGBColor c0(c[first]), c1(c[first+1]), c2(c[first+2]), c3(c[first+3]);
+		// Bezier spline evaluated with de Castilejau's algorithm
+		RGBColor s0(Lerp(t, c0, c1));
+		RGBColor s1(Lerp(t, c1, c2));
+		RGBColor s2(Lerp(t, c2, c3));
+		s0 = Lerp(t, s0, s1);
+		s1 = Lerp(t, s1, s2);
+		return Lerp(t, s0, s1);
+	}
+	RGBColor BakedColor(float u, float v) const;
+
 	// MarbleTexture Private Data
+	// Number of marble spline control points and segments
+	static const u_int nColors = 9;
+	static const u_int nSegments = nColors - 3;
 	int octaves;
 	float omega, scale, variation;
 	TextureMapping3D *mapping;
+	boost::shared_ptr<MIPMap> baked;
 };
 
 }//namespace lux
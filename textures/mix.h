@@ -74,6 +74,10 @@ public:
 		*minValue = min(Lerp(mina, min1, min2), Lerp(maxa, min1, min2));
 		*maxValue = max(Lerp(mina, max1, max2), Lerp(maxa, max1, max2));
 	}
+	virtual bool IsUVMapped() const {
+		return amount->IsUVMapped() && tex1->IsUVMapped() &&
+			tex2->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		tex1->SetIlluminant();
@@ -105,6 +105,13 @@ public:
 			*maxValue += max(wminv, wmaxv);
 		}
 	}
+	virtual bool IsUVMapped() const {
+		for (u_int i = 0; i < tex.size(); ++i) {
+			if (!tex[i]->IsUVMapped())
+				return false;
+		}
+		return true;
+	}
 	virtual void SetIlluminant()
 	{
 		// Update sub-textures
@@ -75,6 +75,9 @@ public:
 		*minValue = min(min(minmin, minmax), min(maxmin, maxmax));
 		*maxValue = max(max(minmin, minmax), max(maxmin, maxmax));
 	}
+	virtual bool IsUVMapped() const {
+		return tex1->IsUVMapped() && tex2->IsUVMapped();
+	}
 	virtual void SetIlluminant() {
 		// Update sub-textures
 		tex1->SetIlluminant();
@@ -95,6 +95,10 @@ public:
 		*minValue = min(min1, min2);
 		*maxValue = max(max1, max2);
 	}
+	virtual bool IsUVMapped() const {
+		return mapping->IsUV() && innerTex->IsUVMapped() &&
+			outerTex->IsUVMapped();
+	}
 
 	static Texture<float> * CreateFloatTexture(const Transform &tex2world,
 	                                           const ParamSet  &tp);
@@ -83,6 +83,7 @@ public:
 		*maxValue = geomsum_wind * geomsum_wave / 4.f;
 		*minValue = -*maxValue;
 	}
+	virtual bool IsUVMapped() const { return mapping->IsUV(); }
 	
 	static Texture<float> * CreateFloatTexture(const Transform &tex2world, const ParamSet &tp);
 private:
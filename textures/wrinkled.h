@@ -85,6 +85,7 @@ public:
 		*minValue = 0.f;
 		*maxValue = max(1.f, geomsum * (3.f/5.f));
 	}
+	virtual bool IsUVMapped() const { return mapping->IsUV(); }
 	
 	static Texture<float> * CreateFloatTexture(const Transform &tex2world, const ParamSet &tp);
 private:
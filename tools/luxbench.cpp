@@ -0,0 +1,984 @@
+/***************************************************************************
+ *   Copyright (C) 1998-2009 by authors (see AUTHORS.txt )                 *
+ *                                                                         *
+ *   This file is part of LuxRender.                                       *
+ *                                                                         *
+ *   Lux Renderer is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   Lux Renderer is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *                                                                         *
+ *   This project is based on PBRT ; see http://www.pbrt.org               *
+ *   Lux Renderer website : http://www.luxrender.net                       *
+ ***************************************************************************/
+
+
+// Benchmark suite of the core hot paths. The micro benchmarks time single
+// components on synthetic data, the macro benchmarks render procedurally
+// generated scenes, no external asset is needed. Every benchmark is run
+// with 1 up to N threads and the results can be saved as JSON to compare
+// builds and machines.
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <exception>
+
+#include "lux.h"
+#include "api.h"
+#include "dynload.h"
+#include "paramset.h"
+#include "primitive.h"
+#include "shape.h"
+#include "film.h"
+#include "filter.h"
+#include "contribution.h"
+#include "color.h"
+#include "mipmap.h"
+#include "texturecolor.h"
+#include "mcdistribution.h"
+#include "mc.h"
+#include "randomgen.h"
+#include "textures/blender_noiselib.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace lux;
+namespace po = boost::program_options;
+
+// Multiplier of the amount of work of the micro benchmarks
+static double workloadScale = 1.;
+// Time the macro benchmarks render before and while measuring, in seconds
+static double warmupTime = 2., renderTime = 10.;
+
+static double Seconds(const boost::posix_time::ptime &start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+}
+
+static u_int Scaled(u_int n)
+{
+	return max(1U, static_cast<u_int>(n * workloadScale));
+}
+
+// Rolling terrain used by the ray casting benchmark and the scenes
+static float TerrainHeight(float x, float y)
+{
+	return .3f * sinf(1.7f * x) * cosf(2.3f * y) +
+		.1f * sinf(7.f * x + 3.f * y) + .04f * cosf(19.f * x - 13.f * y);
+}
+
+// Square grid of (res - 1)^2 quads split in triangles over [-size,size]^2
+static void MakeTerrain(u_int res, float size, vector<Point> &P,
+	vector<int> &indices, vector<float> &uv)
+{
+	P.clear();
+	indices.clear();
+	uv.clear();
+	for (u_int y = 0; y < res; ++y) {
+		for (u_int x = 0; x < res; ++x) {
+			const float u = x / (res - 1.f), v = y / (res - 1.f);
+			const float px = size * (2.f * u - 1.f);
+			const float py = size * (2.f * v - 1.f);
+			P.push_back(Point(px, py, TerrainHeight(px, py)));
+			uv.push_back(u);
+			uv.push_back(v);
+		}
+	}
+	for (u_int y = 0; y + 1 < res; ++y) {
+		for (u_int x = 0; x + 1 < res; ++x) {
+			const int i = static_cast<int>(x + y * res);
+			const int r = static_cast<int>(res);
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + r + 1);
+			indices.push_back(i);
+			indices.push_back(i + r + 1);
+			indices.push_back(i + r);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------
+
+class Benchmark {
+public:
+	Benchmark(const string &n, const string &k, const string &u,
+		const string &d) : name(n), kind(k), unit(u), description(d) { }
+	virtual ~Benchmark() { }
+
+	// Builds the data of the benchmark, not timed
+	virtual void Setup() { }
+	virtual void Cleanup() { }
+	/**
+	 * Runs the benchmark once.
+	 * @param threadCount Number of threads to use
+	 * @param operations Returns the number of operations done
+	 * @param seconds Returns the time spent doing them
+	 */
+	virtual void Run(u_int threadCount, double *operations,
+		double *seconds) = 0;
+
+	const string name, kind, unit, description;
+};
+
+/**
+ * Benchmark running the same kernel on every thread, the rate is the total
+ * number of operations done by all threads over the wall clock time.
+ */
+class MicroBenchmark : public Benchmark {
+public:
+	MicroBenchmark(const string &n, const string &u, const string &d) :
+		Benchmark(n, "micro", u, d), checksum(0.) { }
+
+	virtual void Run(u_int threadCount, double *operations,
+		double *seconds) {
+		vector<double> ops(threadCount, 0.), sums(threadCount, 0.);
+		boost::barrier barrier(threadCount + 1);
+		boost::thread_group threads;
+		for (u_int i = 0; i < threadCount; ++i)
+			threads.create_thread(boost::bind(&MicroBenchmark::Thread,
+				this, i, &barrier, &ops[i], &sums[i]));
+		barrier.wait();
+		const boost::posix_time::ptime start(boost::posix_time::microsec_clock::universal_time());
+		threads.join_all();
+		Finish();
+		*seconds = Seconds(start);
+
+		*operations = 0.;
+		for (u_int i = 0; i < threadCount; ++i) {
+			*operations += ops[i];
+			checksum += sums[i];
+		}
+	}
+
+	// Keeps the results of the kernels alive
+	double checksum;
+
+protected:
+	/**
+	 * Work of one thread.
+	 * @param sum Returns a value depending on all the results
+	 * @return The number of operations done
+	 */
+	virtual double Kernel(u_int thread, double *sum) = 0;
+	// Work done once all threads are done, part of the timing
+	virtual void Finish() { }
+
+private:
+	void Thread(u_int thread, boost::barrier *barrier, double *ops,
+		double *sum) {
+		barrier->wait();
+		*ops = Kernel(thread, sum);
+	}
+};
+
+// Closest hit and shadow rays against a QBVH of a large triangle mesh
+class QBVHBenchmark : public MicroBenchmark {
+public:
+	QBVHBenchmark(bool s) : MicroBenchmark(s ? "qbvh_intersectp" :
+		"qbvh_intersect", "rays", s ? "QBVHAccel::IntersectP of shadow rays" :
+		"QBVHAccel::Intersect of random rays"), shadow(s) { }
+
+	virtual void Setup() {
+		vector<Point> P;
+		vector<int> indices;
+		vector<float> uv;
+		MakeTerrain(512, 1.f, P, indices, uv);
+		ParamSet params;
+		params.AddInt("indices", &indices[0], indices.size());
+		params.AddPoint("P", &P[0], P.size());
+		params.AddFloat("uv", &uv[0], uv.size());
+		vector<boost::shared_ptr<Primitive> > prims;
+		prims.push_back(MakeShape("trianglemesh", Transform(), false, params));
+		if (!prims[0])
+			throw std::runtime_error("Unable to create the benchmark mesh");
+		accel = MakeAccelerator("qbvh", prims, ParamSet());
+		if (!accel)
+			throw std::runtime_error("Unable to create the QBVH");
+	}
+	virtual void Cleanup() { accel.reset(); }
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		RandomGenerator rng(thread + 1);
+		const u_int count = Scaled(1U << 20);
+		u_int hits = 0;
+		for (u_int i = 0; i < count; ++i) {
+			const Point o(2.4f * rng.floatValue() - 1.2f,
+				2.4f * rng.floatValue() - 1.2f,
+				rng.floatValue() + .5f);
+			if (shadow) {
+				// Segment from above the terrain to a point near it
+				const float x = 2.f * rng.floatValue() - 1.f;
+				const float y = 2.f * rng.floatValue() - 1.f;
+				const Point p(x, y, TerrainHeight(x, y) + .01f);
+				const Ray ray(o, p - o, 1e-4f, 1.f, 0.f);
+				if (accel->IntersectP(ray))
+					++hits;
+			} else {
+				const float u1 = rng.floatValue();
+				const float u2 = rng.floatValue();
+				Ray ray(o, UniformSampleSphere(u1, u2), 1e-4f,
+					INFINITY, 0.f);
+				Intersection isect;
+				if (accel->Intersect(ray, &isect)) {
+					++hits;
+					*sum += ray.maxt;
+				}
+			}
+		}
+		*sum += hits;
+		return count;
+	}
+
+private:
+	bool shadow;
+	boost::shared_ptr<Aggregate> accel;
+};
+
+// Anisotropic EWA filtered lookups of a mip-mapped RGB texture
+class MIPMapBenchmark : public MicroBenchmark {
+public:
+	MIPMapBenchmark() : MicroBenchmark("mipmap_ewa", "lookups",
+		"MIPMapFastImpl EWA lookups with random footprints"),
+		mipmap(NULL) { }
+	virtual ~MIPMapBenchmark() { delete mipmap; }
+
+	virtual void Setup() {
+		const u_int res = 1024;
+		vector<TextureColor<float, 3> > img(res * res);
+		for (u_int y = 0; y < res; ++y) {
+			for (u_int x = 0; x < res; ++x) {
+				// Checks with some high frequency detail
+				const float check = ((x / 64 + y / 64) & 1) ? .8f : .2f;
+				float c[3] = { check,
+					.5f + .5f * sinf(x * .37f) * cosf(y * .23f),
+					(x ^ y) / static_cast<float>(res) };
+				img[x + y * res] = TextureColor<float, 3>(c);
+			}
+		}
+		mipmap = new MIPMapFastImpl<TextureColor<float, 3> >(MIPMAP_EWA,
+			res, res, &img[0], 8.f, TEXTURE_REPEAT);
+	}
+	virtual void Cleanup() {
+		delete mipmap;
+		mipmap = NULL;
+	}
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		RandomGenerator rng(thread + 1);
+		const u_int count = Scaled(1U << 20);
+		for (u_int i = 0; i < count; ++i) {
+			const float s = rng.floatValue(), t = rng.floatValue();
+			// Footprint from a texel to a few hundred texels wide
+			const float width = 1e-3f * powf(256.f, rng.floatValue());
+			const float aniso = 1.f + 7.f * rng.floatValue();
+			const float phi = 2.f * M_PI * rng.floatValue();
+			const float c = cosf(phi), sn = sinf(phi);
+			*sum += mipmap->LookupFloat(CHANNEL_MEAN, s, t,
+				width * aniso * c, width * aniso * sn,
+				-width * sn, width * c);
+		}
+		return count;
+	}
+
+private:
+	MIPMap *mipmap;
+};
+
+// Continuous sampling of a spiky 1D function, CDF inversion or alias table
+class Distribution1DBenchmark : public MicroBenchmark {
+public:
+	Distribution1DBenchmark(bool a) : MicroBenchmark(a ?
+		"distribution1d_alias" : "distribution1d_cdf", "samples", a ?
+		"Distribution1D::SampleContinuous with an alias table" :
+		"Distribution1D::SampleContinuous with CDF inversion"),
+		alias(a), distrib(NULL) { }
+	virtual ~Distribution1DBenchmark() { delete distrib; }
+
+	virtual void Setup() {
+		const u_int n = 1U << 16;
+		vector<float> f(n);
+		for (u_int i = 0; i < n; ++i) {
+			const float x = (i + .5f) / n;
+			f[i] = .1f + sinf(31.f * x) * sinf(31.f * x) +
+				(i % 997 == 0 ? 1000.f : 0.f);
+		}
+		distrib = new Distribution1D(&f[0], n, alias);
+	}
+	virtual void Cleanup() {
+		delete distrib;
+		distrib = NULL;
+	}
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		RandomGenerator rng(thread + 1);
+		const u_int count = Scaled(1U << 23);
+		for (u_int i = 0; i < count; ++i) {
+			float pdf;
+			*sum += distrib->SampleContinuous(rng.floatValue(), &pdf) +
+				pdf;
+		}
+		return count;
+	}
+
+private:
+	bool alias;
+	Distribution1D *distrib;
+};
+
+// Lat-long HDR sky: horizon gradient, scattered clouds and a small bright sun
+static void MakeEnvironment(u_int width, u_int height, vector<float> &img)
+{
+	img.resize(width * height);
+	const float sunPhi = 1.1f, sunTheta = .6f;
+	for (u_int y = 0; y < height; ++y) {
+		const float theta = M_PI * (y + .5f) / height;
+		const float sky = theta < M_PI * .5f ?
+			.2f + .8f * cosf(theta) : .05f;
+		for (u_int x = 0; x < width; ++x) {
+			const float phi = 2.f * M_PI * (x + .5f) / width;
+			// Hashed cells for the clouds
+			u_int h = (x / 64) * 73856093U ^ (y / 64) * 19349663U;
+			h = (h ^ (h >> 13)) * 0x5bd1e995U;
+			const float cloud = ((h >> 8) & 0xff) / 255.f;
+			const float d2 = (phi - sunPhi) * (phi - sunPhi) +
+				(theta - sunTheta) * (theta - sunTheta);
+			const float sun = 50000.f * expf(-d2 / (2.f * .0004f));
+			// Weight by the solid angle of the pixel as infinitesample does
+			img[x + y * width] = (sky * (.5f + cloud) + sun) * sinf(theta);
+		}
+	}
+}
+
+// Sampling of a synthetic environment map, CDF inversion or alias tables
+class Distribution2DBenchmark : public MicroBenchmark {
+public:
+	Distribution2DBenchmark(bool a) : MicroBenchmark(a ?
+		"distribution2d_alias" : "distribution2d_cdf", "samples", a ?
+		"Distribution2D::SampleContinuous of a 4096x2048 sky with alias tables" :
+		"Distribution2D::SampleContinuous of a 4096x2048 sky with CDF inversion"),
+		alias(a), distrib(NULL) { }
+	virtual ~Distribution2DBenchmark() { delete distrib; }
+
+	virtual void Setup() {
+		const u_int width = 4096, height = 2048;
+		vector<float> img;
+		MakeEnvironment(width, height, img);
+		distrib = new Distribution2D(&img[0], width, height, alias);
+		if (!alias)
+			return;
+		// The pdfs of the samples must be the ones of the CDF
+		// distribution at the sampled points, up to the rounding of
+		// points at cell boundaries
+		const Distribution2D reference(&img[0], width, height, false);
+		RandomGenerator rng(1);
+		const u_int checks = 1U << 20;
+		u_int mismatches = 0;
+		for (u_int i = 0; i < checks; ++i) {
+			const float u0 = rng.floatValue();
+			float uv[2], pdf;
+			distrib->SampleContinuous(u0, rng.floatValue(), uv, &pdf);
+			if (pdf != reference.Pdf(uv[0], uv[1]))
+				++mismatches;
+		}
+		if (mismatches > checks / 1000)
+			std::cerr << name << ": " << mismatches << " pdfs out of " <<
+				checks << " differ from the CDF distribution" <<
+				std::endl;
+	}
+	virtual void Cleanup() {
+		delete distrib;
+		distrib = NULL;
+	}
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		RandomGenerator rng(thread + 1);
+		const u_int count = Scaled(1U << 22);
+		for (u_int i = 0; i < count; ++i) {
+			const float u0 = rng.floatValue();
+			float uv[2], pdf;
+			distrib->SampleContinuous(u0, rng.floatValue(), uv, &pdf);
+			*sum += uv[0] + uv[1] + pdf;
+		}
+		return count;
+	}
+
+private:
+	bool alias;
+	Distribution2D *distrib;
+};
+
+// Contributions added to per thread ContributionBuffers and splatted to a film
+class ContributionBenchmark : public MicroBenchmark {
+public:
+	ContributionBenchmark() : MicroBenchmark("contribution_splat",
+		"contributions", "ContributionBuffer::Add and film splatting"),
+		film(NULL) { }
+	virtual ~ContributionBenchmark() { Cleanup(); }
+
+	virtual void Setup() {
+		const int xres = 1280, yres = 720;
+		const bool no = false;
+		const string filename("luxbench");
+		ParamSet params;
+		params.AddInt("xresolution", &xres);
+		params.AddInt("yresolution", &yres);
+		params.AddBool("write_exr", &no);
+		params.AddBool("write_png", &no);
+		params.AddBool("write_tga", &no);
+		params.AddBool("write_resume_flm", &no);
+		params.AddString("filename", &filename);
+		film = MakeFilm("fleximage", params,
+			MakeFilter("gaussian", ParamSet()));
+		if (!film)
+			throw std::runtime_error("Unable to create the benchmark film");
+		film->RequestBuffer(BUF_TYPE_PER_PIXEL, BUF_FRAMEBUFFER, "");
+		film->CreateBuffers();
+		film->GetSampleExtent(&xStart, &xEnd, &yStart, &yEnd);
+	}
+	virtual void Cleanup() {
+		if (film) {
+			film->contribPool->Delete();
+			delete film;
+			film = NULL;
+		}
+	}
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		RandomGenerator rng(thread + 1);
+		const u_int count = Scaled(1U << 21);
+		ContributionBuffer *buffer = new ContributionBuffer(film->contribPool);
+		for (u_int i = 0; i < count; ++i) {
+			const float x = xStart + (xEnd - xStart) * rng.floatValue();
+			const float y = yStart + (yEnd - yStart) * rng.floatValue();
+			const XYZColor c(rng.floatValue());
+			buffer->Add(Contribution(x, y, c, 1.f, 0.f), 1.f);
+		}
+		buffer->AddSampleCount(count);
+		delete buffer;
+		*sum += count;
+		return count;
+	}
+	// Splats what is left in the buffers, as done at the end of a render
+	virtual void Finish() { film->contribPool->Flush(); }
+
+private:
+	Film *film;
+	int xStart, xEnd, yStart, yEnd;
+};
+
+// Tone mapping of a HDR image with bloom, every thread runs its own pipeline
+class ImagingPipelineBenchmark : public MicroBenchmark {
+public:
+	ImagingPipelineBenchmark() : MicroBenchmark("imaging_pipeline", "pixels",
+		"ApplyImagingPipeline with bloom and Reinhard tone mapping"),
+		xRes(1280), yRes(720) { }
+
+	virtual void Setup() {
+		image.resize(xRes * yRes);
+		for (u_int y = 0; y < yRes; ++y) {
+			for (u_int x = 0; x < xRes; ++x) {
+				// Sky gradient with a few very bright spots
+				const float sky = 1.f - y / static_cast<float>(yRes);
+				const float spot = (x % 211 == 0 && y % 157 == 0) ?
+					1000.f : 0.f;
+				image[x + y * xRes] = XYZColor(.3f + sky + spot);
+			}
+		}
+	}
+	virtual void Cleanup() { image.clear(); }
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		const ColorSystem colorSpace(.64f, .33f, .3f, .6f, .15f, .06f,
+			.3127f, .329f, 1.f);
+		const GREYCStorationParams GREYCParams;
+		const ChiuParams chiuParams;
+		ParamSet toneParams;
+		const float prescale = 1.f, postscale = 1.2f, burn = 6.f;
+		toneParams.AddFloat("prescale", &prescale);
+		toneParams.AddFloat("postscale", &postscale);
+		toneParams.AddFloat("burn", &burn);
+
+		const u_int count = Scaled(8);
+		for (u_int i = 0; i < count; ++i) {
+			vector<XYZColor> pixels(image);
+			bool haveBloomImage = false, haveGlareImage = false;
+			XYZColor *bloomImage = NULL, *glareImage = NULL;
+			ApplyImagingPipeline(pixels, xRes, yRes, GREYCParams,
+				chiuParams, colorSpace, NULL, false,
+				haveBloomImage, bloomImage, true, .07f, .25f,
+				true, .4f, false, .005f,
+				haveGlareImage, glareImage, false, .03f, .03f, 3, .5f,
+				"reinhard", &toneParams, NULL, 0.f);
+			delete[] bloomImage;
+			delete[] glareImage;
+			*sum += pixels[xRes * yRes / 2].c[1];
+		}
+		return static_cast<double>(count) * xRes * yRes;
+	}
+
+private:
+	u_int xRes, yRes;
+	vector<XYZColor> image;
+};
+
+// Blender noise bases, with the SIMD code or with the scalar code only
+static const int noiseBases[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 14 };
+
+class NoiseBenchmark : public MicroBenchmark {
+public:
+	/**
+	 * @param f true for the improved Perlin fBm, the most common procedural
+	 * texture, false for all the noise bases evaluated 4 points at a time
+	 * @param s false to only use the scalar code
+	 */
+	NoiseBenchmark(bool f, bool s) : MicroBenchmark(string(f ? "noise_fbm" :
+		"noise_basis") + (s ? "" : "_scalar"), "evaluations",
+		string(f ? "8 octaves Blender improved Perlin fBm" :
+		"Blender noise bases evaluated 4 points at a time") +
+		(s ? "" : ", scalar code")), fbm(f), simd(s) { }
+
+	virtual void Setup() {
+		if (simd && !blender::BLI_noiseSIMDSupported())
+			std::cerr << name << ": SIMD noise isn't available in this build, the scalar code is measured" << std::endl;
+		if (!simd)
+			return;
+		// The SIMD results must match the scalar ones
+		RandomGenerator rng(1);
+		float diff = 0.f;
+		for (u_int b = 0; b < sizeof(noiseBases) / sizeof(noiseBases[0]); ++b) {
+			for (u_int i = 0; i < 256; ++i) {
+				float x[4], y[4], z[4], scalar[4], vector[4];
+				for (u_int j = 0; j < 4; ++j) {
+					x[j] = 200.f * rng.floatValue() - 100.f;
+					y[j] = 200.f * rng.floatValue() - 100.f;
+					z[j] = 200.f * rng.floatValue() - 100.f;
+				}
+				blender::BLI_setNoiseSIMD(false);
+				blender::BLI_noiseBasis4(x, y, z, scalar, noiseBases[b], true);
+				const float fbmScalar = blender::mg_fBm(x[0], y[0], z[0], .5f, 2.f, 8.f, noiseBases[b]);
+				blender::BLI_setNoiseSIMD(true);
+				blender::BLI_noiseBasis4(x, y, z, vector, noiseBases[b], true);
+				const float fbmVector = blender::mg_fBm(x[0], y[0], z[0], .5f, 2.f, 8.f, noiseBases[b]);
+				for (u_int j = 0; j < 4; ++j)
+					diff = max(diff, fabsf(scalar[j] - vector[j]));
+				diff = max(diff, fabsf(fbmScalar - fbmVector));
+			}
+		}
+		if (diff > 1e-4f)
+			std::cerr << name << ": the SIMD noise differs from the scalar noise by up to " << diff << std::endl;
+	}
+
+	virtual void Run(u_int threadCount, double *operations,
+		double *seconds) {
+		const bool enabled = blender::BLI_noiseSIMD();
+		blender::BLI_setNoiseSIMD(simd);
+		MicroBenchmark::Run(threadCount, operations, seconds);
+		blender::BLI_setNoiseSIMD(enabled);
+	}
+
+protected:
+	virtual double Kernel(u_int thread, double *sum) {
+		RandomGenerator rng(thread + 1);
+		if (fbm) {
+			const u_int count = Scaled(1U << 18);
+			for (u_int i = 0; i < count; ++i) {
+				const float x = 200.f * rng.floatValue() - 100.f;
+				const float y = 200.f * rng.floatValue() - 100.f;
+				const float z = 200.f * rng.floatValue() - 100.f;
+				*sum += blender::mg_fBm(x, y, z, .5f, 2.f, 8.f, 2);
+			}
+			return count;
+		}
+		const u_int count = Scaled(1U << 16);
+		const u_int basisCount = sizeof(noiseBases) / sizeof(noiseBases[0]);
+		for (u_int i = 0; i < count; ++i) {
+			float x[4], y[4], z[4], out[4];
+			for (u_int j = 0; j < 4; ++j) {
+				x[j] = 200.f * rng.floatValue() - 100.f;
+				y[j] = 200.f * rng.floatValue() - 100.f;
+				z[j] = 200.f * rng.floatValue() - 100.f;
+			}
+			blender::BLI_noiseBasis4(x, y, z, out, noiseBases[i % basisCount], true);
+			*sum += out[0] + out[1] + out[2] + out[3];
+		}
+		return 4. * count;
+	}
+
+private:
+	bool fbm, simd;
+};
+
+/**
+ * Renders a procedurally generated scene through the API and measures the
+ * throughput of the renderer once it is warmed up. The scene is written to
+ * a temporary file and parsed like any other scene.
+ */
+class RenderBenchmark : public Benchmark {
+public:
+	/**
+	 * @param options Renderer, sampler and integrator declarations
+	 * @param p true to measure photons instead of camera samples
+	 */
+	RenderBenchmark(const string &n, const string &d, const string &o,
+		bool p) : Benchmark(n, "macro", p ? "photons" : "samples", d),
+		options(o), photons(p) { }
+
+	virtual void Setup() {
+		sceneFile = boost::filesystem::temp_directory_path() /
+			boost::filesystem::unique_path("luxbench-%%%%-%%%%.lxs");
+		std::ofstream os(sceneFile.string().c_str());
+		WriteScene(os);
+		if (!os.good())
+			throw std::runtime_error("Unable to write " + sceneFile.string());
+	}
+	virtual void Cleanup() {
+		boost::system::error_code error;
+		boost::filesystem::remove(sceneFile, error);
+	}
+
+	virtual void Run(u_int threadCount, double *operations,
+		double *seconds) {
+		parseError = false;
+		boost::thread engine(boost::bind(&RenderBenchmark::Parse, this));
+		while (!luxStatistics("sceneIsReady") && !parseError)
+			boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+		if (parseError) {
+			engine.join();
+			luxCleanup();
+			throw std::runtime_error("Unable to render the " + name +
+				" scene");
+		}
+		// The renderer starts its first thread after the scene is ready
+		while (luxGetIntAttribute("renderer_statistics", "threadCount") < 1)
+			boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+		for (u_int i = 1; i < threadCount; ++i)
+			luxAddThread();
+
+		boost::this_thread::sleep(boost::posix_time::milliseconds(static_cast<int>(warmupTime * 1000.)));
+		const double start = Count();
+		const boost::posix_time::ptime startTime(boost::posix_time::microsec_clock::universal_time());
+		boost::this_thread::sleep(boost::posix_time::milliseconds(static_cast<int>(renderTime * 1000.)));
+		*operations = Count() - start;
+		*seconds = Seconds(startTime);
+
+		luxExit();
+		luxWait();
+		engine.join();
+		luxCleanup();
+	}
+
+private:
+	void Parse() {
+		if (!luxParse(sceneFile.string().c_str()))
+			parseError = true;
+	}
+	double Count() const {
+		if (photons)
+			return luxGetDoubleAttribute("renderer_statistics",
+				"photonCount");
+		return luxGetDoubleAttribute("renderer_statistics",
+			"samplesPerPixel") * xResolution * yResolution;
+	}
+	void WriteScene(std::ostream &os) const {
+		os << "Film \"fleximage\" \"integer xresolution\" [" <<
+			xResolution << "] \"integer yresolution\" [" <<
+			yResolution << "]" << std::endl <<
+			"\t\"bool write_exr\" [\"false\"] \"bool write_png\" [\"false\"] \"bool write_tga\" [\"false\"]" << std::endl <<
+			"\t\"bool write_resume_flm\" [\"false\"] \"integer writeinterval\" [100000] \"integer displayinterval\" [100000]" << std::endl <<
+			"\t\"string filename\" [\"luxbench\"]" << std::endl;
+		os << "LookAt 0 -2.6 1.1 0 0 0.1 0 0 1" << std::endl <<
+			"Camera \"perspective\" \"float fov\" [50]" << std::endl <<
+			options << std::endl;
+		os << "WorldBegin" << std::endl;
+		os << "LightSource \"infinite\" \"color L\" [0.1 0.12 0.16]" << std::endl;
+		os << "AttributeBegin" << std::endl <<
+			"AreaLightSource \"area\" \"color L\" [1 0.95 0.9] \"float gain\" [8]" << std::endl <<
+			"Shape \"trianglemesh\" \"integer indices\" [0 1 2 0 2 3]" << std::endl <<
+			"\t\"point P\" [-0.4 -0.4 1.8 -0.4 0.4 1.8 0.4 0.4 1.8 0.4 -0.4 1.8]" << std::endl <<
+			"AttributeEnd" << std::endl;
+
+		// Ground with a textured roughness
+		os << "Texture \"checks\" \"float\" \"checkerboard\" \"float tex1\" [0.02] \"float tex2\" [0.3]" << std::endl <<
+			"\t\"float uscale\" [24] \"float vscale\" [24]" << std::endl;
+		os << "AttributeBegin" << std::endl <<
+			"Material \"glossy\" \"color Kd\" [0.5 0.45 0.4] \"color Ks\" [0.04 0.04 0.04]" << std::endl <<
+			"\t\"texture uroughness\" [\"checks\"] \"texture vroughness\" [\"checks\"]" << std::endl;
+		vector<Point> P;
+		vector<int> indices;
+		vector<float> uv;
+		MakeTerrain(128, 1.5f, P, indices, uv);
+		os << "Shape \"trianglemesh\" \"integer indices\" [";
+		for (u_int i = 0; i < indices.size(); ++i)
+			os << (i % 24 ? " " : "\n") << indices[i];
+		os << "]" << std::endl << "\t\"point P\" [";
+		for (u_int i = 0; i < P.size(); ++i)
+			os << (i % 8 ? " " : "\n") << P[i].x << " " << P[i].y <<
+				" " << P[i].z;
+		os << "]" << std::endl << "\t\"float uv\" [";
+		for (u_int i = 0; i < uv.size(); ++i)
+			os << (i % 16 ? " " : "\n") << uv[i];
+		os << "]" << std::endl << "AttributeEnd" << std::endl;
+
+		// Spheres with the common materials
+		static const char *materials[] = {
+			"\"matte\" \"color Kd\" [0.7 0.2 0.2]",
+			"\"glossy\" \"color Kd\" [0.1 0.3 0.6] \"color Ks\" [0.1 0.1 0.1] \"float uroughness\" [0.05] \"float vroughness\" [0.05]",
+			"\"glass\" \"color Kr\" [1 1 1] \"color Kt\" [1 1 1] \"float index\" [1.5]",
+			"\"metal\" \"string name\" [\"gold\"] \"float uroughness\" [0.02] \"float vroughness\" [0.02]"
+		};
+		for (u_int y = 0; y < 4; ++y) {
+			for (u_int x = 0; x < 4; ++x) {
+				const float px = .6f * x - .9f, py = .6f * y - .9f;
+				const float radius = .12f + .03f * ((x + y) % 3);
+				os << "AttributeBegin" << std::endl <<
+					"Translate " << px << " " << py << " " <<
+					TerrainHeight(px, py) + radius << std::endl <<
+					"Material " << materials[(x + y) % 4] << std::endl <<
+					"Shape \"sphere\" \"float radius\" [" << radius <<
+					"]" << std::endl << "AttributeEnd" << std::endl;
+			}
+		}
+		os << "WorldEnd" << std::endl;
+	}
+
+	static const u_int xResolution = 480, yResolution = 270;
+
+	string options;
+	bool photons;
+	boost::filesystem::path sceneFile;
+	volatile bool parseError;
+};
+
+//------------------------------------------------------------------------------
+// Results
+//------------------------------------------------------------------------------
+
+struct BenchmarkResult {
+	string name, kind, unit;
+	u_int threads;
+	double operations, seconds, rate, speedup;
+};
+
+static string JSONString(const string &s)
+{
+	string r("\"");
+	for (u_int i = 0; i < s.size(); ++i) {
+		if (s[i] == '"' || s[i] == '\\')
+			r += '\\';
+		r += s[i];
+	}
+	return r + "\"";
+}
+
+static void WriteJSON(std::ostream &os, const vector<BenchmarkResult> &results)
+{
+	os << "{" << std::endl;
+	os << "  \"version\": " << JSONString(luxVersion()) << "," << std::endl;
+	os << "  \"hardwareConcurrency\": " <<
+		boost::thread::hardware_concurrency() << "," << std::endl;
+	os << "  \"results\": [";
+	for (u_int i = 0; i < results.size(); ++i) {
+		const BenchmarkResult &r(results[i]);
+		os << (i ? "," : "") << std::endl << "    { " <<
+			"\"name\": " << JSONString(r.name) <<
+			", \"kind\": " << JSONString(r.kind) <<
+			", \"unit\": " << JSONString(r.unit) <<
+			", \"threads\": " << r.threads <<
+			", \"operations\": " << std::setprecision(12) << r.operations <<
+			", \"seconds\": " << std::setprecision(6) << r.seconds <<
+			", \"rate\": " << r.rate <<
+			", \"speedup\": " << r.speedup <<
+			", \"efficiency\": " << r.speedup / r.threads << " }";
+	}
+	os << std::endl << "  ]" << std::endl << "}" << std::endl;
+}
+
+int main(int ac, char *av[])
+{
+	try {
+		u_int maxThreads, repeat;
+		bool noScaling;
+		string jsonFile;
+		vector<string> selected;
+		po::options_description desc("Usage: luxbench [options]");
+		desc.add_options()
+			("help,h", "Display this help and exit")
+			("list,l", "List the benchmarks and exit")
+			("benchmark,b", po::value<vector<string> >(&selected)->composing(), "Run only this benchmark, can be repeated, \"micro\" or \"macro\" select a kind")
+			("threads,t", po::value<u_int>(&maxThreads)->default_value(boost::thread::hardware_concurrency()), "Largest number of threads")
+			("noscaling,n", po::bool_switch(&noScaling), "Only run with the largest number of threads instead of 1, 2, 4... threads")
+			("repeat,r", po::value<u_int>(&repeat)->default_value(3), "Number of runs of the micro benchmarks, the best one is kept")
+			("workload,w", po::value<double>(&workloadScale)->default_value(1.), "Multiplier of the work of the micro benchmarks")
+			("warmup", po::value<double>(&warmupTime)->default_value(2.), "Rendering time before measuring the macro benchmarks, in seconds")
+			("time,s", po::value<double>(&renderTime)->default_value(10.), "Measured rendering time of the macro benchmarks, in seconds")
+			("json,j", po::value<string>(&jsonFile), "Write the results as JSON to this file, - for the standard output")
+			("verbose,v", "Show the informational messages of the renderer")
+			;
+		po::variables_map vm;
+		po::store(po::parse_command_line(ac, av, desc), vm);
+		po::notify(vm);
+		if (vm.count("help")) {
+			std::cout << desc << std::endl;
+			return 0;
+		}
+		maxThreads = max(maxThreads, 1U);
+		repeat = max(repeat, 1U);
+
+		boost::ptr_vector<Benchmark> benchmarks;
+		benchmarks.push_back(new QBVHBenchmark(false));
+		benchmarks.push_back(new QBVHBenchmark(true));
+		benchmarks.push_back(new MIPMapBenchmark());
+		benchmarks.push_back(new Distribution1DBenchmark(false));
+		benchmarks.push_back(new Distribution1DBenchmark(true));
+		benchmarks.push_back(new Distribution2DBenchmark(false));
+		benchmarks.push_back(new Distribution2DBenchmark(true));
+		benchmarks.push_back(new ContributionBenchmark());
+		benchmarks.push_back(new ImagingPipelineBenchmark());
+		benchmarks.push_back(new NoiseBenchmark(false, false));
+		benchmarks.push_back(new NoiseBenchmark(false, true));
+		benchmarks.push_back(new NoiseBenchmark(true, false));
+		benchmarks.push_back(new NoiseBenchmark(true, true));
+		benchmarks.push_back(new RenderBenchmark("render_path",
+			"Path tracing of the procedural scene",
+			"Renderer \"sampler\"\n"
+			"Sampler \"lowdiscrepancy\" \"string pixelsampler\" [\"hilbert\"] \"integer pixelsamples\" [4]\n"
+			"SurfaceIntegrator \"path\" \"integer maxdepth\" [8]", false));
+		benchmarks.push_back(new RenderBenchmark("render_bidir",
+			"Bidirectional path tracing of the procedural scene with Metropolis sampling",
+			"Renderer \"sampler\"\n"
+			"Sampler \"metropolis\"\n"
+			"SurfaceIntegrator \"bidirectional\" \"integer eyedepth\" [8] \"integer lightdepth\" [8]", false));
+		benchmarks.push_back(new RenderBenchmark("render_sppm_hashgrid",
+			"SPPM of the procedural scene with the hash grid lookup",
+			"Renderer \"sppm\"\n"
+			"SurfaceIntegrator \"sppm\" \"string lookupaccel\" [\"hashgrid\"] \"integer photonperpass\" [200000]", true));
+		benchmarks.push_back(new RenderBenchmark("render_sppm_parallelhashgrid",
+			"SPPM of the procedural scene with the parallel hash grid lookup",
+			"Renderer \"sppm\"\n"
+			"SurfaceIntegrator \"sppm\" \"string lookupaccel\" [\"parallelhashgrid\"] \"integer photonperpass\" [200000]", true));
+
+		if (vm.count("list")) {
+			for (u_int i = 0; i < benchmarks.size(); ++i)
+				std::cout << std::left << std::setw(30) <<
+					benchmarks[i].name << std::setw(7) <<
+					benchmarks[i].kind << benchmarks[i].description <<
+					std::endl;
+			return 0;
+		}
+
+		vector<u_int> threadCounts;
+		if (!noScaling) {
+			for (u_int t = 1; t < maxThreads; t *= 2)
+				threadCounts.push_back(t);
+		}
+		threadCounts.push_back(maxThreads);
+
+		luxInit();
+		if (!vm.count("verbose"))
+			luxErrorFilter(LUX_WARNING);
+
+		const bool quiet = jsonFile == "-";
+		if (!quiet)
+			std::cout << std::left << std::setw(30) << "benchmark" <<
+				std::right << std::setw(8) << "threads" <<
+				std::setw(16) << "rate" << "  " << std::left <<
+				std::setw(16) << "unit" << std::right <<
+				std::setw(10) << "speedup" << std::setw(12) <<
+				"efficiency" << std::endl;
+
+		vector<BenchmarkResult> results;
+		for (u_int b = 0; b < benchmarks.size(); ++b) {
+			Benchmark &bench(benchmarks[b]);
+			if (!selected.empty() && std::find(selected.begin(),
+				selected.end(), bench.name) == selected.end() &&
+				std::find(selected.begin(), selected.end(),
+				bench.kind) == selected.end())
+				continue;
+
+			bench.Setup();
+			const u_int runs = bench.kind == "micro" ? repeat : 1;
+			double baseRate = 0.;
+			for (u_int t = 0; t < threadCounts.size(); ++t) {
+				BenchmarkResult result;
+				result.name = bench.name;
+				result.kind = bench.kind;
+				result.unit = bench.unit;
+				result.threads = threadCounts[t];
+				result.rate = 0.;
+				for (u_int r = 0; r < runs; ++r) {
+					double operations, seconds;
+					bench.Run(threadCounts[t], &operations, &seconds);
+					const double rate = seconds > 0. ?
+						operations / seconds : 0.;
+					if (r == 0 || rate > result.rate) {
+						result.operations = operations;
+						result.seconds = seconds;
+						result.rate = rate;
+					}
+				}
+				if (t == 0)
+					baseRate = result.rate / result.threads;
+				result.speedup = baseRate > 0. ?
+					result.rate / baseRate : 0.;
+				results.push_back(result);
+
+				if (!quiet)
+					std::cout << std::left << std::setw(30) <<
+						result.name << std::right <<
+						std::setw(8) << result.threads <<
+						std::fixed << std::setprecision(0) <<
+						std::setw(16) << result.rate << "  " <<
+						std::left << std::setw(16) <<
+						(result.unit + "/s") << std::right <<
+						std::setprecision(2) <<
+						std::setw(10) << result.speedup <<
+						std::setw(12) <<
+						result.speedup / result.threads <<
+						std::endl;
+			}
+			bench.Cleanup();
+		}
+
+		if (quiet)
+			WriteJSON(std::cout, results);
+		else if (!jsonFile.empty()) {
+			std::ofstream os(jsonFile.c_str());
+			WriteJSON(os, results);
+			if (!os.good()) {
+				std::cerr << "Unable to write " << jsonFile << std::endl;
+				return 1;
+			}
+		}
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -59,6 +59,12 @@ int main(int ac, char *av[]) {
 				("help,h", "Produce help message")
 				("debug,d", "Enable debug mode")
 				("output,o", po::value< std::string >()->default_value("merged.flm"), "Output file")
+				("chunked,c", "Write the output in the chunked random access FLM format")
+				("compression,z", po::value< std::string >()->default_value("gzip"), "Output FLM compression (gzip, lz or lzshuffle)")
+				("exr,e", po::value< std::string >(), "Also write the merged film as an untonemapped EXR file")
+				("parallel,p", "Merge all the input files at once with a parallel tile-wise reduction")
+				("threads,t", po::value < unsigned int >()->default_value(0), "Number of merging threads (0 for all cores)")
+				("memory,m", po::value < unsigned int >()->default_value(0), "Memory budget in MB for decoding non-chunked films in parallel mode (0 for no limit)")
 				("verbose,V", "Increase output verbosity (show DEBUG messages)")
 				("quiet,q", "Reduce output verbosity (hide INFO messages)") // (give once for WARNING only, twice for ERROR only)")
 				;
@@ -109,7 +115,11 @@ int main(int ac, char *av[]) {
 		string outputFileName = vm["output"].as<string>();
 
 		boost::scoped_ptr<FlexImageFilm> film;
-		int mergedCount = 0;
+		u_int mergedCount = 0;
+		u_int skippedCount = 0;
+		const bool parallelMerge = vm.count("parallel") > 0;
+		vector<string> pendingFiles;
+		const unsigned int threadCount = vm["threads"].as<unsigned int>();
 
 		luxInit();
 
@@ -120,6 +130,7 @@ int main(int ac, char *av[]) {
 
 				if (!boost::filesystem::exists(fullPath) && v[i] != "-") {
 					LOG(LUX_SEVERE,LUX_NOFILE) << "Unable to open file '" << fullPath.string() << "'";
+					skippedCount++;
 					continue;
 				}
 
@@ -130,31 +141,34 @@ int main(int ac, char *av[]) {
 					film.reset((FlexImageFilm*)FlexImageFilm::CreateFilmFromFLM(flmFileName));
 					if (!film) {
 						LOG( LUX_SEVERE,LUX_NOFILE) << "Error reading FLM file '" << flmFileName << "'";
+						skippedCount++;
 						continue;
 					}
+				} else if (parallelMerge) {
+					// merged all at once below
+					pendingFiles.push_back(flmFileName);
+					continue;
 				} else {
-					// additional flm file
-					std::ifstream ifs(flmFileName.c_str(), std::ios_base::in | std::ios_base::binary);
-
-					if(ifs.good()) {
-						// read the data
-						LOG( LUX_INFO,LUX_NOERROR)<< "Merging FLM file " << flmFileName;
-						float newSamples = film->MergeFilmFromStream(ifs);
-						if (newSamples <= 0) {
-							LOG( LUX_SEVERE,LUX_NOFILE) << "Error reading FLM file '" << flmFileName << "'";
-							ifs.close();
-							continue;
-						} else {
-							LOG( LUX_DEBUG,LUX_NOERROR) << "Merged " << newSamples << " samples from FLM file";
-						}
+					// additional flm file, merged with the same tile and
+					// row reductions as the parallel mode
+					LOG( LUX_INFO,LUX_NOERROR)<< "Merging FLM file " << flmFileName;
+					u_int skipped = 0;
+					if (film->MergeFilmsFromFiles(vector<string>(1, flmFileName), threadCount, 0, &skipped) == 0) {
+						skippedCount += skipped;
+						continue;
 					}
-
-					ifs.close();
 				}
 
 				mergedCount++;
 			}
 
+			if (film && pendingFiles.size() > 0) {
+				const size_t memoryBudget = static_cast<size_t>(vm["memory"].as<unsigned int>()) * 1024 * 1024;
+				u_int skipped = 0;
+				mergedCount += film->MergeFilmsFromFiles(pendingFiles, threadCount, memoryBudget, &skipped);
+				skippedCount += skipped;
+			}
+
 			luxCleanup();
 
 			if (!film) {
@@ -162,9 +176,19 @@ int main(int ac, char *av[]) {
 				return 2;
 			}
 
+			if (skippedCount > 0)
+				LOG( LUX_WARNING,LUX_NOERROR) << "Skipped " << skippedCount << " unreadable or damaged FLM files";
 			LOG( LUX_INFO,LUX_NOERROR) << "Merged " << mergedCount << " FLM files, writing merged FLM to " << outputFileName;
 
+			(*film)["flmCompression"] = vm["compression"].as<string>();
+			(*film)["writeFlmChunked"] = vm.count("chunked") > 0;
 			film->WriteFilmToFile(outputFileName);
+
+			if (vm.count("exr")) {
+				const string exrFileName = vm["exr"].as<string>();
+				LOG( LUX_INFO,LUX_NOERROR) << "Writing merged EXR to " << exrFileName;
+				film->SaveEXR(exrFileName, false, false, 1, false);
+			}
 		} else {
 			LOG( LUX_ERROR,LUX_SYSTEM) << "luxmerger: no input file";
 		}
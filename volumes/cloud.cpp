@@ -50,10 +50,11 @@ Region * Cloud::CreateVolumeRegion(const Transform &volume2world,
 	float variability = params.FindOneFloat("variability", 0.9f);
 	float baseflatness = params.FindOneFloat("baseflatness", 0.8f);
 	float spheresize = params.FindOneFloat("spheresize", 0.15f);
-	return new VolumeRegion<CloudVolume>(volume2world, BBox(p0, p1),
-		CloudVolume(sigma_a, sigma_s, g, Le, BBox(p0, p1), radius,
+	CloudVolume cloud(sigma_a, sigma_s, g, Le, BBox(p0, p1), radius,
 		volume2world, noiseScale, turbulence, sharpness, variability,
-		baseflatness, octaves, omega, offSet, numSpheres, spheresize));
+		baseflatness, octaves, omega, offSet, numSpheres, spheresize);
+	return new VolumeRegion<CloudVolume>(volume2world, BBox(p0, p1),
+		cloud);
 }
 
 static DynamicLoader::RegisterVolumeRegion<Cloud> r("cloud");
@@ -40,9 +40,12 @@ Region * ExponentialDensity::CreateVolumeRegion(const Transform &volume2world,
 	float a = params.FindOneFloat("a", 1.);
 	float b = params.FindOneFloat("b", 1.);
 	Vector up = params.FindOneVector("updir", Vector(0,1,0));
+	ExponentialDensity density(sigma_a, sigma_s, g, Le, BBox(p0, p1),
+		volume2world, a, b, up);
+	density.SetMajorantGrid(volume2world, BBox(p0, p1),
+		max(params.FindOneInt("majorantresolution", 16), 0));
 	return new VolumeRegion<ExponentialDensity>(volume2world, BBox(p0, p1),
-		ExponentialDensity(sigma_a, sigma_s, g, Le, BBox(p0, p1),
-		volume2world, a, b, up));
+		density);
 }
 
 static DynamicLoader::RegisterVolumeRegion<ExponentialDensity> r("exponential");
@@ -42,6 +42,15 @@ public:
 		const float height = Dot(Pobj - base, dir);
 		return a * expf(-b * height);
 	}
+	virtual float MaxDensity(const Transform &v2w, const BBox &bb) const {
+		// The density is monotonic along dir so it peaks at a corner
+		float m = 0.f;
+		for (u_int i = 0; i < 8; ++i)
+			m = max(m, Density(v2w * Point(i & 1 ? bb.pMax.x : bb.pMin.x,
+				i & 2 ? bb.pMax.y : bb.pMin.y,
+				i & 4 ? bb.pMax.z : bb.pMin.z)));
+		return m;
+	}
 	
 	static Region *CreateVolumeRegion(const Transform &volume2world,
 		const ParamSet &params);
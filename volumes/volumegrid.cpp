@@ -31,15 +31,95 @@ using std::memset;
 
 using namespace lux;
 
+// BrickGrid Method Definitions
+BrickGrid::BrickGrid(int x, int y, int z, const float *d, bool quantize) :
+	nx(x), ny(y), nz(z), storedBricks(0)
+{
+	const int brickSize = 1 << BRICK_LOG;
+	bnx = (nx + brickSize - 1) >> BRICK_LOG;
+	bny = (ny + brickSize - 1) >> BRICK_LOG;
+	bnz = (nz + brickSize - 1) >> BRICK_LOG;
+	const u_int count = bnx * bny * bnz;
+	brickIndex.resize(count, static_cast<u_int>(CONSTANT_BRICK));
+	brickMin.resize(count, 0.f);
+	brickMax.resize(count, 0.f);
+	brickScale.resize(count, 0.f);
+
+	vector<float> brick(BRICK_VOXELS);
+	for (int bz = 0; bz < bnz; ++bz) {
+		for (int by = 0; by < bny; ++by) {
+			for (int bx = 0; bx < bnx; ++bx) {
+				// Gather the brick, the voxels past the grid
+				// repeat its border
+				float vMin = INFINITY, vMax = -INFINITY;
+				for (u_int i = 0; i < BRICK_VOXELS; ++i) {
+					const int vx = min((bx << BRICK_LOG) + static_cast<int>(i & BRICK_MASK), nx - 1);
+					const int vy = min((by << BRICK_LOG) + static_cast<int>((i >> BRICK_LOG) & BRICK_MASK), ny - 1);
+					const int vz = min((bz << BRICK_LOG) + static_cast<int>(i >> (2 * BRICK_LOG)), nz - 1);
+					brick[i] = d[(vz * ny + vy) * nx + vx];
+					vMin = min(vMin, brick[i]);
+					vMax = max(vMax, brick[i]);
+				}
+
+				const u_int b = Brick(bx, by, bz);
+				brickMin[b] = vMin;
+				brickMax[b] = vMax;
+				// Empty and uniform bricks are not stored
+				if (vMin == vMax)
+					continue;
+
+				brickIndex[b] = storedBricks++;
+				if (!quantize) {
+					values.insert(values.end(), brick.begin(),
+						brick.end());
+					continue;
+				}
+				brickScale[b] = (vMax - vMin) / 65535.f;
+				const float invScale = 65535.f / (vMax - vMin);
+				for (u_int i = 0; i < BRICK_VOXELS; ++i)
+					quantized.push_back(static_cast<u_short>(min(Round2UInt((brick[i] - vMin) * invScale), 65535U)));
+			}
+		}
+	}
+}
+
+float BrickGrid::MaxVoxel(int x0, int y0, int z0, int x1, int y1, int z1) const
+{
+	x0 = Clamp(x0, 0, nx - 1) >> BRICK_LOG;
+	y0 = Clamp(y0, 0, ny - 1) >> BRICK_LOG;
+	z0 = Clamp(z0, 0, nz - 1) >> BRICK_LOG;
+	x1 = Clamp(x1, 0, nx - 1) >> BRICK_LOG;
+	y1 = Clamp(y1, 0, ny - 1) >> BRICK_LOG;
+	z1 = Clamp(z1, 0, nz - 1) >> BRICK_LOG;
+	float m = -INFINITY;
+	for (int bz = z0; bz <= z1; ++bz) {
+		for (int by = y0; by <= y1; ++by) {
+			for (int bx = x0; bx <= x1; ++bx)
+				m = max(m, brickMax[Brick(bx, by, bz)]);
+		}
+	}
+	return m;
+}
+
+size_t BrickGrid::MemorySize() const
+{
+	return brickIndex.size() * (sizeof(u_int) + 3 * sizeof(float)) +
+		values.size() * sizeof(float) +
+		quantized.size() * sizeof(u_short);
+}
+
 // VolumeGrid Method Definitions
 VolumeGrid::VolumeGrid(const RGBColor &sa, const RGBColor &ss, float gg,
 	const RGBColor &emit, const BBox &e, const Transform &v2w,
-	int x, int y, int z, const float *d) :
+	int x, int y, int z, const float *d, bool quantize) :
 	DensityVolume<RGBVolume>("VolumeGrid-"  + boost::lexical_cast<string>(this),
 		RGBVolume(sa, ss, emit, gg)),
+	density(new BrickGrid(x, y, z, d, quantize)),
 	nx(x), ny(y), nz(z), extent(e), VolumeToWorld(v2w)
 {
-	density.assign(d, d+(nx*ny*nz));
+	LOG(LUX_DEBUG, LUX_NOERROR) << "VolumeGrid stores " <<
+		density->StoredBrickCount() << "/" << density->BrickCount() <<
+		" bricks in " << density->MemorySize() / 1024 << " Kbytes";
 }
 float VolumeGrid::Density(const Point &p) const
 {
@@ -66,6 +146,24 @@ float VolumeGrid::Density(const Point &p) const
 	float d1 = Lerp(dy, d01, d11);
 	return Lerp(dz, d0, d1);
 }
+float VolumeGrid::MaxDensity(const Transform &v2w, const BBox &b) const
+{
+	// The interpolated density is bounded by the voxels around the box
+	const int x0 = Floor2Int((b.pMin.x - extent.pMin.x) /
+		(extent.pMax.x - extent.pMin.x) * nx - .5f);
+	const int y0 = Floor2Int((b.pMin.y - extent.pMin.y) /
+		(extent.pMax.y - extent.pMin.y) * ny - .5f);
+	const int z0 = Floor2Int((b.pMin.z - extent.pMin.z) /
+		(extent.pMax.z - extent.pMin.z) * nz - .5f);
+	const int x1 = Floor2Int((b.pMax.x - extent.pMin.x) /
+		(extent.pMax.x - extent.pMin.x) * nx - .5f) + 1;
+	const int y1 = Floor2Int((b.pMax.y - extent.pMin.y) /
+		(extent.pMax.y - extent.pMin.y) * ny - .5f) + 1;
+	const int z1 = Floor2Int((b.pMax.z - extent.pMin.z) /
+		(extent.pMax.z - extent.pMin.z) * nz - .5f) + 1;
+	// Only the bricks are bounded, the bound is a bit loose
+	return max(density->MaxVoxel(x0, y0, z0, x1, y1, z1), 0.f);
+}
 Region * VolumeGrid::CreateVolumeRegion(const Transform &volume2world,
 		const ParamSet &params) {
 	// Initialize common volume region parameters
@@ -90,9 +188,15 @@ Region * VolumeGrid::CreateVolumeRegion(const Transform &volume2world,
 		LOG(LUX_ERROR,LUX_CONSISTENCY)<<"VolumeGrid has "<<nitems<<" density values but nx*ny*nz = "<<nx*ny*nz;
 		return NULL;
 	}
-	return new VolumeRegion<VolumeGrid>(volume2world, BBox(p0, p1),
-		VolumeGrid(sigma_a, sigma_s, g, Le, BBox(p0, p1),
-		volume2world, nx, ny, nz, data));
+	const bool quantize = params.FindOneBool("quantize", false);
+	VolumeGrid grid(sigma_a, sigma_s, g, Le, BBox(p0, p1), volume2world,
+		nx, ny, nz, data, quantize);
+	// By default one majorant per brick, to skip the empty ones
+	const int bricks = (max(nx, max(ny, nz)) + BrickGrid::BRICK_MASK) >>
+		BrickGrid::BRICK_LOG;
+	grid.SetMajorantGrid(volume2world, BBox(p0, p1),
+		max(params.FindOneInt("majorantresolution", max(bricks, 16)), 0));
+	return new VolumeRegion<VolumeGrid>(volume2world, BBox(p0, p1), grid);
 }
 
 static DynamicLoader::RegisterVolumeRegion<VolumeGrid> r("volumegrid");
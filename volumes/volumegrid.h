@@ -26,26 +26,78 @@
 namespace lux
 {
 
+// BrickGrid Declarations
+// Sparse two level storage of a voxel grid. The grid is split in bricks of
+// 8x8x8 voxels, bricks holding a single value are only stored as that value
+// and the others hold their voxels as floats, or as 16 bit values scaled to
+// the range of the brick if quantized.
+class BrickGrid {
+public:
+	BrickGrid(int nx, int ny, int nz, const float *d, bool quantize);
+	// x, y and z must be inside the grid
+	float Voxel(int x, int y, int z) const {
+		const u_int brick = Brick(x >> BRICK_LOG, y >> BRICK_LOG,
+			z >> BRICK_LOG);
+		const u_int index = brickIndex[brick];
+		if (index == CONSTANT_BRICK)
+			return brickMin[brick];
+		const u_int offset = index * BRICK_VOXELS +
+			((((z & BRICK_MASK) << BRICK_LOG) + (y & BRICK_MASK)) <<
+			BRICK_LOG) + (x & BRICK_MASK);
+		if (quantized.empty())
+			return values[offset];
+		return brickMin[brick] + quantized[offset] * brickScale[brick];
+	}
+	// Maximum of the voxels of the bricks holding the voxels of a box,
+	// the bounds are clamped to the grid
+	float MaxVoxel(int x0, int y0, int z0, int x1, int y1, int z1) const;
+	// Number of bricks holding more than one value
+	u_int StoredBrickCount() const { return storedBricks; }
+	u_int BrickCount() const { return brickIndex.size(); }
+	size_t MemorySize() const;
+
+	static const int BRICK_LOG = 3;
+	static const int BRICK_MASK = (1 << BRICK_LOG) - 1;
+	static const u_int BRICK_VOXELS = 1U << (3 * BRICK_LOG);
+private:
+	static const u_int CONSTANT_BRICK = 0xffffffffU;
+	u_int Brick(int bx, int by, int bz) const {
+		return (bz * bny + by) * bnx + bx;
+	}
+
+	const int nx, ny, nz;
+	int bnx, bny, bnz;
+	u_int storedBricks;
+	// Per brick data, the value of constant bricks is brickMin
+	vector<u_int> brickIndex;
+	vector<float> brickMin, brickMax, brickScale;
+	// Voxels of the stored bricks, only one of them is used
+	vector<float> values;
+	vector<u_short> quantized;
+};
+
 // VolumeGrid Declarations
 class VolumeGrid : public DensityVolume<RGBVolume> {
 public:
 	// VolumeGrid Public Methods
 	VolumeGrid(const RGBColor &sa, const RGBColor &ss, float gg,
  		const RGBColor &emit, const BBox &e, const Transform &v2w,
-		int nx, int ny, int nz, const float *d);
+		int nx, int ny, int nz, const float *d, bool quantize = false);
 	virtual ~VolumeGrid() { }
 	virtual float Density(const Point &Pobj) const;
+	virtual float MaxDensity(const Transform &v2w, const BBox &b) const;
 	float D(int x, int y, int z) const {
 		x = Clamp(x, 0, nx - 1);
 		y = Clamp(y, 0, ny - 1);
 		z = Clamp(z, 0, nz - 1);
-		return density[z * nx * ny + y * nx + x];
+		return density->Voxel(x, y, z);
 	}
 	
 	static Region *CreateVolumeRegion(const Transform &volume2world, const ParamSet &params);
 private:
 	// VolumeGrid Private Data
-	std::vector<float> density;
+	// Shared by the copies of the volume
+	boost::shared_ptr<const BrickGrid> density;
 	const int nx, ny, nz;
 	const BBox extent;
 	Transform VolumeToWorld;